@@ -0,0 +1,324 @@
+#include "ahci.h"
+#include "pci.h"
+#include "blk.h"
+#include "irq.h"
+#include "printk.h"
+#include "lib.h"
+#include "tsc.h"
+
+#define AHCI_SLOTS          32
+#define AHCI_MAX_SECTORS    2048        /* 1 MB per command */
+
+/* ATA commands */
+#define ATA_CMD_IDENTIFY            0xEC
+#define ATA_CMD_READ_DMA_EXT        0x25
+#define ATA_CMD_WRITE_DMA_EXT       0x35
+#define ATA_CMD_READ_FPDMA_QUEUED   0x60
+#define ATA_CMD_WRITE_FPDMA_QUEUED  0x61
+
+#define FIS_TYPE_REG_H2D    0x27
+
+/* Command list entry */
+struct ahci_cmd_header {
+    uint16_t flags;                 /* CFL in bits 0-4, W = bit 6 */
+    uint16_t prdtl;                 /* PRDT entries */
+    volatile uint32_t prdbc;        /* Bytes transferred */
+    uint32_t ctba;
+    uint32_t ctbau;
+    uint32_t reserved[4];
+};
+
+#define AHCI_CMD_FLAG_WRITE     (1u << 6)
+
+struct ahci_prd {
+    uint32_t dba;
+    uint32_t dbau;
+    uint32_t reserved;
+    uint32_t dbc;                   /* Byte count - 1 (bit 0 set), bit 31 = IRQ */
+};
+
+struct ahci_cmd_table {
+    uint8_t cfis[64];
+    uint8_t acmd[16];
+    uint8_t reserved[48];
+    struct ahci_prd prdt[AHCI_MAX_PRDT];
+};
+
+/* Per-port DMA memory: command list (1 KB aligned), received FIS area
+ * (256 byte aligned) and the command tables (128 byte aligned) */
+static struct ahci_cmd_header ahci_cmd_list[AHCI_SLOTS] __attribute__((aligned(1024)));
+static uint8_t ahci_rfis[256] __attribute__((aligned(256)));
+static struct ahci_cmd_table ahci_tables[AHCI_SLOTS] __attribute__((aligned(128)));
+static uint16_t ahci_identify_buf[256] __attribute__((aligned(2)));
+
+struct ahci_port {
+    volatile uint8_t *regs;
+    int index;
+    uint32_t slot_mask;             /* Usable slots */
+    uint32_t active;                /* Issued and not completed */
+    uint32_t pending;               /* Prepared, issued on the next commit */
+    int ncq;
+    struct blk_req *req[AHCI_SLOTS];
+};
+
+static volatile uint8_t *ahci_abar;
+static struct ahci_port ahci_port;
+
+static inline uint32_t hba_read(uint32_t reg) {
+    return *(volatile uint32_t *)(ahci_abar + reg);
+}
+
+static inline void hba_write(uint32_t reg, uint32_t val) {
+    *(volatile uint32_t *)(ahci_abar + reg) = val;
+}
+
+static inline uint32_t port_read(const struct ahci_port *p, uint32_t reg) {
+    return *(volatile uint32_t *)(p->regs + reg);
+}
+
+static inline void port_write(const struct ahci_port *p, uint32_t reg, uint32_t val) {
+    *(volatile uint32_t *)(p->regs + reg) = val;
+}
+
+/* Wait up to ms for (read(reg) & mask) == value */
+static int ahci_wait(const struct ahci_port *p, uint32_t reg, uint32_t mask, uint32_t value, uint32_t ms) {
+    if (tsc_khz == 0) tsc_calibrate();
+    uint64_t limit = rdtsc() + (uint64_t)tsc_khz * ms;
+
+    while (((p ? port_read(p, reg) : hba_read(reg)) & mask) != value) {
+        if (rdtsc() > limit) return -1;
+        __asm__ volatile ("pause");
+    }
+    return 0;
+}
+
+static int ahci_port_stop(struct ahci_port *p) {
+    port_write(p, AHCI_PxCMD, port_read(p, AHCI_PxCMD) & ~AHCI_PxCMD_ST);
+    if (ahci_wait(p, AHCI_PxCMD, AHCI_PxCMD_CR, 0, 500) < 0) return -1;
+    port_write(p, AHCI_PxCMD, port_read(p, AHCI_PxCMD) & ~AHCI_PxCMD_FRE);
+    return ahci_wait(p, AHCI_PxCMD, AHCI_PxCMD_FR, 0, 500);
+}
+
+static void ahci_port_start(struct ahci_port *p) {
+    ahci_wait(p, AHCI_PxCMD, AHCI_PxCMD_CR, 0, 500);
+    port_write(p, AHCI_PxCMD, port_read(p, AHCI_PxCMD) | AHCI_PxCMD_FRE);
+    port_write(p, AHCI_PxCMD, port_read(p, AHCI_PxCMD) | AHCI_PxCMD_ST);
+}
+
+/* Fill slot's header, FIS and PRDT for one ATA command */
+static void ahci_build(int slot, uint8_t command, uint64_t lba, uint32_t count,
+                       int write, const struct blk_seg *segs, int nsegs, int ncq) {
+    struct ahci_cmd_table *t = &ahci_tables[slot];
+    struct ahci_cmd_header *h = &ahci_cmd_list[slot];
+    uint8_t *fis = t->cfis;
+
+    memset(fis, 0, 20);
+    fis[0] = FIS_TYPE_REG_H2D;
+    fis[1] = 0x80;                  /* Command register update */
+    fis[2] = command;
+    fis[4] = (uint8_t)lba;
+    fis[5] = (uint8_t)(lba >> 8);
+    fis[6] = (uint8_t)(lba >> 16);
+    fis[7] = 0x40;                  /* LBA mode */
+    fis[8] = (uint8_t)(lba >> 24);
+    fis[9] = (uint8_t)(lba >> 32);
+    fis[10] = (uint8_t)(lba >> 40);
+    if (ncq) {
+        /* Sector count in FEATURES, tag in COUNT[7:3] */
+        fis[3] = (uint8_t)count;
+        fis[11] = (uint8_t)(count >> 8);
+        fis[12] = (uint8_t)(slot << 3);
+    } else {
+        fis[12] = (uint8_t)count;
+        fis[13] = (uint8_t)(count >> 8);
+    }
+
+    for (int i = 0; i < nsegs; i++) {
+        t->prdt[i].dba = (uint32_t)segs[i].buf;
+        t->prdt[i].dbau = 0;
+        t->prdt[i].reserved = 0;
+        t->prdt[i].dbc = segs[i].len - 1;
+    }
+
+    h->flags = (uint16_t)(5 | (write ? AHCI_CMD_FLAG_WRITE : 0));     /* 5-dword FIS */
+    h->prdtl = (uint16_t)nsegs;
+    h->prdbc = 0;
+}
+
+static int ahci_submit(struct blk_dev *dev, struct blk_req *req) {
+    struct ahci_port *p = dev->priv;
+    uint32_t free = p->slot_mask & ~(p->active | p->pending);
+    struct blk_seg segs[AHCI_MAX_PRDT];
+    int n = 0;
+
+    if (!free) return -1;
+    int slot = __builtin_ctz(free);
+
+    for (struct blk_req *r = req; r; r = r->merge_next) {
+        for (int i = 0; i < r->nseg; i++) segs[n++] = r->seg[i];
+    }
+
+    int write = req->op == BLK_WRITE;
+    uint8_t command = p->ncq ? (write ? ATA_CMD_WRITE_FPDMA_QUEUED : ATA_CMD_READ_FPDMA_QUEUED)
+                             : (write ? ATA_CMD_WRITE_DMA_EXT : ATA_CMD_READ_DMA_EXT);
+    ahci_build(slot, command, req->sector, req->merge_sectors, write, segs, n, p->ncq);
+
+    p->req[slot] = req;
+    p->pending |= 1u << slot;
+    return 0;
+}
+
+/* Issue every prepared slot with one register write each */
+static void ahci_commit(struct blk_dev *dev) {
+    struct ahci_port *p = dev->priv;
+    uint32_t bits = p->pending;
+
+    if (!bits) return;
+    p->pending = 0;
+    p->active |= bits;
+    if (p->ncq) port_write(p, AHCI_PxSACT, bits);
+    port_write(p, AHCI_PxCI, bits);
+}
+
+static const struct blk_ops ahci_ops = {
+    .submit = ahci_submit,
+    .commit = ahci_commit,
+};
+
+static struct blk_dev ahci_blk = {
+    .name = "sda",
+    .ops = &ahci_ops,
+    .priv = &ahci_port,
+};
+
+static void ahci_complete_slots(struct ahci_port *p, uint32_t done, int status) {
+    p->active &= ~done;
+    while (done) {
+        int slot = __builtin_ctz(done);
+        done &= done - 1;
+        blk_complete(&ahci_blk, p->req[slot], status);
+    }
+}
+
+static void ahci_port_irq(struct ahci_port *p) {
+    uint32_t is = port_read(p, AHCI_PxIS);
+    port_write(p, AHCI_PxIS, is);
+
+    if (is & AHCI_PxIS_ERROR) {
+        /* Fail everything outstanding and restart the port */
+        ahci_port_stop(p);
+        port_write(p, AHCI_PxSERR, 0xFFFFFFFFu);
+        port_write(p, AHCI_PxIS, 0xFFFFFFFFu);
+        ahci_port_start(p);
+        ahci_complete_slots(p, p->active, BLK_EIO);
+        return;
+    }
+
+    uint32_t busy = port_read(p, AHCI_PxCI);
+    if (p->ncq) busy |= port_read(p, AHCI_PxSACT);
+    ahci_complete_slots(p, p->active & ~busy, BLK_OK);
+}
+
+static void ahci_irq(void *ctx) {
+    (void)ctx;
+    uint32_t is = hba_read(AHCI_IS);
+    if (!(is & (1u << ahci_port.index))) return;
+
+    ahci_port_irq(&ahci_port);
+    hba_write(AHCI_IS, is);
+}
+
+/* IDENTIFY DEVICE in slot 0, polled (interrupts are not enabled yet) */
+static int ahci_identify(struct ahci_port *p) {
+    struct blk_seg seg = { ahci_identify_buf, sizeof(ahci_identify_buf) };
+
+    ahci_build(0, ATA_CMD_IDENTIFY, 0, 0, 0, &seg, 1, 0);
+    ahci_tables[0].cfis[7] = 0;
+    port_write(p, AHCI_PxCI, 1);
+    if (ahci_wait(p, AHCI_PxCI, 1, 0, 1000) < 0) return -1;
+    if (port_read(p, AHCI_PxTFD) & AHCI_TFD_ERR) return -1;
+    return 0;
+}
+
+static int ahci_port_init(struct ahci_port *p, uint32_t cap) {
+    if (ahci_port_stop(p) < 0) return -1;
+
+    memset(ahci_cmd_list, 0, sizeof(ahci_cmd_list));
+    memset(ahci_rfis, 0, sizeof(ahci_rfis));
+    memset(ahci_tables, 0, sizeof(ahci_tables));
+    for (int i = 0; i < AHCI_SLOTS; i++) {
+        ahci_cmd_list[i].ctba = (uint32_t)&ahci_tables[i];
+        ahci_cmd_list[i].ctbau = 0;
+    }
+    port_write(p, AHCI_PxCLB, (uint32_t)ahci_cmd_list);
+    port_write(p, AHCI_PxCLBU, 0);
+    port_write(p, AHCI_PxFB, (uint32_t)ahci_rfis);
+    port_write(p, AHCI_PxFBU, 0);
+    port_write(p, AHCI_PxSERR, 0xFFFFFFFFu);
+    port_write(p, AHCI_PxIS, 0xFFFFFFFFu);
+    port_write(p, AHCI_PxCMD, port_read(p, AHCI_PxCMD) | AHCI_PxCMD_SUD | AHCI_PxCMD_POD);
+    ahci_port_start(p);
+
+    if (ahci_wait(p, AHCI_PxTFD, AHCI_TFD_BSY | AHCI_TFD_DRQ, 0, 1000) < 0) return -1;
+    if (ahci_identify(p) < 0) return -1;
+
+    const uint16_t *id = ahci_identify_buf;
+    uint32_t slots = AHCI_CAP_NCS(cap);
+    uint64_t sectors = id[100] | ((uint64_t)id[101] << 16) | ((uint64_t)id[102] << 32) |
+                       ((uint64_t)id[103] << 48);
+    if (sectors == 0) sectors = id[60] | ((uint32_t)id[61] << 16);   /* LBA28 only */
+
+    /* NCQ needs HBA and device support; the device queue may be shorter */
+    p->ncq = (cap & AHCI_CAP_SNCQ) && (id[76] & (1u << 8));
+    if (p->ncq && (uint32_t)(id[75] & 0x1F) + 1 < slots) slots = (id[75] & 0x1F) + 1u;
+    p->slot_mask = slots == 32 ? 0xFFFFFFFFu : (1u << slots) - 1;
+    p->active = 0;
+    p->pending = 0;
+
+    ahci_blk.nsectors = sectors;
+    ahci_blk.max_segs = AHCI_MAX_PRDT;
+    ahci_blk.max_sectors = AHCI_MAX_SECTORS;
+
+    port_write(p, AHCI_PxIS, 0xFFFFFFFFu);
+    port_write(p, AHCI_PxIE, AHCI_PxIS_DHRS | AHCI_PxIS_PSS | AHCI_PxIS_SDBS | AHCI_PxIS_ERROR);
+    return 0;
+}
+
+int ahci_init(void) {
+    struct pci_dev dev;
+
+    if (pci_find_class(0x01, 0x06, 0x01, &dev) < 0) return -1;
+
+    /* The kernel's 4 MB identity map (vm.h) covers MMIO: the ABAR is used
+     * at its physical address */
+    uint32_t abar = pci_bar_mem(&dev, 5);
+    if (!abar) return -1;
+    pci_enable(&dev, PCI_COMMAND_MEMORY | PCI_COMMAND_MASTER);
+    ahci_abar = (volatile uint8_t *)abar;
+
+    /* Reset the HBA, then run it in AHCI mode */
+    hba_write(AHCI_GHC, hba_read(AHCI_GHC) | AHCI_GHC_AE);
+    hba_write(AHCI_GHC, hba_read(AHCI_GHC) | AHCI_GHC_HR);
+    if (ahci_wait(NULL, AHCI_GHC, AHCI_GHC_HR, 0, 1000) < 0) return -1;
+    hba_write(AHCI_GHC, hba_read(AHCI_GHC) | AHCI_GHC_AE);
+
+    uint32_t cap = hba_read(AHCI_CAP);
+    uint32_t pi = hba_read(AHCI_PI);
+
+    /* First port with a SATA disk attached */
+    for (int i = 0; i < 32; i++) {
+        if (!(pi & (1u << i))) continue;
+        struct ahci_port *p = &ahci_port;
+        p->regs = ahci_abar + AHCI_PORT(i);
+        p->index = i;
+        if ((port_read(p, AHCI_PxSSTS) & 0xF) != AHCI_SSTS_DET_PRESENT) continue;
+        if (port_read(p, AHCI_PxSIG) != AHCI_SIG_ATA) continue;
+        if (ahci_port_init(p, cap) < 0) continue;
+
+        if (irq_register(dev.irq_line, ahci_irq, NULL) < 0) return -1;
+        hba_write(AHCI_IS, 0xFFFFFFFFu);
+        hba_write(AHCI_GHC, hba_read(AHCI_GHC) | AHCI_GHC_IE);
+        return blk_register(&ahci_blk);
+    }
+    return -1;
+}
@@ -0,0 +1,80 @@
+#ifndef AHCI_H
+#define AHCI_H
+
+#include <stdint.h>
+
+/*
+ * AHCI SATA host bus adapter ("sda").
+ *
+ * The HBA is found by PCI class (01:06:01) and driven through its ABAR
+ * (BAR5), used at its physical address.  The first port with a SATA disk
+ * gets a command list with up to 32 slots, a FIS receive area and one
+ * command table per slot.  Commands are issued with NCQ (READ/WRITE FPDMA
+ * QUEUED), so all slots can be outstanding; disks without NCQ fall back
+ * to READ/WRITE DMA EXT.  Completions are taken from the HBA's PCI
+ * interrupt: PxSACT (NCQ) or PxCI bits that clear mark finished slots.
+ * Commands dispatched in one batch are issued with one PxSACT/PxCI write.
+ *
+ *   qemu ... -device ahci,id=ahci \
+ *            -drive file=sata.img,if=none,id=sata0,format=raw \
+ *            -device ide-hd,drive=sata0,bus=ahci.0
+ */
+
+/* Generic host control */
+#define AHCI_CAP            0x00
+#define AHCI_GHC            0x04
+#define AHCI_IS             0x08
+#define AHCI_PI             0x0C
+
+#define AHCI_CAP_NCS(cap)   ((((cap) >> 8) & 0x1F) + 1)     /* Command slots */
+#define AHCI_CAP_SNCQ       (1u << 30)
+#define AHCI_GHC_HR         (1u << 0)
+#define AHCI_GHC_IE         (1u << 1)
+#define AHCI_GHC_AE         (1u << 31)
+
+/* Port registers, at 0x100 + port * 0x80 */
+#define AHCI_PORT(n)        (0x100 + (n) * 0x80)
+#define AHCI_PxCLB          0x00
+#define AHCI_PxCLBU         0x04
+#define AHCI_PxFB           0x08
+#define AHCI_PxFBU          0x0C
+#define AHCI_PxIS           0x10
+#define AHCI_PxIE           0x14
+#define AHCI_PxCMD          0x18
+#define AHCI_PxTFD          0x20
+#define AHCI_PxSIG          0x24
+#define AHCI_PxSSTS         0x28
+#define AHCI_PxSERR         0x30
+#define AHCI_PxSACT         0x34
+#define AHCI_PxCI           0x38
+
+#define AHCI_PxCMD_ST       (1u << 0)
+#define AHCI_PxCMD_SUD      (1u << 1)
+#define AHCI_PxCMD_POD      (1u << 2)
+#define AHCI_PxCMD_FRE      (1u << 4)
+#define AHCI_PxCMD_FR       (1u << 14)
+#define AHCI_PxCMD_CR       (1u << 15)
+
+#define AHCI_PxIS_DHRS      (1u << 0)   /* D2H register FIS */
+#define AHCI_PxIS_PSS       (1u << 1)   /* PIO setup FIS */
+#define AHCI_PxIS_SDBS      (1u << 3)   /* Set device bits FIS (NCQ completion) */
+#define AHCI_PxIS_IFS       (1u << 27)
+#define AHCI_PxIS_HBDS      (1u << 28)
+#define AHCI_PxIS_HBFS      (1u << 29)
+#define AHCI_PxIS_TFES      (1u << 30)
+#define AHCI_PxIS_ERROR     (AHCI_PxIS_IFS | AHCI_PxIS_HBDS | AHCI_PxIS_HBFS | AHCI_PxIS_TFES)
+
+#define AHCI_TFD_ERR        0x01
+#define AHCI_TFD_DRQ        0x08
+#define AHCI_TFD_BSY        0x80
+
+#define AHCI_SIG_ATA        0x00000101
+#define AHCI_SSTS_DET_PRESENT 3
+
+#define AHCI_MAX_PRDT       16          /* Scatter-gather entries per command */
+
+/* Register the block device if an AHCI HBA with a SATA disk is present.
+ * Returns 0 on success, -1 if there is none. */
+int ahci_init(void);
+
+#endif /* AHCI_H */
@@ -0,0 +1,472 @@
+#include "bcache.h"
+#include "printk.h"
+#include "bench.h"
+#include "lib.h"
+#include "cpu.h"
+#include "timer.h"
+#include "tsc.h"
+#include "div64.h"
+
+struct bcache_stream {
+    struct blk_dev *dev;
+    uint32_t next;                  /* Block expected next if sequential */
+    uint32_t ra_end;                /* First block not read ahead yet */
+    uint32_t window;                /* Size of the last read-ahead batch */
+};
+
+struct bcache_stats bcache_stats;
+
+static uint8_t bcache_data[BCACHE_NBUF][BCACHE_BLOCK_SIZE] __attribute__((aligned(4096)));
+static struct buf bcache_bufs[BCACHE_NBUF];
+static struct buf *bcache_hash[BCACHE_HASH_SIZE];
+static struct buf bcache_lru;       /* Sentinel: next = most, prev = least recent */
+static struct bcache_stream bcache_streams[BLK_MAX_DEVS];
+static uint32_t bcache_ndirty;
+static volatile uint32_t bcache_writes;     /* Write-backs in flight */
+static uint32_t bcache_last_poll;
+
+static inline uint32_t bcache_hashfn(const struct blk_dev *dev, uint32_t block) {
+    uint32_t h = (block ^ ((uint32_t)dev >> 4)) * 2654435761u;
+    return (h >> 16) & (BCACHE_HASH_SIZE - 1);
+}
+
+/* The helpers below run with interrupts disabled */
+
+static void lru_remove(struct buf *b) {
+    b->lru_prev->lru_next = b->lru_next;
+    b->lru_next->lru_prev = b->lru_prev;
+}
+
+static void lru_add_head(struct buf *b) {
+    b->lru_next = bcache_lru.lru_next;
+    b->lru_prev = &bcache_lru;
+    bcache_lru.lru_next->lru_prev = b;
+    bcache_lru.lru_next = b;
+}
+
+static void lru_add_tail(struct buf *b) {
+    b->lru_prev = bcache_lru.lru_prev;
+    b->lru_next = &bcache_lru;
+    bcache_lru.lru_prev->lru_next = b;
+    bcache_lru.lru_prev = b;
+}
+
+static void hash_remove(struct buf *b) {
+    if (!b->hash_pprev) return;
+    *b->hash_pprev = b->hash_next;
+    if (b->hash_next) b->hash_next->hash_pprev = b->hash_pprev;
+    b->hash_pprev = NULL;
+}
+
+static void hash_insert(struct buf *b) {
+    struct buf **head = &bcache_hash[bcache_hashfn(b->dev, b->block)];
+
+    b->hash_next = *head;
+    if (*head) (*head)->hash_pprev = &b->hash_next;
+    b->hash_pprev = head;
+    *head = b;
+}
+
+static struct buf *hash_lookup(struct blk_dev *dev, uint32_t block) {
+    for (struct buf *b = bcache_hash[bcache_hashfn(dev, block)]; b; b = b->hash_next) {
+        if (b->dev == dev && b->block == block) return b;
+    }
+    return NULL;
+}
+
+static void buf_hold(struct buf *b) {
+    if (b->refcnt++ == 0) lru_remove(b);
+}
+
+static void buf_release(struct buf *b) {
+    if (--b->refcnt == 0) lru_add_head(b);
+}
+
+static void bcache_req(struct buf *b, int op, blk_done_fn done) {
+    b->req.sector = (uint64_t)b->block * BCACHE_BLOCK_SECTORS;
+    b->req.op = (uint8_t)op;
+    b->req.nseg = 1;
+    b->req.seg[0].buf = b->data;
+    b->req.seg[0].len = BCACHE_BLOCK_SIZE;
+    b->req.done = done;
+    b->req.priv = b;
+}
+
+static void bcache_read_done(struct blk_req *req) {
+    struct buf *b = req->priv;
+
+    if (req->status == BLK_OK) {
+        b->flags = (b->flags & ~B_IO) | B_VALID;
+    } else {
+        b->flags = (b->flags & ~(B_IO | B_RA)) | B_ERROR;
+        bcache_stats.errors++;
+    }
+    buf_release(b);
+}
+
+static void bcache_write_done(struct blk_req *req) {
+    struct buf *b = req->priv;
+
+    if (req->status != BLK_OK) {
+        if (!(b->flags & B_DIRTY)) bcache_ndirty++;
+        b->flags |= B_DIRTY;
+        bcache_stats.errors++;
+    }
+    b->flags &= ~B_IO;
+    bcache_writes--;
+    buf_release(b);
+}
+
+/* In-flight I/O holds its own reference, dropped by the done callback
+ * (which may run before blk_submit() returns) */
+static void bcache_start_read(struct buf *b, int readahead) {
+    buf_hold(b);
+    b->flags = B_IO | (readahead ? B_RA : 0);
+    bcache_req(b, BLK_READ, bcache_read_done);
+    if (blk_submit(b->dev, &b->req) < 0) {
+        b->flags = B_ERROR;
+        bcache_stats.errors++;
+        buf_release(b);
+    }
+}
+
+static void bcache_start_write(struct buf *b) {
+    buf_hold(b);
+    b->flags = (b->flags & ~B_DIRTY) | B_IO;
+    bcache_ndirty--;
+    bcache_writes++;
+    bcache_stats.writebacks++;
+    bcache_req(b, BLK_WRITE, bcache_write_done);
+    if (blk_submit(b->dev, &b->req) < 0) {
+        b->req.status = BLK_EIO;
+        bcache_write_done(&b->req);
+    }
+}
+
+/* Least recently used clean buffer; dirty ones passed on the way are
+ * written back so they can be taken next time.  NULL if there is none. */
+static struct buf *bcache_victim(void) {
+    struct buf *b = bcache_lru.lru_prev;
+
+    while (b != &bcache_lru) {
+        struct buf *prev = b->lru_prev;
+        if (!(b->flags & B_DIRTY)) return b;
+        bcache_start_write(b);
+        b = prev;
+    }
+    return NULL;
+}
+
+/* Held buffer for (dev, block), cached or recycled; NULL if every
+ * buffer is held or being written back */
+static struct buf *bcache_get(struct blk_dev *dev, uint32_t block) {
+    struct buf *b = hash_lookup(dev, block);
+
+    if (b) {
+        buf_hold(b);
+        return b;
+    }
+
+    b = bcache_victim();
+    if (!b) return NULL;
+    if (b->dev) {
+        bcache_stats.evictions++;
+        if (b->flags & B_RA) bcache_stats.ra_wasted++;
+        hash_remove(b);
+    }
+    b->dev = dev;
+    b->block = block;
+    b->flags = 0;
+    hash_insert(b);
+    buf_hold(b);
+    return b;
+}
+
+static struct bcache_stream *bcache_stream(struct blk_dev *dev) {
+    for (int i = 0; i < BLK_MAX_DEVS; i++) {
+        struct bcache_stream *s = &bcache_streams[i];
+        if (s->dev == dev) return s;
+        if (!s->dev) {
+            s->dev = dev;
+            s->next = 0xFFFFFFFFu;
+            return s;
+        }
+    }
+    return NULL;
+}
+
+static void bcache_readahead(struct blk_dev *dev, uint32_t block) {
+    struct bcache_stream *s = bcache_stream(dev);
+    uint32_t nblocks = (uint32_t)(dev->nsectors / BCACHE_BLOCK_SECTORS);
+
+    if (!s || block + 1 == s->next) return;
+    if (block != s->next) {
+        /* Random access: start a new stream here */
+        s->next = block + 1;
+        s->ra_end = block + 1;
+        s->window = 0;
+        return;
+    }
+    s->next = block + 1;
+
+    /* Read the next batch once half of the previous one is consumed */
+    if (s->ra_end < block + 1) s->ra_end = block + 1;
+    if (s->ra_end - (block + 1) > s->window / 2) return;
+    s->window = s->window ? s->window * 2 : BCACHE_RA_MIN;
+    if (s->window > BCACHE_RA_MAX) s->window = BCACHE_RA_MAX;
+
+    uint32_t end = s->ra_end + s->window;
+    if (end > nblocks || end < s->ra_end) end = nblocks;
+
+    uint32_t n;
+    blk_plug(dev);
+    for (n = s->ra_end; n < end; n++) {
+        if (hash_lookup(dev, n)) continue;
+        struct buf *b = bcache_get(dev, n);
+        if (!b) break;
+        bcache_start_read(b, 1);
+        buf_release(b);
+        bcache_stats.ra_issued++;
+    }
+    blk_unplug(dev);
+    s->ra_end = n;
+}
+
+void bcache_init(void) {
+    bcache_lru.lru_next = bcache_lru.lru_prev = &bcache_lru;
+    for (int i = 0; i < BCACHE_NBUF; i++) {
+        struct buf *b = &bcache_bufs[i];
+        b->data = bcache_data[i];
+        lru_add_tail(b);
+    }
+}
+
+struct buf *bread(struct blk_dev *dev, uint32_t block) {
+    struct buf *b;
+    uint32_t flags;
+
+    if ((uint64_t)(block + 1) * BCACHE_BLOCK_SECTORS > dev->nsectors) return NULL;
+
+    for (;;) {
+        flags = irq_save();
+        b = bcache_get(dev, block);
+        if (b) break;
+        irq_restore(flags);
+        __asm__ volatile ("hlt");       /* Wait for a write-back to finish */
+    }
+
+    bcache_stats.lookups++;
+    if (b->flags & (B_VALID | B_IO)) {
+        bcache_stats.hits++;
+        if (b->flags & B_RA) {
+            bcache_stats.ra_hits++;
+            b->flags &= ~B_RA;
+        }
+    } else {
+        bcache_stats.misses++;
+        bcache_start_read(b, 0);
+    }
+    bcache_readahead(dev, block);
+    irq_restore(flags);
+
+    while (b->flags & B_IO) __asm__ volatile ("hlt");
+    if (!(b->flags & B_VALID)) {
+        brelse(b);
+        return NULL;
+    }
+    return b;
+}
+
+void brelse(struct buf *b) {
+    uint32_t flags = irq_save();
+    buf_release(b);
+    irq_restore(flags);
+}
+
+void bdirty(struct buf *b) {
+    uint32_t flags = irq_save();
+    if (!(b->flags & B_DIRTY)) {
+        b->dirtied = jiffies;
+        bcache_ndirty++;
+    }
+    b->flags |= B_DIRTY | B_VALID;
+    irq_restore(flags);
+}
+
+int bcache_sync(struct blk_dev *dev) {
+    uint32_t errors = bcache_stats.errors;
+    uint32_t flags = irq_save();
+
+    if (dev) blk_plug(dev);
+    for (int i = 0; i < BCACHE_NBUF; i++) {
+        struct buf *b = &bcache_bufs[i];
+        if ((!dev || b->dev == dev) && (b->flags & (B_DIRTY | B_IO)) == B_DIRTY) bcache_start_write(b);
+    }
+    if (dev) blk_unplug(dev);
+    irq_restore(flags);
+
+    while (bcache_writes) __asm__ volatile ("hlt");
+    return bcache_stats.errors == errors ? BLK_OK : BLK_EIO;
+}
+
+void bcache_drop(struct blk_dev *dev) {
+    uint32_t flags = irq_save();
+
+    for (int i = 0; i < BCACHE_NBUF; i++) {
+        struct buf *b = &bcache_bufs[i];
+        if (!b->dev || (dev && b->dev != dev)) continue;
+        if (b->refcnt || (b->flags & (B_DIRTY | B_IO))) continue;
+        hash_remove(b);
+        b->dev = NULL;
+        b->flags = 0;
+        lru_remove(b);
+        lru_add_tail(b);
+    }
+    for (int i = 0; i < BLK_MAX_DEVS; i++) {
+        if (!dev || bcache_streams[i].dev == dev) bcache_streams[i].next = 0xFFFFFFFFu;
+    }
+    irq_restore(flags);
+}
+
+void bcache_poll(void) {
+    if (!bcache_ndirty || jiffies - bcache_last_poll < TIMER_HZ / 10) return;
+    bcache_last_poll = jiffies;
+
+    uint32_t flags = irq_save();
+    for (int i = 0; i < BCACHE_NBUF; i++) {
+        struct buf *b = &bcache_bufs[i];
+        if ((b->flags & (B_DIRTY | B_IO)) != B_DIRTY) continue;
+        if (jiffies - b->dirtied >= BCACHE_WRITEBACK_MS * TIMER_HZ / 1000) bcache_start_write(b);
+    }
+    irq_restore(flags);
+}
+
+uint32_t bcache_poll_delay(void) {
+    uint32_t since = jiffies - bcache_last_poll;
+
+    if (!bcache_ndirty) return TIMER_NONE;
+    return since >= TIMER_HZ / 10 ? 0 : TIMER_HZ / 10 - since;
+}
+
+static uint32_t percent(uint32_t part, uint32_t whole) {
+    return whole ? (uint32_t)div64_u32((uint64_t)part * 100, whole, NULL) : 0;
+}
+
+static void bcache_print_stats(void) {
+    const struct bcache_stats *s = &bcache_stats;
+    uint32_t cached = 0, held = 0;
+
+    for (int i = 0; i < BCACHE_NBUF; i++) {
+        if (bcache_bufs[i].dev) cached++;
+        if (bcache_bufs[i].refcnt) held++;
+    }
+    printk("bcache: %u x %u KB buffers, %u cached, %u held, %u dirty\n",
+           BCACHE_NBUF, BCACHE_BLOCK_SIZE / 1024, cached, held, bcache_ndirty);
+    printk("  lookups %u, hits %u (%u%%), misses %u, evictions %u\n",
+           s->lookups, s->hits, percent(s->hits, s->lookups), s->misses, s->evictions);
+    printk("  read-ahead %u blocks, %u used (%u%%), %u evicted unused\n",
+           s->ra_issued, s->ra_hits, percent(s->ra_hits, s->ra_issued), s->ra_wasted);
+    printk("  write-back %u blocks, %u I/O errors\n", s->writebacks, s->errors);
+}
+
+/* Default device: the RAM disk if there is one */
+static struct blk_dev *bcache_default_dev(void) {
+    struct blk_dev *dev = blk_find("ram0");
+    return dev ? dev : blk_find(NULL);
+}
+
+/* Read blocks [0, count) in order; returns elapsed microseconds, 0 on error */
+static uint32_t bcache_scan(struct blk_dev *dev, uint32_t count) {
+    uint64_t start = rdtsc();
+
+    for (uint32_t i = 0; i < count; i++) {
+        struct buf *b = bread(dev, i);
+        if (!b) return 0;
+        brelse(b);
+    }
+    uint32_t us = tsc_cycles_to_us(rdtsc() - start);
+    return us ? us : 1;
+}
+
+static void bcache_cmd_scan(int argc, char *argv[]) {
+    struct blk_dev *dev = NULL;
+    uint32_t count = 0;
+
+    for (int i = 2; i < argc; i++) {
+        if (argv[i][0] >= '0' && argv[i][0] <= '9') count = (uint32_t)atoi(argv[i]);
+        else dev = blk_find(argv[i]);
+    }
+    if (!dev && argc > 2 && count == 0) {
+        printk("bcache: no such device\n");
+        return;
+    }
+    if (!dev) dev = bcache_default_dev();
+    if (!dev) {
+        printk("bcache: no block device\n");
+        return;
+    }
+
+    uint32_t nblocks = (uint32_t)(dev->nsectors / BCACHE_BLOCK_SECTORS);
+    if (count == 0 || count > nblocks) count = nblocks;
+
+    uint32_t us = bcache_scan(dev, count);
+    if (!us) {
+        printk("bcache: I/O error\n");
+        return;
+    }
+    printk("%s: %u blocks in %u us, %u KB/s\n", dev->name, count, us,
+           (uint32_t)div64_u32((uint64_t)count * (BCACHE_BLOCK_SIZE / 1024) * 1000000, us, NULL));
+}
+
+/**
+ * bcache                      - statistics
+ * bcache sync                 - write back all dirty buffers
+ * bcache drop                 - forget clean buffers
+ * bcache reset                - zero the statistics
+ * bcache scan [dev] [blocks]  - sequential read through the cache
+ */
+void cmd_bcache(int argc, char *argv[]) {
+    if (argc < 2) {
+        bcache_print_stats();
+    } else if (strcmp(argv[1], "sync") == 0) {
+        if (bcache_sync(NULL) != BLK_OK) printk("bcache: write-back failed\n");
+    } else if (strcmp(argv[1], "drop") == 0) {
+        bcache_drop(NULL);
+    } else if (strcmp(argv[1], "reset") == 0) {
+        memset(&bcache_stats, 0, sizeof(bcache_stats));
+    } else if (strcmp(argv[1], "scan") == 0) {
+        bcache_cmd_scan(argc, argv);
+    } else {
+        printk("Usage: bcache [sync|drop|reset|scan [dev] [blocks]]\n");
+    }
+}
+
+void bench_bcache(void) {
+    struct blk_dev *dev = bcache_default_dev();
+
+    if (!dev) {
+        printk("bcache: no block device\n");
+        return;
+    }
+
+    /* Half the cache, so the warm pass hits every block */
+    uint32_t count = (uint32_t)(dev->nsectors / BCACHE_BLOCK_SECTORS);
+    if (count > BCACHE_NBUF / 2) count = BCACHE_NBUF / 2;
+
+    bcache_sync(dev);
+    bcache_drop(dev);
+    struct bcache_stats before = bcache_stats;
+
+    uint32_t cold = bcache_scan(dev, count);
+    uint32_t misses = bcache_stats.misses - before.misses;
+    uint32_t warm = bcache_scan(dev, count);
+    if (!cold || !warm) {
+        printk("bcache: I/O error\n");
+        return;
+    }
+
+    uint64_t kb = (uint64_t)count * (BCACHE_BLOCK_SIZE / 1024) * 1000000;
+    bench_report("bcache_cold", (uint32_t)div64_u32(kb, cold, NULL), "KB/s");
+    bench_report("bcache_warm", (uint32_t)div64_u32(kb, warm, NULL), "KB/s");
+    bench_report("bcache_cold_misses", misses, "blocks");
+}
@@ -0,0 +1,103 @@
+#ifndef BCACHE_H
+#define BCACHE_H
+
+#include <stdint.h>
+#include "blk.h"
+
+/*
+ * Buffer cache: 4 KB blocks of block devices, keyed by (device, block).
+ *
+ * Buffers are found through a hash table and, while nobody holds them,
+ * kept on an LRU list; a miss takes the least recently used clean
+ * buffer.  bread() returns a held buffer with valid data, brelse() drops
+ * the hold.  Written buffers are marked with bdirty() and written back
+ * later: when they are about to be evicted, when they have been dirty
+ * for BCACHE_WRITEBACK_MS (bcache_poll(), run from the shell idle loop)
+ * or on bcache_sync().
+ *
+ * Each device has a read-ahead stream.  Once two blocks are read in a
+ * row, the following window of blocks is read asynchronously; the
+ * window doubles on every sequential read up to BCACHE_RA_MAX and the
+ * next batch starts when the reader is halfway through the previous
+ * one.  A random access resets the stream.
+ *
+ * All functions except bcache_init() need interrupts enabled, since
+ * they wait for I/O with hlt.
+ */
+
+#define BCACHE_BLOCK_SIZE   4096
+#define BCACHE_BLOCK_SECTORS (BCACHE_BLOCK_SIZE / BLK_SECTOR_SIZE)
+#define BCACHE_NBUF         512     /* 2 MB of cached data */
+#define BCACHE_HASH_SIZE    1024    /* Power of two */
+#define BCACHE_RA_MIN       4       /* Read-ahead window, in blocks */
+#define BCACHE_RA_MAX       32
+#define BCACHE_WRITEBACK_MS 1000
+
+/* Buffer flags */
+#define B_VALID     0x01            /* data holds the block */
+#define B_DIRTY     0x02            /* data is newer than the disk */
+#define B_IO        0x04            /* Read or write in flight */
+#define B_RA        0x08            /* Read ahead, not used yet */
+#define B_ERROR     0x10            /* Last read failed */
+
+struct buf {
+    struct blk_dev *dev;
+    uint32_t block;
+    volatile uint32_t flags;
+    uint32_t refcnt;
+    uint8_t *data;
+    uint32_t dirtied;               /* jiffies when it became dirty */
+
+    struct buf *hash_next;          /* Hash chain */
+    struct buf **hash_pprev;
+    struct buf *lru_prev;           /* LRU list, while refcnt == 0 */
+    struct buf *lru_next;
+
+    struct blk_req req;
+};
+
+struct bcache_stats {
+    uint32_t lookups;
+    uint32_t hits;
+    uint32_t misses;
+    uint32_t evictions;
+    uint32_t writebacks;            /* Blocks written */
+    uint32_t ra_issued;             /* Blocks read ahead */
+    uint32_t ra_hits;               /* ... and later read */
+    uint32_t ra_wasted;             /* ... and evicted unread */
+    uint32_t errors;
+};
+
+extern struct bcache_stats bcache_stats;
+
+void bcache_init(void);
+
+/* Held buffer for block with valid data; NULL on I/O error */
+struct buf *bread(struct blk_dev *dev, uint32_t block);
+
+/* Drop the hold from bread() */
+void brelse(struct buf *b);
+
+/* The caller changed b->data; write it back later */
+void bdirty(struct buf *b);
+
+/* Write back every dirty buffer of dev (all devices if NULL) and wait.
+ * Returns BLK_OK or BLK_EIO. */
+int bcache_sync(struct blk_dev *dev);
+
+/* Forget the clean, unheld buffers of dev (all devices if NULL) */
+void bcache_drop(struct blk_dev *dev);
+
+/* Start write-back of buffers dirty for more than BCACHE_WRITEBACK_MS */
+void bcache_poll(void);
+
+/* Ticks until bcache_poll() has work again, TIMER_NONE if nothing is dirty */
+uint32_t bcache_poll_delay(void);
+
+/* Shell command: bcache [sync|drop|scan [dev] [blocks]] */
+void cmd_bcache(int argc, char *argv[]);
+
+/* Benchmark: cold and warm sequential scans of the RAM disk */
+void bench_bcache(void);
+
+#endif /* BCACHE_H */
@@ -0,0 +1,172 @@
+#include "bench.h"
+#include "printk.h"
+#include "printf.h"
+#include "shell.h"
+#include "lib.h"
+#include "tsc.h"
+#include "boottime.h"
+#include "ksyms.h"
+#include "console.h"
+#include "virtio_console.h"
+#include "blk.h"
+#include "bcache.h"
+#include "initramfs.h"
+#include "usermode.h"
+#include "elf.h"
+#include "proc.h"
+#include "timer.h"
+#include "workpool.h"
+#include "ioring.h"
+
+/*
+ * Each benchmark times a loop body with rdtsc, repeats the measurement
+ * BENCH_RUNS times and reports the best run: under QEMU the minimum is
+ * far more stable across boots than the mean.
+ */
+#define BENCH_RUNS 5
+
+typedef void (*bench_body)(uint32_t iters);
+
+static uint8_t bench_src[4096];
+static uint8_t bench_dst[4096];
+static char bench_line[256];
+
+/* Best-of-BENCH_RUNS cycles per iteration of body */
+static uint32_t bench_cycles(bench_body body, uint32_t iters) {
+    uint32_t best = 0xFFFFFFFF;
+
+    for (int run = 0; run < BENCH_RUNS; run++) {
+        uint64_t start = rdtsc();
+        body(iters);
+        uint32_t elapsed = (uint32_t)(rdtsc() - start);
+        if (elapsed < best) best = elapsed;
+    }
+    return best / iters;
+}
+
+void bench_report(const char *name, uint32_t value, const char *unit) {
+    printk("@bench %s %d %s\n", name, (int)value, unit);
+}
+
+/* Benchmark bodies */
+
+static void body_memcpy_4k(uint32_t iters) {
+    while (iters--) memcpy(bench_dst, bench_src, sizeof(bench_dst));
+}
+
+static void body_memset_4k(uint32_t iters) {
+    while (iters--) memset(bench_dst, 0x20, sizeof(bench_dst));
+}
+
+static void body_strlen_255(uint32_t iters) {
+    volatile size_t len = 0;
+    while (iters--) len += strlen(bench_line);
+    (void)len;
+}
+
+static void body_snprintf_ints(uint32_t iters) {
+    char buf[64];
+    while (iters--) snprintf(buf, sizeof(buf), "%d %u %x %08x", -123456, 4000000000u, 0xBEEFu, iters);
+}
+
+static void body_shell_parse(uint32_t iters) {
+    static const char line[] = "  echo Hello from\tthe kernel shell!  ";
+    char tmp[sizeof(line)];
+    char *args[SHELL_MAX_ARGS];
+
+    while (iters--) {
+        memcpy(tmp, line, sizeof(line));
+        shell_parse_input(tmp, args);
+    }
+}
+
+static void body_ksym_lookup(uint32_t iters) {
+    uint32_t span = (uint32_t)(_text_end - _text_start);
+    uint32_t offset;
+
+    /* Stride through all of .text so every branch of the search is hit */
+    for (uint32_t i = 0; i < iters; i++) {
+        ksym_lookup((uint32_t)_text_start + (i * 2654435761u) % span, &offset);
+    }
+}
+
+static void body_printk_line(uint32_t iters) {
+    while (iters--) printk("bench: 0123456789abcdef0123456789abcdef\n");
+}
+
+/* Benchmark entry points */
+
+static void bench_lib(void) {
+    bench_report("memcpy_4k", bench_cycles(body_memcpy_4k, 64), "cycles");
+    bench_report("memset_4k", bench_cycles(body_memset_4k, 64), "cycles");
+    bench_report("strlen_255", bench_cycles(body_strlen_255, 256), "cycles");
+}
+
+static void bench_format(void) {
+    bench_report("snprintf_ints", bench_cycles(body_snprintf_ints, 256), "cycles");
+}
+
+static void bench_shell(void) {
+    bench_report("shell_parse", bench_cycles(body_shell_parse, 256), "cycles");
+}
+
+static void bench_ksyms(void) {
+    bench_report("ksym_lookup", bench_cycles(body_ksym_lookup, 256), "cycles");
+}
+
+static void bench_printk(void) {
+    bench_report("printk_line", bench_cycles(body_printk_line, 16), "cycles");
+    bench_printk_sinks();
+}
+
+/* Benchmark table */
+static const bench_t benchmarks[] = {
+    {"lib",     bench_lib,            "memcpy/memset/strlen"},
+    {"format",  bench_format,         "snprintf integer formatting"},
+    {"shell",   bench_shell,          "shell command-line tokenizer"},
+    {"ksyms",   bench_ksyms,          "address-to-symbol lookup"},
+    {"printk",  bench_printk,         "printk line, msgs/s per sink"},
+    {"boot",    bench_boottime,       "boot phase timing (us)"},
+    {"console", bench_console,        "VGA console lines/s vs naive writes"},
+    {"virtio",  bench_virtio_console, "serial vs virtio-console KB/s and exits/MB"},
+    {"blk",     bench_blk,            "4 KB seq/random reads at QD 1 and 32"},
+    {"bcache",  bench_bcache,         "buffer cache cold/warm sequential scan"},
+    {"initramfs", bench_initramfs,    "initramfs path lookup (cycles)"},
+    {"syscall", bench_syscall,        "null system call, int 0x80 vs sysenter"},
+    {"exec",    bench_exec,           "ELF launch latency and resident pages"},
+    {"fork",    bench_fork,           "copy-on-write clone vs parent size"},
+    {"idle",    bench_idle,           "idle wakeups/s, tickless vs periodic"},
+    {"timers",  bench_timers,         "timer wheel add/mod/del/expire (cycles)"},
+    {"workpool", bench_workpool,      "parallel_for frame zeroing and CRC (MB/s)"},
+    {"ioring",  bench_ioring,         "ring ops/s at batch 1 and 32 vs sync printk"},
+};
+
+static const uint32_t benchmarks_count = sizeof(benchmarks) / sizeof(benchmarks[0]);
+
+/**
+ * bench          - run every benchmark
+ * bench list     - list benchmarks
+ * bench <name>.. - run the named benchmarks
+ */
+void cmd_bench(int argc, char *argv[]) {
+    for (uint32_t i = 0; i < sizeof(bench_src); i++) bench_src[i] = (uint8_t)i;
+    memset(bench_line, 'k', sizeof(bench_line) - 1);
+    bench_line[sizeof(bench_line) - 1] = '\0';
+
+    if (argc >= 2 && strcmp(argv[1], "list") == 0) {
+        for (uint32_t i = 0; i < benchmarks_count; i++) {
+            printk("  %s - %s\n", benchmarks[i].name, benchmarks[i].help);
+        }
+        return;
+    }
+
+    printk("@bench-begin\n");
+    for (uint32_t i = 0; i < benchmarks_count; i++) {
+        int selected = (argc < 2);
+        for (int a = 1; a < argc && !selected; a++) {
+            selected = (strcmp(argv[a], benchmarks[i].name) == 0);
+        }
+        if (selected) benchmarks[i].func();
+    }
+    printk("@bench-end\n");
+}
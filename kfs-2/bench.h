@@ -0,0 +1,31 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stdint.h>
+
+/*
+ * In-kernel benchmark suite.
+ *
+ * Results are printed as one structured line per metric:
+ *
+ *     @bench <name> <value> <unit>
+ *
+ * which tools/perf.py collects from the serial log.  Units ending in
+ * "/s" are treated as higher-is-better, everything else as lower.
+ */
+
+typedef void (*bench_func)(void);
+
+typedef struct {
+    const char *name;
+    bench_func func;
+    const char *help;
+} bench_t;
+
+/* Emit one structured result line */
+void bench_report(const char *name, uint32_t value, const char *unit);
+
+/* Shell command: bench [name...] */
+void cmd_bench(int argc, char *argv[]);
+
+#endif /* BENCH_H */
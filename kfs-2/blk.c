@@ -0,0 +1,345 @@
+#include "blk.h"
+#include "printk.h"
+#include "bench.h"
+#include "lib.h"
+#include "cpu.h"
+#include "tsc.h"
+#include "div64.h"
+#include "printf.h"
+
+static struct blk_dev *blk_devs[BLK_MAX_DEVS];
+static int blk_devs_count;
+
+int blk_register(struct blk_dev *dev) {
+    if (blk_devs_count == BLK_MAX_DEVS) return -1;
+    dev->queue_head = dev->queue_tail = NULL;
+    dev->plugged = 0;
+    dev->inflight = 0;
+    blk_devs[blk_devs_count++] = dev;
+    return 0;
+}
+
+struct blk_dev *blk_find(const char *name) {
+    for (int i = 0; i < blk_devs_count; i++) {
+        if (!name || strcmp(blk_devs[i]->name, name) == 0) return blk_devs[i];
+    }
+    return NULL;
+}
+
+struct blk_dev *blk_get(int index) {
+    return index >= 0 && index < blk_devs_count ? blk_devs[index] : NULL;
+}
+
+/* Hand queued groups to the driver while it has room */
+static void blk_run_queue(struct blk_dev *dev) {
+    int started = 0;
+
+    while (!dev->plugged && dev->queue_head) {
+        struct blk_req *req = dev->queue_head;
+
+        if (dev->ops->submit(dev, req) < 0) break;
+        dev->queue_head = req->next;
+        if (!dev->queue_head) dev->queue_tail = NULL;
+        dev->inflight++;
+        dev->stat_commands++;
+        started = 1;
+    }
+    if (started && dev->ops->commit) dev->ops->commit(dev);
+}
+
+/* Append req to a queued group that ends where it starts */
+static int blk_try_merge(struct blk_dev *dev, struct blk_req *req) {
+    for (struct blk_req *q = dev->queue_head; q; q = q->next) {
+        struct blk_req *last = q->merge_tail;
+
+        if (q->op != req->op || last->sector + last->nsectors != req->sector) continue;
+        if (q->merge_segs + req->nseg > dev->max_segs ||
+            q->merge_sectors + req->nsectors > dev->max_sectors) continue;
+
+        last->merge_next = req;
+        q->merge_tail = req;
+        q->merge_segs += req->nseg;
+        q->merge_sectors += req->nsectors;
+        dev->stat_merged++;
+        return 1;
+    }
+    return 0;
+}
+
+int blk_submit(struct blk_dev *dev, struct blk_req *req) {
+    uint32_t bytes = 0;
+
+    if (req->nseg == 0 || req->nseg > BLK_MAX_SEGS) return -1;
+    if (req->op == BLK_WRITE && dev->read_only) return -1;
+    for (int i = 0; i < req->nseg; i++) {
+        if (req->seg[i].len == 0 || (req->seg[i].len & (BLK_SECTOR_SIZE - 1))) return -1;
+        bytes += req->seg[i].len;
+    }
+
+    req->nsectors = bytes >> BLK_SECTOR_SHIFT;
+    if (req->nsectors > dev->max_sectors || req->nseg > dev->max_segs) return -1;
+    if (req->sector >= dev->nsectors || dev->nsectors - req->sector < req->nsectors) return -1;
+
+    req->status = BLK_OK;
+    req->next = NULL;
+    req->merge_next = NULL;
+    req->merge_tail = req;
+    req->merge_sectors = req->nsectors;
+    req->merge_segs = req->nseg;
+
+    uint32_t flags = irq_save();
+    dev->stat_reqs++;
+    if (!blk_try_merge(dev, req)) {
+        if (dev->queue_tail) dev->queue_tail->next = req;
+        else dev->queue_head = req;
+        dev->queue_tail = req;
+    }
+    blk_run_queue(dev);
+    irq_restore(flags);
+    return 0;
+}
+
+void blk_plug(struct blk_dev *dev) {
+    uint32_t flags = irq_save();
+    dev->plugged++;
+    irq_restore(flags);
+}
+
+void blk_unplug(struct blk_dev *dev) {
+    uint32_t flags = irq_save();
+    if (dev->plugged && --dev->plugged == 0) blk_run_queue(dev);
+    irq_restore(flags);
+}
+
+void blk_complete(struct blk_dev *dev, struct blk_req *req, int status) {
+    dev->inflight--;
+
+    /* Requests resubmitted by the callbacks are queued, merged, and
+     * started together afterwards */
+    dev->plugged++;
+    while (req) {
+        struct blk_req *next = req->merge_next;
+        req->status = status;
+        if (req->done) req->done(req);
+        req = next;
+    }
+    dev->plugged--;
+    if (!dev->plugged) blk_run_queue(dev);
+}
+
+static void blk_rw_done(struct blk_req *req) {
+    *(volatile int *)req->priv = 1;
+}
+
+int blk_rw(struct blk_dev *dev, int op, uint64_t sector, void *buf, uint32_t count) {
+    uint8_t *p = buf;
+
+    while (count) {
+        uint32_t n = count < dev->max_sectors ? count : dev->max_sectors;
+        volatile int done = 0;
+        struct blk_req req;
+
+        req.sector = sector;
+        req.op = (uint8_t)op;
+        req.nseg = 1;
+        req.seg[0].buf = p;
+        req.seg[0].len = n << BLK_SECTOR_SHIFT;
+        req.done = blk_rw_done;
+        req.priv = (void *)&done;
+        if (blk_submit(dev, &req) < 0) return BLK_EIO;
+        while (!done) __asm__ volatile ("hlt");
+        if (req.status != BLK_OK) return BLK_EIO;
+
+        sector += n;
+        p += n << BLK_SECTOR_SHIFT;
+        count -= n;
+    }
+    return BLK_OK;
+}
+
+void cmd_lsblk(int argc, char *argv[]) {
+    (void)argc;
+    (void)argv;
+
+    if (blk_devs_count == 0) {
+        printk("no block devices\n");
+        return;
+    }
+    for (int i = 0; i < blk_devs_count; i++) {
+        struct blk_dev *dev = blk_devs[i];
+        printk("%-8s %6u MB  %s  reqs %u, merged %u, commands %u\n", dev->name,
+               (uint32_t)(dev->nsectors >> (20 - BLK_SECTOR_SHIFT)), dev->read_only ? "ro" : "rw",
+               dev->stat_reqs, dev->stat_merged, dev->stat_commands);
+    }
+}
+
+/* Benchmark: keeps qd reads of BLKBENCH_IO bytes outstanding, refilling
+ * from the completion callback */
+
+#define BLKBENCH_IO         4096
+#define BLKBENCH_MAX_QD     32
+#define BLKBENCH_BYTES      (8u << 20)      /* Per run */
+
+struct blkbench_run {
+    struct blk_dev *dev;
+    int random;
+    uint32_t total;
+    uint32_t issued;
+    volatile uint32_t completed;
+    uint32_t errors;
+    uint32_t next;                  /* Sequential position, in I/O units */
+    uint32_t span;                  /* Device size, in I/O units */
+    uint32_t rng;
+    uint64_t lat_cycles;            /* Sum of submit-to-completion times */
+    uint64_t submitted[BLKBENCH_MAX_QD];
+};
+
+struct blkbench_result {
+    uint32_t iops;
+    uint32_t kbps;
+    uint32_t lat_us;                /* Average completion latency */
+    uint32_t merged;
+};
+
+static struct blkbench_run bb;
+static struct blk_req blkbench_reqs[BLKBENCH_MAX_QD];
+static uint8_t blkbench_buf[BLKBENCH_MAX_QD][BLKBENCH_IO] __attribute__((aligned(4096)));
+
+static void blkbench_done(struct blk_req *req);
+
+static void blkbench_issue(struct blk_req *req) {
+    uint32_t unit;
+
+    if (bb.random) {
+        bb.rng = bb.rng * 1664525u + 1013904223u;
+        unit = (bb.rng >> 8) % bb.span;
+    } else {
+        unit = bb.next++;
+        if (bb.next == bb.span) bb.next = 0;
+    }
+
+    req->sector = (uint64_t)unit * (BLKBENCH_IO / BLK_SECTOR_SIZE);
+    req->op = BLK_READ;
+    req->nseg = 1;
+    req->seg[0].buf = blkbench_buf[req - blkbench_reqs];
+    req->seg[0].len = BLKBENCH_IO;
+    req->done = blkbench_done;
+    bb.submitted[req - blkbench_reqs] = rdtsc();
+    bb.issued++;
+    if (blk_submit(bb.dev, req) < 0) {
+        bb.errors++;
+        bb.completed++;
+    }
+}
+
+static void blkbench_done(struct blk_req *req) {
+    if (req->status != BLK_OK) bb.errors++;
+    bb.lat_cycles += rdtsc() - bb.submitted[req - blkbench_reqs];
+    bb.completed++;
+    if (bb.issued < bb.total) blkbench_issue(req);
+}
+
+/* One run; fills in requests/s, KB/s and average latency */
+static int blkbench_run(struct blk_dev *dev, int random, uint32_t qd, struct blkbench_result *res) {
+    uint64_t span = (dev->nsectors * BLK_SECTOR_SIZE) / BLKBENCH_IO;
+
+    if (span == 0) return -1;
+    if (qd > BLKBENCH_MAX_QD) qd = BLKBENCH_MAX_QD;
+
+    bb.dev = dev;
+    bb.random = random;
+    bb.total = BLKBENCH_BYTES / BLKBENCH_IO;
+    bb.issued = 0;
+    bb.completed = 0;
+    bb.errors = 0;
+    bb.next = 0;
+    bb.span = span > 0xFFFFFFFFu ? 0xFFFFFFFFu : (uint32_t)span;
+    bb.rng = 12345;
+    bb.lat_cycles = 0;
+
+    uint32_t merges = dev->stat_merged;
+    uint64_t start = rdtsc();
+
+    blk_plug(dev);
+    for (uint32_t i = 0; i < qd && bb.issued < bb.total; i++) blkbench_issue(&blkbench_reqs[i]);
+    blk_unplug(dev);
+    while (bb.completed < bb.issued || (bb.issued < bb.total && !bb.errors)) __asm__ volatile ("hlt");
+
+    uint32_t us = tsc_cycles_to_us(rdtsc() - start);
+    if (us == 0) us = 1;
+
+    res->iops = (uint32_t)div64_u32((uint64_t)bb.total * 1000000, us, NULL);
+    res->kbps = (uint32_t)div64_u32((uint64_t)bb.total * (BLKBENCH_IO / 1024) * 1000000, us, NULL);
+    res->lat_us = tsc_cycles_to_us(div64_u32(bb.lat_cycles, bb.total, NULL));
+    res->merged = dev->stat_merged - merges;
+    return bb.errors ? -1 : 0;
+}
+
+void cmd_blkbench(int argc, char *argv[]) {
+    static const uint32_t default_qd[] = { 1, 4, 16, 32 };
+    uint32_t qds[8];
+    int nqd = 0;
+    const char *name = NULL;
+
+    for (int i = 1; i < argc; i++) {
+        if (argv[i][0] >= '0' && argv[i][0] <= '9') {
+            if (nqd < 8 && atoi(argv[i]) > 0) qds[nqd++] = (uint32_t)atoi(argv[i]);
+        } else {
+            name = argv[i];
+        }
+    }
+    if (nqd == 0) {
+        for (nqd = 0; nqd < 4; nqd++) qds[nqd] = default_qd[nqd];
+    }
+
+    struct blk_dev *dev = blk_find(name);
+    if (!dev) {
+        printk("blkbench: no block device%s%s\n", name ? " " : "", name ? name : "");
+        return;
+    }
+
+    printk("%s: %u KB reads, %u MB per run\n", dev->name, BLKBENCH_IO / 1024, BLKBENCH_BYTES >> 20);
+    printk("pattern  qd      req/s      KB/s  lat(us)  merged\n");
+    for (int random = 0; random < 2; random++) {
+        for (int i = 0; i < nqd; i++) {
+            struct blkbench_result res;
+            if (blkbench_run(dev, random, qds[i], &res) < 0) {
+                printk("%-7s %3u  I/O error\n", random ? "random" : "seq", qds[i]);
+                continue;
+            }
+            printk("%-7s %3u %10u %9u %8u %7u\n", random ? "random" : "seq",
+                   qds[i] > BLKBENCH_MAX_QD ? BLKBENCH_MAX_QD : qds[i],
+                   res.iops, res.kbps, res.lat_us, res.merged);
+        }
+    }
+}
+
+void bench_blk(void) {
+    static const uint32_t qds[] = { 1, 32 };
+    char prefix[16], name[32];
+
+    if (blk_devs_count == 0) {
+        printk("blk: no block device\n");
+        return;
+    }
+    /* The first device keeps the plain blk_ names */
+    for (int d = 0; d < blk_devs_count; d++) {
+        struct blk_dev *dev = blk_devs[d];
+        if (d == 0) snprintf(prefix, sizeof(prefix), "blk");
+        else snprintf(prefix, sizeof(prefix), "blk_%s", dev->name);
+
+        for (int random = 0; random < 2; random++) {
+            for (int i = 0; i < 2; i++) {
+                struct blkbench_result res;
+                const char *pattern = random ? "rand" : "seq";
+                if (blkbench_run(dev, random, qds[i], &res) < 0) continue;
+                snprintf(name, sizeof(name), "%s_%s_qd%u", prefix, pattern, qds[i]);
+                bench_report(name, res.iops, "req/s");
+                snprintf(name, sizeof(name), "%s_%s_qd%u_kb", prefix, pattern, qds[i]);
+                bench_report(name, res.kbps, "KB/s");
+                snprintf(name, sizeof(name), "%s_%s_qd%u_lat", prefix, pattern, qds[i]);
+                bench_report(name, res.lat_us, "us");
+            }
+        }
+    }
+}
@@ -0,0 +1,127 @@
+#ifndef BLK_H
+#define BLK_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * Block layer: asynchronous requests on 512-byte sectors.
+ *
+ * blk_submit() queues a request and returns.  Its done callback runs
+ * when the request completes, usually from the driver's interrupt
+ * handler, and may submit new requests.  A request describes one
+ * contiguous sector range and scatters it over up to BLK_MAX_SEGS
+ * buffers.
+ *
+ * A request that starts where a queued one ends (same direction) is
+ * merged into it, so the driver sees one command with the segments of
+ * both.  Requests wait in the queue only while the device has no room or
+ * the queue is plugged (blk_plug()); callbacks run by blk_complete() are
+ * plugged too, so requests resubmitted from completions merge again.
+ */
+
+#define BLK_SECTOR_SIZE     512
+#define BLK_SECTOR_SHIFT    9
+#define BLK_MAX_SEGS        8       /* Segments per request */
+
+/* Operations */
+#define BLK_READ            0
+#define BLK_WRITE           1
+
+/* Status */
+#define BLK_OK              0
+#define BLK_EIO             (-1)
+
+struct blk_req;
+struct blk_dev;
+
+typedef void (*blk_done_fn)(struct blk_req *req);
+
+struct blk_seg {
+    void *buf;
+    uint32_t len;                   /* Multiple of BLK_SECTOR_SIZE */
+};
+
+struct blk_req {
+    /* Filled by the caller */
+    uint64_t sector;
+    uint8_t op;                     /* BLK_READ / BLK_WRITE */
+    uint8_t nseg;
+    struct blk_seg seg[BLK_MAX_SEGS];
+    blk_done_fn done;               /* Completion callback, may be NULL */
+    void *priv;
+
+    /* Set on completion */
+    int status;                     /* BLK_OK or BLK_EIO */
+
+    /* Block layer */
+    uint32_t nsectors;
+    struct blk_req *next;           /* Queue link */
+    struct blk_req *merge_next;     /* Requests merged behind this one */
+    struct blk_req *merge_tail;
+    uint32_t merge_sectors;         /* Totals of the merged group */
+    uint32_t merge_segs;
+};
+
+struct blk_ops {
+    /* Start the request group headed by req (walk merge_next for the
+     * rest).  Returns 0, or -1 if the device has no room right now. */
+    int (*submit)(struct blk_dev *dev, struct blk_req *req);
+    /* Optional: make everything submitted so far visible to the device
+     * (one doorbell for a batch) */
+    void (*commit)(struct blk_dev *dev);
+};
+
+struct blk_dev {
+    const char *name;
+    uint64_t nsectors;
+    const struct blk_ops *ops;
+    void *priv;
+    uint32_t max_segs;              /* Per driver command, merges included */
+    uint32_t max_sectors;
+    uint8_t read_only;
+
+    /* Block layer state */
+    struct blk_req *queue_head;
+    struct blk_req *queue_tail;
+    uint32_t plugged;
+    uint32_t inflight;              /* Driver commands */
+    uint32_t stat_reqs;
+    uint32_t stat_merged;
+    uint32_t stat_commands;
+};
+
+#define BLK_MAX_DEVS        4
+
+/* Add a device; returns -1 if the table is full */
+int blk_register(struct blk_dev *dev);
+
+/* Device by name, or the first one if name is NULL; NULL if none */
+struct blk_dev *blk_find(const char *name);
+
+/* Device by registration order (lsblk order); NULL past the end */
+struct blk_dev *blk_get(int index);
+
+/* Queue req.  Returns 0, or -1 without calling done if the request is
+ * malformed, out of range or writes a read-only device. */
+int blk_submit(struct blk_dev *dev, struct blk_req *req);
+
+/* Hold requests in the queue (for merging) until the matching unplug */
+void blk_plug(struct blk_dev *dev);
+void blk_unplug(struct blk_dev *dev);
+
+/* Driver side: the group headed by req finished with status */
+void blk_complete(struct blk_dev *dev, struct blk_req *req, int status);
+
+/* Synchronous read/write of count sectors into one buffer; waits with
+ * hlt, so interrupts must be enabled.  Returns BLK_OK or BLK_EIO. */
+int blk_rw(struct blk_dev *dev, int op, uint64_t sector, void *buf, uint32_t count);
+
+/* Shell commands: lsblk, blkbench [dev] [qd...] */
+void cmd_lsblk(int argc, char *argv[]);
+void cmd_blkbench(int argc, char *argv[]);
+
+/* Benchmark: sequential/random 4 KB reads at QD 1 and 32 */
+void bench_blk(void);
+
+#endif /* BLK_H */
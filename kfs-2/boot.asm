@@ -2,16 +2,25 @@ BITS 32 ; 32-битный код (GRUB уже перевёл процессор
 
 section .multiboot ; Секция заголовка Multiboot v1
 align 4            ; Выравнивание заголовка на 4 байта
+MB_FLAGS equ 0x3  ; бит 0: модули выровнены на 4 КБ, бит 1: сведения о памяти
     dd 0x1BADB002  ; magic — сигнатура Multiboot
-    dd 0x0         ; flags = 0 (никаких дополнительных требований)
-    dd -(0x1BADB002 + 0x0) ; checksum: magic + flags + checksum == 0
+    dd MB_FLAGS    ; flags — требования к загрузчику
+    dd -(0x1BADB002 + MB_FLAGS) ; checksum: magic + flags + checksum == 0
 
 section .text      ; Кодовая секция
 global start       ; Экспорт точки входа для линковщика
+global boot_tsc_start ; TSC в момент входа в ядро (читается в boottime.c)
+global stack_space  ; Границы стека ядра — для обхода цепочки кадров (EBP)
+global stack_end
 extern kmain       ; Внешняя C-функция (определена в kernel.c)
 
 start:             ; Точка входа ядра
     cli           ; Отключить прерывания на время начальной инициализации
+    mov ecx, eax   ; Сохранить magic: rdtsc затирает EAX и EDX
+    rdtsc          ; EDX:EAX = счётчик тактов — начало отсчёта времени загрузки
+    mov [boot_tsc_start], eax     ; Младшие 32 бита TSC
+    mov [boot_tsc_start + 4], edx ; Старшие 32 бита TSC
+    mov eax, ecx   ; Вернуть magic в EAX
     mov esp, stack_end ; Инициализировать указатель стека вершиной заранее выделенной области
     ; Multiboot v1: при входе EAX=magic (0x2BADB002), EBX=адрес multiboot_info
     ; Передадим их в kmain по cdecl через стек: сначала EBX, затем EAX
@@ -24,6 +33,10 @@ start:             ; Точка входа ядра
     hlt            ; Остановить CPU до следующего события/прерывания
     jmp .hang      ; Зациклиться навсегда
 
+section .data      ; Инициализированные данные
+align 8
+boot_tsc_start: dq 0 ; 64-битное значение TSC, записанное в start
+
 section .bss       ; Неинициализированные данные
 align 16           ; Выравнивание стека по 16 байт (ABI-дружелюбно)
 stack_space:    resb 8192  ; 8 КБ под стек
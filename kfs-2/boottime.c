@@ -0,0 +1,78 @@
+#include "boottime.h"
+#include "printk.h"
+#include "bench.h"
+#include "tsc.h"
+
+struct boot_phase {
+    const char *name;
+    uint64_t tsc;
+};
+
+static struct boot_phase boot_phases[BOOT_PHASES_MAX];
+static uint32_t boot_phases_count = 0;
+
+#ifdef CONFIG_FASTBOOT
+static int boot_fast = 1;
+#else
+static int boot_fast = 0;
+#endif
+
+void boot_phase(const char *name) {
+    if (boot_phases_count >= BOOT_PHASES_MAX) return;
+
+    boot_phases[boot_phases_count].name = name;
+    boot_phases[boot_phases_count].tsc = rdtsc();
+    boot_phases_count++;
+}
+
+void boot_set_fast(int fast) {
+    boot_fast = fast;
+}
+
+int boot_is_fast(void) {
+    return boot_fast;
+}
+
+void cmd_boottime(int argc, char *argv[]) {
+    (void)argc;
+    (void)argv;
+    
+    uint64_t prev = boot_tsc_start;
+    
+    if (tsc_khz == 0) tsc_calibrate();
+    
+    printk("\n========== BOOT TIME ==========\n");
+    printk("TSC: %d kHz, fast boot: %s\n\n", (int)tsc_khz, boot_fast ? "on" : "off");
+    
+    for (uint32_t i = 0; i < boot_phases_count; i++) {
+        uint32_t delta = tsc_cycles_to_us(boot_phases[i].tsc - prev);
+        uint32_t total = tsc_cycles_to_us(boot_phases[i].tsc - boot_tsc_start);
+        
+        printk("  %s: +%d us (at %d us)\n", boot_phases[i].name, (int)delta, (int)total);
+        prev = boot_phases[i].tsc;
+    }
+    printk("===============================\n\n");
+}
+
+/* Report every phase, plus the total, as benchmark results */
+void bench_boottime(void) {
+    uint64_t prev = boot_tsc_start;
+    
+    for (uint32_t i = 0; i < boot_phases_count; i++) {
+        char name[32] = "boot_";
+        uint32_t len = 5;
+        
+        for (const char *p = boot_phases[i].name; *p && len < sizeof(name) - 1; p++) {
+            name[len++] = *p;
+        }
+        name[len] = '\0';
+        
+        bench_report(name, tsc_cycles_to_us(boot_phases[i].tsc - prev), "us");
+        prev = boot_phases[i].tsc;
+    }
+    
+    if (boot_phases_count > 0) {
+        bench_report("boot_to_prompt",
+                     tsc_cycles_to_us(boot_phases[boot_phases_count - 1].tsc - boot_tsc_start), "us");
+    }
+}
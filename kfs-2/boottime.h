@@ -0,0 +1,30 @@
+#ifndef BOOTTIME_H
+#define BOOTTIME_H
+
+#include <stdint.h>
+
+/*
+ * Boot-phase timing.
+ *
+ * boot.asm stores the TSC in boot_tsc_start as its very first action;
+ * kmain() and the shell then call boot_phase() at the end of every init
+ * step.  The `boottime` command prints the per-phase breakdown.
+ */
+
+#define BOOT_PHASES_MAX 16
+
+/* TSC value sampled at `start` in boot.asm */
+extern uint64_t boot_tsc_start;
+
+/* Record the end of the named phase (name must be a string literal) */
+void boot_phase(const char *name);
+
+/* Fast boot: skip the banner, init chatter and shell demo replay */
+void boot_set_fast(int fast);
+int boot_is_fast(void);
+
+/* Shell command and benchmark */
+void cmd_boottime(int argc, char *argv[]);
+void bench_boottime(void);
+
+#endif /* BOOTTIME_H */
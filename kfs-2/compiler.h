@@ -0,0 +1,20 @@
+#ifndef COMPILER_H
+#define COMPILER_H
+
+/*
+ * Placement hints for the function layout in linker.ld.
+ *
+ * With optimisation on, GCC puts __hot functions in .text.hot.<name> and
+ * __cold ones in .text.unlikely.<name>, and treats calls to __cold
+ * functions as unlikely branches.  linker.ld keeps the hot functions
+ * together and moves the cold ones off the pages the hot paths use.  A
+ * profile-guided build (PROFILE=pgo) finds the rest by itself.
+ *
+ * __hot:  IRQ entry, printk, memcpy, shell dispatch
+ * __cold: fault reports, help and usage output
+ */
+
+#define __hot           __attribute__((hot))
+#define __cold          __attribute__((cold))
+
+#endif /* COMPILER_H */
@@ -0,0 +1,481 @@
+#include "console.h"
+#include "bench.h"
+#include "tsc.h"
+#include "div64.h"
+#include "lib.h"
+#include "printf.h"
+#include "timer.h"
+#include "cpu.h"
+#include "printk.h"
+
+/* CRT controller */
+#define CRTC_INDEX          0x3D4
+#define CRTC_DATA           0x3D5
+#define CRTC_START_HIGH     0x0C
+#define CRTC_START_LOW      0x0D
+#define CRTC_CURSOR_HIGH    0x0E
+#define CRTC_CURSOR_LOW     0x0F
+
+#define VGA_MEMORY          ((volatile uint16_t *)0xB8000)
+#define VGA_BLANK           ((uint16_t)(' ' | (CONSOLE_ATTR << 8)))
+
+/* Escape decoder states */
+#define ESC_NONE            0
+#define ESC_START           1   /* Got ESC */
+#define ESC_CSI             2   /* Got ESC [ */
+
+struct vt {
+    uint16_t shadow[VT_LINES * VGA_COLS];   /* Mirror of this terminal's VGA page */
+    uint32_t dirty[(VT_LINES + 31) / 32];   /* Lines not yet flushed */
+    uint32_t base;              /* First VGA memory line of the page */
+    uint32_t top;               /* Page line shown at screen row 0 */
+    uint32_t row, col;          /* Cursor, relative to top */
+    uint8_t attr;
+    uint8_t esc;                /* ESC_* state */
+    uint8_t esc_param;          /* First numeric CSI parameter */
+    uint8_t utf8_left;          /* Continuation bytes still expected */
+    uint32_t utf8_cp;           /* Code point being decoded */
+    uint8_t pending;            /* Has dirty lines */
+    uint32_t bytes;             /* Bytes rendered */
+    uint32_t wraps;             /* Screen copies back to the top of the page */
+};
+
+static struct vt vts[NR_VTS];
+static int active_vt;
+static uint8_t start_dirty;     /* CRTC start address needs rewriting */
+static uint16_t hw_cursor;      /* Cursor offset last written to the CRTC */
+static uint32_t vt_switches;
+static uint32_t console_flushes;
+static uint32_t stats_jiffies;  /* Last stats terminal refresh */
+static uint8_t log_bol = 1;     /* Log terminal is at the start of a line */
+static uint8_t log_esc;         /* ESC_* state of the printk stream */
+
+static inline void outb(uint16_t port, uint8_t val) {
+    __asm__ volatile ("outb %0, %1" : : "a"(val), "Nd"(port));
+}
+
+static inline void crtc_write(uint8_t reg, uint8_t val) {
+    outb(CRTC_INDEX, reg);
+    outb(CRTC_DATA, val);
+}
+
+/* Bulk copy to VGA memory with 32-bit stores (cells must be even) */
+static inline void vga_copy(volatile uint16_t *dst, const uint16_t *src, uint32_t cells) {
+    uint32_t dwords = cells / 2;
+    __asm__ volatile ("rep movsl" : "+D"(dst), "+S"(src), "+c"(dwords) : : "memory");
+}
+
+static inline uint16_t *vt_line(struct vt *t, uint32_t line) {
+    return &t->shadow[line * VGA_COLS];
+}
+
+static inline void vt_mark_dirty(struct vt *t, uint32_t line) {
+    t->dirty[line / 32] |= 1u << (line % 32);
+    t->pending = 1;
+}
+
+static void vt_clear_line(struct vt *t, uint32_t line) {
+    uint16_t *p = vt_line(t, line);
+    for (uint32_t i = 0; i < VGA_COLS; i++) p[i] = VGA_BLANK;
+    vt_mark_dirty(t, line);
+}
+
+static void vt_newline(struct vt *t) {
+    if (t->row < VGA_ROWS - 1) {
+        t->row++;
+        return;
+    }
+
+    if (t->top + VGA_ROWS < VT_LINES) {
+        /* Hardware scroll: show the next line of the page */
+        t->top++;
+    } else {
+        /* Out of page: move the visible screen back to the top */
+        memcpy(vt_line(t, 0), vt_line(t, t->top + 1), (VGA_ROWS - 1) * VGA_COLS * sizeof(uint16_t));
+        for (uint32_t line = 0; line < VGA_ROWS - 1; line++) vt_mark_dirty(t, line);
+        t->top = 0;
+        t->wraps++;
+    }
+    vt_clear_line(t, t->top + VGA_ROWS - 1);
+    if (t == &vts[active_vt]) start_dirty = 1;
+}
+
+static void vt_put(struct vt *t, uint8_t ch) {
+    uint32_t line = t->top + t->row;
+
+    vt_line(t, line)[t->col] = (uint16_t)(ch | (t->attr << 8));
+    vt_mark_dirty(t, line);
+    if (++t->col == VGA_COLS) {
+        t->col = 0;
+        vt_newline(t);
+    }
+}
+
+static void vt_clear_screen(struct vt *t) {
+    for (uint32_t row = 0; row < VGA_ROWS; row++) vt_clear_line(t, t->top + row);
+    t->row = 0;
+    t->col = 0;
+}
+
+/* Handle the final byte of an ESC [ <n> <final> sequence */
+static void vt_csi(struct vt *t, uint8_t final) {
+    switch (final) {
+        case 'J':   /* Erase display */
+            vt_clear_screen(t);
+            break;
+        case 'H':   /* Cursor home */
+            t->row = 0;
+            t->col = 0;
+            break;
+        case 'K': { /* Erase to end of line */
+            uint16_t *p = vt_line(t, t->top + t->row);
+            for (uint32_t c = t->col; c < VGA_COLS; c++) p[c] = VGA_BLANK;
+            vt_mark_dirty(t, t->top + t->row);
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+/* Map the UTF-8 box-drawing characters used by the shell banner to CP437 */
+static uint8_t vt_cp437(uint32_t cp) {
+    switch (cp) {
+        case 0x2550: return 0xCD;   /* ═ */
+        case 0x2551: return 0xBA;   /* ║ */
+        case 0x2554: return 0xC9;   /* ╔ */
+        case 0x2557: return 0xBB;   /* ╗ */
+        case 0x255A: return 0xC8;   /* ╚ */
+        case 0x255D: return 0xBC;   /* ╝ */
+        default:     return '?';
+    }
+}
+
+static void vt_byte(struct vt *t, uint8_t ch) {
+    if (t->esc == ESC_START) {
+        t->esc = (ch == '[') ? ESC_CSI : ESC_NONE;
+        t->esc_param = 0;
+        return;
+    }
+    if (t->esc == ESC_CSI) {
+        if (ch >= '0' && ch <= '9') {
+            t->esc_param = (uint8_t)(t->esc_param * 10 + (ch - '0'));
+        } else if (ch != ';') {
+            vt_csi(t, ch);
+            t->esc = ESC_NONE;
+        }
+        return;
+    }
+
+    if (t->utf8_left) {
+        if ((ch & 0xC0) == 0x80) {
+            t->utf8_cp = (t->utf8_cp << 6) | (ch & 0x3F);
+            if (--t->utf8_left == 0) vt_put(t, vt_cp437(t->utf8_cp));
+            return;
+        }
+        t->utf8_left = 0;   /* Malformed: drop the partial character */
+    }
+
+    if (ch >= 0x80) {
+        if ((ch & 0xE0) == 0xC0)      { t->utf8_cp = ch & 0x1F; t->utf8_left = 1; }
+        else if ((ch & 0xF0) == 0xE0) { t->utf8_cp = ch & 0x0F; t->utf8_left = 2; }
+        else if ((ch & 0xF8) == 0xF0) { t->utf8_cp = ch & 0x07; t->utf8_left = 3; }
+        return;
+    }
+
+    switch (ch) {
+        case '\n':
+            t->col = 0;
+            vt_newline(t);
+            break;
+        case '\r':
+            t->col = 0;
+            break;
+        case '\b':
+            if (t->col > 0) t->col--;
+            break;
+        case '\t':
+            do vt_put(t, ' '); while (t->col % 8 != 0);
+            break;
+        case 0x1B:
+            t->esc = ESC_START;
+            break;
+        default:
+            if (ch >= 0x20) vt_put(t, ch);
+            break;
+    }
+}
+
+void vt_render(int vt, const char *s, size_t len) {
+    struct vt *t = &vts[vt];
+
+    for (size_t i = 0; i < len; i++) vt_byte(t, (uint8_t)s[i]);
+    t->bytes += len;
+}
+
+static void vt_flush(struct vt *t) {
+    volatile uint16_t *vga = VGA_MEMORY + t->base * VGA_COLS;
+
+    for (uint32_t line = t->top; line < t->top + VGA_ROWS; line++) {
+        if (t->dirty[line / 32] & (1u << (line % 32))) {
+            vga_copy(vga + line * VGA_COLS, vt_line(t, line), VGA_COLS);
+        }
+    }
+    memset(t->dirty, 0, sizeof(t->dirty));
+    t->pending = 0;
+}
+
+void console_flush(void) {
+    for (int i = 0; i < NR_VTS; i++) {
+        if (vts[i].pending) vt_flush(&vts[i]);
+    }
+    console_flushes++;
+
+    /* Alt+Fn switches from IRQ context, so read active_vt once */
+    uint32_t flags = irq_save();
+    struct vt *t = &vts[active_vt];
+
+    if (start_dirty) {
+        uint16_t start = (uint16_t)((t->base + t->top) * VGA_COLS);
+        crtc_write(CRTC_START_HIGH, start >> 8);
+        crtc_write(CRTC_START_LOW, start & 0xFF);
+        start_dirty = 0;
+    }
+
+    uint16_t cursor = (uint16_t)((t->base + t->top + t->row) * VGA_COLS + t->col);
+    if (cursor != hw_cursor) {
+        crtc_write(CRTC_CURSOR_HIGH, cursor >> 8);
+        crtc_write(CRTC_CURSOR_LOW, cursor & 0xFF);
+        hw_cursor = cursor;
+    }
+    irq_restore(flags);
+}
+
+void vt_write(int vt, const char *s, size_t len) {
+    vt_render(vt, s, len);
+    console_flush();
+}
+
+/*
+ * Copy printk output to the log terminal, stamping each line with the
+ * uptime.  Escape sequences are for the live terminals and are dropped
+ * here, so a clear screen cannot wipe the log.
+ */
+static void log_render(const char *s, size_t len) {
+    char stamp[16];
+
+    while (len > 0) {
+        if (log_esc != ESC_NONE || *s == '\033') {
+            char ch = *s++;
+            len--;
+            if (ch == '\033')
+                log_esc = ESC_START;
+            else if (log_esc == ESC_START)
+                log_esc = (ch == '[') ? ESC_CSI : ESC_NONE;
+            else if (!(ch >= '0' && ch <= '9') && ch != ';')
+                log_esc = ESC_NONE;     /* Final byte */
+            continue;
+        }
+
+        /* Stamp only once the line has something to show */
+        if (log_bol) {
+            uint32_t j = jiffies;
+            int n = snprintf(stamp, sizeof(stamp), "[%5u.%03u] ",
+                             j / TIMER_HZ, (j % TIMER_HZ) * 1000 / TIMER_HZ);
+            vt_render(VT_LOG, stamp, (size_t)n);
+            log_bol = 0;
+        }
+
+        size_t n = 0;
+        while (n < len && s[n] != '\n' && s[n] != '\033') n++;
+        if (n < len && s[n] == '\n') {
+            n++;
+            log_bol = 1;
+        }
+        vt_render(VT_LOG, s, n);
+        s += n;
+        len -= n;
+    }
+}
+
+static void console_sink_write(const char *s, size_t len) {
+    vt_render(VT_SHELL, s, len);
+    log_render(s, len);
+}
+
+/* printk sink: chunks are rendered as they arrive, flushed once per message */
+static struct printk_sink console_sink = {
+    .name  = "vga",
+    .write = console_sink_write,
+    .flush = console_flush,
+    .level = LOGLEVEL_DEBUG,
+    .enabled = 1,
+};
+
+void console_write(const char *s, size_t len) {
+    console_sink_write(s, len);
+    console_flush();
+}
+
+void vt_switch(int vt) {
+    if (vt < 0 || vt >= NR_VTS) return;
+
+    uint32_t flags = irq_save();
+    struct vt *t = &vts[vt];
+    uint16_t start = (uint16_t)((t->base + t->top) * VGA_COLS);
+    uint16_t cursor = (uint16_t)((t->base + t->top + t->row) * VGA_COLS + t->col);
+
+    active_vt = vt;
+    crtc_write(CRTC_START_HIGH, start >> 8);
+    crtc_write(CRTC_START_LOW, start & 0xFF);
+    crtc_write(CRTC_CURSOR_HIGH, cursor >> 8);
+    crtc_write(CRTC_CURSOR_LOW, cursor & 0xFF);
+    hw_cursor = cursor;
+    start_dirty = 0;
+    vt_switches++;
+    irq_restore(flags);
+}
+
+int vt_active(void) {
+    return active_vt;
+}
+
+void console_redraw(void) {
+    struct vt *t = &vts[active_vt];
+
+    for (uint32_t row = 0; row < VGA_ROWS; row++) vt_mark_dirty(t, t->top + row);
+    start_dirty = 1;
+    hw_cursor = 0xFFFF;
+    console_flush();
+}
+
+static void stats_refresh(void) {
+    static const char *const names[NR_VTS] = {"shell", "log", "stats", "spare"};
+    char line[96];
+    uint32_t j = jiffies;
+    int n;
+
+    n = snprintf(line, sizeof(line), "\033[HConsole statistics      uptime %u.%03u s\033[K\n\n",
+                 j / TIMER_HZ, (j % TIMER_HZ) * 1000 / TIMER_HZ);
+    vt_render(VT_STATS, line, (size_t)n);
+    for (int i = 0; i < NR_VTS; i++) {
+        n = snprintf(line, sizeof(line), "  Alt+F%d %s: %u bytes, %u wraps, top line %u\033[K\n",
+                     i + 1, names[i], vts[i].bytes, vts[i].wraps, vts[i].top);
+        vt_render(VT_STATS, line, (size_t)n);
+    }
+    n = snprintf(line, sizeof(line), "\n  flushes %u, switches %u, active Alt+F%d\033[K\n",
+                 console_flushes, vt_switches, active_vt + 1);
+    vt_render(VT_STATS, line, (size_t)n);
+    console_flush();
+}
+
+void console_poll(void) {
+    if (jiffies - stats_jiffies >= TIMER_HZ) {
+        stats_jiffies = jiffies;
+        stats_refresh();
+    }
+}
+
+uint32_t console_poll_delay(void) {
+    uint32_t since = jiffies - stats_jiffies;
+    return since >= TIMER_HZ ? 0 : TIMER_HZ - since;
+}
+
+void console_init(void) {
+    for (int i = 0; i < NR_VTS; i++) {
+        vts[i].base = (uint32_t)i * VT_LINES;
+        vts[i].attr = CONSOLE_ATTR;
+        vts[i].top = 0;
+        vt_clear_screen(&vts[i]);
+    }
+    active_vt = VT_SHELL;
+    console_redraw();
+    printk_register_sink(&console_sink);
+}
+
+void cmd_vt(int argc, char *argv[]) {
+    if (argc > 1) {
+        int vt = atoi(argv[1]);
+        if (vt < 1 || vt > NR_VTS) {
+            printk("vt: terminal must be 1-%d\n", NR_VTS);
+            return;
+        }
+        vt_switch(vt - 1);
+        return;
+    }
+    printk("Active terminal: %d (Alt+F1 shell, Alt+F2 log, Alt+F3 stats, Alt+F4 spare)\n",
+           active_vt + 1);
+}
+
+/* Naive output as done before this driver: every cell, cursor update and
+ * scroll goes straight to VGA memory and the CRTC */
+static uint32_t naive_pos;
+
+static void naive_putc(char ch) {
+    volatile uint16_t *vga = VGA_MEMORY;
+
+    if (ch == '\n') {
+        naive_pos += VGA_COLS - naive_pos % VGA_COLS;
+    } else {
+        vga[naive_pos++] = (uint16_t)(ch | (CONSOLE_ATTR << 8));
+    }
+    if (naive_pos >= VGA_ROWS * VGA_COLS) {
+        for (uint32_t i = 0; i < (VGA_ROWS - 1) * VGA_COLS; i++) vga[i] = vga[i + VGA_COLS];
+        for (uint32_t i = (VGA_ROWS - 1) * VGA_COLS; i < VGA_ROWS * VGA_COLS; i++) vga[i] = VGA_BLANK;
+        naive_pos -= VGA_COLS;
+    }
+    crtc_write(CRTC_CURSOR_HIGH, (naive_pos >> 8) & 0xFF);
+    crtc_write(CRTC_CURSOR_LOW, naive_pos & 0xFF);
+}
+
+#define BENCH_CONSOLE_LINES 200
+
+static const char bench_console_line[] =
+    "console bench: the quick brown fox jumps over the lazy dog 0123\n";
+
+static uint32_t lines_per_sec(uint64_t cycles) {
+    uint32_t per_line = (uint32_t)div64_u32(cycles, BENCH_CONSOLE_LINES, NULL);
+    if (tsc_khz == 0) tsc_calibrate();
+    return per_line ? (uint32_t)div64_u32((uint64_t)tsc_khz * 1000, per_line, NULL) : 0;
+}
+
+void bench_console(void) {
+    uint64_t start, naive, shadow, background;
+    int shown = active_vt;
+
+    /* Naive writes draw into the shell page at the top of VGA memory */
+    vt_switch(VT_SHELL);
+    crtc_write(CRTC_START_HIGH, 0);
+    crtc_write(CRTC_START_LOW, 0);
+    naive_pos = 0;
+    start = rdtsc();
+    for (uint32_t n = 0; n < BENCH_CONSOLE_LINES; n++) {
+        for (const char *p = bench_console_line; *p; p++) naive_putc(*p);
+    }
+    naive = rdtsc() - start;
+    console_redraw();
+
+    /* One flush per line, as printk does */
+    start = rdtsc();
+    for (uint32_t n = 0; n < BENCH_CONSOLE_LINES; n++) {
+        vt_write(VT_SPARE, bench_console_line, sizeof(bench_console_line) - 1);
+    }
+    background = rdtsc() - start;
+
+    vt_switch(VT_SPARE);
+    start = rdtsc();
+    for (uint32_t n = 0; n < BENCH_CONSOLE_LINES; n++) {
+        vt_write(VT_SPARE, bench_console_line, sizeof(bench_console_line) - 1);
+    }
+    shadow = rdtsc() - start;
+
+    /* Time a full round of terminal switches */
+    start = rdtsc();
+    for (int i = 0; i < NR_VTS; i++) vt_switch((shown + 1 + i) % NR_VTS);
+    uint32_t switch_cycles = (uint32_t)div64_u32(rdtsc() - start, NR_VTS, NULL);
+
+    bench_report("console_naive", lines_per_sec(naive), "lines/s");
+    bench_report("console_shadow", lines_per_sec(shadow), "lines/s");
+    bench_report("console_background", lines_per_sec(background), "lines/s");
+    bench_report("vt_switch", switch_cycles, "cycles");
+}
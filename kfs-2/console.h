@@ -0,0 +1,72 @@
+#ifndef CONSOLE_H
+#define CONSOLE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * VGA text console with virtual terminals.
+ *
+ * The 32 KB of VGA text memory is split into NR_VTS pages, one per
+ * virtual terminal.  Each terminal renders into a RAM shadow of its page
+ * and only lines marked dirty are copied out, in bulk, by console_flush().
+ * Background terminals are flushed into their own pages as well, so
+ * switching terminals is just a CRTC start-address write.
+ *
+ * Scrolling moves the start address one line further into the page
+ * instead of copying the screen; only when the bottom of the page is
+ * reached is the visible screen copied back to the top.  The CRTC start
+ * and cursor registers are written at most once per flush, and only for
+ * the visible terminal.
+ */
+
+#define VGA_COLS        80
+#define VGA_ROWS        25
+#define VGA_MEM_CELLS   16384                       /* 32 KB at 0xB8000 */
+#define VGA_MEM_LINES   (VGA_MEM_CELLS / VGA_COLS)  /* 204 lines */
+
+#define CONSOLE_ATTR    0x0F    /* Bright white on black */
+
+/* Virtual terminals, switched with Alt+F1..F4 */
+#define NR_VTS          4
+#define VT_LINES        (VGA_MEM_LINES / NR_VTS)    /* 51 lines of VGA memory each */
+#define VT_SHELL        0       /* printk output and the shell */
+#define VT_LOG          1       /* Timestamped copy of all printk output */
+#define VT_STATS        2       /* Console statistics, refreshed by console_poll() */
+#define VT_SPARE        3
+
+/* Set up the terminals and register the "vga" printk sink */
+void console_init(void);
+
+/* Render to the shell and log terminals (as the printk sink does) and flush */
+void console_write(const char *s, size_t len);
+
+/* Render len bytes (UTF-8, a few ANSI escapes) to one terminal and flush */
+void vt_write(int vt, const char *s, size_t len);
+
+/* Render without flushing; call console_flush() afterwards */
+void vt_render(int vt, const char *s, size_t len);
+
+/* Copy dirty lines to VGA memory and update CRTC start/cursor */
+void console_flush(void);
+
+/* Repaint the visible terminal from its shadow buffer */
+void console_redraw(void);
+
+/* Show another terminal: one CRTC start/cursor update, no copying */
+void vt_switch(int vt);
+int vt_active(void);
+
+/* Periodic work from the idle loop: refreshes the stats terminal */
+void console_poll(void);
+
+/* Ticks until console_poll() has work again */
+uint32_t console_poll_delay(void);
+
+/* Shell command: vt [1-4] */
+void cmd_vt(int argc, char *argv[]);
+
+/* Benchmark: lines/s through the console vs naive per-cell writes */
+void bench_console(void);
+
+#endif /* CONSOLE_H */
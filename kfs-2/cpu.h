@@ -0,0 +1,35 @@
+#ifndef CPU_H
+#define CPU_H
+
+#include <stdint.h>
+
+/*
+ * Per-CPU data is sized by NR_CPUS and indexed by smp_processor_id().
+ * Only the boot CPU runs today, so the id is always 0.
+ */
+#define NR_CPUS 1
+
+static inline uint32_t smp_processor_id(void) {
+    return 0;
+}
+
+/* Disable interrupts, returning the previous EFLAGS for irq_restore() */
+static inline uint32_t irq_save(void) {
+    uint32_t flags;
+    __asm__ volatile ("pushf; pop %0; cli" : "=r"(flags) : : "memory");
+    return flags;
+}
+
+static inline void irq_restore(uint32_t flags) {
+    __asm__ volatile ("push %0; popf" : : "r"(flags) : "memory", "cc");
+}
+
+/* CPUID leaf 1 EDX feature bits */
+#define CPUID_EDX_PSE   (1u << 3)       /* 4 MB pages */
+#define CPUID_EDX_SEP   (1u << 11)      /* sysenter/sysexit */
+
+static inline void cpuid(uint32_t leaf, uint32_t *a, uint32_t *b, uint32_t *c, uint32_t *d) {
+    __asm__ volatile ("cpuid" : "=a"(*a), "=b"(*b), "=c"(*c), "=d"(*d) : "a"(leaf), "c"(0));
+}
+
+#endif /* CPU_H */
@@ -0,0 +1,33 @@
+#include "debugcon.h"
+#include "printk.h"
+
+static inline uint8_t inb(uint16_t port) {
+    uint8_t ret;
+    __asm__ volatile ("inb %1, %0" : "=a"(ret) : "Nd"(port));
+    return ret;
+}
+
+void debugcon_write(const char *s, size_t len) {
+    __asm__ volatile ("rep outsb"
+                      : "+S"(s), "+c"(len)
+                      : "d"((uint16_t)DEBUGCON_PORT)
+                      : "memory");
+}
+
+static struct printk_sink debugcon_sink = {
+    .name  = "debugcon",
+    .write = debugcon_write,
+    .flush = NULL,
+    .level = LOGLEVEL_DEBUG,
+    .enabled = 1,
+};
+
+int debugcon_present(void) {
+    /* The device reads back 0xE9; an unused port floats to 0xFF */
+    return inb(DEBUGCON_PORT) == DEBUGCON_PORT;
+}
+
+int debugcon_init(void) {
+    if (!debugcon_present()) return -1;
+    return printk_register_sink(&debugcon_sink);
+}
@@ -0,0 +1,24 @@
+#ifndef DEBUGCON_H
+#define DEBUGCON_H
+
+#include <stddef.h>
+
+/*
+ * QEMU/Bochs debug console: every byte written to port 0xE9 goes straight
+ * to the host (qemu -debugcon file:debugcon.log) with no UART emulation,
+ * so a whole chunk is sent with one rep outsb.
+ */
+
+#define DEBUGCON_PORT   0xE9
+
+/* Register the "debugcon" printk sink if the port is present.
+ * Returns 0 on success, -1 if there is no debug console. */
+int debugcon_init(void);
+
+/* 1 if the port is there */
+int debugcon_present(void);
+
+/* Raw output, bypassing printk (e.g. bulk data for the host) */
+void debugcon_write(const char *s, size_t len);
+
+#endif /* DEBUGCON_H */
@@ -0,0 +1,34 @@
+#ifndef DIV64_H
+#define DIV64_H
+
+#include <stdint.h>
+
+/*
+ * 64-by-32-bit unsigned division.
+ *
+ * The kernel is linked without libgcc, so plain 64-bit '/' and '%'
+ * (which call __udivdi3/__umoddi3) are not available.  On i386 this is
+ * done with two 32-bit divl instructions; other targets (the host test
+ * build) just use the compiler.
+ */
+static inline uint64_t div64_u32(uint64_t n, uint32_t d, uint32_t *rem) {
+#if defined(__i386__)
+    uint32_t hi = (uint32_t)(n >> 32);
+    uint32_t lo = (uint32_t)n;
+    uint32_t q_hi = 0, r;
+
+    if (hi >= d) {
+        q_hi = hi / d;
+        hi %= d;
+    }
+    /* hi < d now, so the 64/32 divl cannot overflow */
+    __asm__ ("divl %4" : "=a"(lo), "=d"(r) : "a"(lo), "d"(hi), "rm"(d));
+    if (rem) *rem = r;
+    return ((uint64_t)q_hi << 32) | lo;
+#else
+    if (rem) *rem = (uint32_t)(n % d);
+    return n / d;
+#endif
+}
+
+#endif /* DIV64_H */
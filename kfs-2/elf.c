@@ -0,0 +1,131 @@
+#include "elf.h"
+#include "vm.h"
+#include "usermode.h"
+#include "initramfs.h"
+#include "module.h"
+#include "printk.h"
+#include "bench.h"
+#include "tsc.h"
+
+#define EXEC_BENCH_PROGRAM  "true"
+#define EXEC_BENCH_RUNS     20
+
+/* Image for path: an initramfs file (following symlinks), else a module */
+static int find_image(const char *path, const uint8_t **data, uint32_t *size) {
+    const struct initramfs_file *f = NULL;
+
+    if (initramfs_count()) f = initramfs_resolve(initramfs_lookup(path));
+    if (f && f->type == INITRAMFS_FILE) {
+        *data = f->data;
+        *size = f->size;
+        return 0;
+    }
+
+    const struct module *m = module_find(path);
+    if (!m) return -1;
+    *data = m->start;
+    *size = m->size;
+    return 0;
+}
+
+/* Check the headers and add an area per PT_LOAD segment */
+static int elf_load(struct vm_space *space, const uint8_t *image, uint32_t size, uint32_t *entry) {
+    const struct elf32_ehdr *eh = (const struct elf32_ehdr *)image;
+
+    if (size < sizeof(*eh) || eh->e_magic != ELF_MAGIC || eh->e_class != ELFCLASS32 ||
+        eh->e_data != ELFDATA2LSB || eh->e_type != ET_EXEC || eh->e_machine != EM_386 ||
+        eh->e_phentsize != sizeof(struct elf32_phdr) || eh->e_phoff > size ||
+        eh->e_phnum > (size - eh->e_phoff) / sizeof(struct elf32_phdr)) {
+        return -1;
+    }
+
+    const struct elf32_phdr *ph = (const struct elf32_phdr *)(image + eh->e_phoff);
+    int segments = 0;
+    for (uint32_t i = 0; i < eh->e_phnum; i++) {
+        if (ph[i].p_type != PT_LOAD || ph[i].p_memsz == 0) continue;
+        if (ph[i].p_offset > size || ph[i].p_filesz > size - ph[i].p_offset) return -1;
+
+        uint32_t flags = VM_READ | ((ph[i].p_flags & PF_W) ? VM_WRITE : 0) |
+                         ((ph[i].p_flags & PF_X) ? VM_EXEC : 0);
+        if (vm_add_area(space, ph[i].p_vaddr, ph[i].p_memsz, flags, image + ph[i].p_offset,
+                        ph[i].p_filesz, image, size) < 0) {
+            return -1;
+        }
+        segments++;
+    }
+    *entry = eh->e_entry;
+    return segments ? 0 : -1;
+}
+
+int elf_run(const char *path, struct exec_stats *stats) {
+    uint64_t start = rdtsc();
+    const uint8_t *image;
+    uint32_t size, entry;
+
+    if (find_image(path, &image, &size) < 0) return -1;
+
+    struct vm_space *space = vm_create();
+    if (!space) return -1;
+    if (elf_load(space, image, size, &entry) < 0 ||
+        vm_add_area(space, USER_STACK_TOP - USER_STACK_SIZE, USER_STACK_SIZE,
+                    VM_READ | VM_WRITE, NULL, 0, NULL, 0) < 0) {
+        vm_destroy(space);
+        return -1;
+    }
+    vm_switch(space);
+
+    uint64_t entered = rdtsc();
+    stats->exit_code = user_exec(entry, USER_STACK_TOP);
+    stats->run_cycles = (uint32_t)(rdtsc() - entered);
+    stats->exec_cycles = (uint32_t)(entered - start);
+    stats->resident = space->resident;
+    stats->direct = space->direct;
+    stats->copied = space->copied;
+    stats->zeroed = space->zeroed;
+    stats->tables = space->tables;
+    stats->cow = space->cow;
+
+    vm_destroy(space);
+    return 0;
+}
+
+void cmd_run(int argc, char *argv[]) {
+    struct exec_stats st;
+
+    if (argc < 2) {
+        printk("Usage: run <path>\n");
+        return;
+    }
+    if (!vm_enabled()) {
+        printk("run: paging is off\n");
+        return;
+    }
+    if (elf_run(argv[1], &st) < 0) {
+        printk("run: %s: not found or not an i386 executable\n", argv[1]);
+        return;
+    }
+    printk("run: exit code %d, exec %u us, ran %u us\n", st.exit_code,
+           tsc_cycles_to_us(st.exec_cycles), tsc_cycles_to_us(st.run_cycles));
+    printk("run: %u resident pages (%u in place, %u copied, %u zeroed), %u page tables\n",
+           st.resident, st.direct, st.copied, st.zeroed, st.tables);
+    if (st.cow) printk("run: %u copy-on-write copies\n", st.cow);
+}
+
+void bench_exec(void) {
+    struct exec_stats st;
+    uint32_t best_exec = 0xFFFFFFFF, best_total = 0xFFFFFFFF;
+
+    for (int run = 0; run < EXEC_BENCH_RUNS; run++) {
+        uint64_t start = rdtsc();
+        if (elf_run(EXEC_BENCH_PROGRAM, &st) < 0) {
+            printk("bench exec: no \"%s\" program\n", EXEC_BENCH_PROGRAM);
+            return;
+        }
+        uint32_t total = (uint32_t)(rdtsc() - start);
+        if (st.exec_cycles < best_exec) best_exec = st.exec_cycles;
+        if (total < best_total) best_total = total;
+    }
+    bench_report("exec_latency", best_exec, "cycles");
+    bench_report("exec_roundtrip", tsc_cycles_to_us(best_total), "us");
+    bench_report("exec_resident", st.resident, "pages");
+}
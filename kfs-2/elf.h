@@ -0,0 +1,64 @@
+#ifndef ELF_H
+#define ELF_H
+
+#include <stdint.h>
+
+/*
+ * ELF32 program loader.
+ *
+ * Programs are i386 ET_EXEC images linked into the user window (vm.h),
+ * taken from the initramfs or from a Multiboot module.  Loading only
+ * checks the headers and adds one area per PT_LOAD segment plus a stack;
+ * pages are filled on first touch, read-only ones straight from the
+ * image when it is page aligned (modules are; files inside the tar
+ * usually are not, and are copied).  A program ends with SYS_EXIT.
+ */
+
+#define ELF_MAGIC       0x464C457Fu         /* "\x7FELF" */
+#define ELFCLASS32      1
+#define ELFDATA2LSB     1
+#define ET_EXEC         2
+#define EM_386          3
+#define PT_LOAD         1
+#define PF_X            0x1
+#define PF_W            0x2
+#define PF_R            0x4
+
+struct elf32_ehdr {
+    uint32_t e_magic;
+    uint8_t  e_class, e_data, e_version, e_osabi;
+    uint8_t  e_pad[8];
+    uint16_t e_type, e_machine;
+    uint32_t e_version2;
+    uint32_t e_entry, e_phoff, e_shoff, e_flags;
+    uint16_t e_ehsize, e_phentsize, e_phnum;
+    uint16_t e_shentsize, e_shnum, e_shstrndx;
+} __attribute__((packed));
+
+struct elf32_phdr {
+    uint32_t p_type, p_offset, p_vaddr, p_paddr;
+    uint32_t p_filesz, p_memsz, p_flags, p_align;
+} __attribute__((packed));
+
+/* What one launch cost */
+struct exec_stats {
+    int exit_code;
+    uint32_t exec_cycles;                   /* Lookup to the jump into ring 3 */
+    uint32_t run_cycles;                    /* Ring 3 until SYS_EXIT */
+    uint32_t resident;                      /* Pages mapped at exit ... */
+    uint32_t direct, copied, zeroed;        /* ... by how they were filled */
+    uint32_t tables;                        /* Page tables */
+    uint32_t cow;                           /* Copy-on-write copies (after fork) */
+};
+
+/* Run the program at path (initramfs file, else module name) to
+ * completion; -1 if it cannot be found or loaded */
+int elf_run(const char *path, struct exec_stats *stats);
+
+/* Shell command: run <path> */
+void cmd_run(int argc, char *argv[]);
+
+/* Benchmark: exec latency and resident pages of the "true" program */
+void bench_exec(void);
+
+#endif /* ELF_H */
@@ -0,0 +1,500 @@
+#include "format.h"
+#include "div64.h"
+#include <stdint.h>
+
+/* Conversion flags */
+#define F_LEFT      0x01    /* '-' */
+#define F_PLUS      0x02    /* '+' */
+#define F_SPACE     0x04    /* ' ' */
+#define F_ALT       0x08    /* '#' */
+#define F_ZERO      0x10    /* '0' */
+#define F_UPPER     0x20    /* %X */
+
+/* Length modifiers */
+enum { LEN_INT, LEN_CHAR, LEN_SHORT, LEN_LONG, LEN_LLONG, LEN_SIZE, LEN_PTRDIFF, LEN_MAX };
+
+/* "00" "01" ... "99": two decimal digits per table lookup */
+static const char digit_pairs[201] =
+    "00010203040506070809101112131415161718192021222324252627282930313233343536373839404142434445464748495051525354555657585960616263646566676869707172737475767778798081828384858687888990919293949596979899";
+
+static const char pad_spaces[] = "                ";
+static const char pad_zeros[]  = "0000000000000000";
+
+/*
+ * Output state.  Streaming passes every chunk to out(); buffer mode
+ * copies into [cur, limit) and only counts what does not fit (limit is
+ * the terminator's slot).
+ */
+struct fmt_state {
+    format_out_fn out;
+    void *ctx;
+    size_t len;                 /* Streaming: characters produced */
+    char *cur;                  /* Buffer: where the next character goes */
+    char *limit;
+    size_t lost;                /* Buffer: characters that did not fit */
+};
+
+/*
+ * When optimising, every helper is inlined into format_core(), and
+ * format_core() into vformat() and vformat_buf() with a constant stream
+ * argument: each mode gets a formatter of its own, without the other
+ * mode's checks and with the state in registers.  Unoptimised builds
+ * keep one copy.
+ */
+#ifdef __OPTIMIZE__
+#define FMT_INLINE  static inline __attribute__((always_inline))
+#else
+#define FMT_INLINE  static
+#endif
+
+FMT_INLINE void put(struct fmt_state *st, int stream, const char *s, size_t len) {
+    if (stream) {
+        if (len) st->out(st->ctx, s, len);
+        st->len += len;
+        return;
+    }
+
+    /* Keep as much as fits */
+    size_t room = (size_t)(st->limit - st->cur);
+    if (len > room) {
+        st->lost += len - room;
+        len = room;
+    }
+    for (size_t i = 0; i < len; i++) st->cur[i] = s[i];
+    st->cur += len;
+}
+
+/* Count the rest of a run that did not fit, up to a '%' or the end */
+FMT_INLINE const char *lose_run(struct fmt_state *st, const char *p, int stop_at_percent) {
+    const char *q = p;
+    while (*q && !(stop_at_percent && *q == '%')) q++;
+    st->lost += (size_t)(q - p);
+    return q;
+}
+
+/*
+ * Emit a literal run up to the next '%' or the end of the format and
+ * return where it stopped.  In buffer mode it is copied while scanning.
+ */
+FMT_INLINE const char *put_literal(struct fmt_state *st, int stream, const char *s) {
+    const char *p = s;
+    char c;
+
+    if (stream) {
+        while (*p != '%' && *p) p++;
+        put(st, 1, s, (size_t)(p - s));
+        return p;
+    }
+
+    char *d = st->cur;
+    while ((c = *p) != '%' && c) {
+        if (d == st->limit) {
+            p = lose_run(st, p, 1);
+            break;
+        }
+        *d++ = c;
+        p++;
+    }
+    st->cur = d;
+    return p;
+}
+
+/* Emit a NUL-terminated string, copying while scanning in buffer mode */
+FMT_INLINE void put_cstr(struct fmt_state *st, int stream, const char *s) {
+    const char *p = s;
+
+    if (stream) {
+        while (*p) p++;
+        put(st, 1, s, (size_t)(p - s));
+        return;
+    }
+
+    char *d = st->cur;
+    while (*p) {
+        if (d == st->limit) {
+            lose_run(st, p, 0);
+            break;
+        }
+        *d++ = *p++;
+    }
+    st->cur = d;
+}
+
+/* n copies of pad[0]; pad is a 16-character run of it for streaming */
+FMT_INLINE void put_pad(struct fmt_state *st, int stream, const char *pad, int n) {
+    if (n <= 0) return;
+    if (stream) {
+        while (n > 0) {
+            int chunk = n < 16 ? n : 16;
+            put(st, 1, pad, (size_t)chunk);
+            n -= chunk;
+        }
+        return;
+    }
+
+    size_t room = (size_t)(st->limit - st->cur), len = (size_t)n;
+    if (len > room) {
+        st->lost += len - room;
+        len = room;
+    }
+    for (size_t i = 0; i < len; i++) st->cur[i] = pad[0];
+    st->cur += len;
+}
+
+/* Write the decimal digits of v ending just before end; returns the start */
+static char *utoa10_32(char *end, uint32_t v) {
+    while (v >= 100) {
+        uint32_t r = v % 100;
+        v /= 100;
+        end -= 2;
+        end[0] = digit_pairs[r * 2];
+        end[1] = digit_pairs[r * 2 + 1];
+    }
+    if (v >= 10) {
+        end -= 2;
+        end[0] = digit_pairs[v * 2];
+        end[1] = digit_pairs[v * 2 + 1];
+    } else {
+        *--end = (char)('0' + v);
+    }
+    return end;
+}
+
+static char *utoa10(char *end, uint64_t v) {
+    /* Peel off 8-digit chunks with one 64/32 division each */
+    while (v > 0xFFFFFFFFu) {
+        uint32_t chunk;
+        v = div64_u32(v, 100000000u, &chunk);
+        char *p = utoa10_32(end, chunk);
+        while (p > end - 8) *--p = '0';
+        end = p;
+    }
+    return utoa10_32(end, (uint32_t)v);
+}
+
+static const char hex_lower[] = "0123456789abcdef";
+static const char hex_upper[] = "0123456789ABCDEF";
+
+/* Hex digits of v, 32 bits at a time so there are no 64-bit shifts */
+static char *utoa16(char *end, uint64_t v, const char *digits) {
+    uint32_t lo = (uint32_t)v, hi = (uint32_t)(v >> 32);
+
+    if (hi) {
+        for (int i = 0; i < 8; i++) {
+            *--end = digits[lo & 0xF];
+            lo >>= 4;
+        }
+        lo = hi;
+    }
+    do {
+        *--end = digits[lo & 0xF];
+        lo >>= 4;
+    } while (lo);
+    return end;
+}
+
+static char *utoa8(char *end, uint64_t v) {
+    do {
+        *--end = (char)('0' + (v & 7));
+        v >>= 3;
+    } while (v);
+    return end;
+}
+
+/* Fetch an integer argument of length modifier len into v */
+#define ARG_UNSIGNED(v, ap, len) do {                                       \
+        if (len == LEN_INT) v = va_arg(ap, unsigned int);                   \
+        else switch (len) {                                                      \
+            case LEN_CHAR:    v = (unsigned char)va_arg(ap, unsigned int); break;  \
+            case LEN_SHORT:   v = (unsigned short)va_arg(ap, unsigned int); break; \
+            case LEN_LONG:    v = va_arg(ap, unsigned long); break;         \
+            case LEN_LLONG:   v = va_arg(ap, unsigned long long); break;    \
+            case LEN_SIZE:    v = va_arg(ap, size_t); break;                \
+            case LEN_PTRDIFF: v = (uint64_t)va_arg(ap, ptrdiff_t); break;   \
+            case LEN_MAX:     v = va_arg(ap, uintmax_t); break;             \
+            default:          v = va_arg(ap, unsigned int); break;          \
+        }                                                                   \
+    } while (0)
+
+#define ARG_SIGNED(v, ap, len) do {                                         \
+        if (len == LEN_INT) v = va_arg(ap, int);                            \
+        else switch (len) {                                                      \
+            case LEN_CHAR:    v = (signed char)va_arg(ap, int); break;      \
+            case LEN_SHORT:   v = (short)va_arg(ap, int); break;            \
+            case LEN_LONG:    v = va_arg(ap, long); break;                  \
+            case LEN_LLONG:   v = va_arg(ap, long long); break;             \
+            case LEN_SIZE:    v = (int64_t)va_arg(ap, size_t); break;       \
+            case LEN_PTRDIFF: v = va_arg(ap, ptrdiff_t); break;             \
+            case LEN_MAX:     v = va_arg(ap, intmax_t); break;              \
+            default:          v = va_arg(ap, int); break;                   \
+        }                                                                   \
+    } while (0)
+
+/*
+ * Emit an integer: [pad][sign/prefix][zeros][digits][pad].  digits ends
+ * at the end of a buffer with room in front of it, so the prefix and
+ * leading zeros are normally prepended in place and the number goes out
+ * as one chunk.
+ */
+FMT_INLINE void put_number(struct fmt_state *st, int stream, char *digits, char *buf, int ndigits,
+                           const char *prefix, int nprefix, int flags, int width, int prec) {
+    int zeros = prec > ndigits ? prec - ndigits : 0;
+    int pad = width - nprefix - zeros - ndigits;
+
+    if ((flags & (F_ZERO | F_LEFT)) == F_ZERO && prec < 0 && pad > 0) {
+        zeros += pad;
+        pad = 0;
+    }
+    if (!(flags & F_LEFT)) put_pad(st, stream, pad_spaces, pad);
+    if (digits - buf >= zeros + nprefix) {
+        char *end = digits + ndigits;
+        while (zeros-- > 0) *--digits = '0';
+        while (nprefix-- > 0) *--digits = prefix[nprefix];
+        put(st, stream, digits, (size_t)(end - digits));
+    } else {
+        put(st, stream, prefix, (size_t)nprefix);
+        put_pad(st, stream, pad_zeros, zeros);
+        put(st, stream, digits, (size_t)ndigits);
+    }
+    if (flags & F_LEFT) put_pad(st, stream, pad_spaces, pad);
+}
+
+FMT_INLINE void put_string(struct fmt_state *st, int stream, const char *s, size_t len,
+                           int flags, int width) {
+    int pad = width - (int)len;
+
+    if (!(flags & F_LEFT)) put_pad(st, stream, pad_spaces, pad);
+    put(st, stream, s, len);
+    if (flags & F_LEFT) put_pad(st, stream, pad_spaces, pad);
+}
+
+FMT_INLINE void format_core(struct fmt_state *st, int stream, const char *fmt, va_list ap) {
+    char buf[48];       /* 22 octal digits of a 64-bit value, plus prefix and zeros */
+    char *end = buf + sizeof(buf);
+
+    while (*fmt) {
+        fmt = put_literal(st, stream, fmt);
+        if (!*fmt) break;
+
+        const char *spec = fmt++;
+
+        /* Fast path for the common forms: %s, and %d %u %x %X with at
+         * most a '0' flag and a width (%08X, %2d) */
+        if (*fmt == 's') {
+            const char *s = va_arg(ap, const char *);
+            put_cstr(st, stream, s ? s : "(null)");
+            fmt++;
+            continue;
+        }
+        {
+            const char *q = fmt;
+            char padc = ' ';
+            int w = 0;
+
+            if (*q == '0') {
+                padc = '0';
+                q++;
+            }
+            while (*q >= '0' && *q <= '9' && w < 100) w = w * 10 + (*q++ - '0');
+
+            char c = *q;
+
+            /* %08X (addresses, registers) and wider: all eight digits,
+             * straight into the buffer when they fit */
+            if ((c == 'x' || c == 'X') && padc == '0' && w >= 8 && w <= 32) {
+                uint32_t v = va_arg(ap, unsigned int);
+                const char *digits = c == 'X' ? hex_upper : hex_lower;
+                int direct = !stream && st->limit - st->cur >= w;
+                char *p = direct ? st->cur : end - w;
+
+                char *x = p + w - 8;
+                for (int i = 0; i < w - 8; i++) p[i] = '0';
+                x[0] = digits[v >> 28];
+                x[1] = digits[(v >> 24) & 0xF];
+                x[2] = digits[(v >> 20) & 0xF];
+                x[3] = digits[(v >> 16) & 0xF];
+                x[4] = digits[(v >> 12) & 0xF];
+                x[5] = digits[(v >> 8) & 0xF];
+                x[6] = digits[(v >> 4) & 0xF];
+                x[7] = digits[v & 0xF];
+                if (direct) st->cur += w;
+                else put(st, stream, p, (size_t)w);
+                fmt = q + 1;
+                continue;
+            }
+
+            if ((c == 'd' || c == 'u' || c == 'x' || c == 'X') && w <= 32) {
+                char *p;
+                char sign = 0;
+
+                if (c == 'd') {
+                    int v = va_arg(ap, int);
+                    if (v < 0) sign = '-';
+                    p = utoa10_32(end, v < 0 ? 0u - (uint32_t)v : (uint32_t)v);
+                } else if (c == 'u') {
+                    p = utoa10_32(end, va_arg(ap, unsigned int));
+                } else {
+                    p = utoa16(end, va_arg(ap, unsigned int), c == 'X' ? hex_upper : hex_lower);
+                }
+
+                int fill = w - (int)(end - p) - (sign ? 1 : 0);
+                if (padc == '0') {
+                    while (fill-- > 0) *--p = '0';
+                    if (sign) *--p = sign;
+                } else {
+                    if (sign) *--p = sign;
+                    while (fill-- > 0) *--p = ' ';
+                }
+                put(st, stream, p, (size_t)(end - p));
+                fmt = q + 1;
+                continue;
+            }
+        }
+
+        int flags = 0, width = 0, prec = -1, len = LEN_INT;
+        for (;; fmt++) {
+            if (*fmt == '-')      flags |= F_LEFT;
+            else if (*fmt == '+') flags |= F_PLUS;
+            else if (*fmt == ' ') flags |= F_SPACE;
+            else if (*fmt == '#') flags |= F_ALT;
+            else if (*fmt == '0') flags |= F_ZERO;
+            else break;
+        }
+
+        if (*fmt == '*') {
+            width = va_arg(ap, int);
+            if (width < 0) {
+                flags |= F_LEFT;
+                width = -width;
+            }
+            fmt++;
+        } else {
+            while (*fmt >= '0' && *fmt <= '9') width = width * 10 + (*fmt++ - '0');
+        }
+
+        if (*fmt == '.') {
+            fmt++;
+            if (*fmt == '*') {
+                prec = va_arg(ap, int);
+                if (prec < 0) prec = -1;
+                fmt++;
+            } else {
+                prec = 0;
+                while (*fmt >= '0' && *fmt <= '9') prec = prec * 10 + (*fmt++ - '0');
+            }
+        }
+
+        switch (*fmt) {
+            case 'h':
+                fmt++;
+                if (*fmt == 'h') { len = LEN_CHAR; fmt++; } else len = LEN_SHORT;
+                break;
+            case 'l':
+                fmt++;
+                if (*fmt == 'l') { len = LEN_LLONG; fmt++; } else len = LEN_LONG;
+                break;
+            case 'z': len = LEN_SIZE;    fmt++; break;
+            case 't': len = LEN_PTRDIFF; fmt++; break;
+            case 'j': len = LEN_MAX;     fmt++; break;
+            default:  break;
+        }
+
+        char conv = *fmt;
+        if (!conv) {
+            /* Lone '%' (with flags) at the end: emit it as is */
+            put(st, stream, spec, (size_t)(fmt - spec));
+            break;
+        }
+        fmt++;
+
+        switch (conv) {
+            case 'd':
+            case 'i': {
+                int64_t v;
+                ARG_SIGNED(v, ap, len);
+                uint64_t u = v < 0 ? 0 - (uint64_t)v : (uint64_t)v;
+                char sign = v < 0 ? '-' : (flags & F_PLUS) ? '+' : (flags & F_SPACE) ? ' ' : 0;
+                char *p = (prec == 0 && u == 0) ? end : utoa10(end, u);
+                put_number(st, stream, p, buf, (int)(end - p), &sign, sign ? 1 : 0, flags, width, prec);
+                break;
+            }
+            case 'u':
+            case 'o':
+            case 'x':
+            case 'X':
+            case 'p': {
+                uint64_t u;
+                const char *prefix = "";
+                int nprefix = 0;
+                char *p;
+
+                if (conv == 'p') {
+                    u = (uintptr_t)va_arg(ap, void *);
+                    if (!u) {
+                        put_string(st, stream, "(nil)", 5, flags, width);
+                        break;
+                    }
+                    flags |= F_ALT;
+                } else {
+                    ARG_UNSIGNED(u, ap, len);
+                }
+
+                if (prec == 0 && u == 0) {
+                    p = end;
+                } else if (conv == 'u') {
+                    p = utoa10(end, u);
+                } else if (conv == 'o') {
+                    p = utoa8(end, u);
+                } else {
+                    p = utoa16(end, u, conv == 'X' ? hex_upper : hex_lower);
+                }
+
+                if (flags & F_ALT) {
+                    if (conv == 'o') {
+                        /* '#' makes sure an octal number starts with 0 */
+                        if (p == end || *p != '0') *--p = '0';
+                    } else if (conv != 'u' && u != 0) {
+                        prefix = (conv == 'X') ? "0X" : "0x";
+                        nprefix = 2;
+                    }
+                }
+                put_number(st, stream, p, buf, (int)(end - p), prefix, nprefix, flags, width, prec);
+                break;
+            }
+            case 'c': {
+                char c = (char)va_arg(ap, int);
+                put_string(st, stream, &c, 1, flags, width);
+                break;
+            }
+            case 's': {
+                const char *s = va_arg(ap, const char *);
+                size_t n = 0;
+                if (!s) s = "(null)";
+                /* With a precision, never read past it */
+                while ((prec < 0 || n < (size_t)prec) && s[n]) n++;
+                put_string(st, stream, s, n, flags, width);
+                break;
+            }
+            case '%':
+                put(st, stream, "%", 1);
+                break;
+            default:
+                /* Unknown conversion: emit the whole specification */
+                put(st, stream, spec, (size_t)(fmt - spec));
+                break;
+        }
+    }
+}
+
+int vformat(format_out_fn out, void *ctx, const char *fmt, va_list args) {
+    struct fmt_state st = { out, ctx, 0, NULL, NULL, 0 };
+    format_core(&st, 1, fmt, args);
+    return (int)st.len;
+}
+
+int vformat_buf(char *buf, size_t size, const char *fmt, va_list args) {
+    struct fmt_state st = { NULL, NULL, 0, buf, size ? buf + size - 1 : buf, 0 };
+    format_core(&st, 0, fmt, args);
+    if (size) *st.cur = '\0';
+    return (int)((size_t)(st.cur - buf) + st.lost);
+}
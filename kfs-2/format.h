@@ -0,0 +1,32 @@
+#ifndef FORMAT_H
+#define FORMAT_H
+
+#include <stdarg.h>
+#include <stddef.h>
+
+/*
+ * Single-pass printf-style formatting core behind printk() and vsnprintf().
+ *
+ * Output goes to a callback in chunks: literal runs of the format string
+ * are passed in place, each conversion from a small stack buffer, padding
+ * from a constant string.  Nothing is buffered and nothing is truncated
+ * here; the callback decides what to keep.
+ *
+ * Supported: flags "-+ #0", width and precision (both also as '*'),
+ * length modifiers hh h l ll j z t, conversions d i u o x X c s p %.
+ * 64-bit values are converted with div64_u32(), so no libgcc is needed.
+ */
+
+typedef void (*format_out_fn)(void *ctx, const char *s, size_t len);
+
+/* Format into out(ctx, ...); returns the number of characters produced */
+int vformat(format_out_fn out, void *ctx, const char *fmt, va_list args);
+
+/*
+ * Same core writing straight into buf (no callback per chunk), for
+ * vsnprintf().  Keeps at most size - 1 characters plus the terminator
+ * and returns the full length, like vsnprintf().
+ */
+int vformat_buf(char *buf, size_t size, const char *fmt, va_list args);
+
+#endif /* FORMAT_H */
@@ -0,0 +1,285 @@
+#include "gcov.h"
+#include "printk.h"
+#include "printf.h"
+#include "lib.h"
+#include "debugcon.h"
+
+#ifdef CONFIG_GCOV
+
+/*
+ * The compiler's gcov_info layout (libgcc/libgcov.h, gcc 9 and later).
+ * Each object has one, listing its functions; a function has one
+ * counter array per counter kind the object uses, i.e. per non-NULL
+ * merge function.  This runtime is compiled without -fprofile-arcs.
+ *
+ * gcda_emit() writes the two-word object summary (runs, sum_max) that
+ * gcc 9 introduced; older compilers expect a program summary with a
+ * histogram and would reject the file.
+ */
+#if __GNUC__ < 9
+#error "gcov.c: the .gcda summary format needs gcc 9 or later"
+#endif
+
+#if __GNUC__ >= 14
+#define GCOV_COUNTERS           9
+#elif __GNUC__ >= 10
+#define GCOV_COUNTERS           8
+#else
+#define GCOV_COUNTERS           9
+#endif
+
+#if __GNUC__ >= 12
+#define GCOV_UNIT               4       /* Record lengths count bytes */
+#else
+#define GCOV_UNIT               1       /* ... or 32-bit words */
+#endif
+
+#define GCOV_DATA_MAGIC         0x67636461u     /* "gcda" */
+#define GCOV_TAG_FUNCTION       0x01000000u
+#define GCOV_TAG_FUNCTION_LEN   3
+#define GCOV_TAG_COUNTER(i)     (0x01a10000u + ((uint32_t)(i) << 17))
+#define GCOV_TAG_SUMMARY        0xa1000000u
+#define GCOV_TAG_SUMMARY_LEN    2
+#define GCOV_COUNTER_ARCS       0
+
+#define GCDA_LINE_BYTES         32
+
+typedef int64_t gcov_type;
+
+struct gcov_info;
+
+struct gcov_ctr_info {
+    uint32_t num;
+    gcov_type *values;
+};
+
+struct gcov_fn_info {
+    const struct gcov_info *key;        /* Not this object's: dropped COMDAT copy */
+    uint32_t ident;
+    uint32_t lineno_checksum;
+    uint32_t cfg_checksum;
+    struct gcov_ctr_info ctrs[];
+};
+
+struct gcov_info {
+    uint32_t version;
+    struct gcov_info *next;
+    uint32_t stamp;
+#if __GNUC__ >= 12
+    uint32_t checksum;
+#endif
+    const char *filename;
+    void (*merge[GCOV_COUNTERS])(gcov_type *, uint32_t);
+    uint32_t n_functions;
+    const struct gcov_fn_info *const *functions;
+};
+
+/* Constructors, collected by linker.ld */
+extern void (*__init_array_start[])(void);
+extern void (*__init_array_end[])(void);
+
+static struct gcov_info *gcov_list;
+
+/* Called by each object's constructor */
+void __gcov_init(struct gcov_info *info) {
+    info->next = gcov_list;
+    gcov_list = info;
+}
+
+/* Referenced from gcov_info.merge; only a host-side libgcov merges */
+void __gcov_merge_add(gcov_type *counters, uint32_t n) {
+    (void)counters;
+    (void)n;
+}
+
+/* Called from the objects' destructors, which the kernel never runs */
+void __gcov_exit(void) {
+}
+
+void gcov_init(void) {
+    for (void (**ctor)(void) = __init_array_start; ctor < __init_array_end; ctor++) (*ctor)();
+}
+
+static int fn_valid(const struct gcov_info *info, const struct gcov_fn_info *fn) {
+    return fn && fn->key == info;
+}
+
+void gcov_reset(void) {
+    for (struct gcov_info *info = gcov_list; info; info = info->next) {
+        for (uint32_t f = 0; f < info->n_functions; f++) {
+            const struct gcov_fn_info *fn = info->functions[f];
+            const struct gcov_ctr_info *ctr = fn_valid(info, fn) ? fn->ctrs : NULL;
+
+            for (int c = 0; ctr && c < GCOV_COUNTERS; c++) {
+                if (!info->merge[c]) continue;
+                memset(ctr->values, 0, ctr->num * sizeof(gcov_type));
+                ctr++;
+            }
+        }
+    }
+}
+
+/* Largest arc count of the whole kernel, for the object summaries
+ * (-fprofile-use derives its hot/cold thresholds from it) */
+static uint32_t gcov_sum_max(void) {
+    gcov_type max = 0;
+
+    for (struct gcov_info *info = gcov_list; info; info = info->next) {
+        if (!info->merge[GCOV_COUNTER_ARCS]) continue;
+        for (uint32_t f = 0; f < info->n_functions; f++) {
+            const struct gcov_fn_info *fn = info->functions[f];
+            if (!fn_valid(info, fn)) continue;
+            for (uint32_t i = 0; i < fn->ctrs[0].num; i++) {
+                if (fn->ctrs[0].values[i] > max) max = fn->ctrs[0].values[i];
+            }
+        }
+    }
+    return max > 0xFFFFFFFF ? 0xFFFFFFFF : (uint32_t)max;
+}
+
+/* Hex record writer */
+struct gcda_out {
+    char line[8 + 2 * GCDA_LINE_BYTES];
+    uint32_t fill;                      /* Bytes in line */
+};
+
+static void gcda_flush(struct gcda_out *out) {
+    static const char prefix[] = "@gcda ";
+
+    if (out->fill == 0) return;
+    debugcon_write(prefix, sizeof(prefix) - 1);
+    out->line[2 * out->fill] = '\n';
+    debugcon_write(out->line, 2 * out->fill + 1);
+    out->fill = 0;
+}
+
+static void gcda_u32(struct gcda_out *out, uint32_t v) {
+    static const char hex[] = "0123456789abcdef";
+
+    for (int i = 0; i < 4; i++, v >>= 8) {
+        out->line[2 * out->fill] = hex[(v >> 4) & 0xF];
+        out->line[2 * out->fill + 1] = hex[v & 0xF];
+        if (++out->fill == GCDA_LINE_BYTES) gcda_flush(out);
+    }
+}
+
+static void gcda_u64(struct gcda_out *out, uint64_t v) {
+    gcda_u32(out, (uint32_t)v);
+    gcda_u32(out, (uint32_t)(v >> 32));
+}
+
+/* Walk one object's .gcda image: count its words, or write them */
+static uint32_t gcda_emit(const struct gcov_info *info, uint32_t sum_max, struct gcda_out *out) {
+    uint32_t words = 0;
+
+#define PUT32(v)    do { if (out) gcda_u32(out, v); words++; } while (0)
+#define PUT64(v)    do { if (out) gcda_u64(out, v); words += 2; } while (0)
+
+    PUT32(GCOV_DATA_MAGIC);
+    PUT32(info->version);
+    PUT32(info->stamp);
+#if __GNUC__ >= 12
+    PUT32(info->checksum);
+#endif
+    PUT32(GCOV_TAG_SUMMARY);
+    PUT32(GCOV_TAG_SUMMARY_LEN * GCOV_UNIT);
+    PUT32(1);                           /* Runs */
+    PUT32(sum_max);
+
+    for (uint32_t f = 0; f < info->n_functions; f++) {
+        const struct gcov_fn_info *fn = info->functions[f];
+
+        PUT32(GCOV_TAG_FUNCTION);
+        if (!fn_valid(info, fn)) {
+            PUT32(0);
+            continue;
+        }
+        PUT32(GCOV_TAG_FUNCTION_LEN * GCOV_UNIT);
+        PUT32(fn->ident);
+        PUT32(fn->lineno_checksum);
+        PUT32(fn->cfg_checksum);
+
+        const struct gcov_ctr_info *ctr = fn->ctrs;
+        for (int c = 0; c < GCOV_COUNTERS; c++) {
+            if (!info->merge[c]) continue;
+            PUT32(GCOV_TAG_COUNTER(c));
+            PUT32(ctr->num * 2 * GCOV_UNIT);
+            for (uint32_t i = 0; i < ctr->num; i++) PUT64((uint64_t)ctr->values[i]);
+            ctr++;
+        }
+    }
+    PUT32(0);                           /* End of file */
+
+#undef PUT32
+#undef PUT64
+    return words * 4;
+}
+
+int gcov_dump(void) {
+    uint32_t sum_max = gcov_sum_max();
+    struct gcda_out out;
+    char header[96];
+    int objects = 0;
+
+    for (struct gcov_info *info = gcov_list; info; info = info->next) {
+        const char *base = info->filename;
+        for (const char *p = base; *p; p++) {
+            if (*p == '/') base = p + 1;
+        }
+
+        int n = snprintf(header, sizeof(header), "@gcda begin %s %u\n", base,
+                         gcda_emit(info, sum_max, NULL));
+        debugcon_write(header, n);
+        out.fill = 0;
+        gcda_emit(info, sum_max, &out);
+        gcda_flush(&out);
+        debugcon_write("@gcda end\n", 10);
+        objects++;
+    }
+    return objects;
+}
+
+/* gcov: counted objects; gcov dump: write them out; gcov reset: zero */
+void cmd_gcov(int argc, char *argv[]) {
+    if (argc >= 2 && strcmp(argv[1], "reset") == 0) {
+        gcov_reset();
+        printk("gcov: counters cleared\n");
+        return;
+    }
+    if (argc >= 2 && strcmp(argv[1], "dump") == 0) {
+        if (!debugcon_present()) {
+            printk("gcov: no debug console to dump to\n");
+            return;
+        }
+        printk("gcov: dumped %d objects to debugcon\n", gcov_dump());
+        return;
+    }
+
+    uint32_t objects = 0, functions = 0;
+    for (struct gcov_info *info = gcov_list; info; info = info->next) {
+        objects++;
+        functions += info->n_functions;
+    }
+    printk("gcov: %u objects, %u functions, max arc count %u\n",
+           objects, functions, gcov_sum_max());
+}
+
+#else /* !CONFIG_GCOV */
+
+void gcov_init(void) {
+}
+
+void gcov_reset(void) {
+}
+
+int gcov_dump(void) {
+    return -1;
+}
+
+void cmd_gcov(int argc, char *argv[]) {
+    (void)argc;
+    (void)argv;
+    printk("gcov: kernel not instrumented (build with PROFILE=pgo-gen)\n");
+}
+
+#endif /* CONFIG_GCOV */
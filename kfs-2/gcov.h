@@ -0,0 +1,37 @@
+#ifndef GCOV_H
+#define GCOV_H
+
+#include <stdint.h>
+
+/*
+ * Freestanding gcov runtime for profile-guided builds.
+ *
+ * A kernel built with PROFILE=pgo-gen is compiled with -fprofile-arcs
+ * (-DCONFIG_GCOV): every object counts its control-flow arcs and
+ * registers its counters through a constructor calling __gcov_init().
+ * gcov_init() runs those constructors; "gcov dump" writes one .gcda
+ * image per object to the debug console as text records
+ *
+ *   @gcda begin <file.gcda> <bytes>
+ *   @gcda <up to 32 bytes in hex>
+ *   @gcda end
+ *
+ * which tools/gcda.py turns back into files for -fprofile-use.  Only arc
+ * counters are recorded; value profiles are not.  Without CONFIG_GCOV
+ * all of this compiles to stubs.
+ */
+
+/* Run the profiling constructors; call first thing in kmain() */
+void gcov_init(void);
+
+/* Zero every counter */
+void gcov_reset(void);
+
+/* Write every object's .gcda to the debug console; returns the number
+ * of objects, -1 if the kernel is not instrumented */
+int gcov_dump(void);
+
+/* Shell command: gcov [dump|reset] */
+void cmd_gcov(int argc, char *argv[]);
+
+#endif /* GCOV_H */
@@ -1,11 +1,14 @@
 #include "gdt.h"
 #include "lib.h"
+#include "init.h"
 
 /* Global GDT array at fixed address 0x00000800 */
 static struct gdt_descriptor gdt[GDT_TOTAL_DESCRIPTORS] __attribute__((section(".gdt")));
 
+struct tss_entry tss;
+
 /* Helper function to fill a GDT descriptor */
-static void gdt_set_descriptor(
+static void __init gdt_set_descriptor(
     uint32_t index,
     uint32_t base,
     uint32_t limit,
@@ -24,7 +27,7 @@ static void gdt_set_descriptor(
     gdt[index].access_byte = access;
 }
 
-void gdt_init(void) {
+void __init gdt_init(void) {
     /* Null descriptor (required, selector 0x00) */
     gdt_set_descriptor(0, 0x00000000, 0x00000000,
                        0x00, 0x00);
@@ -77,10 +80,44 @@ void gdt_init(void) {
                        GDT_ACCESS_DC_DOWN | GDT_ACCESS_RW,
                        GDT_GRAN_PAGE_SIZE | GDT_GRAN_32BIT);
 
+    /* Task State Segment (byte granularity) */
+    memset(&tss, 0, sizeof(tss));
+    tss.ss0 = GDT_KERNEL_DATA_SELECTOR;
+    tss.iomap_base = sizeof(tss);
+    gdt_set_descriptor(GDT_TSS_INDEX,
+                       (uint32_t)&tss, sizeof(tss) - 1,
+                       GDT_ACCESS_PRESENT | GDT_ACCESS_DPL_0 | GDT_ACCESS_TSS32,
+                       0x00);
+
+    /* SYSENTER/SYSEXIT group: kernel code, kernel data, user code, user data */
+    gdt_set_descriptor(GDT_SYSENTER_CODE_INDEX,
+                       0x00000000, 0xFFFFF,
+                       GDT_ACCESS_PRESENT | GDT_ACCESS_DPL_0 | GDT_ACCESS_S_CODE_DATA |
+                       GDT_ACCESS_EXECUTABLE | GDT_ACCESS_RW,
+                       GDT_GRAN_PAGE_SIZE | GDT_GRAN_32BIT);
+    gdt_set_descriptor(GDT_SYSENTER_DATA_INDEX,
+                       0x00000000, 0xFFFFF,
+                       GDT_ACCESS_PRESENT | GDT_ACCESS_DPL_0 | GDT_ACCESS_S_CODE_DATA |
+                       GDT_ACCESS_RW,
+                       GDT_GRAN_PAGE_SIZE | GDT_GRAN_32BIT);
+    gdt_set_descriptor(GDT_SYSEXIT_CODE_INDEX,
+                       0x00000000, 0xFFFFF,
+                       GDT_ACCESS_PRESENT | GDT_ACCESS_DPL_3 | GDT_ACCESS_S_CODE_DATA |
+                       GDT_ACCESS_EXECUTABLE | GDT_ACCESS_RW,
+                       GDT_GRAN_PAGE_SIZE | GDT_GRAN_32BIT);
+    gdt_set_descriptor(GDT_SYSEXIT_DATA_INDEX,
+                       0x00000000, 0xFFFFF,
+                       GDT_ACCESS_PRESENT | GDT_ACCESS_DPL_3 | GDT_ACCESS_S_CODE_DATA |
+                       GDT_ACCESS_RW,
+                       GDT_GRAN_PAGE_SIZE | GDT_GRAN_32BIT);
+
     /* Load the GDT register */
     struct gdtr gdtr_value;
     gdtr_value.base = (uint32_t)&gdt[0];
     gdtr_value.limit = (sizeof(struct gdt_descriptor) * GDT_TOTAL_DESCRIPTORS) - 1;
 
     gdt_load(&gdtr_value);
+
+    /* Load the task register */
+    __asm__ volatile ("ltr %0" : : "r"((uint16_t)GDT_TSS_SELECTOR));
 }
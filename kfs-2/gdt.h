@@ -19,6 +19,22 @@ struct gdtr {
     uint32_t base;           /* Linear address of GDT */
 } __attribute__((packed));
 
+/* 32-bit Task State Segment.  Only ss0/esp0 (the stack taken on a
+ * trap from ring 3) and iomap_base are used; there is no hardware task
+ * switching. */
+struct tss_entry {
+    uint32_t prev_tss;
+    uint32_t esp0;
+    uint32_t ss0;
+    uint32_t esp1, ss1, esp2, ss2;
+    uint32_t cr3, eip, eflags;
+    uint32_t eax, ecx, edx, ebx, esp, ebp, esi, edi;
+    uint32_t es, cs, ss, ds, fs, gs;
+    uint32_t ldt;
+    uint16_t trap;
+    uint16_t iomap_base;            /* Past the limit: no I/O bitmap */
+} __attribute__((packed));
+
 /* GDT Descriptor Access Byte Flags */
 #define GDT_ACCESS_PRESENT     0x80  /* Segment present in memory */
 #define GDT_ACCESS_DPL_0       0x00  /* Privilege level 0 (kernel) */
@@ -28,6 +44,7 @@ struct gdtr {
 #define GDT_ACCESS_DC_DOWN     0x04  /* Direction (0=up for stack) */
 #define GDT_ACCESS_RW          0x02  /* Readable/Writable */
 #define GDT_ACCESS_ACCESSED    0x01  /* Accessed bit */
+#define GDT_ACCESS_TSS32       0x09  /* System: available 32-bit TSS */
 
 /* GDT Descriptor Granularity Byte Flags */
 #define GDT_GRAN_PAGE_SIZE     0x80  /* Granularity: 4KB pages */
@@ -41,7 +58,18 @@ struct gdtr {
 #define GDT_USER_CODE_INDEX    4
 #define GDT_USER_DATA_INDEX    5
 #define GDT_USER_STACK_INDEX   6
-#define GDT_TOTAL_DESCRIPTORS  7
+#define GDT_TSS_INDEX          7
+
+/* SYSENTER/SYSEXIT derive all four selectors from IA32_SYSENTER_CS:
+ * kernel CS, kernel SS = CS + 8, user CS = CS + 16, user SS = CS + 24.
+ * The descriptors above are not in that order (and 0x33 is expand-down
+ * with a 4 GB limit, which leaves no valid offsets), so this group
+ * repeats the flat kernel and user segments in the required layout. */
+#define GDT_SYSENTER_CODE_INDEX      8
+#define GDT_SYSENTER_DATA_INDEX      9
+#define GDT_SYSEXIT_CODE_INDEX       10
+#define GDT_SYSEXIT_DATA_INDEX       11
+#define GDT_TOTAL_DESCRIPTORS  12
 
 /* Selector values (index * 8) */
 #define GDT_KERNEL_CODE_SELECTOR  (GDT_KERNEL_CODE_INDEX << 3)
@@ -50,10 +78,15 @@ struct gdtr {
 #define GDT_USER_CODE_SELECTOR    ((GDT_USER_CODE_INDEX << 3) | 3)
 #define GDT_USER_DATA_SELECTOR    ((GDT_USER_DATA_INDEX << 3) | 3)
 #define GDT_USER_STACK_SELECTOR   ((GDT_USER_STACK_INDEX << 3) | 3)
+#define GDT_TSS_SELECTOR          (GDT_TSS_INDEX << 3)
+#define GDT_SYSENTER_CS           (GDT_SYSENTER_CODE_INDEX << 3)
 
-/* GDT initialization function */
+/* GDT initialization function (also loads the TSS) */
 void gdt_init(void);
 
+/* TSS: esp0 is the kernel stack used on traps from ring 3 */
+extern struct tss_entry tss;
+
 /* GDT load function (defined in gdt_load.asm) */
 extern void gdt_load(struct gdtr *gdtr);
 
@@ -0,0 +1,304 @@
+/*
+ * Host-native microbenchmarks for portable kernel code.
+ *
+ * Built by `make host-bench` with optimisation and without sanitizers.
+ * Every benchmark is calibrated so one sample takes about 2 ms, then
+ * BENCH_SAMPLES samples are taken and summarised as median / min ns per
+ * operation plus the median absolute deviation, which is robust against
+ * the odd preempted sample.  Kernel and host libc versions are run side
+ * by side so optimisations can be judged against a known baseline;
+ * "(old)" rows run the formatters replaced by format.c (legacy_format.c).
+ * parallel_for rows use threads as the pool's workers; the speed-up over
+ * one worker is bounded by the host's core count.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "kfs.h"
+#include "legacy_format.h"
+
+#define BENCH_SAMPLES     31
+#define BENCH_SAMPLE_NS   2000000ull
+
+typedef void (*bench_fn)(size_t iters);
+
+static volatile uintptr_t sink;
+static char buf_a[4096], buf_b[4096];
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static int cmp_double(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static void run(const char *name, bench_fn fn) {
+    double samples[BENCH_SAMPLES], dev[BENCH_SAMPLES];
+    size_t iters = 1;
+    uint64_t t;
+
+    /* Calibrate (this also warms caches and branch predictors) */
+    for (;;) {
+        t = now_ns();
+        fn(iters);
+        t = now_ns() - t;
+        if (t >= BENCH_SAMPLE_NS || iters >= ((size_t)1 << 30)) break;
+        iters *= 2;
+    }
+
+    for (int i = 0; i < BENCH_SAMPLES; i++) {
+        t = now_ns();
+        fn(iters);
+        samples[i] = (double)(now_ns() - t) / (double)iters;
+    }
+    qsort(samples, BENCH_SAMPLES, sizeof(samples[0]), cmp_double);
+
+    double median = samples[BENCH_SAMPLES / 2];
+    for (int i = 0; i < BENCH_SAMPLES; i++) {
+        dev[i] = samples[i] > median ? samples[i] - median : median - samples[i];
+    }
+    qsort(dev, BENCH_SAMPLES, sizeof(dev[0]), cmp_double);
+
+    printf("%-28s %10.2f %10.2f %8.2f%%\n", name, median, samples[0],
+           median > 0 ? 100.0 * dev[BENCH_SAMPLES / 2] / median : 0.0);
+}
+
+/* ---------------------------------------------------------------- lib.c */
+
+#define MEM_BENCH(name, call)                               \
+    static void name(size_t iters) {                        \
+        for (size_t i = 0; i < iters; i++) {                \
+            call;                                           \
+            __asm__ volatile("" : : "r"(buf_a) : "memory"); \
+        }                                                   \
+    }
+
+MEM_BENCH(kfs_memcpy_64,   kfs_memcpy(buf_a, buf_b, 64))
+MEM_BENCH(libc_memcpy_64,  memcpy(buf_a, buf_b, 64))
+MEM_BENCH(kfs_memcpy_4k,   kfs_memcpy(buf_a, buf_b, 4096))
+MEM_BENCH(libc_memcpy_4k,  memcpy(buf_a, buf_b, 4096))
+MEM_BENCH(kfs_memset_4k,   kfs_memset(buf_a, 0x20, 4096))
+MEM_BENCH(libc_memset_4k,  memset(buf_a, 0x20, 4096))
+
+static void kfs_strlen_64(size_t iters) {
+    for (size_t i = 0; i < iters; i++) {
+        __asm__ volatile("" : : "r"(buf_b) : "memory");
+        sink += kfs_strlen(buf_b);
+    }
+}
+
+static void libc_strlen_64(size_t iters) {
+    for (size_t i = 0; i < iters; i++) {
+        __asm__ volatile("" : : "r"(buf_b) : "memory");
+        sink += strlen(buf_b);
+    }
+}
+
+/* ------------------------------------------------------------- printf.c */
+
+#define FMT_BENCH(name, fn, ...)                                \
+    static void name(size_t iters) {                            \
+        for (size_t i = 0; i < iters; i++) {                    \
+            sink += (uintptr_t)fn(buf_a, 256, __VA_ARGS__);     \
+        }                                                       \
+    }
+
+FMT_BENCH(kfs_fmt_literal,  kfs_snprintf, "Initializing keyboard...\n")
+FMT_BENCH(libc_fmt_literal, snprintf,     "Initializing keyboard...\n")
+FMT_BENCH(kfs_fmt_ints,     kfs_snprintf, "%d %u %x %08x", -123456, 4000000000u, 0xBEEFu, (unsigned)i)
+FMT_BENCH(libc_fmt_ints,    snprintf,     "%d %u %x %08x", -123456, 4000000000u, 0xBEEFu, (unsigned)i)
+FMT_BENCH(old_fmt_ints,     legacy_snprintf, "%d %u %x %08x", -123456, 4000000000u, 0xBEEFu, (unsigned)i)
+FMT_BENCH(kfs_fmt_strings,  kfs_snprintf, "%s - %s\n", "uptime", "Display system uptime")
+FMT_BENCH(libc_fmt_strings, snprintf,     "%s - %s\n", "uptime", "Display system uptime")
+FMT_BENCH(old_fmt_strings,  legacy_snprintf, "%s - %s\n", "uptime", "Display system uptime")
+FMT_BENCH(kfs_fmt_help,     kfs_snprintf, "  %-12s - %s\n", "uptime", "Display system uptime")
+FMT_BENCH(libc_fmt_help,    snprintf,     "  %-12s - %s\n", "uptime", "Display system uptime")
+FMT_BENCH(kfs_fmt_u64,      kfs_snprintf, "%llu %lld", 18446744073709551615ull, -1234567890123ll)
+FMT_BENCH(libc_fmt_u64,     snprintf,     "%llu %lld", 18446744073709551615ull, -1234567890123ll)
+
+/* print_stack()-style line: the old printk loop vs the same output via vformat */
+static void kfs_fmt_stackline(size_t iters) {
+    for (size_t i = 0; i < iters; i++) {
+        sink += (uintptr_t)kfs_snprintf(buf_a, 256, "[%08X] = 0x%08X  <%s> %d\n",
+                                        0x00107FC0u, (unsigned)i, "shell_main_loop+0x1c", -42);
+    }
+}
+
+static void old_fmt_stackline(size_t iters) {
+    for (size_t i = 0; i < iters; i++) {
+        sink += (uintptr_t)legacy_printk_format(buf_a, "[%x] = 0x%x  <%s> %d\n",
+                                                0x00107FC0u, (unsigned)i, "shell_main_loop+0x1c", -42);
+    }
+}
+
+/* -------------------------------------------------------- shell_parse.c */
+
+static void shell_parse(size_t iters) {
+    static const char line[] = "  echo Hello from\tthe kernel shell!  ";
+    char tmp[sizeof(line)];
+    char *argv[SHELL_MAX_ARGS];
+
+    for (size_t i = 0; i < iters; i++) {
+        memcpy(tmp, line, sizeof(line));
+        sink += (uintptr_t)shell_parse_input(tmp, argv);
+    }
+}
+
+/* ---------------------------------------------------------- initramfs.c */
+
+static uint8_t archive[6 << 20];
+static char paths[5000][32];
+static size_t lookup_files;
+
+/* ustar archive of n files "dN/fileN" */
+static void build_archive(size_t n) {
+    size_t len = 0;
+
+    for (size_t i = 0; i < n; i++) {
+        uint8_t *h = archive + len;
+        unsigned sum = 0;
+
+        snprintf(paths[i], sizeof(paths[i]), "/d%zu/file%zu", i % 50, i);
+        memset(h, 0, 1024);
+        memcpy(h, paths[i] + 1, strlen(paths[i]) - 1);
+        memcpy(h + 100, "0000644", 7);
+        memcpy(h + 124, "00000000004", 11);
+        h[156] = '0';
+        memcpy(h + 257, "ustar", 6);
+        memset(h + 148, ' ', 8);
+        for (int k = 0; k < 512; k++) sum += h[k];
+        snprintf((char *)h + 148, 8, "%06o", sum);
+        len += 1024;
+    }
+    memset(archive + len, 0, 1024);
+    initramfs_load(archive, len + 1024);
+    lookup_files = n;
+}
+
+static void initramfs_lookups(size_t iters) {
+    for (size_t i = 0; i < iters; i++) {
+        sink += (uintptr_t)initramfs_lookup(paths[i % lookup_files]);
+    }
+}
+
+/* ----------------------------------------------------------- workpool.c */
+
+#define PFOR_FRAMES     1024            /* 4 MB, memory-bound */
+#define PFOR_CRC_FRAMES 64              /* 256 KB, compute-bound */
+
+static struct workpool pool;
+static pthread_t pool_threads[WORKPOOL_MAX_WORKERS];
+static uint32_t pool_self[WORKPOOL_MAX_WORKERS];
+static int pool_stop;
+static uint8_t frames[PFOR_FRAMES][4096];
+static volatile uint32_t crcs[PFOR_FRAMES];   /* Volatile: nothing reads them */
+
+static void *pool_worker(void *arg) {
+    uint32_t self = *(uint32_t *)arg;
+
+    while (!__atomic_load_n(&pool_stop, __ATOMIC_ACQUIRE)) {
+        if (!workpool_help(&pool, self)) __builtin_ia32_pause();
+    }
+    return NULL;
+}
+
+static void pool_start(uint32_t workers) {
+    workpool_init(&pool, workers);
+    pool_stop = 0;
+    for (uint32_t i = 1; i < workers; i++) {
+        pool_self[i] = i;
+        pthread_create(&pool_threads[i], NULL, pool_worker, &pool_self[i]);
+    }
+}
+
+static void pool_end(void) {
+    __atomic_store_n(&pool_stop, 1, __ATOMIC_RELEASE);
+    for (uint32_t i = 1; i < pool.workers; i++) pthread_join(pool_threads[i], NULL);
+}
+
+static void zero_frames(uint32_t begin, uint32_t end, void *arg) {
+    (void)arg;
+    for (uint32_t i = begin; i < end; i++) memset(frames[i], 0, sizeof(frames[i]));
+}
+
+/* Same bitwise CRC-32 as the kernel benchmark */
+static void crc_frames(uint32_t begin, uint32_t end, void *arg) {
+    (void)arg;
+    for (uint32_t i = begin; i < end; i++) {
+        uint32_t crc = 0xFFFFFFFF;
+        for (size_t j = 0; j < sizeof(frames[i]); j++) {
+            crc ^= frames[i][j];
+            for (int k = 0; k < 8; k++) crc = (crc >> 1) ^ (0xEDB88320 & -(crc & 1));
+        }
+        crcs[i] = ~crc;
+    }
+}
+
+static void pfor_zero(size_t iters) {
+    for (size_t i = 0; i < iters; i++) parallel_for_on(&pool, 0, 0, PFOR_FRAMES, 8, zero_frames, NULL);
+}
+
+static void pfor_crc(size_t iters) {
+    for (size_t i = 0; i < iters; i++) parallel_for_on(&pool, 0, 0, PFOR_CRC_FRAMES, 1, crc_frames, NULL);
+}
+
+int main(void) {
+    memset(buf_b, 'k', sizeof(buf_b));
+    buf_b[64] = '\0';
+
+    printf("%-28s %10s %10s %9s\n", "benchmark", "median ns", "min ns", "MAD");
+
+    run("memcpy 64B (kfs)", kfs_memcpy_64);
+    run("memcpy 64B (libc)", libc_memcpy_64);
+    run("memcpy 4KB (kfs)", kfs_memcpy_4k);
+    run("memcpy 4KB (libc)", libc_memcpy_4k);
+    run("memset 4KB (kfs)", kfs_memset_4k);
+    run("memset 4KB (libc)", libc_memset_4k);
+    run("strlen 64B (kfs)", kfs_strlen_64);
+    run("strlen 64B (libc)", libc_strlen_64);
+
+    run("snprintf literal (kfs)", kfs_fmt_literal);
+    run("snprintf literal (libc)", libc_fmt_literal);
+    run("snprintf ints (kfs)", kfs_fmt_ints);
+    run("snprintf ints (libc)", libc_fmt_ints);
+    run("snprintf ints (old)", old_fmt_ints);
+    run("snprintf strings (kfs)", kfs_fmt_strings);
+    run("snprintf strings (libc)", libc_fmt_strings);
+    run("snprintf strings (old)", old_fmt_strings);
+    run("snprintf %-12s (kfs)", kfs_fmt_help);
+    run("snprintf %-12s (libc)", libc_fmt_help);
+    run("snprintf 64-bit (kfs)", kfs_fmt_u64);
+    run("snprintf 64-bit (libc)", libc_fmt_u64);
+    run("printk stack line (kfs)", kfs_fmt_stackline);
+    run("printk stack line (old)", old_fmt_stackline);
+
+    run("shell_parse_input", shell_parse);
+
+    /* Hashed lookup: the cost should not depend on the file count */
+    build_archive(16);
+    run("initramfs lookup, 16 files", initramfs_lookups);
+    build_archive(5000);
+    run("initramfs lookup, 5000 files", initramfs_lookups);
+
+    /* Work-stealing scaling: memory-bound vs compute-bound */
+    for (uint32_t workers = 1; workers <= 4; workers *= 2) {
+        char name[64];
+
+        pool_start(workers);
+        snprintf(name, sizeof(name), "parallel_for zero 4MB, %u cpu", workers);
+        run(name, pfor_zero);
+        snprintf(name, sizeof(name), "parallel_for crc 256KB, %u cpu", workers);
+        run(name, pfor_crc);
+        pool_end();
+    }
+    return 0;
+}
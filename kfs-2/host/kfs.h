@@ -0,0 +1,33 @@
+#ifndef HOST_KFS_H
+#define HOST_KFS_H
+
+/*
+ * Prototypes of kernel functions as seen from host test/bench code,
+ * under the names given to them by shim.h.
+ */
+
+#include <stdarg.h>
+#include <stddef.h>
+
+size_t kfs_strlen(const char *str);
+int kfs_strcmp(const char *a, const char *b);
+void *kfs_memset(void *dest, int val, size_t len);
+void *kfs_memcpy(void *dest, const void *src, size_t len);
+int kfs_atoi(const char *str);
+
+int kfs_vsnprintf(char *buf, size_t size, const char *fmt, va_list args);
+int kfs_snprintf(char *buf, size_t size, const char *fmt, ...);
+
+/* shell_parse_input() and SHELL_MAX_ARGS */
+#include "shell.h"
+
+/* initramfs_load(), initramfs_lookup() */
+#include "initramfs.h"
+
+/* wheel_add(), wheel_expire() ... */
+#include "timer_wheel.h"
+
+/* wsdeque_*(), parallel_for_on() */
+#include "workpool.h"
+
+#endif /* HOST_KFS_H */
@@ -0,0 +1,223 @@
+/*
+ * The two formatters that vformat() replaced, kept verbatim (apart from
+ * names and output) so `make host-bench` can compare against them:
+ *
+ *   legacy_vsnprintf()      - the old printf.c (%s %c %d %u %x, width, '0')
+ *   legacy_printk_format()  - the old printk() loop (%d %x %s %c into a
+ *                             256-byte buffer, one division per digit)
+ */
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "legacy_format.h"
+
+static void out_char(char **buf, size_t *rem, char c) {
+    if (*rem > 1) {
+        **buf = c;
+        (*buf)++;
+        (*rem)--;
+    } else {
+        /* when no room, still advance pointer to count length */
+        (*buf)++;
+    }
+}
+
+static void out_str(char **buf, size_t *rem, const char *s) {
+    while (*s) out_char(buf, rem, *s++);
+}
+
+/* sign is '-' or 0; it counts towards width and goes before zero padding */
+static void out_uint_base(char **buf, size_t *rem, unsigned int v, int base, int width, int pad_zero, char sign) {
+    char tmp[32];
+    int pos = 0;
+    if (v == 0) {
+        tmp[pos++] = '0';
+    } else {
+        while (v && pos < (int)sizeof(tmp)) {
+            unsigned int d = v % base;
+            tmp[pos++] = (d < 10) ? ('0' + d) : ('a' + d - 10);
+            v /= base;
+        }
+    }
+    if (sign) width--;
+    if (sign && pad_zero) out_char(buf, rem, sign);
+    while (pos < width) { out_char(buf, rem, pad_zero ? '0' : ' '); width--; }
+    if (sign && !pad_zero) out_char(buf, rem, sign);
+    while (pos--) out_char(buf, rem, tmp[pos]);
+}
+
+int legacy_vsnprintf(char *buf, size_t size, const char *fmt, va_list args) {
+    char *out = buf;
+    size_t rem = size;
+    const char *p = fmt;
+
+    if (rem == 0) return 0; /* nothing to do */
+
+    while (*p) {
+        if (*p != '%') {
+            out_char(&out, &rem, *p++);
+            continue;
+        }
+        p++; /* skip '%' */
+
+        /* simple width/zero parsing (e.g. %02d) */
+        int width = 0;
+        int pad_zero = 0;
+        if (*p == '0') { pad_zero = 1; p++; }
+        while (*p >= '0' && *p <= '9') {
+            width = width * 10 + (*p - '0');
+            p++;
+        }
+
+        switch (*p) {
+            case 'c': {
+                int c = va_arg(args, int);
+                out_char(&out, &rem, (char)c);
+                break;
+            }
+            case 's': {
+                const char *s = va_arg(args, const char*);
+                if (!s) s = "(null)";
+                out_str(&out, &rem, s);
+                break;
+            }
+            case 'd': {
+                int v = va_arg(args, int);
+                if (v < 0) {
+                    /* 0u - v avoids overflow on INT_MIN */
+                    out_uint_base(&out, &rem, 0u - (unsigned int)v, 10, width, pad_zero, '-');
+                } else {
+                    out_uint_base(&out, &rem, (unsigned int)v, 10, width, pad_zero, 0);
+                }
+                break;
+            }
+            case 'u': {
+                unsigned int v = va_arg(args, unsigned int);
+                out_uint_base(&out, &rem, v, 10, width, pad_zero, 0);
+                break;
+            }
+            case 'x': {
+                unsigned int v = va_arg(args, unsigned int);
+                out_uint_base(&out, &rem, v, 16, width, pad_zero, 0);
+                break;
+            }
+            case '%': {
+                out_char(&out, &rem, '%');
+                break;
+            }
+            default:
+                out_char(&out, &rem, '?');
+                break;
+        }
+        p++;
+    }
+
+    /* out runs past the buffer on truncation; terminate at the last slot */
+    if ((size_t)(out - buf) < size) {
+        *out = '\0';
+    } else {
+        buf[size - 1] = '\0';
+    }
+
+    return (int)(out - buf);
+}
+
+int legacy_snprintf(char *buf, size_t size, const char *fmt, ...) {
+    va_list ap;
+    va_start(ap, fmt);
+    int r = legacy_vsnprintf(buf, size, fmt, ap);
+    va_end(ap);
+    return r;
+}
+
+/* Convert integer to hex string */
+static void itohex(uint32_t value, char *buffer, int width) {
+    const char *hex_chars = "0123456789ABCDEF";
+    int i = width - 1;
+    
+    while (i >= 0) {
+        buffer[i] = hex_chars[value & 0xF];
+        value >>= 4;
+        i--;
+    }
+    buffer[width] = '\0';
+}
+
+/* Convert integer to decimal string */
+static void itodec(int32_t value, char *buffer) {
+    if (value < 0) {
+        *buffer++ = '-';
+        value = -value;
+    }
+    
+    char temp[12];
+    int i = 0;
+    
+    if (value == 0) {
+        temp[i++] = '0';
+    } else {
+        while (value > 0) {
+            temp[i++] = '0' + (value % 10);
+            value /= 10;
+        }
+    }
+    
+    while (i > 0) {
+        *buffer++ = temp[--i];
+    }
+    *buffer = '\0';
+}
+
+    
+int legacy_printk_format(char buffer[256], const char *fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    
+    int buf_pos = 0;
+    
+    while (*fmt && buf_pos < 255) {
+        if (*fmt == '%' && *(fmt + 1)) {
+            fmt++;
+            if (*fmt == 'd') {
+                int val = va_arg(args, int);
+                char temp[12];
+                itodec(val, temp);
+                const char *p = temp;
+                while (*p && buf_pos < 255) {
+                    buffer[buf_pos++] = *p++;
+                }
+            } else if (*fmt == 'x') {
+                uint32_t val = va_arg(args, uint32_t);
+                char temp[9];
+                itohex(val, temp, 8);
+                const char *p = temp;
+                while (*p && buf_pos < 255) {
+                    buffer[buf_pos++] = *p++;
+                }
+            } else if (*fmt == 's') {
+                const char *str = va_arg(args, const char *);
+                while (*str && buf_pos < 255) {
+                    buffer[buf_pos++] = *str++;
+                }
+            } else if (*fmt == 'c') {
+                char c = va_arg(args, int);
+                buffer[buf_pos++] = c;
+            } else if (*fmt == '%') {
+                buffer[buf_pos++] = '%';
+            }
+            fmt++;
+        } else if (*fmt == '\\' && *(fmt + 1) == 'n') {
+            buffer[buf_pos++] = '\n';
+            fmt += 2;
+        } else {
+            buffer[buf_pos++] = *fmt++;
+        }
+    }
+    
+    buffer[buf_pos] = '\0';
+    va_end(args);
+    
+    return buf_pos;
+}
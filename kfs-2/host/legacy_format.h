@@ -0,0 +1,11 @@
+#ifndef HOST_LEGACY_FORMAT_H
+#define HOST_LEGACY_FORMAT_H
+
+#include <stdarg.h>
+#include <stddef.h>
+
+int legacy_vsnprintf(char *buf, size_t size, const char *fmt, va_list args);
+int legacy_snprintf(char *buf, size_t size, const char *fmt, ...);
+int legacy_printk_format(char buffer[256], const char *fmt, ...);
+
+#endif /* HOST_LEGACY_FORMAT_H */
@@ -0,0 +1,21 @@
+#ifndef HOST_SHIM_H
+#define HOST_SHIM_H
+
+/*
+ * Host build shim.
+ *
+ * Force-included (-include host/shim.h) into every kernel translation
+ * unit compiled for the build host.  Renames the kernel's freestanding
+ * libc replacements so they link next to the host libc instead of
+ * interposing it, and so tests can call both and compare the results.
+ */
+
+#define strlen    kfs_strlen
+#define strcmp    kfs_strcmp
+#define memset    kfs_memset
+#define memcpy    kfs_memcpy
+#define atoi      kfs_atoi
+#define vsnprintf kfs_vsnprintf
+#define snprintf  kfs_snprintf
+
+#endif /* HOST_SHIM_H */
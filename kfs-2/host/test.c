@@ -0,0 +1,692 @@
+/*
+ * Host-native unit and conformance tests for portable kernel code.
+ *
+ * Built by `make host-test` with -fsanitize=address,undefined.
+ * Randomised cases are driven by a xorshift PRNG; the seed is printed
+ * on start and can be fixed with KFS_SEED=<n> to reproduce a failure.
+ */
+
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <stddef.h>
+#include <sys/types.h>
+#include <pthread.h>
+
+#include "kfs.h"
+
+static int failures = 0;
+static int checks = 0;
+
+#define CHECK(cond, ...) do {                                   \
+        checks++;                                               \
+        if (!(cond)) {                                          \
+            failures++;                                         \
+            fprintf(stderr, "%s:%d: FAIL: ", __FILE__, __LINE__); \
+            fprintf(stderr, __VA_ARGS__);                       \
+            fputc('\n', stderr);                                \
+        }                                                       \
+    } while (0)
+
+static uint64_t rng_state;
+
+static uint32_t rnd(void) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return (uint32_t)(rng_state >> 16);
+}
+
+static uint32_t rnd_below(uint32_t n) {
+    return rnd() % n;
+}
+
+static int sign(int v) {
+    return (v > 0) - (v < 0);
+}
+
+/* ---------------------------------------------------------------- lib.c */
+
+static void test_lib(void) {
+    static const char *strs[] = { "", "a", "abc", "abd", "ab", "kernel> ", "\xff" };
+    const size_t n = sizeof(strs) / sizeof(strs[0]);
+
+    for (size_t i = 0; i < n; i++) {
+        CHECK(kfs_strlen(strs[i]) == strlen(strs[i]), "strlen(\"%s\")", strs[i]);
+        for (size_t j = 0; j < n; j++) {
+            CHECK(sign(kfs_strcmp(strs[i], strs[j])) == sign(strcmp(strs[i], strs[j])),
+                  "strcmp(\"%s\", \"%s\")", strs[i], strs[j]);
+        }
+    }
+
+    static const char *nums[] = { "0", "42", "-17", "+8", "  123", "\t-5x", "abc", "", "2147483647" };
+    for (size_t i = 0; i < sizeof(nums) / sizeof(nums[0]); i++) {
+        CHECK(kfs_atoi(nums[i]) == atoi(nums[i]), "atoi(\"%s\")", nums[i]);
+    }
+    for (int iter = 0; iter < 1000; iter++) {
+        char num[16];
+        int v = (int)rnd() / 2;
+        snprintf(num, sizeof(num), "%d", v);
+        CHECK(kfs_atoi(num) == v, "atoi(\"%s\")", num);
+    }
+
+    for (int iter = 0; iter < 2000; iter++) {
+        unsigned char src[300], a[300], b[300];
+        size_t len = rnd_below(257);
+        size_t off = rnd_below(8);
+        int val = (int)rnd();
+
+        for (size_t k = 0; k < sizeof(src); k++) src[k] = (unsigned char)rnd();
+        memcpy(a, src, sizeof(a));
+        memcpy(b, src, sizeof(b));
+
+        CHECK(kfs_memset(a + off, val, len) == a + off, "memset return value");
+        memset(b + off, val, len);
+        CHECK(memcmp(a, b, sizeof(a)) == 0, "memset len=%zu off=%zu", len, off);
+
+        CHECK(kfs_memcpy(a + off, src + 7, len) == a + off, "memcpy return value");
+        memcpy(b + off, src + 7, len);
+        CHECK(memcmp(a, b, sizeof(a)) == 0, "memcpy len=%zu off=%zu", len, off);
+    }
+}
+
+/* ------------------------------------------------------------- printf.c */
+
+static void compare_format(size_t size, const char *fmt, ...) {
+    char got[128], want[128];
+    va_list ap, aq;
+    int rg, rw;
+
+    memset(got, 0x5A, sizeof(got));
+    memset(want, 0x5A, sizeof(want));
+
+    va_start(ap, fmt);
+    va_copy(aq, ap);
+    rg = kfs_vsnprintf(got, size, fmt, ap);
+    rw = vsnprintf(want, size, fmt, aq);
+    va_end(aq);
+    va_end(ap);
+
+    CHECK(rg == rw, "vsnprintf(size=%zu, \"%s\") returned %d, libc %d", size, fmt, rg, rw);
+    CHECK(memcmp(got, want, sizeof(got)) == 0,
+          "vsnprintf(size=%zu, \"%s\") wrote \"%.*s\", libc \"%.*s\"",
+          size, fmt, (int)size, got, (int)size, want);
+}
+
+/* Append a random integer conversion (%d %u %x %c with flags/width) */
+static void append_int_spec(char *fmt, size_t cap) {
+    static const char convs[] = "duxc";
+    char conv = convs[rnd_below(4)];
+    char spec[16];
+
+    if (conv == 'c' || rnd_below(2)) {
+        snprintf(spec, sizeof(spec), "%%%c", conv);
+    } else {
+        snprintf(spec, sizeof(spec), "%%%s%u%c", rnd_below(2) ? "0" : "",
+                 rnd_below(12), conv);
+    }
+    strncat(fmt, spec, cap - strlen(fmt) - 1);
+}
+
+static int random_int(void) {
+    switch (rnd_below(6)) {
+        case 0:  return 0;
+        case 1:  return INT_MIN;
+        case 2:  return INT_MAX;
+        case 3:  return -(int)rnd_below(1000);
+        case 4:  return (int)rnd_below(100000);
+        default: return (int)rnd();
+    }
+}
+
+static char random_char(void) {
+    return (char)(' ' + rnd_below(95));
+}
+
+static void test_vsnprintf_fixed(void) {
+    compare_format(64, "plain text");
+    compare_format(64, "%%");
+    compare_format(64, "%d %d %d", 0, -1, 1);
+    compare_format(64, "%d %d", INT_MIN, INT_MAX);
+    compare_format(64, "%u %x", 0xFFFFFFFFu, 0xDEADBEEFu);
+    compare_format(64, "[%5d] [%3d] [%05d]", -42, 7, -42);
+    compare_format(64, "[%08x] [%2x]", 0xBEEFu, 0x12345u);
+    compare_format(64, "%s|%s|%c", "abc", "", 'z');
+    compare_format(1, "truncated");
+    compare_format(4, "hello");
+    compare_format(5, "%d", 123456);
+    compare_format(9, "%s-%s", "abcd", "efgh");
+
+    /* Flags, width, precision */
+    compare_format(64, "[%-12s] [%12s] [%-3s]", "help", "help", "toolong");
+    compare_format(64, "[%+d] [% d] [%+d] [% 5d] [%-+6d]", 5, 5, -5, 42, 42);
+    compare_format(64, "[%#x] [%#X] [%#o] [%#o] [%#x]", 255u, 255u, 8u, 0u, 0u);
+    compare_format(64, "[%.3d] [%.0d] [%5.3d] [%-5.3d] [%05.3d]", 7, 0, -7, 7, 7);
+    compare_format(64, "[%.0u] [%.0x] [%#.0o] [%08.3x]", 0u, 0u, 0u, 0xABu);
+    compare_format(64, "[%.2s] [%8.3s] [%-8.3s] [%.0s]", "abcdef", "abcdef", "abcdef", "x");
+    compare_format(64, "[%*d] [%-*d] [%.*d] [%*d]", 6, 42, 6, 42, 4, 42, -6, 42);
+    compare_format(64, "[%5c] [%-5c] [%o] [%X]", 'a', 'b', 0777u, 0xDEADBEEFu);
+    compare_format(64, "[%%] 100%%");
+
+    /* Length modifiers and 64-bit values */
+    compare_format(64, "%hhd %hhu %hd %hu", 300, 300, 70000, 70000);
+    compare_format(64, "%ld %lu %lx", LONG_MIN, ULONG_MAX, ULONG_MAX);
+    compare_format(64, "%llu %llu %llu", 0ull, 4294967296ull, ULLONG_MAX);
+    compare_format(64, "%lld %lld %lld", LLONG_MIN, LLONG_MAX, -100000000ll);
+    compare_format(64, "%llu %llu", 10000000000000000000ull, 100000000ull * 100000000ull);
+    compare_format(64, "[%020llu] [%-22lld] [%.20llu]", 123456789012345ull, -1ll, 99ull);
+    compare_format(64, "%llx %#llX %llo", 0x123456789ABCDEFull, ULLONG_MAX, ULLONG_MAX);
+    compare_format(64, "%zu %zd %jd %ju %td", (size_t)-1, (ssize_t)-5, INTMAX_MIN, UINTMAX_MAX,
+                   (ptrdiff_t)-9);
+
+    /* Pointers */
+    compare_format(64, "%p", (void *)compare_format);
+    compare_format(64, "[%20p] [%-20p]", (void *)0x1000, (void *)0xC0FFEE);
+    compare_format(64, "%p", (void *)NULL);
+}
+
+/* One random conversion with flags/width/precision/length and a matching argument */
+static void compare_random_spec(void) {
+    static const char convs[] = "diuoxX";
+    static const char *const lens[] = { "", "hh", "h", "l", "ll", "z" };
+    char conv = convs[rnd_below(6)];
+    int li = (int)rnd_below(6);
+    int is_signed = conv == 'd' || conv == 'i';
+    char fmt[48] = "<";
+    uint64_t v = ((uint64_t)rnd() << 32) | rnd();
+
+    /* '#' only applies to o/x/X and '+'/' ' to signed conversions */
+    if (rnd_below(3) == 0) strcat(fmt, "-");
+    if (rnd_below(3) == 0) strcat(fmt, "0");
+    if (!is_signed && conv != 'u' && rnd_below(3) == 0) strcat(fmt, "#");
+    if (is_signed && rnd_below(4) == 0) strcat(fmt, rnd_below(2) ? "+" : " ");
+    if (rnd_below(2)) sprintf(fmt + strlen(fmt), "%u", rnd_below(24));
+    if (rnd_below(3) == 0) sprintf(fmt + strlen(fmt), ".%u", rnd_below(22));
+    sprintf(fmt + strlen(fmt), "%s%c>", lens[li], conv);
+
+    /* Small magnitudes are where the edge cases are */
+    switch (rnd_below(4)) {
+        case 0: v &= 0xFF; break;
+        case 1: v &= 0xFFFFFFFF; break;
+        case 2: v = (uint64_t)-(int64_t)(v & 0xFFFF); break;
+        default: break;
+    }
+
+    size_t size = 1 + rnd_below(80);
+    switch (li) {
+        case 3:  compare_format(size, fmt, (long)v); break;
+        case 4:  compare_format(size, fmt, (long long)v); break;
+        case 5:  compare_format(size, fmt, (size_t)v); break;
+        default: compare_format(size, fmt, (int)v); break;
+    }
+}
+
+static void test_vsnprintf_random(void) {
+    static const char *lits[] = { "", "x", " = ", "[", "]\n", "kernel> " };
+    const size_t nlits = sizeof(lits) / sizeof(lits[0]);
+
+    for (int iter = 0; iter < 20000; iter++) {
+        char fmt[96] = "";
+        size_t size = 1 + rnd_below(80);
+
+        for (int k = 0; k < 4; k++) {
+            strcat(fmt, lits[rnd_below(nlits)]);
+            append_int_spec(fmt, sizeof(fmt));
+        }
+
+        /* %c consumes an int too, so every slot can share one argument type */
+        compare_format(size, fmt, random_int(), random_int(), random_int(), random_int());
+    }
+
+    for (int iter = 0; iter < 5000; iter++) {
+        char s0[40], s1[40];
+        size_t size = 1 + rnd_below(100);
+        size_t l0 = rnd_below(sizeof(s0)), l1 = rnd_below(sizeof(s1));
+
+        for (size_t k = 0; k < l0; k++) s0[k] = random_char();
+        for (size_t k = 0; k < l1; k++) s1[k] = random_char();
+        s0[l0] = '\0';
+        s1[l1] = '\0';
+        compare_format(size, "<%s> and <%s>", s0, s1);
+    }
+
+    for (int iter = 0; iter < 50000; iter++) {
+        compare_random_spec();
+    }
+
+    for (int iter = 0; iter < 5000; iter++) {
+        char fmt[32], s0[40];
+        size_t l0 = rnd_below(sizeof(s0));
+
+        for (size_t k = 0; k < l0; k++) s0[k] = random_char();
+        s0[l0] = '\0';
+        snprintf(fmt, sizeof(fmt), "[%%%s%u.%us]", rnd_below(2) ? "-" : "",
+                 rnd_below(30), rnd_below(45));
+        compare_format(1 + rnd_below(100), fmt, s0);
+    }
+}
+
+/* -------------------------------------------------------- shell_parse.c */
+
+static void check_parse(const char *line, int want_argc, const char *const want[]) {
+    char buf[512];
+    char *argv[SHELL_MAX_ARGS + 1];
+    int argc;
+
+    snprintf(buf, sizeof(buf), "%s", line);
+    argc = shell_parse_input(buf, argv);
+    CHECK(argc == want_argc, "parse(\"%s\"): argc %d, want %d", line, argc, want_argc);
+    for (int i = 0; i < argc && i < want_argc; i++) {
+        CHECK(strcmp(argv[i], want[i]) == 0,
+              "parse(\"%s\"): argv[%d] \"%s\", want \"%s\"", line, i, argv[i], want[i]);
+    }
+}
+
+static void test_shell_parse(void) {
+    static const char *const echo_hi[] = { "echo", "hi" };
+    static const char *const help[] = { "help" };
+    static const char *const many[] = {
+        "0", "1", "2", "3", "4", "5", "6", "7",
+        "8", "9", "a", "b", "c", "d", "e", "f",
+    };
+
+    check_parse("", 0, NULL);
+    check_parse("   \t  ", 0, NULL);
+    check_parse("help", 1, help);
+    check_parse("\thelp\r\n", 1, help);
+    check_parse("echo hi", 2, echo_hi);
+    check_parse("  echo \t  hi   ", 2, echo_hi);
+    check_parse("0 1 2 3 4 5 6 7 8 9 a b c d e f g h", SHELL_MAX_ARGS, many);
+
+    /* Random whitespace-separated tokens round-trip through the parser */
+    for (int iter = 0; iter < 2000; iter++) {
+        static const char ws[] = " \t\r\n";
+        char line[512] = "", tok[SHELL_MAX_ARGS][12];
+        const char *want[SHELL_MAX_ARGS];
+        int ntok = (int)rnd_below(SHELL_MAX_ARGS + 1);
+
+        for (int t = 0; t < ntok; t++) {
+            size_t len = 1 + rnd_below(sizeof(tok[t]) - 1);
+            for (size_t k = 0; k < len; k++) tok[t][k] = (char)('!' + rnd_below(94));
+            tok[t][len] = '\0';
+            want[t] = tok[t];
+
+            for (uint32_t k = rnd_below(3) + (t > 0); k > 0; k--) {
+                strncat(line, &ws[rnd_below(4)], 1);
+            }
+            strcat(line, tok[t]);
+        }
+        check_parse(line, ntok, want);
+    }
+}
+
+/* ---------------------------------------------------------- initramfs.c */
+
+static uint8_t archive[6 << 20];
+static size_t archive_len;
+
+static void tar_add(const char *name, const char *prefix, char type, const char *data, size_t len,
+                    const char *link) {
+    uint8_t *h = archive + archive_len;
+    unsigned sum = 0;
+
+    memset(h, 0, 512);
+    memcpy(h, name, strnlen(name, 100));
+    snprintf((char *)h + 100, 8, "%07o", 0644);
+    snprintf((char *)h + 124, 12, "%011zo", len);
+    snprintf((char *)h + 136, 12, "%011o", 1234567u);
+    h[156] = (uint8_t)type;
+    if (link) memcpy(h + 157, link, strlen(link));
+    memcpy(h + 257, "ustar", 6);
+    memcpy(h + 263, "00", 2);
+    if (prefix) memcpy(h + 345, prefix, strlen(prefix));
+    memset(h + 148, ' ', 8);
+    for (int i = 0; i < 512; i++) sum += h[i];
+    snprintf((char *)h + 148, 8, "%06o", sum);
+
+    memcpy(h + 512, data, len);
+    archive_len += 512 + ((len + 511) & ~(size_t)511);
+}
+
+static void tar_end(void) {
+    memset(archive + archive_len, 0, 1024);
+    archive_len += 1024;
+}
+
+static void newc_add(const char *name, unsigned mode, const char *data, size_t len) {
+    size_t namesize = strlen(name) + 1;
+
+    archive_len += (size_t)sprintf((char *)archive + archive_len,
+                                   "070701%08X%08X%08X%08X%08X%08X%08zX%08X%08X%08X%08X%08zX%08X",
+                                   1u, mode, 0u, 0u, 1u, 99u, len, 0u, 0u, 0u, 0u, namesize, 0u);
+    memcpy(archive + archive_len, name, namesize);
+    archive_len = (archive_len + namesize + 3) & ~(size_t)3;
+    memcpy(archive + archive_len, data, len);
+    archive_len = (archive_len + len + 3) & ~(size_t)3;
+}
+
+static int in_archive(const void *p) {
+    return (const uint8_t *)p >= archive && (const uint8_t *)p < archive + archive_len;
+}
+
+static void check_file(const char *path, const char *want) {
+    const struct initramfs_file *f = initramfs_lookup(path);
+
+    CHECK(f != NULL, "lookup(\"%s\") failed", path);
+    if (!f) return;
+    CHECK(f->type == INITRAMFS_FILE, "\"%s\": type %d", path, f->type);
+    CHECK(f->size == strlen(want) && memcmp(f->data, want, f->size) == 0, "\"%s\": contents", path);
+    CHECK(in_archive(f->data), "\"%s\": data copied out of the archive", path);
+}
+
+/* Names of the children of dir, space separated */
+static void children(const char *dir, char *out, size_t cap) {
+    const struct initramfs_file *d = initramfs_lookup(dir);
+
+    out[0] = '\0';
+    if (!d) return;
+    for (uint16_t i = d->first_child; i != INITRAMFS_NONE; i = initramfs_get(i)->next_sibling) {
+        const struct initramfs_file *c = initramfs_get(i);
+        const char *base = c->name + c->name_len;
+        while (base > c->name && base[-1] != '/') base--;
+        if (out[0]) strncat(out, " ", cap - strlen(out) - 1);
+        strncat(out, base, (size_t)(c->name + c->name_len - base));
+    }
+}
+
+static void test_initramfs(void) {
+    char list[256], longname[180], path[64];
+
+    /* ustar: explicit and implicit directories, prefix, GNU long name, links */
+    archive_len = 0;
+    tar_add("./", NULL, '5', "", 0, NULL);
+    tar_add("./etc/", NULL, '5', "", 0, NULL);
+    tar_add("./etc/motd", NULL, '0', "hello\n", 6, NULL);
+    tar_add("./bin/sh", NULL, '0', "#!", 2, NULL);              /* bin/ implicit */
+    tar_add("file", "deep/prefix/dir", '0', "pfx", 3, NULL);
+    memset(longname, 'n', sizeof(longname) - 1);
+    longname[sizeof(longname) - 1] = '\0';
+    memcpy(longname, "long/", 5);
+    tar_add("././@LongLink", NULL, 'L', longname, strlen(longname) + 1, NULL);
+    tar_add("truncated-name", NULL, '0', "long", 4, NULL);
+    tar_add("./etc/issue", NULL, '1', "", 0, "./etc/motd");
+    tar_add("./etc/link", NULL, '2', "", 0, "motd");
+    tar_end();
+
+    int n = initramfs_load(archive, archive_len);
+    CHECK(n == 13, "tar: %d entries, want 13", n);
+    check_file("/etc/motd", "hello\n");
+    check_file("etc/motd", "hello\n");
+    check_file("./bin/sh", "#!");
+    check_file("/deep/prefix/dir/file", "pfx");
+    check_file(longname, "long");
+    check_file("/etc/issue", "hello\n");
+    CHECK(initramfs_lookup("truncated-name") == NULL, "long name not applied");
+    CHECK(initramfs_lookup("/etc/link") && initramfs_lookup("/etc/link")->type == INITRAMFS_SYMLINK,
+          "symlink");
+    CHECK(initramfs_lookup("/bin") && initramfs_lookup("/bin")->type == INITRAMFS_DIR, "implicit dir");
+    CHECK(initramfs_lookup("/") == initramfs_get(0), "root");
+    CHECK(initramfs_lookup("/etc/") == initramfs_lookup("etc"), "trailing slash");
+    CHECK(initramfs_lookup("/etc/mot") == NULL && initramfs_lookup("/etc/motd/x") == NULL, "misses");
+    CHECK(in_archive(initramfs_lookup("/etc/motd")->name), "name copied out of the archive");
+
+    children("/", list, sizeof(list));
+    CHECK(strcmp(list, "etc bin deep long") == 0, "ls /: \"%s\"", list);
+    children("/etc", list, sizeof(list));
+    CHECK(strcmp(list, "motd issue link") == 0, "ls /etc: \"%s\"", list);
+
+    /* newc */
+    archive_len = 0;
+    newc_add(".", 0040755, "", 0);
+    newc_add("sbin", 0040755, "", 0);
+    newc_add("sbin/init", 0100755, "ELF", 3);
+    newc_add("usr/share/doc/x", 0100644, "abcde", 5);
+    newc_add("lnk", 0120777, "sbin/init", 9);
+    newc_add("TRAILER!!!", 0, "", 0);
+    n = initramfs_load(archive, archive_len);
+    CHECK(n == 8, "newc: %d entries, want 8", n);
+    check_file("/sbin/init", "ELF");
+    check_file("/usr/share/doc/x", "abcde");
+    CHECK(initramfs_lookup("/usr/share")->type == INITRAMFS_DIR, "newc implicit dir");
+    CHECK(initramfs_lookup("/sbin/init")->mode == 0755, "newc mode");
+
+    /* Thousands of files, every one found; garbage is rejected */
+    archive_len = 0;
+    for (int i = 0; i < 5000; i++) {
+        snprintf(path, sizeof(path), "d%d/file%d", i % 50, i);
+        tar_add(path, NULL, '0', path, strlen(path), NULL);
+    }
+    tar_end();
+    n = initramfs_load(archive, archive_len);
+    CHECK(n == 5051, "5000 files: %d entries", n);
+    for (int i = 0; i < 5000; i++) {
+        snprintf(path, sizeof(path), "/d%d/file%d", i % 50, i);
+        check_file(path, path + 1);
+    }
+    CHECK(initramfs_load("not an archive", 14) == -1, "garbage accepted");
+}
+
+/* -------------------------------------------------------- timer_wheel.c */
+
+#define WHEEL_TEST_TIMERS   512
+
+static struct timer wheel_timers[WHEEL_TEST_TIMERS];
+static struct timer_wheel wheel;
+static int wheel_model[WHEEL_TEST_TIMERS];      /* Pending in the model */
+
+static void wheel_fired(void *arg) {
+    (void)arg;
+}
+
+/* Far timers exercise the upper levels; near ones the root */
+static uint32_t wheel_delay(void) {
+    uint32_t shift = rnd_below(31);
+    return rnd() & ((1u << shift) - 1);
+}
+
+/* Random add/mod/del against a model; every timer must fire exactly
+ * once, on the first advance reaching its tick, and wheel_next() must
+ * never point past the earliest one */
+static void wheel_run(uint32_t start, int steps) {
+    uint32_t now = start;
+
+    wheel_init(&wheel, now);
+    memset(wheel_model, 0, sizeof(wheel_model));
+    for (int i = 0; i < WHEEL_TEST_TIMERS; i++) timer_setup(&wheel_timers[i], wheel_fired, NULL);
+
+    for (int step = 0; step < steps; step++) {
+        uint32_t i = rnd_below(WHEEL_TEST_TIMERS);
+        struct timer *t = &wheel_timers[i];
+
+        switch (rnd_below(3)) {
+        case 0:
+            if (!wheel_model[i]) {
+                wheel_add(&wheel, t, now + wheel_delay());
+                wheel_model[i] = 1;
+            }
+            break;
+        case 1:
+            CHECK(wheel_del(&wheel, t) == wheel_model[i], "del of timer %u", i);
+            wheel_add(&wheel, t, now + wheel_delay());
+            wheel_model[i] = 1;
+            break;
+        default:
+            CHECK(wheel_del(&wheel, t) == wheel_model[i], "del of timer %u", i);
+            CHECK(!timer_pending(t), "deleted timer still pending");
+            wheel_model[i] = 0;
+            break;
+        }
+
+        uint32_t next = wheel_next(&wheel, now);
+        uint32_t pending = 0, earliest = TIMER_NONE;
+        for (int j = 0; j < WHEEL_TEST_TIMERS; j++) {
+            if (!wheel_model[j]) continue;
+            uint32_t left = time_after(wheel_timers[j].expires, now) ? wheel_timers[j].expires - now : 0;
+            if (left < earliest) earliest = left;
+            pending++;
+        }
+        CHECK(wheel.pending == pending, "pending %u, want %u", wheel.pending, pending);
+        CHECK(next <= earliest, "next %u past the earliest timer (%u)", next, earliest);
+
+        /* Advance by a tick, a few, or a long way at once (the wheel
+         * still steps through every tick while timers are pending) */
+        uint32_t r = rnd_below(16);
+        now += r < 8 ? r : r < 15 ? rnd_below(1024) : rnd_below(1u << 18);
+
+        for (struct timer *e; (e = wheel_expire(&wheel, now)) != NULL; ) {
+            uint32_t j = (uint32_t)(e - wheel_timers);
+            CHECK(j < WHEEL_TEST_TIMERS && wheel_model[j], "timer %u fired twice or unqueued", j);
+            CHECK(time_after_eq(now, e->expires), "timer %u early: now %u, expires %u",
+                  j, now, e->expires);
+            if (j < WHEEL_TEST_TIMERS) wheel_model[j] = 0;
+        }
+        int missed = 0;
+        for (int j = 0; j < WHEEL_TEST_TIMERS; j++) {
+            missed += wheel_model[j] && !time_after(wheel_timers[j].expires, now);
+        }
+        CHECK(missed == 0, "%d timers missed at %u", missed, now);
+    }
+}
+
+static void test_timer_wheel(void) {
+    wheel_run(0, 20000);
+    wheel_run(0xFFFFF000u, 20000);      /* Clock wraps */
+    CHECK(wheel.cascaded > 0, "no timer cascaded");
+
+    /* An empty wheel jumps straight to now */
+    wheel_init(&wheel, 100);
+    CHECK(wheel_next(&wheel, 100) == TIMER_NONE, "empty wheel has a deadline");
+    CHECK(wheel_expire(&wheel, 1u << 30) == NULL && wheel.clk == (1u << 30) + 1, "empty advance");
+}
+
+/* ----------------------------------------------------------- workpool.c */
+
+#define DEQUE_TEST_ITEMS    200000
+#define DEQUE_TEST_THIEVES  3
+
+static struct wsdeque test_deque;
+static uint8_t deque_taken[DEQUE_TEST_ITEMS];
+static int deque_done;
+
+static void deque_take(const struct pfor_task *task) {
+    __atomic_fetch_add(&deque_taken[task->begin], 1, __ATOMIC_RELAXED);
+}
+
+static void *deque_thief(void *arg) {
+    struct pfor_task task;
+    (void)arg;
+
+    while (!__atomic_load_n(&deque_done, __ATOMIC_ACQUIRE)) {
+        if (wsdeque_steal(&test_deque, &task)) deque_take(&task);
+    }
+    while (wsdeque_steal(&test_deque, &task)) deque_take(&task);
+    return NULL;
+}
+
+static struct workpool test_pool;
+static uint8_t pfor_hits[100000];
+static int pool_stop;
+
+struct pool_worker {
+    pthread_t thread;
+    uint32_t self;
+};
+
+static void *pool_worker(void *arg) {
+    const struct pool_worker *w = arg;
+
+    while (!__atomic_load_n(&pool_stop, __ATOMIC_ACQUIRE)) workpool_help(&test_pool, w->self);
+    return NULL;
+}
+
+static int pfor_oversize;
+
+static void pfor_mark(uint32_t begin, uint32_t end, void *arg) {
+    if (end - begin > *(uint32_t *)arg) __atomic_fetch_add(&pfor_oversize, 1, __ATOMIC_RELAXED);
+    for (uint32_t i = begin; i < end; i++) __atomic_fetch_add(&pfor_hits[i], 1, __ATOMIC_RELAXED);
+}
+
+static void test_workpool(void) {
+    pthread_t thieves[DEQUE_TEST_THIEVES];
+    struct pfor_task task = { NULL, 0, 0 };
+
+    /* Single-threaded: LIFO for the owner, FIFO for thieves, bounded */
+    wsdeque_init(&test_deque);
+    for (uint32_t i = 0; i < WSDEQUE_SIZE; i++) {
+        task.begin = i;
+        CHECK(wsdeque_push(&test_deque, &task) == 0, "push %u", i);
+    }
+    CHECK(wsdeque_push(&test_deque, &task) == -1, "push into a full deque");
+    CHECK(wsdeque_pop(&test_deque, &task) && task.begin == WSDEQUE_SIZE - 1, "pop order");
+    CHECK(wsdeque_steal(&test_deque, &task) && task.begin == 0, "steal order");
+    while (wsdeque_pop(&test_deque, &task)) {}
+    CHECK(!wsdeque_steal(&test_deque, &task), "steal from an empty deque");
+
+    /* Owner pushing and popping against thieves: each item taken once */
+    wsdeque_init(&test_deque);
+    memset(deque_taken, 0, sizeof(deque_taken));
+    deque_done = 0;
+    for (int i = 0; i < DEQUE_TEST_THIEVES; i++) pthread_create(&thieves[i], NULL, deque_thief, NULL);
+    for (uint32_t i = 0; i < DEQUE_TEST_ITEMS; i++) {
+        task.begin = i;
+        while (wsdeque_push(&test_deque, &task) < 0) {
+            struct pfor_task t;
+            if (wsdeque_pop(&test_deque, &t)) deque_take(&t);
+        }
+        if (rnd_below(3) == 0 && wsdeque_pop(&test_deque, &task)) deque_take(&task);
+    }
+    while (wsdeque_pop(&test_deque, &task)) deque_take(&task);
+    __atomic_store_n(&deque_done, 1, __ATOMIC_RELEASE);
+    for (int i = 0; i < DEQUE_TEST_THIEVES; i++) pthread_join(thieves[i], NULL);
+
+    int bad = 0;
+    for (uint32_t i = 0; i < DEQUE_TEST_ITEMS; i++) bad += deque_taken[i] != 1;
+    CHECK(bad == 0, "%d deque items lost or taken twice", bad);
+
+    /* parallel_for over 1 and 4 workers: every index exactly once */
+    for (uint32_t workers = 1; workers <= 4; workers += 3) {
+        struct pool_worker w[4];
+        uint32_t grains[] = { 1, 7, 1000, 200000 };
+
+        workpool_init(&test_pool, workers);
+        pool_stop = 0;
+        for (uint32_t i = 1; i < workers; i++) {
+            w[i].self = i;
+            pthread_create(&w[i].thread, NULL, pool_worker, &w[i]);
+        }
+        for (size_t g = 0; g < sizeof(grains) / sizeof(grains[0]); g++) {
+            memset(pfor_hits, 0, sizeof(pfor_hits));
+            parallel_for_on(&test_pool, 0, 5, sizeof(pfor_hits), grains[g], pfor_mark, &grains[g]);
+            bad = pfor_hits[0] + pfor_hits[4];
+            for (size_t i = 5; i < sizeof(pfor_hits); i++) bad += pfor_hits[i] != 1;
+            CHECK(bad == 0, "%u workers, grain %u: %d indexes wrong", workers, grains[g], bad);
+            CHECK(pfor_oversize == 0, "%u workers, grain %u: slices over the grain", workers, grains[g]);
+        }
+        __atomic_store_n(&pool_stop, 1, __ATOMIC_RELEASE);
+        for (uint32_t i = 1; i < workers; i++) pthread_join(w[i].thread, NULL);
+    }
+    CHECK(test_pool.stats[1].steals + test_pool.stats[2].steals + test_pool.stats[3].steals > 0,
+          "no worker stole anything");
+}
+
+int main(void) {
+    const char *seed = getenv("KFS_SEED");
+
+    rng_state = seed ? strtoull(seed, NULL, 0) : 0x2BADB002u;
+    if (rng_state == 0) rng_state = 1;
+    printf("host-test: seed=%llu\n", (unsigned long long)rng_state);
+
+    test_lib();
+    test_vsnprintf_fixed();
+    test_vsnprintf_random();
+    test_shell_parse();
+    test_initramfs();
+    test_timer_wheel();
+    test_workpool();
+
+    printf("host-test: %d checks, %d failures\n", checks, failures);
+    return failures ? 1 : 0;
+}
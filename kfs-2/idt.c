@@ -1,5 +1,6 @@
 #include "idt.h"
 #include "lib.h"
+#include "init.h"
 
 /* IDT Table - 256 entries for all interrupts */
 static struct idt_gate idt[IDT_ENTRIES] __attribute__((section(".data")));
@@ -25,7 +26,7 @@ void idt_set_gate(uint8_t num, uint32_t handler, uint8_t type, uint8_t dpl) {
  * Initialize the IDT
  * Sets up exception handlers and interrupt handlers
  */
-void idt_init(void) {
+void __init idt_init(void) {
     /* Clear the IDT */
     memset(idt, 0, sizeof(idt));
 
@@ -36,10 +37,17 @@ void idt_init(void) {
     /* Install exception handlers */
     idt_set_gate(0, (uint32_t)isr0_handler, IDT_GATE_INTERRUPT, IDT_DPL_KERNEL);
     idt_set_gate(8, (uint32_t)isr8_handler, IDT_GATE_INTERRUPT, IDT_DPL_KERNEL);
+    idt_set_gate(3, (uint32_t)isr3_handler, IDT_GATE_INTERRUPT, IDT_DPL_KERNEL);
+    idt_set_gate(6, (uint32_t)isr6_handler, IDT_GATE_INTERRUPT, IDT_DPL_KERNEL);
+    idt_set_gate(13, (uint32_t)isr13_handler, IDT_GATE_INTERRUPT, IDT_DPL_KERNEL);
+    idt_set_gate(14, (uint32_t)isr14_handler, IDT_GATE_INTERRUPT, IDT_DPL_KERNEL);
 
     /* Install interrupt handlers */
     idt_set_gate(32, (uint32_t)irq0_handler, IDT_GATE_INTERRUPT, IDT_DPL_KERNEL);  /* Timer (IRQ0) */
     idt_set_gate(33, (uint32_t)irq1_handler, IDT_GATE_INTERRUPT, IDT_DPL_KERNEL);  /* Keyboard (IRQ1) */
+    for (int irq = 2; irq < 16; irq++) {                                             /* Devices (irq.c) */
+        idt_set_gate((uint8_t)(32 + irq), irq_stub_table[irq], IDT_GATE_INTERRUPT, IDT_DPL_KERNEL);
+    }
 
     /* Load IDT into processor */
     idt_load();
@@ -18,6 +18,14 @@ struct idtr {
     uint32_t address;         /* 32-bit address of IDT */
 } __attribute__((packed));
 
+/* Register state saved by the assembly interrupt stubs (see idt_load.asm) */
+struct irq_frame {
+    uint32_t edi, esi, ebp, esp, ebx, edx, ecx, eax;  /* pusha */
+    uint32_t int_no;          /* Vector number */
+    uint32_t err_code;        /* Error code (0 if none) */
+    uint32_t eip, cs, eflags; /* Pushed by the CPU */
+} __attribute__((packed));
+
 /* Gate Type Attributes */
 #define IDT_GATE_INTERRUPT  0x0E  /* 32-bit interrupt gate */
 #define IDT_GATE_TRAP       0x0F  /* 32-bit trap gate */
@@ -41,8 +49,15 @@ void idt_load(void);
 
 /* Interrupt Handler Declarations */
 extern void isr0_handler(void);   /* Division by zero */
+extern void isr3_handler(void);   /* Breakpoint (freed init code) */
 extern void isr8_handler(void);   /* Double fault */
+extern void isr6_handler(void);   /* Invalid opcode */
+extern void isr13_handler(void);  /* General protection fault */
+extern void isr14_handler(void);  /* Page fault */
 extern void irq0_handler(void);   /* PIT (timer) */
 extern void irq1_handler(void);   /* PS/2 Keyboard */
 
+/* Entry stubs for IRQ0-15 (vectors 32-47), IRQ2-15 go to irq_dispatch() */
+extern const uint32_t irq_stub_table[16];
+
 #endif /* IDT_H */
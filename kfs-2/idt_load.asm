@@ -3,11 +3,20 @@
 section .text
 global idt_load_register
 global isr0_handler
+global isr3_handler
 global isr8_handler
+global isr6_handler
+global isr13_handler
+global isr14_handler
 global irq0_handler
 global irq1_handler
+global irq_stub_table
 
 extern keyboard_irq_handler
+extern timer_irq_handler
+extern softirq_run
+extern irq_dispatch
+extern exception_dispatch
 
 ; Load IDT Register (LIDT instruction)
 ; Parameters: edi = pointer to IDTR structure (on 32-bit, first arg is on stack)
@@ -16,6 +25,12 @@ idt_load_register:
     lidt [eax]                  ; Load IDTR
     ret
 
+; Interrupt and exception entry: its own section, which linker.ld keeps
+; with the hot code (NASM has no -ffunction-sections)
+%define HOT_TEXT .text.hot.irq_entry progbits alloc exec nowrite align=16
+
+section HOT_TEXT
+
 ; ISR0: Division by Zero (Exception)
 isr0_handler:
     push byte 0                 ; Error code (no error code, so push 0)
@@ -28,6 +43,27 @@ isr8_handler:
     push byte 8                 ; ISR number
     jmp isr_common_handler
 
+; ISR3/6/13/14: breakpoint, invalid opcode, general protection, page
+; fault.  These go to exception_dispatch(), which kills a faulting ring 3
+; program.  Freed init memory is filled with int3 (init.h)
+isr3_handler:
+    push byte 0                 ; No error code
+    push byte 3
+    jmp exception_common_handler
+
+isr6_handler:
+    push byte 0                 ; No error code
+    push byte 6
+    jmp exception_common_handler
+
+isr13_handler:
+    push byte 13                ; Error code pushed by the CPU
+    jmp exception_common_handler
+
+isr14_handler:
+    push byte 14                ; Error code pushed by the CPU
+    jmp exception_common_handler
+
 ; IRQ0: Timer (Programmable Interval Timer)
 irq0_handler:
     push byte 0                 ; No error code
@@ -40,6 +76,39 @@ irq1_handler:
     push byte 33                ; IRQ1 = ISR 33
     jmp irq_common_handler
 
+; IRQ2-15: other devices, dispatched through irq.c
+%macro IRQ_STUB 1
+irq%1_handler:
+    push byte 0                 ; No error code
+    push byte (32 + %1)         ; IRQn = ISR 32+n
+    jmp irq_common_handler
+%endmacro
+
+IRQ_STUB 2
+IRQ_STUB 3
+IRQ_STUB 4
+IRQ_STUB 5
+IRQ_STUB 6
+IRQ_STUB 7
+IRQ_STUB 8
+IRQ_STUB 9
+IRQ_STUB 10
+IRQ_STUB 11
+IRQ_STUB 12
+IRQ_STUB 13
+IRQ_STUB 14
+IRQ_STUB 15
+
+; Entry points for IRQ0-15, installed by idt_init()
+section .data
+irq_stub_table:
+    dd irq0_handler,  irq1_handler,  irq2_handler,  irq3_handler
+    dd irq4_handler,  irq5_handler,  irq6_handler,  irq7_handler
+    dd irq8_handler,  irq9_handler,  irq10_handler, irq11_handler
+    dd irq12_handler, irq13_handler, irq14_handler, irq15_handler
+
+section HOT_TEXT
+
 ; Common ISR handler
 isr_common_handler:
     pusha                       ; Push all general-purpose registers
@@ -53,6 +122,17 @@ isr_common_handler:
     add esp, 8                  ; Remove ISR number and error code
     iret
 
+; Common handler for the exceptions above (same frame as the IRQs)
+exception_common_handler:
+    pusha
+    cld
+    push esp                    ; struct irq_frame * argument
+    call exception_dispatch
+    add esp, 4
+    popa
+    add esp, 8
+    iret
+
 ; Common IRQ handler
 irq_common_handler:
     pusha                       ; Push all general-purpose registers
@@ -63,35 +143,53 @@ irq_common_handler:
     cmp al, 33
     je handle_keyboard
     
-    ; For other IRQs, just acknowledge PIC and return
-    mov al, 0x20                ; End of Interrupt (EOI) command
-    out 0x20, al                ; Send EOI to master PIC
+    ; Check if it's IRQ0 (timer)
+    cmp al, 32
+    je handle_timer
+    
+    ; Other IRQs: irq_dispatch() runs the registered handlers and sends
+    ; the EOI to the right PIC(s)
+    cld
+    push esp                    ; struct irq_frame * argument
+    call irq_dispatch
+    add esp, 4
     
     popa
     add esp, 8
     iret
 
-handle_keyboard:
-    ; Read scancode from keyboard port
-    mov edx, 0x60               ; Keyboard data port
-    in al, dx                   ; Read scancode into AL
+handle_timer:
+    ; The saved registers plus vector, error code and the CPU-pushed
+    ; EIP/CS/EFLAGS form a struct irq_frame starting at ESP
+    cld
+    push esp                    ; struct irq_frame * argument
+    call timer_irq_handler
+    add esp, 4
     
-    ; Save the scancode
-    mov ecx, eax                ; Save scancode in ECX
+    ; Send EOI to master PIC
+    mov al, 0x20
+    out 0x20, al
     
-    ; Restore general registers before calling C function
-    popa
+    ; Deferred work (timer wheel) with interrupts enabled again
+    call softirq_run
     
-    ; Push scancode as argument (32-bit cdecl calling convention)
-    push ecx                    ; Push scancode as first argument
-    call keyboard_irq_handler   ; Call the C function
-    add esp, 4                  ; Clean up the argument
+    popa
+    add esp, 8                  ; Remove IRQ number and error code
+    iret
+
+handle_keyboard:
+    ; Registers stay saved: the IRQ can interrupt ring 3 or the idle loop
+    cld
+    in al, 0x60                 ; Scancode from the keyboard data port
+    movzx eax, al
+    push eax                    ; uint8_t scancode argument
+    call keyboard_irq_handler
+    add esp, 4
     
-    ; Send EOI to PIC
-    mov al, 0x20
-    out 0x20, al                ; Master PIC
+    ; Send EOI to master PIC
     mov al, 0x20
-    out 0xA0, al                ; Slave PIC (in case)
+    out 0x20, al
     
+    popa
     add esp, 8                  ; Remove IRQ number and error code
     iret
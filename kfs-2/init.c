@@ -0,0 +1,26 @@
+#include "init.h"
+#include "pmm.h"
+#include "lib.h"
+
+static int init_done;
+static uint32_t freed_bytes;
+
+uint32_t free_initmem(void) {
+    uint32_t start = (uint32_t)__init_begin, end = (uint32_t)__init_end;
+
+    if (init_done) return 0;
+    init_done = 1;
+
+    /* int3 everywhere: a stale call or jump traps on its first byte */
+    memset(__init_begin, 0xCC, end - start);
+    freed_bytes = pmm_release(start, end) * PAGE_SIZE;
+    return freed_bytes;
+}
+
+uint32_t initmem_freed(void) {
+    return freed_bytes;
+}
+
+int init_freed(uint32_t addr) {
+    return init_done && addr >= (uint32_t)__init_begin && addr < (uint32_t)__init_end;
+}
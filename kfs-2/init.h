@@ -0,0 +1,44 @@
+#ifndef INIT_H
+#define INIT_H
+
+#include <stdint.h>
+
+/*
+ * Boot-only code and data.
+ *
+ * Functions and data that only kmain()'s initialisation uses are marked
+ * __init (code), __initconst (read-only data) or __initdata (data);
+ * linker.ld gathers them on pages of their own between __init_begin and
+ * __init_end.  free_initmem(), called once the shell is up, fills those
+ * pages with int3 (0xCC) and hands them to the frame allocator.
+ *
+ * The kernel is identity mapped with 4 MB pages, so freed pages stay
+ * mapped: a call into freed init code hits the int3 poison and traps,
+ * and the exception handler names it, for as long as the frame has not
+ * been reused.  pmm_release() puts the frames at the bottom of the free
+ * stack, so they are the last to be handed out.
+ *
+ * Never call an __init function, or use __init data, from code that can
+ * run after free_initmem().
+ */
+
+/* noinline: an __init function inlined into resident code would stay */
+#define __init          __attribute__((section(".init.text"), cold, noinline))
+#define __initconst     __attribute__((section(".init.rodata")))
+#define __initdata      __attribute__((section(".init.data")))
+
+/* Bounds of the init region (page aligned, linker.ld) */
+extern uint8_t __init_begin[];
+extern uint8_t __init_end[];
+
+/* Poison and free the init region; call once, after the last __init
+ * function has returned.  Returns the number of bytes freed. */
+uint32_t free_initmem(void);
+
+/* Bytes free_initmem() gave back; 0 before it ran */
+uint32_t initmem_freed(void);
+
+/* 1 if addr lies in init memory that free_initmem() has freed */
+int init_freed(uint32_t addr);
+
+#endif /* INIT_H */
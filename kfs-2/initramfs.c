@@ -0,0 +1,321 @@
+#include "initramfs.h"
+#include "lib.h"
+
+#define INITRAMFS_SLOTS     (INITRAMFS_MAX_FILES * 2)   /* Load factor <= 1/2 */
+
+/* cpio mode bits */
+#define CPIO_S_IFMT     0170000
+#define CPIO_S_IFDIR    0040000
+#define CPIO_S_IFREG    0100000
+#define CPIO_S_IFLNK    0120000
+
+static struct initramfs_file files[INITRAMFS_MAX_FILES];
+static uint32_t files_count;
+static uint16_t slots[INITRAMFS_SLOTS];     /* Entry index + 1, 0 if free */
+static char name_pool[INITRAMFS_NAME_POOL];
+static uint32_t name_pool_used;
+
+/* FNV-1a */
+static uint32_t hash_name(const char *s, uint32_t len) {
+    uint32_t h = 2166136261u;
+
+    for (uint32_t i = 0; i < len; i++) h = (h ^ (uint8_t)s[i]) * 16777619u;
+    return h;
+}
+
+static int same_name(const char *a, const char *b, uint32_t len) {
+    for (uint32_t i = 0; i < len; i++) {
+        if (a[i] != b[i]) return 0;
+    }
+    return 1;
+}
+
+static uint32_t bounded_len(const char *s, uint32_t max) {
+    uint32_t n = 0;
+
+    while (n < max && s[n]) n++;
+    return n;
+}
+
+/* Drop leading "/" and "./" and trailing "/" ("." and "/" are the root) */
+static const char *normalize(const char *s, uint32_t *len) {
+    uint32_t n = *len;
+
+    for (;;) {
+        if (n && *s == '/') {
+            s++;
+            n--;
+        } else if (n >= 2 && s[0] == '.' && s[1] == '/') {
+            s += 2;
+            n -= 2;
+        } else {
+            break;
+        }
+    }
+    if (n == 1 && s[0] == '.') n = 0;
+    while (n && s[n - 1] == '/') n--;
+    *len = n;
+    return s;
+}
+
+static int find(const char *name, uint32_t len, uint32_t hash) {
+    uint32_t slot = hash & (INITRAMFS_SLOTS - 1);
+
+    while (slots[slot]) {
+        const struct initramfs_file *f = &files[slots[slot] - 1];
+        if (f->hash == hash && f->name_len == len && same_name(f->name, name, len)) {
+            return slots[slot] - 1;
+        }
+        slot = (slot + 1) & (INITRAMFS_SLOTS - 1);
+    }
+    return -1;
+}
+
+static void index_insert(uint32_t index) {
+    uint32_t slot = files[index].hash & (INITRAMFS_SLOTS - 1);
+
+    while (slots[slot]) slot = (slot + 1) & (INITRAMFS_SLOTS - 1);
+    slots[slot] = (uint16_t)(index + 1);
+}
+
+/* Entry for name, created (with its missing parent directories) as an
+ * empty directory if it does not exist; -1 when the table is full */
+static int lookup_or_create(const char *name, uint32_t len) {
+    uint32_t hash = hash_name(name, len);
+    int index = find(name, len, hash);
+
+    if (index >= 0) return index;
+
+    uint32_t plen = len;
+    while (plen && name[plen - 1] != '/') plen--;
+    int parent = plen ? lookup_or_create(name, plen - 1) : 0;
+    if (parent < 0 || files_count == INITRAMFS_MAX_FILES) return -1;
+
+    index = (int)files_count++;
+    struct initramfs_file *f = &files[index];
+    struct initramfs_file *p = &files[parent];
+    f->name = name;
+    f->name_len = (uint16_t)len;
+    f->hash = hash;
+    f->type = INITRAMFS_DIR;
+    f->mode = 0755;
+    f->data = NULL;
+    f->size = 0;
+    f->mtime = 0;
+    f->parent = (uint16_t)parent;
+    f->first_child = f->last_child = f->next_sibling = INITRAMFS_NONE;
+
+    if (index > 0) {                            /* The root has no parent to join */
+        if (p->last_child == INITRAMFS_NONE) p->first_child = (uint16_t)index;
+        else files[p->last_child].next_sibling = (uint16_t)index;
+        p->last_child = (uint16_t)index;
+    }
+
+    index_insert((uint32_t)index);
+    return index;
+}
+
+static void add_entry(const char *name, uint32_t len, uint8_t type, uint32_t mode,
+                      uint32_t mtime, const uint8_t *data, uint32_t size) {
+    name = normalize(name, &len);
+    if (len > 0xFFFF) return;
+
+    int index = lookup_or_create(name, len);
+    if (index < 0) return;
+
+    /* A later entry for the same path replaces the earlier one */
+    struct initramfs_file *f = &files[index];
+    f->mode = (uint16_t)(mode & 07777);
+    f->mtime = mtime;
+    if (index == 0) return;             /* The root stays a directory */
+    f->type = type;
+    f->data = data;
+    f->size = size;
+}
+
+/* ------------------------------------------------------------- ustar */
+
+static uint32_t tar_octal(const uint8_t *p, uint32_t n) {
+    uint32_t v = 0;
+
+    while (n && (*p == ' ' || *p == '\0')) {
+        p++;
+        n--;
+    }
+    while (n && *p >= '0' && *p <= '7') {
+        v = (v << 3) | (uint32_t)(*p++ - '0');
+        n--;
+    }
+    return v;
+}
+
+static int tar_header_ok(const uint8_t *h) {
+    uint32_t sum = 0;
+
+    for (int i = 0; i < 512; i++) sum += (i >= 148 && i < 156) ? ' ' : h[i];
+    return sum == tar_octal(h + 148, 8);
+}
+
+static int load_tar(const uint8_t *p, size_t size) {
+    const char *long_name = NULL;
+    uint32_t long_len = 0;
+    size_t off = 0;
+
+    while (off + 512 <= size) {
+        const uint8_t *h = p + off;
+        if (h[0] == '\0' || !tar_header_ok(h)) break;     /* End of archive */
+
+        uint32_t fsize = tar_octal(h + 124, 12);
+        const uint8_t *data = h + 512;
+        if (fsize > size - off - 512) break;
+        off += 512 + ((fsize + 511) & ~511u);
+
+        char type = (char)h[156];
+        if (type == 'L') {                      /* GNU long name for the next entry */
+            long_name = (const char *)data;
+            long_len = bounded_len(long_name, fsize);
+            continue;
+        }
+        if (type == 'x' || type == 'g') continue;           /* pax headers */
+
+        const char *name = (const char *)h;
+        uint32_t len = bounded_len(name, 100);
+        if (long_name) {
+            name = long_name;
+            len = long_len;
+            long_name = NULL;
+        } else if (h[345] && same_name((const char *)h + 257, "ustar", 5)) {
+            /* prefix "/" name: the only case that needs a copy */
+            uint32_t plen = bounded_len((const char *)h + 345, 155);
+            if (name_pool_used + plen + 1 + len > INITRAMFS_NAME_POOL) continue;
+            char *joined = name_pool + name_pool_used;
+            memcpy(joined, h + 345, plen);
+            joined[plen] = '/';
+            memcpy(joined + plen + 1, name, len);
+            name = joined;
+            len += plen + 1;
+            name_pool_used += len;
+        }
+
+        uint32_t mode = tar_octal(h + 100, 8);
+        uint32_t mtime = tar_octal(h + 136, 12);
+        const char *target = (const char *)h + 157;
+
+        switch (type) {
+        case '\0':
+        case '0':
+        case '7':
+            add_entry(name, len, INITRAMFS_FILE, mode, mtime, data, fsize);
+            break;
+        case '1': {                             /* Hard link: share the target's data */
+            uint32_t tlen = bounded_len(target, 100);
+            const struct initramfs_file *t;
+            target = normalize(target, &tlen);
+            int index = find(target, tlen, hash_name(target, tlen));
+            if (index < 0) break;
+            t = &files[index];
+            add_entry(name, len, t->type, mode, mtime, t->data, t->size);
+            break;
+        }
+        case '2':
+            add_entry(name, len, INITRAMFS_SYMLINK, mode, mtime, (const uint8_t *)target,
+                      bounded_len(target, 100));
+            break;
+        case '5':
+            add_entry(name, len, INITRAMFS_DIR, mode, mtime, NULL, 0);
+            break;
+        default:                                /* Devices, FIFOs */
+            break;
+        }
+    }
+    return 0;
+}
+
+/* -------------------------------------------------------------- newc */
+
+static uint32_t cpio_hex(const uint8_t *p) {
+    uint32_t v = 0;
+
+    for (int i = 0; i < 8; i++) {
+        uint8_t c = p[i];
+        uint32_t d = c >= '0' && c <= '9' ? (uint32_t)(c - '0') :
+                     c >= 'a' && c <= 'f' ? (uint32_t)(c - 'a' + 10) :
+                     c >= 'A' && c <= 'F' ? (uint32_t)(c - 'A' + 10) : 0;
+        v = (v << 4) | d;
+    }
+    return v;
+}
+
+static int is_newc(const uint8_t *h) {
+    return same_name((const char *)h, "07070", 5) && (h[5] == '1' || h[5] == '2');
+}
+
+static int load_newc(const uint8_t *p, size_t size) {
+    size_t off = 0;
+
+    while (off + 110 <= size && is_newc(p + off)) {
+        const uint8_t *h = p + off;
+        uint32_t mode = cpio_hex(h + 14);
+        uint32_t mtime = cpio_hex(h + 46);
+        uint32_t fsize = cpio_hex(h + 54);
+        uint32_t namesize = cpio_hex(h + 94);
+
+        /* Header and name are padded to 4 bytes, and so is the data */
+        if (namesize == 0 || namesize > size - off - 110) break;
+        size_t data_off = (off + 110 + namesize + 3) & ~(size_t)3;
+        if (data_off > size || fsize > size - data_off) break;
+
+        const char *name = (const char *)h + 110;
+        uint32_t len = namesize - 1;
+        if (len == 10 && same_name(name, "TRAILER!!!", 10)) break;
+
+        const uint8_t *data = p + data_off;
+        switch (mode & CPIO_S_IFMT) {
+        case CPIO_S_IFREG:
+            add_entry(name, len, INITRAMFS_FILE, mode, mtime, data, fsize);
+            break;
+        case CPIO_S_IFDIR:
+            add_entry(name, len, INITRAMFS_DIR, mode, mtime, NULL, 0);
+            break;
+        case CPIO_S_IFLNK:
+            add_entry(name, len, INITRAMFS_SYMLINK, mode, mtime, data, fsize);
+            break;
+        default:
+            break;
+        }
+        off = (data_off + fsize + 3) & ~(size_t)3;
+    }
+    return 0;
+}
+
+int initramfs_load(const void *data, size_t size) {
+    const uint8_t *p = data;
+    int ret;
+
+    files_count = 0;
+    name_pool_used = 0;
+    memset(slots, 0, sizeof(slots));
+    lookup_or_create("", 0);                    /* Root directory, index 0 */
+
+    if (size >= 110 && is_newc(p)) ret = load_newc(p, size);
+    else if (size >= 512 && same_name((const char *)p + 257, "ustar", 5)) ret = load_tar(p, size);
+    else ret = -1;
+
+    return ret < 0 ? -1 : (int)files_count;
+}
+
+const struct initramfs_file *initramfs_lookup(const char *path) {
+    uint32_t len = (uint32_t)strlen(path);
+
+    path = normalize(path, &len);
+    int index = find(path, len, hash_name(path, len));
+    return index < 0 ? NULL : &files[index];
+}
+
+const struct initramfs_file *initramfs_get(uint32_t index) {
+    return index < files_count ? &files[index] : NULL;
+}
+
+uint32_t initramfs_count(void) {
+    return files_count;
+}
@@ -0,0 +1,80 @@
+#ifndef INITRAMFS_H
+#define INITRAMFS_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * Read-only initramfs over an archive in memory (normally the Multiboot
+ * module named "initramfs").
+ *
+ * ustar (including GNU long names) and cpio "newc" archives are parsed
+ * in place: file data and, where the archive stores them contiguously,
+ * names point into the archive, so nothing is copied.  Paths made of a
+ * ustar prefix plus name are the exception; they are joined in a small
+ * name pool.  Directories missing from the archive are created
+ * implicitly, named by a prefix of their child's path.
+ *
+ * Paths are indexed once, in an open-addressing hash table built by
+ * initramfs_load(), so a lookup costs one hash and usually one compare
+ * however many files there are.  Each directory also links its
+ * children, in archive order, for listing.
+ *
+ * Portable: also built into the host tests.
+ */
+
+#define INITRAMFS_MAX_FILES     8192
+#define INITRAMFS_NAME_POOL     (64 * 1024)
+
+/* initramfs_file.type */
+#define INITRAMFS_DIR       1
+#define INITRAMFS_FILE      2
+#define INITRAMFS_SYMLINK   3       /* data/size hold the target */
+
+#define INITRAMFS_NONE      0xFFFFu /* No entry (child/sibling links) */
+
+struct initramfs_file {
+    const char *name;               /* Path without leading '/', not terminated */
+    const uint8_t *data;            /* Inside the archive */
+    uint32_t size;
+    uint32_t mtime;
+    uint32_t hash;
+    uint16_t name_len;
+    uint16_t mode;                  /* Permission bits */
+    uint8_t type;
+    uint16_t parent;
+    uint16_t first_child;
+    uint16_t last_child;
+    uint16_t next_sibling;
+};
+
+/* Index the archive at data.  Returns the number of entries, including
+ * the root directory, or -1 if it is neither ustar nor newc.  Entries
+ * past INITRAMFS_MAX_FILES are dropped. */
+int initramfs_load(const void *data, size_t size);
+
+/* Entry for path ("/etc/motd", "etc/motd", "/" ...); NULL if none */
+const struct initramfs_file *initramfs_lookup(const char *path);
+
+/* Entry by index (0 is the root directory), NULL past the end */
+const struct initramfs_file *initramfs_get(uint32_t index);
+
+uint32_t initramfs_count(void);
+
+/* Kernel side (initramfs_cmd.c) */
+
+/* Index the Multiboot module named "initramfs"; entry count or -1 */
+int initramfs_init(void);
+
+/* Follow symlinks from f; NULL on a dangling link or a loop */
+const struct initramfs_file *initramfs_resolve(const struct initramfs_file *f);
+
+/* Shell commands: ls [path], cat <path...>, stat <path> */
+void cmd_ls(int argc, char *argv[]);
+void cmd_cat(int argc, char *argv[]);
+void cmd_stat(int argc, char *argv[]);
+
+/* Benchmark: average path lookup in cycles */
+void bench_initramfs(void);
+
+#endif /* INITRAMFS_H */
@@ -0,0 +1,168 @@
+#include "initramfs.h"
+#include "module.h"
+#include "printk.h"
+#include "bench.h"
+#include "boottime.h"
+#include "lib.h"
+#include "tsc.h"
+
+#define PATH_MAX_LEN    256
+#define SYMLINK_DEPTH   8
+
+static const char *const type_names[] = { "?", "directory", "file", "symlink" };
+static const char type_chars[] = "?d-l";
+
+/* Index the "initramfs" module; returns the entry count or -1 */
+int initramfs_init(void) {
+    const struct module *mod = module_find("initramfs");
+
+    if (!mod) return -1;
+    int n = initramfs_load(mod->start, mod->size);
+    if (n < 0) {
+        printk(KERN_ERR "initramfs: unknown archive format\n");
+    } else if (!boot_is_fast()) {
+        printk("initramfs: %d entries\n", n);
+    }
+    return n;
+}
+
+/* Follow symlinks, resolving relative targets against the link's
+ * directory; NULL on a dangling link or a loop */
+const struct initramfs_file *initramfs_resolve(const struct initramfs_file *f) {
+    char path[PATH_MAX_LEN];
+
+    for (int depth = 0; f && f->type == INITRAMFS_SYMLINK; depth++) {
+        uint32_t dlen = 0, n = 0;
+
+        if (depth == SYMLINK_DEPTH) return NULL;
+        if (f->size == 0 || f->data[0] != '/') {
+            dlen = f->name_len;
+            while (dlen && f->name[dlen - 1] != '/') dlen--;
+        }
+        if (dlen + f->size >= sizeof(path)) return NULL;
+        memcpy(path, f->name, dlen);
+        n = dlen;
+        memcpy(path + n, f->data, f->size);
+        n += f->size;
+        path[n] = '\0';
+        f = initramfs_lookup(path);
+    }
+    return f;
+}
+
+static const struct initramfs_file *lookup_arg(const char *cmd, const char *path) {
+    const struct initramfs_file *f = initramfs_count() ? initramfs_lookup(path) : NULL;
+
+    if (!f) printk("%s: %s: no such file or directory\n", cmd, path);
+    return f;
+}
+
+/* Last path component of f */
+static const char *basename_of(const struct initramfs_file *f, int *len) {
+    const char *end = f->name + f->name_len;
+    const char *base = end;
+
+    while (base > f->name && base[-1] != '/') base--;
+    *len = (int)(end - base);
+    return base;
+}
+
+static void ls_entry(const struct initramfs_file *f) {
+    int len;
+    const char *base = basename_of(f, &len);
+
+    printk("%c%04o %8u  %.*s", type_chars[f->type], f->mode, f->size, len, base);
+    if (f->type == INITRAMFS_SYMLINK) printk(" -> %.*s", (int)f->size, (const char *)f->data);
+    printk("%s\n", f->type == INITRAMFS_DIR ? "/" : "");
+}
+
+/* ls [path] */
+void cmd_ls(int argc, char *argv[]) {
+    const char *path = argc > 1 ? argv[1] : "/";
+    const struct initramfs_file *f = lookup_arg("ls", path);
+
+    if (!f) return;
+    f = initramfs_resolve(f);
+    if (!f) {
+        printk("ls: %s: dangling symbolic link\n", path);
+    } else if (f->type != INITRAMFS_DIR) {
+        ls_entry(f);
+    } else {
+        for (uint16_t i = f->first_child; i != INITRAMFS_NONE; i = initramfs_get(i)->next_sibling) {
+            ls_entry(initramfs_get(i));
+        }
+    }
+}
+
+/* cat <path...> */
+void cmd_cat(int argc, char *argv[]) {
+    if (argc < 2) {
+        printk("Usage: cat <path...>\n");
+        return;
+    }
+    for (int i = 1; i < argc; i++) {
+        const struct initramfs_file *f = lookup_arg("cat", argv[i]);
+        if (!f) continue;
+        f = initramfs_resolve(f);
+        if (!f) printk("cat: %s: dangling symbolic link\n", argv[i]);
+        else if (f->type == INITRAMFS_DIR) printk("cat: %s: is a directory\n", argv[i]);
+        else printk("%.*s", (int)f->size, (const char *)f->data);
+    }
+}
+
+/* stat <path> */
+void cmd_stat(int argc, char *argv[]) {
+    if (argc < 2) {
+        printk("Usage: stat <path>\n");
+        return;
+    }
+
+    uint64_t start = rdtsc();
+    const struct initramfs_file *f = initramfs_count() ? initramfs_lookup(argv[1]) : NULL;
+    uint32_t cycles = (uint32_t)(rdtsc() - start);
+
+    if (!f) {
+        printk("stat: %s: no such file or directory\n", argv[1]);
+        return;
+    }
+    printk("  File: /%.*s\n", (int)f->name_len, f->name);
+    printk("  Type: %s\n", type_names[f->type]);
+    printk("  Size: %u\n", f->size);
+    printk("  Mode: %04o\n", f->mode);
+    printk(" Mtime: %u\n", f->mtime);
+    if (f->data) printk("  Data: 0x%08x (in place)\n", (uint32_t)f->data);
+    printk("Lookup: %u cycles\n", cycles);
+}
+
+/* Benchmark: average lookup cost over (up to) the first 256 paths */
+
+#define BENCH_PATHS     256
+
+static char bench_paths[BENCH_PATHS][PATH_MAX_LEN];
+
+void bench_initramfs(void) {
+    uint32_t n = 0;
+
+    for (uint32_t i = 1; i < initramfs_count() && n < BENCH_PATHS; i++) {
+        const struct initramfs_file *f = initramfs_get(i);
+        if (f->name_len >= PATH_MAX_LEN) continue;
+        memcpy(bench_paths[n], f->name, f->name_len);
+        bench_paths[n][f->name_len] = '\0';
+        n++;
+    }
+    if (n == 0) {
+        printk("initramfs: no initramfs\n");
+        return;
+    }
+
+    uint32_t best = 0xFFFFFFFF;
+    for (int run = 0; run < 5; run++) {
+        uint64_t start = rdtsc();
+        for (uint32_t i = 0; i < n; i++) {
+            if (!initramfs_lookup(bench_paths[i])) return;
+        }
+        uint32_t elapsed = (uint32_t)(rdtsc() - start);
+        if (elapsed < best) best = elapsed;
+    }
+    bench_report("initramfs_lookup", best / n, "cycles");
+}
@@ -0,0 +1,405 @@
+#include "ioring.h"
+#include "printk.h"
+#include "printf.h"
+#include "bench.h"
+#include "lib.h"
+#include "cpu.h"
+#include "tsc.h"
+#include "div64.h"
+#include "timer.h"
+#include "keyboard.h"
+#include "virtio_console.h"
+
+#define SQ_MASK     (IORING_SQ_ENTRIES - 1)
+#define CQ_MASK     (IORING_CQ_ENTRIES - 1)
+
+#define LOAD_ACQUIRE(p)         __atomic_load_n(p, __ATOMIC_ACQUIRE)
+#define STORE_RELEASE(p, v)     __atomic_store_n(p, v, __ATOMIC_RELEASE)
+
+void ioring_init(struct ioring *r) {
+    memset(r, 0, sizeof(*r));
+    for (int i = IORING_SQ_ENTRIES - 1; i >= 0; i--) {
+        r->ops[i].ring = r;
+        r->ops[i].next = r->free_ops;
+        r->free_ops = &r->ops[i];
+    }
+}
+
+/* ---------------------------------------------------------- submitter */
+
+struct io_sqe *ioring_get_sqe(struct ioring *r) {
+    if (r->sqe_tail - LOAD_ACQUIRE(&r->rings.sq_head) >= IORING_SQ_ENTRIES) return NULL;
+    return &r->rings.sqes[r->sqe_tail++ & SQ_MASK];
+}
+
+void ioring_prep(struct io_sqe *sqe, uint8_t opcode, uint16_t target,
+                 const void *buf, uint32_t len, uint64_t off, uint32_t user_data) {
+    sqe->opcode = opcode;
+    sqe->flags = 0;
+    sqe->target = target;
+    sqe->addr = (uint32_t)buf;
+    sqe->len = len;
+    sqe->user_data = user_data;
+    sqe->off = off;
+}
+
+uint32_t ioring_cq_ready(const struct ioring *r) {
+    return LOAD_ACQUIRE(&r->rings.cq_tail) - r->rings.cq_head;
+}
+
+struct io_cqe *ioring_peek_cqe(struct ioring *r) {
+    uint32_t head = r->rings.cq_head;
+
+    if (head == LOAD_ACQUIRE(&r->rings.cq_tail)) return NULL;
+    return &r->rings.cqes[head & CQ_MASK];
+}
+
+void ioring_cqe_seen(struct ioring *r) {
+    STORE_RELEASE(&r->rings.cq_head, r->rings.cq_head + 1);
+}
+
+/* ------------------------------------------------------------- kernel */
+
+/* Post a completion for a consumed SQE; room was reserved when it was
+ * consumed.  Runs from ioring_enter() and from completion interrupts. */
+static void ioring_post(struct ioring *r, uint32_t user_data, int32_t res) {
+    uint32_t flags = irq_save();
+    uint32_t tail = r->rings.cq_tail;
+
+    r->rings.cqes[tail & CQ_MASK].user_data = user_data;
+    r->rings.cqes[tail & CQ_MASK].res = res;
+    STORE_RELEASE(&r->rings.cq_tail, tail + 1);
+    r->inflight--;
+    r->stats.completed++;
+    irq_restore(flags);
+}
+
+static struct ioring_op *op_get(struct ioring *r, uint32_t user_data) {
+    struct ioring_op *op = r->free_ops;
+
+    r->free_ops = op->next;
+    op->next = NULL;
+    op->user_data = user_data;
+    return op;
+}
+
+static void op_put(struct ioring *r, struct ioring_op *op) {
+    op->next = r->free_ops;
+    r->free_ops = op;
+}
+
+/* Block completion, from the driver's interrupt handler */
+static void ioring_blk_done(struct blk_req *req) {
+    struct ioring_op *op = req->priv;
+    struct ioring *r = op->ring;
+    uint32_t bytes = req->nsectors << BLK_SECTOR_SHIFT;
+
+    ioring_post(r, op->user_data, req->status == BLK_OK ? (int32_t)bytes : -1);
+    op_put(r, op);
+    if (--r->blk_inflight) return;
+
+    while (r->flushes) {
+        op = r->flushes;
+        r->flushes = op->next;
+        ioring_post(r, op->user_data, 0);
+        op_put(r, op);
+    }
+}
+
+/* Copy the input waiting, up to len bytes, into buf */
+static uint32_t console_read(uint8_t *buf, uint32_t len) {
+    uint32_t n = 0;
+
+    while (n < len && keyboard_has_data()) buf[n++] = keyboard_get_char();
+    return n;
+}
+
+static void service_parked(struct ioring *r) {
+    while (r->parked && keyboard_has_data()) {
+        uint32_t flags = irq_save();
+        struct ioring_op *op = r->parked;
+        r->parked = op->next;
+        irq_restore(flags);
+
+        ioring_post(r, op->user_data, (int32_t)console_read(op->buf, op->len));
+        flags = irq_save();
+        op_put(r, op);
+        irq_restore(flags);
+    }
+}
+
+/* Console WRITEs collected for one printk_writev() */
+struct write_batch {
+    int n;
+    struct printk_vec vec[IORING_SQ_ENTRIES];
+    uint32_t user_data[IORING_SQ_ENTRIES];
+};
+
+static void write_batch_flush(struct ioring *r, struct write_batch *wb) {
+    if (wb->n == 0) return;
+    printk_writev(wb->vec, wb->n);
+    r->stats.driver_calls++;
+    for (int i = 0; i < wb->n; i++) ioring_post(r, wb->user_data[i], (int32_t)wb->vec[i].len);
+    wb->n = 0;
+}
+
+/* Queue a block READ/WRITE on dev (plugged by the caller); -1 if malformed */
+static int submit_blk(struct ioring *r, struct blk_dev *dev, const struct io_sqe *sqe) {
+    if ((sqe->off | sqe->len) & (BLK_SECTOR_SIZE - 1)) return -1;
+
+    uint32_t flags = irq_save();
+    struct ioring_op *op = op_get(r, sqe->user_data);
+    irq_restore(flags);
+
+    op->req.sector = sqe->off >> BLK_SECTOR_SHIFT;
+    op->req.op = sqe->opcode == IORING_OP_WRITE ? BLK_WRITE : BLK_READ;
+    op->req.nseg = 1;
+    op->req.seg[0].buf = (void *)sqe->addr;
+    op->req.seg[0].len = sqe->len;
+    op->req.done = ioring_blk_done;
+    op->req.priv = op;
+
+    flags = irq_save();
+    r->blk_inflight++;
+    irq_restore(flags);
+    if (blk_submit(dev, &op->req) < 0) {
+        flags = irq_save();
+        r->blk_inflight--;
+        op_put(r, op);
+        irq_restore(flags);
+        return -1;
+    }
+    return 0;
+}
+
+/* Console READ: what is there now, or park until input arrives (behind
+ * any READs already parked, so input goes out in order) */
+static void console_read_sqe(struct ioring *r, const struct io_sqe *sqe) {
+    uint8_t *buf = (uint8_t *)sqe->addr;
+
+    if (!r->parked) {
+        uint32_t n = console_read(buf, sqe->len);
+        if (n || !sqe->len) {
+            ioring_post(r, sqe->user_data, (int32_t)n);
+            return;
+        }
+    }
+
+    uint32_t flags = irq_save();
+    struct ioring_op *op = op_get(r, sqe->user_data);
+    struct ioring_op **pp = &r->parked;
+    op->buf = buf;
+    op->len = sqe->len;
+    while (*pp) pp = &(*pp)->next;
+    *pp = op;
+    irq_restore(flags);
+}
+
+/* Block FLUSH: complete now, or once the block requests in flight have */
+static void blk_flush_sqe(struct ioring *r, const struct io_sqe *sqe) {
+    uint32_t flags = irq_save();
+
+    if (r->blk_inflight) {
+        struct ioring_op *op = op_get(r, sqe->user_data);
+        op->next = r->flushes;
+        r->flushes = op;
+        irq_restore(flags);
+        return;
+    }
+    irq_restore(flags);
+    ioring_post(r, sqe->user_data, 0);
+}
+
+/* Hand one SQE to its driver.  Returns 0 if it was consumed, -1 if it
+ * needs an op and none is free (it stays queued). */
+static int dispatch(struct ioring *r, const struct io_sqe *sqe, struct write_batch *wb,
+                    uint32_t *plugged) {
+    int console = sqe->target == IORING_CONSOLE;
+    int index = sqe->target - 1;
+    struct blk_dev *dev = console ? NULL : blk_get(index);
+    int needs_op = console ? sqe->opcode == IORING_OP_READ : sqe->opcode != IORING_OP_NOP;
+
+    if (needs_op && !r->free_ops) return -1;
+    r->inflight++;
+
+    if (sqe->flags || sqe->opcode > IORING_OP_FLUSH || (!console && !dev)) {
+        ioring_post(r, sqe->user_data, -1);
+    } else if (sqe->opcode == IORING_OP_NOP) {
+        ioring_post(r, sqe->user_data, 0);
+    } else if (console && sqe->opcode == IORING_OP_WRITE) {
+        wb->vec[wb->n].buf = (const char *)sqe->addr;
+        wb->vec[wb->n].len = sqe->len;
+        wb->user_data[wb->n++] = sqe->user_data;
+    } else if (console && sqe->opcode == IORING_OP_READ) {
+        write_batch_flush(r, wb);                   /* Prompt before input */
+        console_read_sqe(r, sqe);
+    } else if (console) {
+        write_batch_flush(r, wb);
+        virtio_console_sync();
+        ioring_post(r, sqe->user_data, 0);
+    } else if (sqe->opcode == IORING_OP_FLUSH) {
+        blk_flush_sqe(r, sqe);
+    } else {
+        if (!(*plugged & (1u << index))) {
+            blk_plug(dev);
+            *plugged |= 1u << index;
+        }
+        if (submit_blk(r, dev, sqe) < 0) ioring_post(r, sqe->user_data, -1);
+    }
+    return 0;
+}
+
+/* Completions the CQ can still take */
+static uint32_t cq_room(struct ioring *r) {
+    uint32_t flags = irq_save();
+    uint32_t used = r->rings.cq_tail - LOAD_ACQUIRE(&r->rings.cq_head) + r->inflight;
+    irq_restore(flags);
+    return IORING_CQ_ENTRIES - used;
+}
+
+static int ioring_submit(struct ioring *r) {
+    struct write_batch wb;
+    uint32_t plugged = 0;
+    uint32_t head = r->rings.sq_head;
+    uint32_t tail = LOAD_ACQUIRE(&r->rings.sq_tail);
+    uint32_t room = cq_room(r);
+    int consumed = 0;
+
+    wb.n = 0;
+    while (head != tail && room) {
+        struct io_sqe sqe = r->rings.sqes[head & SQ_MASK];   /* Copied once */
+
+        if (dispatch(r, &sqe, &wb, &plugged) < 0) break;
+        head++;
+        room--;
+        consumed++;
+    }
+    STORE_RELEASE(&r->rings.sq_head, head);
+
+    write_batch_flush(r, &wb);
+    for (int i = 0; plugged; i++, plugged >>= 1) {
+        if (!(plugged & 1)) continue;
+        blk_unplug(blk_get(i));
+        r->stats.driver_calls++;
+    }
+
+    if (consumed) {
+        r->stats.submitted += consumed;
+        r->stats.enters++;
+    }
+    return consumed;
+}
+
+int ioring_enter(struct ioring *r, uint32_t min_complete) {
+    STORE_RELEASE(&r->rings.sq_tail, r->sqe_tail);
+    int consumed = ioring_submit(r);
+
+    while (ioring_cq_ready(r) < min_complete && r->inflight) {
+        service_parked(r);
+
+        /* Input or a completion arriving after this check ends the halt */
+        __asm__ volatile("cli");
+        if (ioring_cq_ready(r) >= min_complete || (r->parked && keyboard_has_data())) {
+            __asm__ volatile("sti");
+            continue;
+        }
+        timer_idle(TIMER_NONE);
+    }
+    return consumed;
+}
+
+/* -------------------------------------------------------------- shell */
+
+static struct ioring shell_ring;
+
+/* ioring: statistics; ioring echo <words...>: one WRITE per word;
+ * ioring read: one line of input through a console READ */
+void cmd_ioring(int argc, char *argv[]) {
+    struct ioring *r = &shell_ring;
+    struct io_cqe *cqe;
+
+    if (!r->ops[0].ring) ioring_init(r);
+
+    if (argc >= 2 && strcmp(argv[1], "echo") == 0) {
+        int n = 0;
+        for (int i = 2; i < argc && n + 2 <= IORING_SQ_ENTRIES; i++, n += 2) {
+            ioring_prep(ioring_get_sqe(r), IORING_OP_WRITE, IORING_CONSOLE,
+                        argv[i], strlen(argv[i]), 0, i);
+            ioring_prep(ioring_get_sqe(r), IORING_OP_WRITE, IORING_CONSOLE,
+                        i + 1 < argc ? " " : "\n", 1, 0, i);
+        }
+        ioring_enter(r, n);
+        while ((cqe = ioring_peek_cqe(r)) != NULL) ioring_cqe_seen(r);
+        return;
+    }
+
+    if (argc >= 2 && strcmp(argv[1], "read") == 0) {
+        char buf[64];
+        ioring_prep(ioring_get_sqe(r), IORING_OP_READ, IORING_CONSOLE, buf, sizeof(buf) - 1, 0, 1);
+        ioring_enter(r, 1);
+        cqe = ioring_peek_cqe(r);
+        int n = cqe ? cqe->res : -1;
+        ioring_cqe_seen(r);
+        if (n < 0) {
+            printk("ioring: read failed\n");
+            return;
+        }
+        buf[n] = '\0';
+        printk("read %d bytes: %s\n", n, buf);
+        return;
+    }
+
+    printk("SQ %u entries, CQ %u entries, %u in flight\n",
+           IORING_SQ_ENTRIES, IORING_CQ_ENTRIES, r->inflight);
+    printk("submitted %u, completed %u, enters %u, driver calls %u\n",
+           r->stats.submitted, r->stats.completed, r->stats.enters, r->stats.driver_calls);
+}
+
+/* ------------------------------------------------------------ benchmark */
+
+#define BENCH_NOPS          4096
+#define BENCH_LINES         64
+
+static struct ioring bench_ring;
+static const char bench_ioring_line[] = "ioring bench: the quick brown fox jumps\n";
+
+static uint32_t ops_per_sec(uint32_t ops, uint64_t cycles) {
+    uint32_t us = tsc_cycles_to_us(cycles);
+    return us ? (uint32_t)div64_u32((uint64_t)ops * 1000000, us, NULL) : 0;
+}
+
+/* Submit ops SQEs batch at a time, waiting for each batch */
+static uint64_t ring_run(uint8_t opcode, uint32_t ops, uint32_t batch) {
+    struct ioring *r = &bench_ring;
+    uint64_t start = rdtsc();
+
+    for (uint32_t done = 0; done < ops; done += batch) {
+        for (uint32_t i = 0; i < batch; i++) {
+            ioring_prep(ioring_get_sqe(r), opcode, IORING_CONSOLE, bench_ioring_line,
+                        sizeof(bench_ioring_line) - 1, 0, i);
+        }
+        ioring_enter(r, batch);
+        while (ioring_peek_cqe(r)) ioring_cqe_seen(r);
+    }
+    return rdtsc() - start;
+}
+
+/* NOPs show the ring's own cost per op; console writes compare one
+ * printk per line with the ring at batch 1 and 32 (one flush per batch) */
+void bench_ioring(void) {
+    tsc_calibrate();
+    ioring_init(&bench_ring);
+
+    bench_report("ioring_nop_b1", ops_per_sec(BENCH_NOPS, ring_run(IORING_OP_NOP, BENCH_NOPS, 1)), "ops/s");
+    bench_report("ioring_nop_b32", ops_per_sec(BENCH_NOPS, ring_run(IORING_OP_NOP, BENCH_NOPS, 32)), "ops/s");
+
+    uint64_t start = rdtsc();
+    for (uint32_t i = 0; i < BENCH_LINES; i++) printk("%s", bench_ioring_line);
+    uint32_t sync = ops_per_sec(BENCH_LINES, rdtsc() - start);
+    uint32_t b1 = ops_per_sec(BENCH_LINES, ring_run(IORING_OP_WRITE, BENCH_LINES, 1));
+    uint32_t b32 = ops_per_sec(BENCH_LINES, ring_run(IORING_OP_WRITE, BENCH_LINES, 32));
+
+    bench_report("console_sync", sync, "ops/s");
+    bench_report("ioring_console_b1", b1, "ops/s");
+    bench_report("ioring_console_b32", b32, "ops/s");
+}
@@ -0,0 +1,135 @@
+#ifndef IORING_H
+#define IORING_H
+
+#include <stdint.h>
+#include "blk.h"
+
+/*
+ * Submission/completion rings for asynchronous I/O.
+ *
+ * A ring is a pair of single-producer/single-consumer queues in one
+ * page.  The submitter fills submission entries (SQEs) and publishes
+ * them by moving sq_tail; ioring_enter() consumes everything published
+ * and hands it to the drivers in batches: consecutive console writes go
+ * out as one printk_writev() (one flush per sink), and block requests
+ * are queued under one plug per device, so a batch costs one doorbell.
+ * The kernel posts a completion entry (CQE) for every SQE, from
+ * ioring_enter() or from a driver's completion interrupt, and moves
+ * cq_tail; the submitter reaps from cq_head with plain loads and stores
+ * ordered by acquire/release, no lock.
+ *
+ * SQEs are only consumed while their completions are sure to fit, so
+ * the completion queue never overflows.  Buffers are kernel addresses
+ * for now; the layout of struct io_rings is what a ring 3 program would
+ * map.
+ *
+ *   target             READ                    WRITE           FLUSH
+ *   IORING_CONSOLE     keyboard/serial input   printk sinks    virtio-console sync
+ *   IORING_BLK(n)      block device n (lsblk order), byte offset and
+ *                      length in whole sectors; FLUSH completes once
+ *                      every earlier block request of the ring has
+ *                      completed
+ *
+ * A console READ with no input waiting stays parked until input
+ * arrives while the ring waits in ioring_enter().  Results are the bytes
+ * transferred, 0 for NOP and FLUSH, or -1.
+ */
+
+#define IORING_SQ_ENTRIES   32
+#define IORING_CQ_ENTRIES   (2 * IORING_SQ_ENTRIES)
+
+/* io_sqe.opcode */
+#define IORING_OP_NOP       0
+#define IORING_OP_READ      1
+#define IORING_OP_WRITE     2
+#define IORING_OP_FLUSH     3
+
+/* io_sqe.target */
+#define IORING_CONSOLE      0
+#define IORING_BLK(n)       (1 + (n))
+
+struct io_sqe {
+    uint8_t opcode;
+    uint8_t flags;                  /* None defined yet, must be 0 */
+    uint16_t target;
+    uint32_t addr;                  /* Buffer */
+    uint32_t len;
+    uint32_t user_data;             /* Copied to the CQE */
+    uint64_t off;                   /* Byte offset (block devices) */
+};
+
+struct io_cqe {
+    uint32_t user_data;
+    int32_t res;
+};
+
+/* The shared part */
+struct io_rings {
+    uint32_t sq_head;               /* Kernel consumes */
+    uint32_t sq_tail;               /* Submitter produces */
+    uint32_t cq_head;               /* Submitter consumes */
+    uint32_t cq_tail;               /* Kernel produces */
+    struct io_sqe sqes[IORING_SQ_ENTRIES];
+    struct io_cqe cqes[IORING_CQ_ENTRIES];
+};
+
+/* Kernel side of a consumed SQE that completes later */
+struct ioring_op {
+    struct ioring *ring;
+    struct ioring_op *next;
+    uint32_t user_data;
+    uint8_t *buf;                   /* Parked console READs */
+    uint32_t len;
+    struct blk_req req;
+};
+
+struct ioring_stats {
+    uint32_t submitted;
+    uint32_t completed;
+    uint32_t enters;                /* ioring_enter() calls that consumed SQEs */
+    uint32_t driver_calls;          /* printk_writev() calls and device unplugs */
+};
+
+struct ioring {
+    struct io_rings rings __attribute__((aligned(4096)));
+
+    /* Submitter side */
+    uint32_t sqe_tail;              /* SQEs handed out, not yet published */
+
+    /* Kernel side */
+    uint32_t inflight;              /* Consumed, completion not posted */
+    uint32_t blk_inflight;
+    struct ioring_op *flushes;      /* Block FLUSHes waiting for blk_inflight == 0 */
+    struct ioring_op *parked;       /* Console READs waiting for input */
+    struct ioring_op *free_ops;
+    struct ioring_op ops[IORING_SQ_ENTRIES];
+    struct ioring_stats stats;
+};
+
+void ioring_init(struct ioring *r);
+
+/* Next SQE to fill, NULL if the submission queue is full */
+struct io_sqe *ioring_get_sqe(struct ioring *r);
+
+void ioring_prep(struct io_sqe *sqe, uint8_t opcode, uint16_t target,
+                 const void *buf, uint32_t len, uint64_t off, uint32_t user_data);
+
+/* Publish the SQEs filled so far, pass them to the drivers, then wait
+ * (halting) until at least min_complete completions are ready.  Returns
+ * the number of SQEs consumed; ones that did not fit stay queued. */
+int ioring_enter(struct ioring *r, uint32_t min_complete);
+
+/* Oldest completion, NULL if none; ioring_cqe_seen() releases it */
+struct io_cqe *ioring_peek_cqe(struct ioring *r);
+void ioring_cqe_seen(struct ioring *r);
+
+/* Completions ready to reap */
+uint32_t ioring_cq_ready(const struct ioring *r);
+
+/* Shell command: ioring [echo <words...> | read] */
+void cmd_ioring(int argc, char *argv[]);
+
+/* Benchmark: ops/s through the ring at batch 1 and 32 vs synchronous */
+void bench_ioring(void);
+
+#endif /* IORING_H */
@@ -0,0 +1,43 @@
+#include "irq.h"
+#include "compiler.h"
+#include "pic.h"
+#include "cpu.h"
+
+struct irq_action {
+    irq_handler_t handler;
+    void *ctx;
+};
+
+static struct irq_action irq_actions[IRQ_LINES][IRQ_MAX_SHARED];
+uint32_t irq_counts[IRQ_LINES];
+
+int irq_register(uint8_t irq, irq_handler_t handler, void *ctx) {
+    if (irq >= IRQ_LINES || irq == 2) return -1;
+
+    uint32_t flags = irq_save();
+    int ret = -1;
+
+    for (int i = 0; i < IRQ_MAX_SHARED; i++) {
+        if (irq_actions[irq][i].handler) continue;
+        irq_actions[irq][i].handler = handler;
+        irq_actions[irq][i].ctx = ctx;
+        if (irq >= 8) pic_enable_irq(2);    /* Cascade from the slave PIC */
+        pic_enable_irq(irq);
+        ret = 0;
+        break;
+    }
+    irq_restore(flags);
+    return ret;
+}
+
+void __hot irq_dispatch(struct irq_frame *frame) {
+    uint8_t irq = (uint8_t)(frame->int_no - 32);
+
+    if (irq >= IRQ_LINES) return;
+    irq_counts[irq]++;
+
+    for (int i = 0; i < IRQ_MAX_SHARED && irq_actions[irq][i].handler; i++) {
+        irq_actions[irq][i].handler(irq_actions[irq][i].ctx);
+    }
+    pic_send_eoi(irq);
+}
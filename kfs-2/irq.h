@@ -0,0 +1,30 @@
+#ifndef IRQ_H
+#define IRQ_H
+
+#include <stdint.h>
+#include "idt.h"
+
+/*
+ * Device IRQs other than the timer and keyboard (which have their own
+ * paths in idt_load.asm) go through irq_dispatch().  A line can be shared
+ * by up to IRQ_MAX_SHARED handlers, as PCI INTx lines often are; every
+ * handler on the line is called and must check whether its device
+ * actually raised the interrupt.
+ */
+
+#define IRQ_LINES       16
+#define IRQ_MAX_SHARED  4
+
+typedef void (*irq_handler_t)(void *ctx);
+
+/* Add a handler for irq and unmask it at the PIC.
+ * Returns -1 if irq is out of range or its handler slots are full. */
+int irq_register(uint8_t irq, irq_handler_t handler, void *ctx);
+
+/* Called from idt_load.asm for IRQ2-15; sends the EOI */
+void irq_dispatch(struct irq_frame *frame);
+
+/* Interrupts taken per line, for the shell */
+extern uint32_t irq_counts[IRQ_LINES];
+
+#endif /* IRQ_H */
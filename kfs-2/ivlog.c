@@ -0,0 +1,184 @@
+#include "ivlog.h"
+#include "pci.h"
+#include "printk.h"
+#include "lib.h"
+#include "cpu.h"
+#include "tsc.h"
+
+#define IVSHMEM_VENDOR      0x1AF4
+#define IVSHMEM_DEVICE      0x1110
+#define IVSHMEM_BAR_SHMEM   2
+
+#define IVLOG_HDR           ((uint32_t)sizeof(struct ivlog_record))
+#define IVLOG_SEQ_PAD       0xFFFFFFFFu
+
+static struct ivlog_header *ivh;
+static uint8_t *iv_data;
+static uint32_t iv_size;
+
+/* Writer-side copies of the shared indices */
+static uint32_t iv_head, iv_head_seq, iv_tail, iv_tail_seq;
+
+/* Record being filled (not yet published) */
+static uint32_t iv_pos, iv_len;
+static uint16_t iv_flags;
+static int iv_open;
+
+static inline void ivlog_barrier(void) {
+    __asm__ volatile ("" : : : "memory");
+}
+
+static uint32_t ivlog_checksum(const struct ivlog_record *r) {
+    const uint8_t *p = (const uint8_t *)r;
+    uint32_t h = 2166136261u;
+
+    for (uint32_t i = 0; i < IVLOG_HDR - 4; i++) {
+        h ^= p[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+static struct ivlog_record *ivlog_at(uint32_t off) {
+    return (struct ivlog_record *)(iv_data + off);
+}
+
+/* Step tail over the oldest record, then over any padding after it */
+static void ivlog_drop_oldest(void) {
+    iv_tail += IVLOG_ALIGN(IVLOG_HDR + ivlog_at(iv_tail)->len);
+    iv_tail_seq++;
+
+    while (iv_tail_seq != iv_head_seq) {
+        if (iv_size - iv_tail < IVLOG_HDR || (ivlog_at(iv_tail)->flags & IVLOG_F_PAD)) {
+            iv_tail = 0;
+        } else {
+            break;
+        }
+    }
+}
+
+/* Free [pos, pos + len) of live records.  tail_seq is published before
+ * the space is written, so a reader copying one of them notices. */
+static void ivlog_make_space(uint32_t pos, uint32_t len) {
+    uint32_t seq = iv_tail_seq;
+
+    while (iv_tail_seq != iv_head_seq && iv_tail >= pos && iv_tail < pos + len) {
+        ivlog_drop_oldest();
+    }
+    if (iv_tail_seq == iv_head_seq) iv_tail = pos;
+    if (iv_tail_seq != seq) {
+        ivh->tail_seq = iv_tail_seq;
+        ivlog_barrier();
+        ivh->tail = iv_tail;
+        ivlog_barrier();
+    }
+}
+
+static void ivlog_open(void) {
+    uint32_t pos = iv_head;
+    uint32_t room = iv_size - pos;
+
+    if (room < IVLOG_RECORD_MAX) {
+        ivlog_make_space(pos, room);
+        if (room >= IVLOG_HDR) {
+            struct ivlog_record *pad = ivlog_at(pos);
+            pad->seq = IVLOG_SEQ_PAD;
+            pad->len = (uint16_t)(room - IVLOG_HDR);
+            pad->flags = IVLOG_F_PAD;
+            pad->tsc = 0;
+            pad->reserved = 0;
+            pad->checksum = ivlog_checksum(pad);
+        }
+        pos = 0;
+    }
+    ivlog_make_space(pos, IVLOG_RECORD_MAX);
+
+    iv_pos = pos;
+    iv_len = 0;
+    iv_flags = 0;
+    iv_open = 1;
+}
+
+/* Text goes straight into the shared ring */
+static void ivlog_write(const char *s, size_t len) {
+    uint32_t flags = irq_save();
+
+    if (!iv_open) ivlog_open();
+
+    uint32_t room = IVLOG_RECORD_MAX - IVLOG_HDR - iv_len;
+    if (len > room) {
+        len = room;
+        iv_flags |= IVLOG_F_TRUNC;
+    }
+    memcpy(iv_data + iv_pos + IVLOG_HDR + iv_len, s, len);
+    iv_len += (uint32_t)len;
+    irq_restore(flags);
+}
+
+/* End of a printk: complete the record and publish it */
+static void ivlog_flush(void) {
+    uint32_t flags = irq_save();
+
+    if (iv_open) {
+        struct ivlog_record *r = ivlog_at(iv_pos);
+        r->seq = iv_head_seq;
+        r->len = (uint16_t)iv_len;
+        r->flags = iv_flags;
+        r->tsc = rdtsc();
+        r->reserved = 0;
+        r->checksum = ivlog_checksum(r);
+
+        iv_head = iv_pos + IVLOG_ALIGN(IVLOG_HDR + iv_len);
+        if (iv_head == iv_size) iv_head = 0;
+        iv_head_seq++;
+        if (iv_flags & IVLOG_F_TRUNC) ivh->truncated++;
+        if (!ivh->tsc_khz) ivh->tsc_khz = tsc_khz;
+
+        ivlog_barrier();
+        ivh->head = iv_head;
+        ivlog_barrier();
+        ivh->head_seq = iv_head_seq;
+        iv_open = 0;
+    }
+    irq_restore(flags);
+}
+
+static struct printk_sink ivlog_sink = {
+    .name  = "ivshmem",
+    .write = ivlog_write,
+    .flush = ivlog_flush,
+    .level = LOGLEVEL_DEBUG,
+    .enabled = 1,
+};
+
+int ivlog_init(void) {
+    struct pci_dev dev;
+
+    if (pci_find_device(IVSHMEM_VENDOR, IVSHMEM_DEVICE, &dev) < 0) return -1;
+
+    uint32_t base = pci_bar_mem(&dev, IVSHMEM_BAR_SHMEM);
+    uint32_t size = pci_bar_size(&dev, IVSHMEM_BAR_SHMEM);
+    if (!base || size < 4 * IVLOG_RECORD_MAX) return -1;
+
+    /* The kernel's 4 MB identity map (vm.h) covers MMIO: the BAR is used
+     * at its physical address */
+    pci_enable(&dev, PCI_COMMAND_MEMORY);
+
+    ivh = (struct ivlog_header *)base;
+    iv_data = (uint8_t *)base + sizeof(struct ivlog_header);
+    iv_size = (size - sizeof(struct ivlog_header)) & ~7u;
+
+    /* The reader waits for the magic, so it is written last */
+    ivh->magic = 0;
+    ivlog_barrier();
+    memset(ivh, 0, sizeof(*ivh));
+    ivh->version = IVLOG_VERSION;
+    ivh->data_offset = sizeof(struct ivlog_header);
+    ivh->data_size = iv_size;
+    ivh->tsc_khz = tsc_khz;
+    ivh->boot_id = (uint32_t)rdtsc();
+    ivlog_barrier();
+    ivh->magic = IVLOG_MAGIC;
+
+    return printk_register_sink(&ivlog_sink);
+}
@@ -0,0 +1,71 @@
+#ifndef IVLOG_H
+#define IVLOG_H
+
+#include <stdint.h>
+
+/*
+ * printk log ring in QEMU ivshmem shared memory ("ivshmem" sink).
+ *
+ * The ring lives directly in the device's memory BAR, which QEMU backs
+ * with a host file, so printk output is written once and the host reads
+ * it with tools/ivlog.py without any VM exit:
+ *
+ *   qemu ... -object memory-backend-file,id=ivlog,share=on,mem-path=ivlog.shm,size=1M \
+ *            -device ivshmem-plain,memdev=ivlog
+ *
+ * Layout (little endian, mirrored in tools/ivlog.py):
+ *
+ *   BAR offset 0    struct ivlog_header
+ *   data_offset     data_size bytes of records
+ *
+ * Each printk message is one record: a struct ivlog_record followed by
+ * the text, padded to 8 bytes.  A record never wraps; the space at the
+ * end of the ring is skipped with a pad record, or silently if it is
+ * smaller than a record header.
+ *
+ * Records carry consecutive sequence numbers.  head_seq is advanced only
+ * after a record is complete.  Before reusing space the writer advances
+ * tail/tail_seq past the records it is about to overwrite.  A reader
+ * copies a record and then checks that tail_seq has not passed it, so
+ * overwritten records are detected by sequence numbers.  The header
+ * checksum catches a header read while it was being rewritten.
+ */
+
+#define IVLOG_MAGIC         0x4C56494Bu     /* "KIVL" */
+#define IVLOG_VERSION       1
+
+#define IVLOG_F_PAD         0x0001  /* Filler up to the end of the ring */
+#define IVLOG_F_TRUNC       0x0002  /* Message cut at IVLOG_RECORD_MAX */
+
+#define IVLOG_RECORD_MAX    1024    /* Header and text */
+#define IVLOG_ALIGN(n)      (((n) + 7) & ~7u)
+
+struct ivlog_header {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t data_offset;           /* From the start of the BAR */
+    uint32_t data_size;
+    uint32_t tsc_khz;               /* 0 until calibrated */
+    uint32_t boot_id;               /* Changes when the kernel restarts the ring */
+    volatile uint32_t head;         /* Offset of the next record */
+    volatile uint32_t head_seq;     /* Sequence number of the next record */
+    volatile uint32_t tail;         /* Offset of the oldest record */
+    volatile uint32_t tail_seq;     /* Its sequence number */
+    volatile uint32_t truncated;    /* Records cut at IVLOG_RECORD_MAX */
+    uint32_t reserved[5];
+};
+
+struct ivlog_record {
+    uint32_t seq;
+    uint16_t len;                   /* Text bytes after the header */
+    uint16_t flags;
+    uint64_t tsc;
+    uint32_t reserved;
+    uint32_t checksum;              /* FNV-1a of the 20 bytes above */
+};
+
+/* Register the "ivshmem" sink if an ivshmem-plain device is present.
+ * Returns 0 on success, -1 if there is none. */
+int ivlog_init(void);
+
+#endif /* IVLOG_H */
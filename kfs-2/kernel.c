@@ -7,6 +7,24 @@
 #include "idt.h" // IDT initialization
 #include "pic.h" // PIC initialization
 #include "keyboard.h" // Keyboard support
+#include "multiboot.h" // Multiboot info structure
+#include "boottime.h" // Boot-phase timing and fast boot
+#include "timer.h" // PIT timer tick
+#include "console.h" // VGA text console
+#include "debugcon.h" // QEMU debug console sink
+#include "virtio_console.h" // virtio-console sink
+#include "ivlog.h" // ivshmem log ring sink
+#include "virtio_blk.h" // virtio-blk disk
+#include "ahci.h" // AHCI SATA disk
+#include "module.h" // Multiboot modules
+#include "initramfs.h" // Read-only initramfs
+#include "ramdisk.h" // RAM disk from a Multiboot module
+#include "bcache.h" // Block buffer cache
+#include "usermode.h" // Ring 3 and system calls
+#include "pmm.h" // Physical frame database
+#include "vm.h" // Paging and user address spaces
+#include "gcov.h" // Profile counters (PROFILE=pgo-gen builds)
+#include "init.h" // Boot-only code and data (__init)
 
 static inline void outb(uint16_t port, uint8_t val) { // Запись одного байта в порт ввода/вывода (I/O)
     __asm__ volatile ("outb %0, %1" : : "a"(val), "Nd"(port)); // asm-инструкция outb: al -> [dx]
@@ -18,57 +36,118 @@ static inline uint8_t inb(uint16_t port) { // Чтение одного байт
     return ret; // Возвращаем полученное значение
 }
 
-void kmain(uint32_t multiboot_magic, uint32_t multiboot_info_addr) { // Точка входа C-части ядра (вызывается из boot.asm)
-    // Multiboot v1: EAX должен быть 0x2BADB002, EBX — адрес структуры multiboot_info
-    if (multiboot_magic != 0x2BADB002) { // Проверка, что нас загрузил совместимый загрузчик
-        while (1) {} // Неверный загрузчик — остановиться
-    }
-    (void)multiboot_info_addr; // Пока не используем структуру, подавить предупреждение
-    
-    /* Initialize the GDT */
-    gdt_init();
-    
-    volatile uint16_t* vga = (uint16_t*)0xB8000; // Адрес текстового буфера VGA
-    vga[0] = '4' | (0x0F << 8);  // Напечатать '4' атрибутом ярко-белый на чёрном
-    vga[1] = '2' | (0x0F << 8);  // Напечатать '2' рядом
-
-    /* Initialize and use printk */
+/* GDT summary and stack dump printed on a normal (non-fast) boot */
+static void __init kernel_banner(void) {
     printk("\n========================================\n");
     printk("Kernel 42 - KFS-2\n");
     printk("========================================\n\n");
     
     printk("GDT initialized successfully!\n");
     printk("GDT Base Address: 0x00000800\n");
-    printk("GDT Descriptors: %d\n", 7);
+    printk("GDT Descriptors: %d\n", 12);
     printk("  - Null Descriptor\n");
     printk("  - Kernel Code Segment (0x08)\n");
     printk("  - Kernel Data Segment (0x10)\n");
     printk("  - Kernel Stack Segment (0x18)\n");
     printk("  - User Code Segment (0x23)\n");
     printk("  - User Data Segment (0x2B)\n");
-    printk("  - User Stack Segment (0x33)\n\n");
+    printk("  - User Stack Segment (0x33)\n");
+    printk("  - Task State Segment (0x38)\n");
+    printk("  - SYSENTER/SYSEXIT segments (0x40-0x5B)\n\n");
     
     /* Display kernel stack information */
     print_stack();
+}
+
+/* Check whether the kernel command line contains the word opt */
+static int __init cmdline_has_option(const char *cmdline, const char *opt) {
+    while (*cmdline) {
+        while (*cmdline == ' ') cmdline++; // Пропустить разделители
+        
+        const char *o = opt;
+        while (*o && *cmdline == *o) { cmdline++; o++; } // Сравнить слово с опцией
+        if (*o == '\0' && (*cmdline == ' ' || *cmdline == '\0')) return 1;
+        
+        while (*cmdline && *cmdline != ' ') cmdline++; // Перейти к следующему слову
+    }
+    return 0;
+}
+
+void kmain(uint32_t multiboot_magic, uint32_t multiboot_info_addr) { // Точка входа C-части ядра (вызывается из boot.asm)
+    boot_phase("entry"); // start в boot.asm -> kmain
+    gcov_init(); // Регистрация счётчиков профиля (пусто без PROFILE=pgo-gen)
+    
+    // Multiboot v1: EAX должен быть 0x2BADB002, EBX — адрес структуры multiboot_info
+    if (multiboot_magic != MULTIBOOT_BOOTLOADER_MAGIC) { // Проверка, что нас загрузил совместимый загрузчик
+        while (1) {} // Неверный загрузчик — остановиться
+    }
+    
+    /* "fastboot" on the GRUB command line skips banner and demo (also -DCONFIG_FASTBOOT) */
+    const struct multiboot_info *mbi = (const struct multiboot_info *)multiboot_info_addr;
+    if ((mbi->flags & MULTIBOOT_INFO_CMDLINE) &&
+        cmdline_has_option((const char *)mbi->cmdline, "fastboot")) {
+        boot_set_fast(1);
+    }
+    module_init(mbi); // Запомнить модули, загруженные GRUB (используются на месте)
+    
+    /* Initialize the GDT */
+    gdt_init();
+    boot_phase("gdt");
+    
+    console_init(); // Очистить экран и взять VGA под драйвер консоли
+    console_write("42\n", 3); // Напечатать "42" в левом верхнем углу
+    debugcon_init(); // Вывод printk в порт 0xE9, если QEMU запущен с -debugcon
+    virtio_console_init(); // Вывод printk через virtio-console, если устройство есть
+    ivlog_init(); // Кольцо лога в общей памяти ivshmem, если устройство есть
+    boot_phase("console");
+
+    if (!boot_is_fast()) {
+        kernel_banner();
+    }
+    boot_phase("banner");
     
     /* Initialize interrupts */
-    printk("Initializing PIC...\n");
+    if (!boot_is_fast()) printk("Initializing PIC...\n");
     pic_init();
+    boot_phase("pic");
     
-    printk("Initializing IDT...\n");
+    if (!boot_is_fast()) printk("Initializing IDT...\n");
     idt_init();
+    syscall_init(); // Шлюз int 0x80 и MSR для sysenter
+    boot_phase("idt");
+    
+    /* Paging: identity map for the kernel, demand-paged user window */
+    pmm_init(mbi); // Свободные физические страницы (без ядра и модулей)
+    vm_init(); // Включить страничную адресацию
+    boot_phase("vm");
+    
+    /* Start the periodic timer tick */
+    timer_init(TIMER_HZ);
+    boot_phase("timer");
     
     /* Initialize keyboard */
-    printk("Initializing keyboard...\n");
+    if (!boot_is_fast()) printk("Initializing keyboard...\n");
     keyboard_init();
+    boot_phase("keyboard");
+    
+    /* Block devices (interrupt-driven, so after the PIC and IDT) */
+    virtio_blk_init();
+    ahci_init();
+    ramdisk_init();
+    bcache_init();
+    boot_phase("disk");
+    
+    /* Index the initramfs module in place */
+    initramfs_init();
+    boot_phase("initramfs");
     
     /* Enable interrupts */
     __asm__ volatile("sti");  /* Set Interrupt Flag */
     
     /* Initialize and start the debugging shell */
     shell_init();
+    boot_phase("shell_init");
     shell_main_loop();
 
     while(1); // Бесконечный цикл, чтобы ядро не завершилось
 }
-
@@ -1,4 +1,12 @@
 #include "keyboard.h"
+#include "console.h"
+#include "printk.h"
+#include "irq.h"
+#include "cpu.h"
+
+#define COM1_DATA       0x3F8
+#define COM1_LSR        0x3FD       /* Line status; bit 0 = data ready */
+#define COM1_IRQ        4
 
 /* Keyboard buffer for IRQ handler */
 volatile uint8_t kb_buffer[KB_BUFFER_SIZE];
@@ -27,7 +35,8 @@ static const char scancode_to_ascii_shift[] = {
 };
 
 /* Keyboard state */
-static uint8_t shift_pressed = 0;
+static uint8_t modifiers = 0;      /* KB_MOD_* bits */
+static uint8_t extended = 0;       /* Previous byte was KB_SC_EXTENDED */
 
 /* Port I/O functions */
 static inline void outb(uint16_t port, uint8_t val) {
@@ -40,16 +49,71 @@ static inline uint8_t inb(uint16_t port) {
     return ret;
 }
 
+/**
+ * Track Shift/Ctrl/Alt press and release.
+ * Returns 1 if the scancode was a modifier key.
+ */
+static int keyboard_update_modifiers(uint8_t scancode, int is_extended) {
+    uint8_t bit;
+    
+    switch (scancode & ~KB_SC_RELEASE) {
+        case 0x2A: bit = KB_MOD_LSHIFT; break;
+        case 0x36: bit = KB_MOD_RSHIFT; break;
+        case 0x1D: bit = is_extended ? KB_MOD_RCTRL : KB_MOD_LCTRL; break;
+        case 0x38: bit = is_extended ? KB_MOD_RALT : KB_MOD_LALT; break;
+        default:   return 0;
+    }
+    
+    if (scancode & KB_SC_RELEASE) {
+        modifiers &= ~bit;
+    } else {
+        modifiers |= bit;
+    }
+    return 1;
+}
+
+uint8_t keyboard_modifiers(void) {
+    return modifiers;
+}
+
+/* Move bytes waiting at COM1 into the buffer; 1 if there were any.
+ * Call with interrupts disabled. */
+static int serial_receive(void) {
+    int got = 0;
+
+    while (inb(COM1_LSR) & 0x01) {
+        uint8_t ch = inb(COM1_DATA);
+        
+        /* QEMU with -serial stdio sends \r (0x0D) for Enter, convert to \n (0x0A) */
+        if (ch == '\r') {
+            ch = '\n';
+        }
+        
+        uint32_t next_head = (kb_buffer_head + 1) % KB_BUFFER_SIZE;
+        if (next_head != kb_buffer_tail) {
+            kb_buffer[kb_buffer_head] = ch;
+            kb_buffer_head = next_head;
+        }
+        got = 1;
+    }
+    return got;
+}
+
+static void serial_irq(void *ctx) {
+    (void)ctx;
+    serial_receive();
+}
+
 void keyboard_init(void) {
     /* Initialize keyboard (8042 controller) */
-    shift_pressed = 0;
+    modifiers = 0;
+    extended = 0;
     kb_buffer_head = 0;
     kb_buffer_tail = 0;
     
-    /* Ensure serial port is initialized for reading */
-    /* COM1 base address is 0x3F8 */
-    /* This is already done in printk.c, but we ensure it's ready */
-    /* Serial port should already be initialized by printk() calls */
+    /* Serial input raises IRQ4 so it can end an idle halt */
+    irq_register(COM1_IRQ, serial_irq, NULL);
+    serial_rx_irq_enable();
 }
 
 /**
@@ -58,26 +122,37 @@ void keyboard_init(void) {
  */
 void keyboard_irq_handler(uint8_t scancode) {
     char ascii = 0;
+    int is_extended = extended;
     
     /* Handle special keys */
-    if (scancode == 0x2A) {
-        /* Left Shift pressed */
-        shift_pressed = 1;
+    if (scancode == KB_SC_EXTENDED) {
+        extended = 1;
         return;
     }
-    if (scancode == 0xAA) {
-        /* Left Shift released */
-        shift_pressed = 0;
+    extended = 0;
+    
+    if (keyboard_update_modifiers(scancode, is_extended)) {
         return;
     }
     
     /* Check if release code (high bit set) */
-    if (scancode & 0x80) {
+    if (scancode & KB_SC_RELEASE) {
         return;  /* Key release, ignore */
     }
     
+    /* Alt+F1..F4 switch virtual terminals */
+    if ((modifiers & KB_MOD_ALT) && scancode >= KB_SC_F1 && scancode < KB_SC_F1 + NR_VTS) {
+        vt_switch(scancode - KB_SC_F1);
+        return;
+    }
+    
+    /* Arrows, keypad Enter etc. have no mapping yet */
+    if (is_extended) {
+        return;
+    }
+    
     /* Convert scancode to ASCII */
-    if (shift_pressed && scancode < 128) {
+    if ((modifiers & KB_MOD_SHIFT) && scancode < 128) {
         ascii = scancode_to_ascii_shift[scancode];
     } else if (scancode < 128) {
         ascii = scancode_to_ascii[scancode];
@@ -102,29 +177,12 @@ int keyboard_has_data(void) {
         return 1;
     }
     
-    /* Fallback: poll serial port for input (for QEMU testing with stdio) */
-    /* COM1 status port is 0x3FD, bit 0 = data ready */
-    uint8_t status = inb(0x3FD);
-    if (status & 0x01) {
-        /* Data available at serial port */
-        uint8_t ch = inb(0x3F8);  /* Read from COM1 data port */
-        
-        /* Handle special characters from serial input */
-        /* QEMU with -serial stdio sends \r (0x0D) for Enter, convert to \n (0x0A) */
-        if (ch == '\r') {
-            ch = '\n';  /* Convert carriage return to newline */
-        }
-        
-        /* Add to buffer */
-        uint32_t next_head = (kb_buffer_head + 1) % KB_BUFFER_SIZE;
-        if (next_head != kb_buffer_tail) {
-            kb_buffer[kb_buffer_head] = ch;
-            kb_buffer_head = next_head;
-        }
-        return 1;
-    }
-    
-    return 0;
+    /* Fallback: poll serial port for input (for QEMU testing with stdio),
+     * in case IRQ4 is lost; the handler fills the same buffer */
+    uint32_t flags = irq_save();
+    int got = serial_receive();
+    irq_restore(flags);
+    return got;
 }
 
 /**
@@ -150,21 +208,14 @@ uint8_t keyboard_read_char(void) {
     /* Read scancode from keyboard */
     scancode = inb(KB_DATA_PORT);
     
-    /* Check for key release (high bit set) */
-    if (scancode & 0x80) {
-        scancode &= 0x7F;
-        
-        /* Handle key release */
-        if (scancode == 0x36 || scancode == 0x2A) {  /* Left or Right Shift */
-            shift_pressed = 0;
-        }
-        return 0;  /* Key was released, no character */
+    /* Modifier press/release */
+    if (keyboard_update_modifiers(scancode, 0)) {
+        return 0;
     }
     
-    /* Handle key press */
-    if (scancode == 0x36 || scancode == 0x2A) {  /* Left or Right Shift */
-        shift_pressed = 1;
-        return 0;
+    /* Check for key release (high bit set) */
+    if (scancode & KB_SC_RELEASE) {
+        return 0;  /* Key was released, no character */
     }
     
     /* Special keys */
@@ -183,7 +234,7 @@ uint8_t keyboard_read_char(void) {
     
     /* Convert scancode to ASCII */
     if (scancode < sizeof(scancode_to_ascii)) {
-        if (shift_pressed) {
+        if (modifiers & KB_MOD_SHIFT) {
             ascii = scancode_to_ascii_shift[scancode];
         } else {
             ascii = scancode_to_ascii[scancode];
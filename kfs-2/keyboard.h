@@ -17,6 +17,22 @@
 #define KB_TAB          0x09
 #define KB_ESCAPE       0x1B
 
+/* Modifier state bits (keyboard_modifiers()) */
+#define KB_MOD_LSHIFT   0x01
+#define KB_MOD_RSHIFT   0x02
+#define KB_MOD_LCTRL    0x04
+#define KB_MOD_RCTRL    0x08
+#define KB_MOD_LALT     0x10
+#define KB_MOD_RALT     0x20    /* AltGr */
+#define KB_MOD_SHIFT    (KB_MOD_LSHIFT | KB_MOD_RSHIFT)
+#define KB_MOD_CTRL     (KB_MOD_LCTRL | KB_MOD_RCTRL)
+#define KB_MOD_ALT      (KB_MOD_LALT | KB_MOD_RALT)
+
+/* Set 1 scancodes */
+#define KB_SC_EXTENDED  0xE0    /* Prefix for right Ctrl/Alt, arrows, ... */
+#define KB_SC_RELEASE   0x80    /* Set on key release */
+#define KB_SC_F1        0x3B    /* F1..F4 are consecutive */
+
 /* Keyboard buffer */
 #define KB_BUFFER_SIZE  256
 extern volatile uint8_t kb_buffer[KB_BUFFER_SIZE];
@@ -30,6 +46,7 @@ void keyboard_wait_for_input(void);
 void keyboard_irq_handler(uint8_t scancode);
 int keyboard_has_data(void);
 uint8_t keyboard_get_char(void);
+uint8_t keyboard_modifiers(void);
 
 #endif /* KEYBOARD_H */
 
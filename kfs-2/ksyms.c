@@ -0,0 +1,83 @@
+#include "ksyms.h"
+#include <stddef.h>
+
+int ksym_lookup(uint32_t addr, uint32_t *offset) {
+    if (ksyms_count == 0 ||
+        addr < (uint32_t)_text_start || addr >= (uint32_t)_text_end ||
+        addr < ksyms_addrs[0]) {
+        return -1;
+    }
+
+    /* Largest index with ksyms_addrs[index] <= addr */
+    uint32_t lo = 0, hi = ksyms_count;
+    while (hi - lo > 1) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (ksyms_addrs[mid] <= addr) lo = mid;
+        else hi = mid;
+    }
+
+    if (offset) *offset = addr - ksyms_addrs[lo];
+    return (int)lo;
+}
+
+const char *ksym_name(int index, char *buf, uint32_t len) {
+    if (len == 0) return buf;
+    buf[0] = '\0';
+    if (index < 0 || (uint32_t)index >= ksyms_count) return buf;
+
+    /* Replay front coding from the start of the block */
+    const uint8_t *p = ksyms_names + ksyms_blocks[index / KSYMS_BLOCK];
+    uint32_t n = 0;
+
+    for (uint32_t i = (uint32_t)index & ~(KSYMS_BLOCK - 1); i <= (uint32_t)index; i++) {
+        uint32_t prefix = p[0], suffix = p[1];
+        p += 2;
+
+        n = prefix < len - 1 ? prefix : len - 1;
+        for (uint32_t k = 0; k < suffix; k++) {
+            if (n < len - 1) buf[n++] = (char)p[k];
+        }
+        p += suffix;
+    }
+    buf[n] = '\0';
+    return buf;
+}
+
+/* Append the hex digits of v without leading zeros */
+static uint32_t ksym_hex(char *buf, uint32_t pos, uint32_t len, uint32_t v) {
+    static const char digits[] = "0123456789abcdef";
+    int shift = 28;
+
+    while (shift > 0 && ((v >> shift) & 0xF) == 0) shift -= 4;
+    for (; shift >= 0 && pos < len - 1; shift -= 4) {
+        buf[pos++] = digits[(v >> shift) & 0xF];
+    }
+    return pos;
+}
+
+const char *ksym_format(uint32_t addr, char *buf, uint32_t len) {
+    uint32_t offset, pos;
+    int index = ksym_lookup(addr, &offset);
+
+    if (len < 4) {
+        if (len) buf[0] = '\0';
+        return buf;
+    }
+
+    if (index >= 0) {
+        ksym_name(index, buf, len);
+        for (pos = 0; buf[pos]; pos++) {}
+        if (pos + 3 < len) {
+            buf[pos++] = '+';
+            buf[pos++] = '0';
+            buf[pos++] = 'x';
+            pos = ksym_hex(buf, pos, len, offset);
+        }
+    } else {
+        buf[0] = '0';
+        buf[1] = 'x';
+        pos = ksym_hex(buf, 2, len, addr);
+    }
+    buf[pos] = '\0';
+    return buf;
+}
@@ -0,0 +1,52 @@
+#ifndef KSYMS_H
+#define KSYMS_H
+
+#include <stdint.h>
+
+/*
+ * Embedded kernel symbol table.
+ *
+ * Generated at build time from `nm -n` output of a first link pass
+ * (tools/gen_ksyms.py) and linked into the dedicated .ksyms section.
+ * Layout:
+ *
+ *   ksyms_addrs[]   function start addresses, ascending (binary search)
+ *   ksyms_names[]   names in the same order, front-coded: each entry is
+ *                   <shared prefix len> <suffix len> <suffix bytes>,
+ *                   the prefix taken from the previous name
+ *   ksyms_blocks[]  offset in ksyms_names of every KSYMS_BLOCK-th entry;
+ *                   these entries restart with a zero-length prefix
+ *
+ * ksym_lookup() only touches ksyms_addrs and is safe in IRQ context;
+ * names are decoded on demand by ksym_name().
+ */
+
+#define KSYMS_BLOCK     16
+#define KSYM_NAME_LEN   128
+
+/* Place generated table data into .ksyms */
+#define __ksyms __attribute__((section(".ksyms"), used))
+
+extern const uint32_t ksyms_count;
+extern const uint32_t ksyms_addrs[];
+extern const uint32_t ksyms_blocks[];
+extern const uint8_t ksyms_names[];
+
+/* Linker-provided bounds of .text */
+extern char _text_start[];
+extern char _text_end[];
+
+/*
+ * Find the function containing addr by binary search.
+ * Returns its symbol index and stores addr - function start in *offset
+ * (if offset is not NULL), or returns -1 if addr is outside kernel text.
+ */
+int ksym_lookup(uint32_t addr, uint32_t *offset);
+
+/* Decode the name of symbol index into buf (len bytes); returns buf */
+const char *ksym_name(int index, char *buf, uint32_t len);
+
+/* Format addr as "func+0xoff" (or "0x<addr>" if unknown) into buf */
+const char *ksym_format(uint32_t addr, char *buf, uint32_t len);
+
+#endif /* KSYMS_H */
@@ -1,4 +1,5 @@
 #include "lib.h" // Прототипы функций стандартной библиотеки ядра
+#include "compiler.h" // __hot
 
 size_t strlen(const char *str) { // Подсчёт длины строки до нулевого терминатора
     size_t len = 0; // Счётчик символов
@@ -19,9 +20,18 @@ void *memset(void *dest, int val, size_t len) { // Заполнение памя
     return dest; // Возвращаем начало области
 }
 
-void *memcpy(void *dest, const void *src, size_t len) { // Копирование памяти из src в dest (байтово)
+void __hot *memcpy(void *dest, const void *src, size_t len) { // Копирование памяти из src в dest (байтово)
     unsigned char *d = dest; // Назначение
     const unsigned char *s = src; // Источник
     while (len--) *d++ = *s++; // Копируем len байт подряд
     return dest; // Возвращаем dest для цепочек вызовов
 }
+
+int atoi(const char *str) { // Разбор десятичного числа: пробелы, знак, цифры
+    unsigned int value = 0; // Накапливаем без знака, чтобы не было переполнения int
+    int negative = 0; // Флаг отрицательного числа
+    while (*str == ' ' || *str == '\t') str++; // Пропускаем ведущие пробелы
+    if (*str == '-' || *str == '+') negative = (*str++ == '-'); // Необязательный знак
+    while (*str >= '0' && *str <= '9') value = value * 10 + (unsigned int)(*str++ - '0'); // Цифры
+    return negative ? (int)(0u - value) : (int)value; // Применяем знак
+}
@@ -7,5 +7,6 @@ size_t strlen(const char *str); // Возвращает длину строки
 int strcmp(const char *a, const char *b); // Сравнивает две строки, возвращает разницу
 void *memset(void *dest, int val, size_t len); // Заполняет len байт по адресу dest значением val
 void *memcpy(void *dest, const void *src, size_t len); // Копирует len байт из src в dest
+int atoi(const char *str); // Преобразует десятичную строку (с необязательным знаком) в int
 
 #endif // LIB_H
@@ -0,0 +1,53 @@
+#include "module.h"
+#include "printk.h"
+#include "lib.h"
+
+static struct module modules[MODULE_MAX];
+static uint32_t modules_count;
+
+/* GRUB 2 passes the words after the path, GRUB legacy the path too, so
+ * the name is the last word either way */
+static const char *module_name(const char *cmdline) {
+    const char *word = cmdline;
+
+    for (const char *p = cmdline; *p; p++) {
+        if (*p == ' ' && p[1] && p[1] != ' ') word = p + 1;
+    }
+    return word;
+}
+
+void module_init(const struct multiboot_info *mbi) {
+    modules_count = 0;
+    if (!(mbi->flags & MULTIBOOT_INFO_MODS)) return;
+
+    const struct multiboot_module *mods = (const struct multiboot_module *)mbi->mods_addr;
+    for (uint32_t i = 0; i < mbi->mods_count && modules_count < MODULE_MAX; i++) {
+        struct module *m = &modules[modules_count++];
+        m->start = (const uint8_t *)mods[i].mod_start;
+        m->size = mods[i].mod_end - mods[i].mod_start;
+        m->cmdline = mods[i].cmdline ? (const char *)mods[i].cmdline : "";
+        m->name = module_name(m->cmdline);
+    }
+}
+
+const struct module *module_find(const char *name) {
+    for (uint32_t i = 0; i < modules_count; i++) {
+        if (strcmp(modules[i].name, name) == 0) return &modules[i];
+    }
+    return NULL;
+}
+
+void cmd_lsmod(int argc, char *argv[]) {
+    (void)argc;
+    (void)argv;
+
+    if (modules_count == 0) {
+        printk("No modules\n");
+        return;
+    }
+    for (uint32_t i = 0; i < modules_count; i++) {
+        const struct module *m = &modules[i];
+        printk("%-10s 0x%08x-0x%08x %8u bytes  %s\n", m->name, (uint32_t)m->start,
+               (uint32_t)m->start + m->size, m->size, m->cmdline);
+    }
+}
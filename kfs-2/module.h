@@ -0,0 +1,34 @@
+#ifndef MODULE_H
+#define MODULE_H
+
+#include <stdint.h>
+#include "multiboot.h"
+
+/*
+ * Multiboot modules: files GRUB loads next to the kernel ("module" lines
+ * in grub.cfg).  boot.asm asks for them to be page aligned.  Modules
+ * stay where GRUB put them and are used in place; each is named by the
+ * last word of its command line:
+ *
+ *   module /boot/initramfs.tar initramfs     ->  "initramfs"
+ */
+
+#define MODULE_MAX  16
+
+struct module {
+    const uint8_t *start;
+    uint32_t size;
+    const char *name;               /* Last word of cmdline */
+    const char *cmdline;
+};
+
+/* Record the modules passed in mbi; call once, early in kmain */
+void module_init(const struct multiboot_info *mbi);
+
+/* Module by name, NULL if not loaded */
+const struct module *module_find(const char *name);
+
+/* Shell command: lsmod */
+void cmd_lsmod(int argc, char *argv[]);
+
+#endif /* MODULE_H */
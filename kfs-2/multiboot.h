@@ -0,0 +1,43 @@
+#ifndef MULTIBOOT_H
+#define MULTIBOOT_H
+
+#include <stdint.h>
+
+/* Multiboot v1 boot information (see the Multiboot 0.6.96 specification) */
+
+#define MULTIBOOT_BOOTLOADER_MAGIC  0x2BADB002
+
+/* multiboot_info.flags: which fields below are valid */
+#define MULTIBOOT_INFO_MEMORY       0x00000001
+#define MULTIBOOT_INFO_BOOTDEV      0x00000002
+#define MULTIBOOT_INFO_CMDLINE      0x00000004
+#define MULTIBOOT_INFO_MODS         0x00000008
+#define MULTIBOOT_INFO_MEM_MAP      0x00000040
+
+struct multiboot_info {
+    uint32_t flags;
+    uint32_t mem_lower;         /* KB below 1 MB */
+    uint32_t mem_upper;         /* KB above 1 MB */
+    uint32_t boot_device;
+    uint32_t cmdline;           /* Physical address of NUL-terminated string */
+    uint32_t mods_count;
+    uint32_t mods_addr;
+    uint32_t syms[4];
+    uint32_t mmap_length;
+    uint32_t mmap_addr;
+    uint32_t drives_length;
+    uint32_t drives_addr;
+    uint32_t config_table;
+    uint32_t boot_loader_name;
+    uint32_t apm_table;
+} __attribute__((packed));
+
+/* Entry of the mods_addr array: one per GRUB "module" line */
+struct multiboot_module {
+    uint32_t mod_start;         /* Physical address of the first byte */
+    uint32_t mod_end;           /* One past the last byte */
+    uint32_t cmdline;           /* Module command line (the rest of the line) */
+    uint32_t reserved;
+} __attribute__((packed));
+
+#endif /* MULTIBOOT_H */
@@ -0,0 +1,191 @@
+#include "pci.h"
+#include "io.h"
+#include "printk.h"
+
+#define PCI_MAX_DEPTH   8       /* Nested bridges followed */
+
+uint32_t pci_config_read32(uint8_t bus, uint8_t slot, uint8_t func, uint8_t offset) {
+    outl(PCI_CONFIG_ADDRESS, 0x80000000u | ((uint32_t)bus << 16) | ((uint32_t)slot << 11) |
+                             ((uint32_t)func << 8) | (offset & 0xFC));
+    return inl(PCI_CONFIG_DATA);
+}
+
+void pci_config_write32(uint8_t bus, uint8_t slot, uint8_t func, uint8_t offset, uint32_t val) {
+    outl(PCI_CONFIG_ADDRESS, 0x80000000u | ((uint32_t)bus << 16) | ((uint32_t)slot << 11) |
+                             ((uint32_t)func << 8) | (offset & 0xFC));
+    outl(PCI_CONFIG_DATA, val);
+}
+
+uint16_t pci_read16(const struct pci_dev *dev, uint8_t offset) {
+    uint32_t v = pci_config_read32(dev->bus, dev->slot, dev->func, offset);
+    return (uint16_t)(v >> ((offset & 2) * 8));
+}
+
+void pci_write16(const struct pci_dev *dev, uint8_t offset, uint16_t val) {
+    uint32_t v = pci_config_read32(dev->bus, dev->slot, dev->func, offset);
+    int shift = (offset & 2) * 8;
+
+    v = (v & ~(0xFFFFu << shift)) | ((uint32_t)val << shift);
+    pci_config_write32(dev->bus, dev->slot, dev->func, offset, v);
+}
+
+void pci_enable(const struct pci_dev *dev, uint16_t bits) {
+    uint16_t cmd = pci_read16(dev, PCI_COMMAND);
+    if ((cmd & bits) != bits) pci_write16(dev, PCI_COMMAND, cmd | bits);
+}
+
+uint16_t pci_bar_io(const struct pci_dev *dev, int n) {
+    if (n < 0 || n >= PCI_NR_BARS || !(dev->bar[n] & PCI_BAR_IO)) return 0;
+    return (uint16_t)(dev->bar[n] & ~3u);
+}
+
+uint32_t pci_bar_mem(const struct pci_dev *dev, int n) {
+    if (n < 0 || n >= PCI_NR_BARS || (dev->bar[n] & PCI_BAR_IO)) return 0;
+    if ((dev->bar[n] & 0x6) == PCI_BAR_MEM_64 && (n + 1 == PCI_NR_BARS || dev->bar[n + 1])) return 0;
+    return dev->bar[n] & ~0xFu;
+}
+
+uint32_t pci_bar_size(const struct pci_dev *dev, int n) {
+    uint8_t offset = (uint8_t)(PCI_BAR0 + 4 * n);
+    uint16_t cmd = pci_read16(dev, PCI_COMMAND);
+
+    /* Decoding is off while the BAR holds the sizing pattern */
+    pci_write16(dev, PCI_COMMAND, cmd & ~(PCI_COMMAND_IO | PCI_COMMAND_MEMORY));
+    uint32_t orig = pci_config_read32(dev->bus, dev->slot, dev->func, offset);
+    pci_config_write32(dev->bus, dev->slot, dev->func, offset, 0xFFFFFFFFu);
+    uint32_t mask = pci_config_read32(dev->bus, dev->slot, dev->func, offset);
+    pci_config_write32(dev->bus, dev->slot, dev->func, offset, orig);
+    pci_write16(dev, PCI_COMMAND, cmd);
+
+    if (orig & PCI_BAR_IO) mask = (mask & ~3u) | 0xFFFF0000u;   /* 16-bit decode */
+    else mask &= ~0xFu;
+    return mask ? ~mask + 1 : 0;
+}
+
+static int pci_scan_bus(uint8_t bus, int depth, pci_visit_fn fn, void *ctx);
+
+/* Read the header of one function; returns 0 if nothing answers */
+static int pci_probe(uint8_t bus, uint8_t slot, uint8_t func, struct pci_dev *dev) {
+    uint32_t id = pci_config_read32(bus, slot, func, PCI_VENDOR_ID);
+
+    if ((id & 0xFFFF) == 0xFFFF) return 0;
+
+    uint32_t class_rev = pci_config_read32(bus, slot, func, PCI_CLASS_REVISION);
+    uint32_t misc = pci_config_read32(bus, slot, func, PCI_HEADER_TYPE & 0xFC);
+
+    dev->bus = bus;
+    dev->slot = slot;
+    dev->func = func;
+    dev->vendor = (uint16_t)id;
+    dev->device = (uint16_t)(id >> 16);
+    dev->class_code = (uint8_t)(class_rev >> 24);
+    dev->subclass = (uint8_t)(class_rev >> 16);
+    dev->prog_if = (uint8_t)(class_rev >> 8);
+    dev->header_type = (uint8_t)(misc >> 16);
+    dev->irq_line = 0;
+    for (int i = 0; i < PCI_NR_BARS; i++) dev->bar[i] = 0;
+
+    if ((dev->header_type & 0x7F) == 0) {
+        for (int i = 0; i < PCI_NR_BARS; i++) {
+            dev->bar[i] = pci_config_read32(bus, slot, func, (uint8_t)(PCI_BAR0 + 4 * i));
+        }
+        dev->irq_line = (uint8_t)pci_config_read32(bus, slot, func, PCI_INTERRUPT_LINE);
+    }
+    return 1;
+}
+
+static int pci_scan_function(const struct pci_dev *dev, int depth, pci_visit_fn fn, void *ctx) {
+    int ret = fn(dev, ctx);
+    if (ret) return ret;
+
+    /* PCI-to-PCI bridge: walk the bus behind it */
+    if (dev->class_code == 0x06 && dev->subclass == 0x04 && depth < PCI_MAX_DEPTH) {
+        uint8_t secondary = (uint8_t)(pci_config_read32(dev->bus, dev->slot, dev->func,
+                                                        PCI_SECONDARY_BUS & 0xFC) >> 8);
+        if (secondary > dev->bus) return pci_scan_bus(secondary, depth + 1, fn, ctx);
+    }
+    return 0;
+}
+
+static int pci_scan_bus(uint8_t bus, int depth, pci_visit_fn fn, void *ctx) {
+    struct pci_dev dev;
+
+    for (uint8_t slot = 0; slot < 32; slot++) {
+        if (!pci_probe(bus, slot, 0, &dev)) continue;
+
+        int ret = pci_scan_function(&dev, depth, fn, ctx);
+        if (ret) return ret;
+
+        if (!(dev.header_type & 0x80)) continue;   /* Single-function device */
+        for (uint8_t func = 1; func < 8; func++) {
+            if (!pci_probe(bus, slot, func, &dev)) continue;
+            ret = pci_scan_function(&dev, depth, fn, ctx);
+            if (ret) return ret;
+        }
+    }
+    return 0;
+}
+
+int pci_enumerate(pci_visit_fn fn, void *ctx) {
+    return pci_scan_bus(0, 0, fn, ctx);
+}
+
+struct pci_match {
+    uint16_t vendor;
+    uint16_t device;
+    struct pci_dev *out;
+};
+
+static int pci_match_visit(const struct pci_dev *dev, void *ctx) {
+    struct pci_match *m = ctx;
+
+    if (dev->vendor != m->vendor || dev->device != m->device) return 0;
+    *m->out = *dev;
+    return 1;
+}
+
+int pci_find_device(uint16_t vendor, uint16_t device, struct pci_dev *dev) {
+    struct pci_match m = { vendor, device, dev };
+    return pci_enumerate(pci_match_visit, &m) ? 0 : -1;
+}
+
+struct pci_class_match {
+    uint8_t class_code;
+    uint8_t subclass;
+    uint8_t prog_if;
+    struct pci_dev *out;
+};
+
+static int pci_class_visit(const struct pci_dev *dev, void *ctx) {
+    struct pci_class_match *m = ctx;
+
+    if (dev->class_code != m->class_code || dev->subclass != m->subclass ||
+        dev->prog_if != m->prog_if) return 0;
+    *m->out = *dev;
+    return 1;
+}
+
+int pci_find_class(uint8_t class_code, uint8_t subclass, uint8_t prog_if, struct pci_dev *dev) {
+    struct pci_class_match m = { class_code, subclass, prog_if, dev };
+    return pci_enumerate(pci_class_visit, &m) ? 0 : -1;
+}
+
+static int lspci_visit(const struct pci_dev *dev, void *ctx) {
+    (void)ctx;
+    printk("%02x:%02x.%d  %04x:%04x  class %02x%02x%02x  irq %d\n",
+           dev->bus, dev->slot, dev->func, dev->vendor, dev->device,
+           dev->class_code, dev->subclass, dev->prog_if, dev->irq_line);
+    for (int i = 0; i < PCI_NR_BARS; i++) {
+        if (!dev->bar[i]) continue;
+        if (dev->bar[i] & PCI_BAR_IO) printk("    BAR%d  io  0x%04x\n", i, dev->bar[i] & ~3u);
+        else printk("    BAR%d  mem 0x%08x\n", i, dev->bar[i] & ~0xFu);
+    }
+    return 0;
+}
+
+void cmd_lspci(int argc, char *argv[]) {
+    (void)argc;
+    (void)argv;
+
+    pci_enumerate(lspci_visit, NULL);
+}
@@ -0,0 +1,85 @@
+#ifndef PCI_H
+#define PCI_H
+
+#include <stdint.h>
+
+/*
+ * PCI configuration space through configuration mechanism #1 (ports
+ * 0xCF8/0xCFC).  Buses are discovered by following PCI-to-PCI bridges
+ * from bus 0 instead of probing all 256 of them, which keeps the number
+ * of config accesses (VM exits under QEMU) at boot small.
+ */
+
+#define PCI_CONFIG_ADDRESS  0xCF8
+#define PCI_CONFIG_DATA     0xCFC
+
+/* Configuration header offsets */
+#define PCI_VENDOR_ID       0x00
+#define PCI_DEVICE_ID       0x02
+#define PCI_COMMAND         0x04
+#define PCI_STATUS          0x06
+#define PCI_CLASS_REVISION  0x08
+#define PCI_HEADER_TYPE     0x0E
+#define PCI_BAR0            0x10
+#define PCI_SECONDARY_BUS   0x19
+#define PCI_CAPABILITY_LIST 0x34
+#define PCI_INTERRUPT_LINE  0x3C
+
+/* Command register bits */
+#define PCI_COMMAND_IO      0x0001
+#define PCI_COMMAND_MEMORY  0x0002
+#define PCI_COMMAND_MASTER  0x0004
+
+#define PCI_BAR_IO          0x1
+#define PCI_BAR_MEM_64      0x4     /* Memory BAR type 2: uses the next BAR too */
+#define PCI_NR_BARS         6
+
+struct pci_dev {
+    uint8_t bus;
+    uint8_t slot;
+    uint8_t func;
+    uint8_t header_type;
+    uint16_t vendor;
+    uint16_t device;
+    uint8_t class_code;
+    uint8_t subclass;
+    uint8_t prog_if;
+    uint8_t irq_line;
+    uint32_t bar[PCI_NR_BARS];      /* Raw BAR values (type 0 headers only) */
+};
+
+uint32_t pci_config_read32(uint8_t bus, uint8_t slot, uint8_t func, uint8_t offset);
+void pci_config_write32(uint8_t bus, uint8_t slot, uint8_t func, uint8_t offset, uint32_t val);
+
+uint16_t pci_read16(const struct pci_dev *dev, uint8_t offset);
+void pci_write16(const struct pci_dev *dev, uint8_t offset, uint16_t val);
+
+/* Set bits in the command register (PCI_COMMAND_*) */
+void pci_enable(const struct pci_dev *dev, uint16_t bits);
+
+/* I/O port base of BAR n, or 0 if it is not an I/O BAR */
+uint16_t pci_bar_io(const struct pci_dev *dev, int n);
+
+/* Physical address of memory BAR n, or 0 if it is not a memory BAR or a
+ * 64-bit BAR placed above 4 GB (unreachable without PAE) */
+uint32_t pci_bar_mem(const struct pci_dev *dev, int n);
+
+/* Size in bytes of BAR n, found by writing all ones to it */
+uint32_t pci_bar_size(const struct pci_dev *dev, int n);
+
+/* Call fn for every function present; a non-zero return stops the walk
+ * and is returned */
+typedef int (*pci_visit_fn)(const struct pci_dev *dev, void *ctx);
+int pci_enumerate(pci_visit_fn fn, void *ctx);
+
+/* Find the first vendor:device function.  Returns 0 and fills *dev, or
+ * -1 if there is none. */
+int pci_find_device(uint16_t vendor, uint16_t device, struct pci_dev *dev);
+
+/* Find the first function of a class/subclass/programming interface */
+int pci_find_class(uint8_t class_code, uint8_t subclass, uint8_t prog_if, struct pci_dev *dev);
+
+/* Shell command: lspci */
+void cmd_lspci(int argc, char *argv[]);
+
+#endif /* PCI_H */
@@ -1,5 +1,6 @@
 #include "pic.h"
 #include "lib.h"
+#include "init.h"
 
 /* I/O Port operations */
 static inline void outb(uint16_t port, uint8_t value) {
@@ -16,7 +17,7 @@ static inline uint8_t inb(uint16_t port) {
  * Initialize the 8259A Programmable Interrupt Controller
  * Maps IRQs 0-7 (master) and 8-15 (slave) to ISRs 32-47
  */
-void pic_init(void) {
+void __init pic_init(void) {
     /* Start initialization sequence with ICW1 */
     outb(PIC_MASTER_CMD, ICW1);
     outb(PIC_SLAVE_CMD, ICW1);
@@ -0,0 +1,121 @@
+#include "pmm.h"
+#include "lib.h"
+
+#define PMM_RESERVED    0xFFFF              /* frame_refs[] value */
+
+extern uint8_t _kernel_end[];               /* linker.ld */
+
+static uint16_t frame_refs[PMM_FRAMES];
+static uint32_t free_stack[PMM_FRAMES];
+static uint32_t free_top;
+static uint32_t total_frames;
+
+static void reserve(uint32_t start, uint32_t end) {
+    uint32_t last = (end + PAGE_SIZE - 1) >> PAGE_SHIFT;
+
+    if (end <= start) return;
+    for (uint32_t f = start >> PAGE_SHIFT; f < last && f < PMM_FRAMES; f++) {
+        frame_refs[f] = PMM_RESERVED;
+    }
+}
+
+static void reserve_string(uint32_t s) {
+    if (s) reserve(s, s + (uint32_t)strlen((const char *)s) + 1);
+}
+
+void pmm_init(const struct multiboot_info *mbi) {
+    /* Without a memory size only trust what the kernel already uses */
+    uint32_t top = (uint32_t)_kernel_end;
+
+    if (mbi->flags & MULTIBOOT_INFO_MEMORY) {
+        top = mbi->mem_upper < (PMM_LIMIT - 0x100000) / 1024 ?
+              0x100000 + mbi->mem_upper * 1024 : PMM_LIMIT;
+    }
+
+    reserve(0, 0x100000);
+    reserve(top & PAGE_MASK, PMM_LIMIT);
+    reserve(0x100000, (uint32_t)_kernel_end);
+    reserve((uint32_t)mbi, (uint32_t)mbi + sizeof(*mbi));
+    if (mbi->flags & MULTIBOOT_INFO_CMDLINE) reserve_string(mbi->cmdline);
+    if (mbi->flags & MULTIBOOT_INFO_MODS) {
+        const struct multiboot_module *mods = (const struct multiboot_module *)mbi->mods_addr;
+        reserve(mbi->mods_addr, mbi->mods_addr + mbi->mods_count * sizeof(*mods));
+        for (uint32_t i = 0; i < mbi->mods_count; i++) {
+            reserve(mods[i].mod_start, mods[i].mod_end);
+            reserve_string(mods[i].cmdline);
+        }
+    }
+
+    /* Pushed from the top, so allocation starts with the lowest frames */
+    free_top = 0;
+    for (uint32_t f = PMM_FRAMES; f-- > 0;) {
+        if (frame_refs[f] == 0) free_stack[free_top++] = f;
+    }
+    total_frames = free_top;
+}
+
+uint32_t pmm_alloc(void) {
+    if (free_top == 0) return 0;
+
+    uint32_t f = free_stack[--free_top];
+    frame_refs[f] = 1;
+    return f << PAGE_SHIFT;
+}
+
+void pmm_get(uint32_t phys) {
+    uint32_t f = phys >> PAGE_SHIFT;
+
+    if (f < PMM_FRAMES && frame_refs[f] != PMM_RESERVED) frame_refs[f]++;
+}
+
+void pmm_put(uint32_t phys) {
+    uint32_t f = phys >> PAGE_SHIFT;
+
+    if (f >= PMM_FRAMES || frame_refs[f] == PMM_RESERVED || frame_refs[f] == 0) return;
+    if (--frame_refs[f] == 0) free_stack[free_top++] = f;
+}
+
+uint32_t pmm_release(uint32_t start, uint32_t end) {
+    uint32_t first = (start + PAGE_SIZE - 1) >> PAGE_SHIFT;
+    uint32_t last = end >> PAGE_SHIFT;
+    uint32_t n = 0;
+
+    if (last > PMM_FRAMES) last = PMM_FRAMES;
+    for (uint32_t f = first; f < last; f++) {
+        if (frame_refs[f] == PMM_RESERVED) n++;
+    }
+    if (n == 0) return 0;
+
+    /* Make room at the bottom of the stack */
+    for (uint32_t i = free_top; i-- > 0;) free_stack[i + n] = free_stack[i];
+    free_top += n;
+    total_frames += n;
+
+    uint32_t slot = 0;
+    for (uint32_t f = first; f < last; f++) {
+        if (frame_refs[f] != PMM_RESERVED) continue;
+        frame_refs[f] = 0;
+        free_stack[slot++] = f;
+    }
+    return n;
+}
+
+uint32_t pmm_refcount(uint32_t phys) {
+    uint32_t f = phys >> PAGE_SHIFT;
+
+    return f < PMM_FRAMES && frame_refs[f] != PMM_RESERVED ? frame_refs[f] : 0;
+}
+
+int pmm_managed(uint32_t phys) {
+    uint32_t f = phys >> PAGE_SHIFT;
+
+    return f < PMM_FRAMES && frame_refs[f] != PMM_RESERVED;
+}
+
+uint32_t pmm_free_frames(void) {
+    return free_top;
+}
+
+uint32_t pmm_total_frames(void) {
+    return total_frames;
+}
@@ -0,0 +1,53 @@
+#ifndef PMM_H
+#define PMM_H
+
+#include <stdint.h>
+#include "multiboot.h"
+
+/*
+ * Physical frame database.
+ *
+ * Every 4 KB frame of RAM below PMM_LIMIT has a reference count.  The
+ * first megabyte, the kernel image, the Multiboot structures and the
+ * modules are reserved: they are never handed out, and mapping them
+ * (module pages mapped into user space) does not count references.
+ * Free frames sit on a stack, so allocating and freeing are O(1).
+ *
+ * Frames are identity mapped, so a frame's physical address is also a
+ * pointer the kernel can use.  Not for interrupt context.
+ */
+
+#define PAGE_SIZE       4096
+#define PAGE_SHIFT      12
+#define PAGE_MASK       (~(PAGE_SIZE - 1))
+
+#define PMM_LIMIT       0x08000000          /* RAM above this is not used */
+#define PMM_FRAMES      (PMM_LIMIT / PAGE_SIZE)
+
+/* Build the free stack from the Multiboot memory size, minus the
+ * reserved ranges; call after module_init() */
+void pmm_init(const struct multiboot_info *mbi);
+
+/* A frame with one reference (contents undefined); 0 if none is free */
+uint32_t pmm_alloc(void);
+
+/* Take / drop a reference; the frame is freed when the last one goes.
+ * Both ignore reserved frames. */
+void pmm_get(uint32_t phys);
+void pmm_put(uint32_t phys);
+
+/* Give the reserved frames wholly inside [start, end) to the allocator
+ * (freed boot-time memory, init.h).  They go to the bottom of the free
+ * stack, so they are handed out last.  Returns the number of frames. */
+uint32_t pmm_release(uint32_t start, uint32_t end);
+
+/* References to the frame at phys; 0 if free or reserved */
+uint32_t pmm_refcount(uint32_t phys);
+
+/* 1 if phys is a frame pmm_alloc() can hand out (i.e. refcounted) */
+int pmm_managed(uint32_t phys);
+
+uint32_t pmm_free_frames(void);
+uint32_t pmm_total_frames(void);
+
+#endif /* PMM_H */
@@ -1,5 +1,16 @@
 #include "printk.h"
 #include "lib.h"
+#include "ksyms.h"
+#include "tsc.h"
+#include "div64.h"
+#include "bench.h"
+#include "printf.h"
+#include "format.h"
+#include "compiler.h"
+
+/* Kernel stack bounds (boot.asm) */
+extern char stack_space[];
+extern char stack_end[];
 
 /* Serial port I/O functions (from kernel.c) */
 static inline void outb(uint16_t port, uint8_t val) {
@@ -12,6 +23,11 @@ static inline uint8_t inb(uint16_t port) {
     return ret;
 }
 
+static int serial_ready;
+static uint8_t serial_ier;      /* Interrupts wanted once the port is set up */
+
+/* Resident, not __init: the first serial write or serial_rx_irq_enable()
+ * sets the port up, whenever that happens */
 static void serial_init(void) {
     const uint16_t base = 0x3F8;
     outb(base + 1, 0x00);
@@ -21,146 +37,184 @@ static void serial_init(void) {
     outb(base + 3, 0x03);
     outb(base + 2, 0xC7);
     outb(base + 4, 0x0B);
+    outb(base + 1, serial_ier);
+    serial_ready = 1;
+}
+
+void serial_rx_irq_enable(void) {
+    serial_ier = 0x01;          /* Received data available */
+    if (serial_ready) outb(0x3F8 + 1, serial_ier);
+    else serial_init();
 }
 
+uint32_t serial_port_io;
+
 static void serial_write_char(char c) {
     const uint16_t base = 0x3F8;
-    while ((inb(base + 5) & 0x20) == 0) {}
+    do {
+        serial_port_io++;
+    } while ((inb(base + 5) & 0x20) == 0);
     outb(base + 0, (uint8_t)c);
+    serial_port_io++;
 }
 
-static void serial_write(const char *s) {
-    for (; *s; ++s) {
-        if (*s == '\n') serial_write_char('\r');
-        serial_write_char(*s);
+static void serial_write(const char *s, size_t len) {
+    if (!serial_ready) serial_init();
+    
+    for (size_t i = 0; i < len; i++) {
+        if (s[i] == '\n') serial_write_char('\r');
+        serial_write_char(s[i]);
     }
 }
 
-/* Convert integer to hex string */
-static void itohex(uint32_t value, char *buffer, int width) {
-    const char *hex_chars = "0123456789ABCDEF";
-    int i = width - 1;
-    
-    while (i >= 0) {
-        buffer[i] = hex_chars[value & 0xF];
-        value >>= 4;
-        i--;
-    }
-    buffer[width] = '\0';
+static struct printk_sink serial_sink = {
+    .name  = "serial",
+    .write = serial_write,
+    .flush = NULL,
+    .level = LOGLEVEL_DEBUG,
+    .enabled = 1,
+};
+
+/* Registered sinks; COM1 is always available */
+static struct printk_sink *sinks[PRINTK_MAX_SINKS] = { &serial_sink };
+static int sinks_count = 1;
+
+int printk_register_sink(struct printk_sink *sink) {
+    if (sinks_count == PRINTK_MAX_SINKS) return -1;
+    sinks[sinks_count++] = sink;
+    return 0;
 }
 
-/* Convert integer to decimal string */
-static void itodec(int32_t value, char *buffer) {
-    if (value < 0) {
-        *buffer++ = '-';
-        value = -value;
+struct printk_sink *printk_sink_find(const char *name) {
+    for (int i = 0; i < sinks_count; i++) {
+        if (strcmp(sinks[i]->name, name) == 0) return sinks[i];
     }
-    
-    char temp[12];
-    int i = 0;
-    
-    if (value == 0) {
-        temp[i++] = '0';
-    } else {
-        while (value > 0) {
-            temp[i++] = '0' + (value % 10);
-            value /= 10;
-        }
+    return NULL;
+}
+
+/* Pass one chunk to every sink selected in mask */
+static void emit(uint32_t mask, const char *s, size_t len) {
+    for (int i = 0; mask; i++, mask >>= 1) {
+        if (mask & 1) sinks[i]->write(s, len);
     }
+}
+
+static void emit_chunk(void *ctx, const char *s, size_t len) {
+    emit(*(uint32_t *)ctx, s, len);
+}
+
+/* Sinks that take a message at level */
+static uint32_t sink_mask(int level) {
+    uint32_t mask = 0;
     
-    while (i > 0) {
-        *buffer++ = temp[--i];
+    for (int i = 0; i < sinks_count; i++) {
+        if (sinks[i]->enabled && level <= sinks[i]->level) mask |= 1u << i;
     }
-    *buffer = '\0';
+    return mask;
 }
 
-/* Simple printk implementation with format support */
-void printk(const char *fmt, ...) {
-    static int initialized = 0;
-    if (!initialized) {
-        serial_init();
-        initialized = 1;
+static void flush_sinks(uint32_t mask) {
+    for (int i = 0; mask; i++, mask >>= 1) {
+        if ((mask & 1) && sinks[i]->flush) sinks[i]->flush();
     }
+}
+
+void printk_writev(const struct printk_vec *vec, int n) {
+    uint32_t mask = sink_mask(LOGLEVEL_DEFAULT);
     
-    va_list args;
-    va_start(args, fmt);
+    if (!mask) return;
+    for (int i = 0; i < n; i++) emit(mask, vec[i].buf, vec[i].len);
+    flush_sinks(mask);
+}
+
+/*
+ * Streaming printk: vformat() hands over literal runs of the format
+ * string in place and each conversion from a small stack buffer, so
+ * messages of any length go out without copying or truncation.
+ */
+void __hot vprintk(const char *fmt, va_list args) {
+    int level = LOGLEVEL_DEFAULT;
     
-    char buffer[256];
-    int buf_pos = 0;
-    
-    while (*fmt && buf_pos < 255) {
-        if (*fmt == '%' && *(fmt + 1)) {
-            fmt++;
-            if (*fmt == 'd') {
-                int val = va_arg(args, int);
-                char temp[12];
-                itodec(val, temp);
-                const char *p = temp;
-                while (*p && buf_pos < 255) {
-                    buffer[buf_pos++] = *p++;
-                }
-            } else if (*fmt == 'x') {
-                uint32_t val = va_arg(args, uint32_t);
-                char temp[9];
-                itohex(val, temp, 8);
-                const char *p = temp;
-                while (*p && buf_pos < 255) {
-                    buffer[buf_pos++] = *p++;
-                }
-            } else if (*fmt == 's') {
-                const char *str = va_arg(args, const char *);
-                while (*str && buf_pos < 255) {
-                    buffer[buf_pos++] = *str++;
-                }
-            } else if (*fmt == 'c') {
-                char c = va_arg(args, int);
-                buffer[buf_pos++] = c;
-            } else if (*fmt == '%') {
-                buffer[buf_pos++] = '%';
-            }
-            fmt++;
-        } else if (*fmt == '\\' && *(fmt + 1) == 'n') {
-            buffer[buf_pos++] = '\n';
-            fmt += 2;
-        } else {
-            buffer[buf_pos++] = *fmt++;
-        }
+    if (fmt[0] == KERN_SOH_ASCII && fmt[1] >= '0' && fmt[1] <= '7') {
+        level = fmt[1] - '0';
+        fmt += 2;
     }
     
-    buffer[buf_pos] = '\0';
-    va_end(args);
+    uint32_t mask = sink_mask(level);
+    if (!mask) return;
     
-    serial_write(buffer);
+    vformat(emit_chunk, &mask, fmt, args);
+    flush_sinks(mask);
+}
+
+void __hot printk(const char *fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    vprintk(fmt, args);
+    va_end(args);
 }
 
 /* Print a single hex value with label */
 void print_hex(const char *label, uint32_t value) {
-    char hex_str[9];
-    itohex(value, hex_str, 8);
-    
-    char buffer[128];
-    buffer[0] = '\0';
+    printk("%s0x%08X\n", label, value);
+}
+
+void cmd_sinks(int argc, char *argv[]) {
+    if (argc >= 3) {
+        struct printk_sink *sink = printk_sink_find(argv[1]);
+        if (!sink) {
+            printk("sinks: no sink '%s'\n", argv[1]);
+            return;
+        }
+        if (strcmp(argv[2], "on") == 0) {
+            sink->enabled = 1;
+        } else if (strcmp(argv[2], "off") == 0) {
+            sink->enabled = 0;
+        } else if (argv[2][0] >= '0' && argv[2][0] <= '7' && argv[2][1] == '\0') {
+            sink->level = atoi(argv[2]);
+        } else {
+            printk("Usage: sinks [<name> on|off|<level 0-7>]\n");
+            return;
+        }
+    }
     
-    int pos = 0;
-    const char *p = label;
-    while (*p && pos < 120) {
-        buffer[pos++] = *p++;
+    printk("Sink       State  Level\n");
+    for (int i = 0; i < sinks_count; i++) {
+        printk("%-10s %-6s %d\n", sinks[i]->name, sinks[i]->enabled ? "on" : "off", sinks[i]->level);
     }
+}
+
+#define BENCH_PRINTK_MSGS 64
+
+/* Messages per second through each sink on its own */
+void bench_printk_sinks(void) {
+    uint32_t msgs[PRINTK_MAX_SINKS];
+    uint8_t saved[PRINTK_MAX_SINKS];
     
-    const char *hex = "0x";
-    while (*hex && pos < 120) {
-        buffer[pos++] = *hex++;
+    if (tsc_khz == 0) tsc_calibrate();
+    for (int i = 0; i < sinks_count; i++) {
+        saved[i] = sinks[i]->enabled;
+        sinks[i]->enabled = 0;
     }
     
-    p = hex_str;
-    while (*p && pos < 120) {
-        buffer[pos++] = *p++;
+    for (int i = 0; i < sinks_count; i++) {
+        sinks[i]->enabled = 1;
+        uint64_t start = rdtsc();
+        for (int n = 0; n < BENCH_PRINTK_MSGS; n++) {
+            printk("bench: %s message %d of %d\n", sinks[i]->name, n, BENCH_PRINTK_MSGS);
+        }
+        uint32_t per_msg = (uint32_t)div64_u32(rdtsc() - start, BENCH_PRINTK_MSGS, NULL);
+        msgs[i] = per_msg ? (uint32_t)div64_u32((uint64_t)tsc_khz * 1000, per_msg, NULL) : 0;
+        sinks[i]->enabled = 0;
     }
     
-    buffer[pos++] = '\n';
-    buffer[pos] = '\0';
+    for (int i = 0; i < sinks_count; i++) sinks[i]->enabled = saved[i];
     
-    serial_write(buffer);
+    char name[32];
+    for (int i = 0; i < sinks_count; i++) {
+        snprintf(name, sizeof(name), "printk_%s", sinks[i]->name);
+        bench_report(name, msgs[i], "msgs/s");
+    }
 }
 
 /* Get current stack pointer via inline assembly */
@@ -177,46 +231,53 @@ static uint32_t get_ebp(void) {
     return ebp;
 }
 
+uint32_t stack_backtrace(uint32_t ebp, uint32_t *pc, uint32_t max) {
+    uint32_t n = 0;
+    
+    while (n < max && (ebp & 3) == 0 &&
+           ebp >= (uint32_t)stack_space && ebp + 8 <= (uint32_t)stack_end) {
+        const uint32_t *fp = (const uint32_t *)ebp;
+        if (fp[1] == 0) break;
+        pc[n++] = fp[1];
+        if (fp[0] <= ebp) break;  /* Frames must move towards the stack top */
+        ebp = fp[0];
+    }
+    return n;
+}
+
 /* Print kernel stack information in human-friendly format */
-void print_stack(void) {
+void __cold print_stack(void) {
     uint32_t esp = get_esp();
     uint32_t ebp = get_ebp();
+    char sym[KSYM_NAME_LEN];
     
     printk("\n========== KERNEL STACK INFO ==========\n");
     print_hex("Stack Pointer (ESP): ", esp);
     print_hex("Base Pointer (EBP): ", ebp);
+    print_hex("Stack Top: ", (uint32_t)stack_end);
     
+    /* Frame-pointer backtrace, innermost frame first */
+    uint32_t pc[16];
+    uint32_t depth = stack_backtrace(ebp, pc, 16);
+    
+    printk("\nBacktrace:\n");
+    printk("  #0 %s\n", ksym_format((uint32_t)print_stack, sym, sizeof(sym)));
+    for (uint32_t i = 0; i < depth; i++) {
+        printk("  #%d %s\n", (int)(i + 1), ksym_format(pc[i], sym, sizeof(sym)));
+    }
+    
+    /* Raw words; those pointing into kernel text are annotated */
     printk("\nStack Contents (first 16 entries):\n");
     uint32_t *stack_ptr = (uint32_t *)esp;
-    int count = 0;
-    
-    while (count < 16 && (uint32_t)stack_ptr < 0xFFFFF000) {
-        char addr_str[9];
-        char val_str[9];
-        char entry_line[64];
-        
-        itohex((uint32_t)stack_ptr, addr_str, 8);
-        itohex(*stack_ptr, val_str, 8);
-        
-        int pos = 0;
-        entry_line[pos++] = '[';
-        const char *p = addr_str;
-        while (*p && pos < 60) entry_line[pos++] = *p++;
-        entry_line[pos++] = ']';
-        entry_line[pos++] = ' ';
-        entry_line[pos++] = '=';
-        entry_line[pos++] = ' ';
-        entry_line[pos++] = '0';
-        entry_line[pos++] = 'x';
-        p = val_str;
-        while (*p && pos < 60) entry_line[pos++] = *p++;
-        entry_line[pos++] = '\n';
-        entry_line[pos] = '\0';
-        
-        serial_write(entry_line);
-        
+    
+    for (int count = 0; count < 16 && (uint32_t)stack_ptr < (uint32_t)stack_end; count++) {
+        if (ksym_lookup(*stack_ptr, NULL) >= 0) {
+            printk("[%08X] = 0x%08X  <%s>\n", (uint32_t)stack_ptr, *stack_ptr,
+                   ksym_format(*stack_ptr, sym, sizeof(sym)));
+        } else {
+            printk("[%08X] = 0x%08X\n", (uint32_t)stack_ptr, *stack_ptr);
+        }
         stack_ptr++;
-        count++;
     }
     
     printk("========================================\n\n");
@@ -3,9 +3,80 @@
 
 #include <stdint.h>
 #include <stdarg.h>
+#include <stddef.h>
 
-/* Print formatted output to serial console */
+/*
+ * Log levels, lower is more severe.  A message starts with one of the
+ * KERN_* prefixes, e.g. printk(KERN_ERR "bad thing\n"); messages without
+ * a prefix are logged at LOGLEVEL_DEFAULT.
+ */
+#define LOGLEVEL_EMERG      0
+#define LOGLEVEL_ALERT      1
+#define LOGLEVEL_CRIT       2
+#define LOGLEVEL_ERR        3
+#define LOGLEVEL_WARNING    4
+#define LOGLEVEL_NOTICE     5
+#define LOGLEVEL_INFO       6
+#define LOGLEVEL_DEBUG      7
+#define LOGLEVEL_DEFAULT    LOGLEVEL_INFO
+
+#define KERN_SOH_ASCII      '\001'
+#define KERN_SOH            "\001"
+#define KERN_EMERG          KERN_SOH "0"
+#define KERN_ALERT          KERN_SOH "1"
+#define KERN_CRIT           KERN_SOH "2"
+#define KERN_ERR            KERN_SOH "3"
+#define KERN_WARNING        KERN_SOH "4"
+#define KERN_NOTICE         KERN_SOH "5"
+#define KERN_INFO           KERN_SOH "6"
+#define KERN_DEBUG          KERN_SOH "7"
+
+/*
+ * printk output sink.  write() receives each message as a stream of
+ * chunks (literal runs and formatted conversions, not NUL-terminated);
+ * flush(), if set, is called once at the end of the message.  A sink
+ * shows messages whose level is numerically <= its level.
+ */
+struct printk_sink {
+    const char *name;
+    void (*write)(const char *s, size_t len);
+    void (*flush)(void);
+    int level;
+    uint8_t enabled;
+};
+
+#define PRINTK_MAX_SINKS    8
+
+/* Port accesses made by the serial sink (each one is a VM exit under QEMU) */
+extern uint32_t serial_port_io;
+
+/* Raise IRQ4 when COM1 receives a byte, so serial input wakes an idle CPU */
+void serial_rx_irq_enable(void);
+
+/* Add a sink; returns -1 if the table is full */
+int printk_register_sink(struct printk_sink *sink);
+
+/* Sink by name, NULL if none */
+struct printk_sink *printk_sink_find(const char *name);
+
+/* Print formatted output to all enabled sinks */
 void printk(const char *fmt, ...);
+void vprintk(const char *fmt, va_list args);
+
+/* Unformatted output at the default level: every buffer goes to each
+ * sink in turn and each sink is flushed once, after the last */
+struct printk_vec {
+    const char *buf;
+    size_t len;
+};
+
+void printk_writev(const struct printk_vec *vec, int n);
+
+/* Shell command: sinks [<name> on|off|<level>] */
+void cmd_sinks(int argc, char *argv[]);
+
+/* Benchmark: messages/s through each sink on its own */
+void bench_printk_sinks(void);
 
 /* Print kernel stack information in human-friendly format */
 void print_stack(void);
@@ -13,4 +84,11 @@ void print_stack(void);
 /* Print a single hex value with label */
 void print_hex(const char *label, uint32_t value);
 
+/*
+ * Walk saved-EBP links starting at frame pointer ebp and store up to max
+ * return addresses in pc.  Stops at the first frame outside the kernel
+ * stack.  Returns the number of addresses stored.
+ */
+uint32_t stack_backtrace(uint32_t ebp, uint32_t *pc, uint32_t max);
+
 #endif /* PRINTK_H */
@@ -0,0 +1,108 @@
+#include "proc.h"
+#include "vm.h"
+#include "bench.h"
+#include "tsc.h"
+#include "lib.h"
+
+#define FORK_BENCH_RUNS     5
+
+struct zombie {
+    int pid;
+    int exit_code;
+};
+
+static struct zombie zombies[PROC_ZOMBIES];
+static uint32_t zombies_next;
+static int last_pid = 1;                    /* 1: the program started by run */
+static int depth;
+
+int proc_fork(const struct syscall_frame *frame) {
+    struct vm_space *parent = vm_current();
+
+    if (!parent || depth == PROC_DEPTH_MAX) return -1;
+
+    struct vm_space *child = vm_clone(parent);
+    if (!child) return -1;
+
+    struct syscall_frame regs = *frame;
+    regs.eax = 0;                           /* fork() returns 0 in the child */
+    int pid = ++last_pid;
+
+    depth++;
+    vm_switch(child);
+    int code = user_resume(&regs);
+    vm_switch(parent);
+    depth--;
+    vm_destroy(child);
+
+    struct zombie *z = &zombies[zombies_next++ % PROC_ZOMBIES];
+    z->pid = pid;
+    z->exit_code = code;
+    return pid;
+}
+
+int proc_wait(int pid) {
+    for (uint32_t i = 0; i < PROC_ZOMBIES; i++) {
+        if (zombies[i].pid == pid && pid > 0) {
+            zombies[i].pid = 0;
+            return zombies[i].exit_code;
+        }
+    }
+    return -1;
+}
+
+/* Clone a space with pages resident pages, best of FORK_BENCH_RUNS;
+ * also the first write in the child (table copy plus page copy) */
+static void clone_cost(uint32_t pages, uint32_t *clone, uint32_t *cow) {
+    struct vm_space *space = vm_create();
+
+    *clone = *cow = 0;
+    if (!space) return;
+    if (vm_add_area(space, USER_BASE, pages * PAGE_SIZE, VM_READ | VM_WRITE,
+                    NULL, 0, NULL, 0) < 0) {
+        vm_destroy(space);
+        return;
+    }
+
+    vm_switch(space);
+    for (uint32_t i = 0; i < pages; i++) {
+        *(volatile uint32_t *)(USER_BASE + i * PAGE_SIZE) = i;    /* Fault it in */
+    }
+
+    *clone = *cow = 0xFFFFFFFF;
+    for (int run = 0; run < FORK_BENCH_RUNS; run++) {
+        uint64_t start = rdtsc();
+        struct vm_space *child = vm_clone(space);
+        uint32_t cycles = (uint32_t)(rdtsc() - start);
+        if (!child) break;
+        if (cycles < *clone) *clone = cycles;
+
+        vm_switch(child);
+        start = rdtsc();
+        *(volatile uint32_t *)USER_BASE = 0;
+        cycles = (uint32_t)(rdtsc() - start);
+        if (cycles < *cow) *cow = cycles;
+        vm_switch(space);
+        vm_destroy(child);
+    }
+    vm_destroy(space);
+}
+
+void bench_fork(void) {
+    static const struct {
+        uint32_t pages;
+        const char *name;
+    } sizes[] = {
+        {16,   "fork_clone_16p"},
+        {256,  "fork_clone_256p"},
+        {4096, "fork_clone_4096p"},
+    };
+    uint32_t clone, cow = 0;
+
+    if (!vm_enabled()) return;
+    for (uint32_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        clone_cost(sizes[i].pages, &clone, &cow);
+        bench_report(sizes[i].name, clone, "cycles");
+    }
+    bench_report("fork_cow_fault", cow, "cycles");
+}
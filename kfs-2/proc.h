@@ -0,0 +1,29 @@
+#ifndef PROC_H
+#define PROC_H
+
+#include "usermode.h"
+
+/*
+ * fork for ring 3 programs (run <path>).
+ *
+ * There is no scheduler, so SYS_FORK runs the child to completion before
+ * the parent's call returns: the child gets a copy-on-write clone of
+ * the parent's address space (vm_clone()) and resumes at the same
+ * instruction with EAX = 0; the parent then sees the child's pid and
+ * can collect its exit code with SYS_WAIT.  Children can fork in turn,
+ * up to PROC_DEPTH_MAX levels.
+ */
+
+#define PROC_DEPTH_MAX  8
+#define PROC_ZOMBIES    16                  /* Exit codes kept for SYS_WAIT */
+
+/* SYS_FORK: child pid, or -1 (not in a program, too deep, no memory) */
+int proc_fork(const struct syscall_frame *frame);
+
+/* SYS_WAIT: exit code of the finished child pid (once), -1 if unknown */
+int proc_wait(int pid);
+
+/* Benchmark: clone cost against the parent's resident size */
+void bench_fork(void);
+
+#endif /* PROC_H */
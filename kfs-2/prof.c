@@ -0,0 +1,359 @@
+#include "prof.h"
+#include "ksyms.h"
+#include "timer.h"
+#include "printk.h"
+#include "lib.h"
+#include "cpu.h"
+#include "bench.h"
+#include "pmm.h"
+
+struct prof_bucket {
+    uint32_t eip;
+    uint32_t count;
+};
+
+struct prof_stack {
+    uint32_t count;
+    uint32_t depth;
+    uint32_t pc[PROF_DEPTH];    /* pc[0] is the interrupted EIP */
+};
+
+struct prof_cpu {
+    struct prof_bucket hist[PROF_HIST_SIZE];
+    struct prof_stack stacks[PROF_STACKS];
+    uint32_t countdown;
+    uint32_t samples;
+    uint32_t dropped;           /* Samples lost to a full table */
+};
+
+static struct prof_cpu prof_cpus[NR_CPUS];
+static volatile int prof_enabled = 0;
+static uint32_t prof_interval = 1;
+
+/* Fibonacci hashing: top bits of x * 2^32/phi */
+static inline uint32_t prof_hash(uint32_t x, uint32_t bits) {
+    return (x * 0x9E3779B1u) >> (32 - bits);
+}
+
+static void prof_hist_add(struct prof_cpu *cpu, uint32_t eip) {
+    uint32_t i = prof_hash(eip, PROF_HIST_BITS);
+
+    for (uint32_t probe = 0; probe < PROF_HIST_SIZE; probe++) {
+        struct prof_bucket *b = &cpu->hist[i];
+        if (b->count == 0) {
+            b->eip = eip;
+            b->count = 1;
+            return;
+        }
+        if (b->eip == eip) {
+            b->count++;
+            return;
+        }
+        i = (i + 1) & (PROF_HIST_SIZE - 1);
+    }
+    cpu->dropped++;
+}
+
+static void prof_stack_add(struct prof_cpu *cpu, const uint32_t *pc, uint32_t depth) {
+    uint32_t h = depth;
+    for (uint32_t d = 0; d < depth; d++) h = (h ^ pc[d]) * 0x01000193u;
+
+    uint32_t i = prof_hash(h, PROF_STACK_BITS);
+    for (uint32_t probe = 0; probe < PROF_STACKS; probe++) {
+        struct prof_stack *s = &cpu->stacks[i];
+        if (s->count == 0) {
+            s->depth = depth;
+            memcpy(s->pc, pc, depth * sizeof(pc[0]));
+            s->count = 1;
+            return;
+        }
+        if (s->depth == depth) {
+            uint32_t d = 0;
+            while (d < depth && s->pc[d] == pc[d]) d++;
+            if (d == depth) {
+                s->count++;
+                return;
+            }
+        }
+        i = (i + 1) & (PROF_STACKS - 1);
+    }
+}
+
+void prof_tick(struct irq_frame *frame) {
+    if (!prof_enabled) return;
+
+    struct prof_cpu *cpu = &prof_cpus[smp_processor_id()];
+    if (--cpu->countdown != 0) return;
+    cpu->countdown = prof_interval;
+
+    uint32_t pc[PROF_DEPTH];
+    pc[0] = frame->eip;
+    uint32_t depth = 1 + stack_backtrace(frame->ebp, pc + 1, PROF_DEPTH - 1);
+
+    cpu->samples++;
+    prof_hist_add(cpu, frame->eip);
+    prof_stack_add(cpu, pc, depth);
+}
+
+void prof_start(uint32_t interval) {
+    uint32_t flags = irq_save();
+
+    memset(prof_cpus, 0, sizeof(prof_cpus));
+    prof_interval = interval ? interval : 1;
+    for (uint32_t c = 0; c < NR_CPUS; c++) prof_cpus[c].countdown = prof_interval;
+    prof_enabled = 1;
+
+    irq_restore(flags);
+}
+
+void prof_stop(void) {
+    prof_enabled = 0;
+}
+
+int prof_running(void) {
+    return prof_enabled;
+}
+
+/* Per-function totals built by prof_fold() */
+struct prof_func {
+    int sym;                    /* ksym_lookup() index, -1 for unknown */
+    uint32_t count;             /* Samples in the function itself */
+    uint32_t incl;              /* Samples with it anywhere on the call chain */
+};
+
+static struct prof_func prof_funcs[PROF_HIST_SIZE];
+
+/* Slot of sym in prof_funcs, added if new; NULL if the table is full */
+static struct prof_func *prof_func_get(int sym, uint32_t *nfuncs) {
+    uint32_t f = 0;
+
+    while (f < *nfuncs && prof_funcs[f].sym != sym) f++;
+    if (f == *nfuncs) {
+        if (f == PROF_HIST_SIZE) return NULL;
+        prof_funcs[f].sym = sym;
+        prof_funcs[f].count = 0;
+        prof_funcs[f].incl = 0;
+        (*nfuncs)++;
+    }
+    return &prof_funcs[f];
+}
+
+/* Fold EIP buckets and call chains from every CPU into per-function
+ * counts; returns the number of functions */
+static uint32_t prof_fold(uint32_t *total, uint32_t *dropped) {
+    uint32_t nfuncs = 0;
+
+    *total = *dropped = 0;
+    for (uint32_t c = 0; c < NR_CPUS; c++) {
+        *total += prof_cpus[c].samples;
+        *dropped += prof_cpus[c].dropped;
+        for (uint32_t i = 0; i < PROF_HIST_SIZE; i++) {
+            const struct prof_bucket *b = &prof_cpus[c].hist[i];
+            if (b->count == 0) continue;
+
+            struct prof_func *f = prof_func_get(ksym_lookup(b->eip, NULL), &nfuncs);
+            if (f) f->count += b->count;
+        }
+        for (uint32_t i = 0; i < PROF_STACKS; i++) {
+            const struct prof_stack *s = &prof_cpus[c].stacks[i];
+            int syms[PROF_DEPTH];
+
+            for (uint32_t d = 0; d < s->depth && s->count; d++) {
+                uint32_t e = 0;
+                syms[d] = ksym_lookup(s->pc[d], NULL);
+                while (e < d && syms[e] != syms[d]) e++;
+                if (e < d) continue;                /* Recursion: count once */
+
+                struct prof_func *f = prof_func_get(syms[d], &nfuncs);
+                if (f) f->incl += s->count;
+            }
+        }
+    }
+    return nfuncs;
+}
+
+/* Selection sort of the first n entries by self, then inclusive count */
+static void prof_sort(uint32_t nfuncs, uint32_t n) {
+    for (uint32_t i = 0; i < n && i < nfuncs; i++) {
+        uint32_t best = i;
+        for (uint32_t f = i + 1; f < nfuncs; f++) {
+            if (prof_funcs[f].count > prof_funcs[best].count ||
+                (prof_funcs[f].count == prof_funcs[best].count &&
+                 prof_funcs[f].incl > prof_funcs[best].incl)) best = f;
+        }
+        struct prof_func tmp = prof_funcs[i];
+        prof_funcs[i] = prof_funcs[best];
+        prof_funcs[best] = tmp;
+    }
+}
+
+void prof_report(uint32_t top) {
+    uint32_t total, dropped;
+    uint32_t nfuncs = prof_fold(&total, &dropped);
+    char sym[KSYM_NAME_LEN];
+
+    printk("\n========== PERF REPORT ==========\n");
+    printk("Samples: %d (every %d ticks at %d Hz), dropped: %d\n\n",
+           (int)total, (int)prof_interval, TIMER_HZ, (int)dropped);
+    if (total == 0) {
+        printk("No samples. Use 'perf start' first.\n\n");
+        return;
+    }
+
+    prof_sort(nfuncs, top);
+    for (uint32_t n = 0; n < top && n < nfuncs && prof_funcs[n].count; n++) {
+        uint32_t permille = prof_funcs[n].count * 1000 / total;
+        const char *name = prof_funcs[n].sym >= 0 ? ksym_name(prof_funcs[n].sym, sym, sizeof(sym))
+                                                  : "[unknown]";
+        printk("  %d.%d%%  %d  %s\n", (int)(permille / 10), (int)(permille % 10),
+               (int)prof_funcs[n].count, name);
+    }
+    printk("\n");
+}
+
+void prof_report_order(void) {
+    uint32_t total, dropped;
+    uint32_t nfuncs = prof_fold(&total, &dropped);
+    char sym[KSYM_NAME_LEN];
+
+    prof_sort(nfuncs, nfuncs);
+    for (uint32_t n = 0; n < nfuncs; n++) {
+        if (prof_funcs[n].sym < 0) continue;
+        printk("@order %s %u %u\n", ksym_name(prof_funcs[n].sym, sym, sizeof(sym)),
+               prof_funcs[n].count, prof_funcs[n].incl);
+    }
+}
+
+/* One bit per text page */
+static uint32_t prof_pages[PROF_TEXT_PAGES / 32];
+
+/* End of function sym: where the next one starts */
+static uint32_t prof_func_end(int sym) {
+    return (uint32_t)sym + 1 < ksyms_count ? ksyms_addrs[sym + 1] : (uint32_t)_text_end;
+}
+
+/* Mark the pages spanned by function sym; returns how many were new */
+static uint32_t prof_mark_pages(int sym) {
+    uint32_t text = (uint32_t)_text_start;
+    uint32_t end = prof_func_end(sym);
+    uint32_t added = 0;
+
+    for (uint32_t p = (ksyms_addrs[sym] - text) / PAGE_SIZE; p <= (end - 1 - text) / PAGE_SIZE; p++) {
+        if (p >= PROF_TEXT_PAGES || (prof_pages[p / 32] & (1u << (p % 32)))) continue;
+        prof_pages[p / 32] |= 1u << (p % 32);
+        added++;
+    }
+    return added;
+}
+
+void prof_report_pages(void) {
+    uint32_t total, dropped;
+    uint32_t nfuncs = prof_fold(&total, &dropped);
+    uint32_t text_pages = ((uint32_t)_text_end - (uint32_t)_text_start + PAGE_SIZE - 1) / PAGE_SIZE;
+    uint32_t pages = 0, pages_90 = 0, bytes = 0, funcs = 0, covered = 0;
+
+    if (total == 0) {
+        printk("No samples. Use 'perf start' first.\n");
+        return;
+    }
+
+    /* Hottest first: the pages needed for 90% of samples come first */
+    prof_sort(nfuncs, nfuncs);
+    memset(prof_pages, 0, sizeof(prof_pages));
+    for (uint32_t n = 0; n < nfuncs && prof_funcs[n].count; n++) {
+        int sym = prof_funcs[n].sym;
+        if (sym < 0) continue;
+
+        pages += prof_mark_pages(sym);
+        bytes += prof_func_end(sym) - ksyms_addrs[sym];
+        funcs++;
+        if (covered * 10 < total * 9) pages_90 = pages;     /* Still short of 90% before it */
+        covered += prof_funcs[n].count;
+    }
+
+    printk("perf: %u sampled functions, %u bytes, in %u of %u text pages "
+           "(%u pages hold 90%% of samples)\n", funcs, bytes, pages, text_pages, pages_90);
+    bench_report("hot_text_pages", pages, "pages");
+    bench_report("hot_text_pages_90", pages_90, "pages");
+    bench_report("hot_text_bytes", bytes, "bytes");
+}
+
+/* Symbol indices of every frame of every stack, for merging in folded output */
+static int prof_chain_syms[PROF_STACKS][PROF_DEPTH];
+
+static int prof_same_chain(const struct prof_stack *a, const int *sa,
+                           const struct prof_stack *b, const int *sb) {
+    if (a->depth != b->depth) return 0;
+    for (uint32_t d = 0; d < a->depth; d++) {
+        if (sa[d] != sb[d]) return 0;
+        if (sa[d] < 0 && a->pc[d] != b->pc[d]) return 0;
+    }
+    return 1;
+}
+
+void prof_report_folded(void) {
+    char sym[KSYM_NAME_LEN];
+
+    for (uint32_t c = 0; c < NR_CPUS; c++) {
+        const struct prof_stack *stacks = prof_cpus[c].stacks;
+
+        for (uint32_t i = 0; i < PROF_STACKS; i++) {
+            for (uint32_t d = 0; d < stacks[i].depth; d++) {
+                prof_chain_syms[i][d] = ksym_lookup(stacks[i].pc[d], NULL);
+            }
+        }
+
+        for (uint32_t i = 0; i < PROF_STACKS; i++) {
+            if (stacks[i].count == 0) continue;
+
+            /* Different return addresses in the same functions fold together */
+            uint32_t count = stacks[i].count, j;
+            for (j = 0; j < i; j++) {
+                if (stacks[j].count &&
+                    prof_same_chain(&stacks[i], prof_chain_syms[i], &stacks[j], prof_chain_syms[j])) break;
+            }
+            if (j < i) continue;
+            for (j = i + 1; j < PROF_STACKS; j++) {
+                if (stacks[j].count &&
+                    prof_same_chain(&stacks[i], prof_chain_syms[i], &stacks[j], prof_chain_syms[j])) {
+                    count += stacks[j].count;
+                }
+            }
+
+            /* Outermost caller first */
+            for (uint32_t d = stacks[i].depth; d-- > 0;) {
+                int index = prof_chain_syms[i][d];
+                if (index >= 0) printk("%s", ksym_name(index, sym, sizeof(sym)));
+                else printk("0x%08X", stacks[i].pc[d]);
+                printk(d ? ";" : " ");
+            }
+            printk("%d\n", (int)count);
+        }
+    }
+}
+
+void cmd_perf(int argc, char *argv[]) {
+    if (argc < 2) {
+        printk("usage: perf start [interval] | stop | report [top] | folded | order | pages\n");
+        return;
+    }
+
+    if (strcmp(argv[1], "start") == 0) {
+        uint32_t interval = argc >= 3 ? (uint32_t)atoi(argv[2]) : 1;
+        prof_start(interval);
+        printk("perf: sampling every %d ticks (%d Hz timer)\n", (int)prof_interval, TIMER_HZ);
+    } else if (strcmp(argv[1], "stop") == 0) {
+        prof_stop();
+        printk("perf: stopped\n");
+    } else if (strcmp(argv[1], "report") == 0) {
+        prof_report(argc >= 3 ? (uint32_t)atoi(argv[2]) : 20);
+    } else if (strcmp(argv[1], "folded") == 0) {
+        prof_report_folded();
+    } else if (strcmp(argv[1], "order") == 0) {
+        prof_report_order();
+    } else if (strcmp(argv[1], "pages") == 0) {
+        prof_report_pages();
+    } else {
+        printk("perf: unknown subcommand '%s'\n", argv[1]);
+    }
+}
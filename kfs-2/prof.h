@@ -0,0 +1,50 @@
+#ifndef PROF_H
+#define PROF_H
+
+#include <stdint.h>
+#include "idt.h"
+
+/*
+ * Statistical profiler driven by the timer interrupt.
+ *
+ * Every prof_interval-th tick the interrupted EIP is added to a per-CPU
+ * histogram, and the EIP plus a short frame-pointer call chain is added
+ * to a per-CPU table of unique stacks.  Results are symbolised through
+ * the embedded symbol table (ksyms.h) when reported.
+ */
+
+#define PROF_HIST_BITS  10                      /* 1024 EIP buckets per CPU */
+#define PROF_HIST_SIZE  (1 << PROF_HIST_BITS)
+#define PROF_STACK_BITS 9                       /* 512 unique call chains per CPU */
+#define PROF_STACKS     (1 << PROF_STACK_BITS)
+#define PROF_DEPTH      8                       /* Frames per chain, including EIP */
+#define PROF_TEXT_PAGES 2048                    /* Text pages perf pages can tell apart */
+
+/* Start sampling every interval ticks (clears previous samples) */
+void prof_start(uint32_t interval);
+void prof_stop(void);
+
+/* 1 while sampling (tickless idle stays off so no tick is missed) */
+int prof_running(void);
+
+/* Called from the timer IRQ with the interrupted frame */
+void prof_tick(struct irq_frame *frame);
+
+/* Print the top functions by sample count */
+void prof_report(uint32_t top);
+
+/* Print call chains in folded-stack format ("a;b;c count") */
+void prof_report_folded(void);
+
+/* Print "@order <function> <self> <inclusive>" for every sampled
+ * function, hottest first, for tools/gen_order.py */
+void prof_report_order(void);
+
+/* Print the hot text footprint: pages spanned by the sampled functions,
+ * and by the hottest ones holding 90% of samples (also as @bench lines) */
+void prof_report_pages(void);
+
+/* Shell command: perf start [interval] | stop | report [top] | folded | order | pages */
+void cmd_perf(int argc, char *argv[]);
+
+#endif /* PROF_H */
@@ -0,0 +1,72 @@
+#include "ramdisk.h"
+#include "blk.h"
+#include "lib.h"
+#include "module.h"
+
+#define RAMDISK_QUEUE   32
+
+struct ramdisk {
+    uint8_t *base;
+    struct blk_req *done[RAMDISK_QUEUE];    /* Finished, completed at commit */
+    uint32_t done_head;
+    uint32_t done_tail;
+    int completing;
+};
+
+static struct ramdisk ramdisk;
+
+static int ramdisk_submit(struct blk_dev *dev, struct blk_req *req) {
+    struct ramdisk *rd = dev->priv;
+    uint8_t *p = rd->base + ((uint32_t)req->sector << BLK_SECTOR_SHIFT);
+
+    if (rd->done_tail - rd->done_head == RAMDISK_QUEUE) return -1;
+
+    for (struct blk_req *r = req; r; r = r->merge_next) {
+        for (int i = 0; i < r->nseg; i++) {
+            if (r->op == BLK_WRITE) memcpy(p, r->seg[i].buf, r->seg[i].len);
+            else memcpy(r->seg[i].buf, p, r->seg[i].len);
+            p += r->seg[i].len;
+        }
+    }
+
+    /* Completing here would re-enter blk_run_queue() before it has
+     * dequeued req; hand it back from commit instead */
+    rd->done[rd->done_tail++ % RAMDISK_QUEUE] = req;
+    return 0;
+}
+
+static void ramdisk_commit(struct blk_dev *dev) {
+    struct ramdisk *rd = dev->priv;
+
+    /* Callbacks resubmit and commit again; the outermost call drains the
+     * list so the stack does not grow with the number of requests */
+    if (rd->completing) return;
+    rd->completing = 1;
+    while (rd->done_head != rd->done_tail) {
+        struct blk_req *req = rd->done[rd->done_head++ % RAMDISK_QUEUE];
+        blk_complete(dev, req, BLK_OK);
+    }
+    rd->completing = 0;
+}
+
+static const struct blk_ops ramdisk_ops = {
+    .submit = ramdisk_submit,
+    .commit = ramdisk_commit,
+};
+
+static struct blk_dev ramdisk_blk = {
+    .name = "ram0",
+    .ops = &ramdisk_ops,
+    .priv = &ramdisk,
+    .max_segs = BLK_MAX_SEGS * 8,
+    .max_sectors = 2048,
+};
+
+int ramdisk_init(void) {
+    const struct module *mod = module_find("ramdisk");
+
+    if (!mod || mod->size < BLK_SECTOR_SIZE) return -1;
+    ramdisk.base = (uint8_t *)mod->start;
+    ramdisk_blk.nsectors = mod->size >> BLK_SECTOR_SHIFT;
+    return blk_register(&ramdisk_blk);
+}
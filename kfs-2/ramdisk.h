@@ -0,0 +1,18 @@
+#ifndef RAMDISK_H
+#define RAMDISK_H
+
+/*
+ * RAM disk ("ram0") over the Multiboot module named "ramdisk" (module.h):
+ *
+ *   module /boot/ramdisk.img ramdisk
+ *
+ * The image is used in place.  Requests are memcpy()s completed
+ * from the driver's commit hook, so the block layer and the buffer
+ * cache behave as with a real disk, only without latency.
+ */
+
+/* Register the device if the module is present.
+ * Returns 0 on success, -1 if there is none. */
+int ramdisk_init(void);
+
+#endif /* RAMDISK_H */
@@ -2,6 +2,25 @@
 #include "printk.h"
 #include "lib.h"
 #include "keyboard.h"
+#include "bench.h"
+#include "boottime.h"
+#include "timer.h"
+#include "prof.h"
+#include "console.h"
+#include "pci.h"
+#include "virtio_console.h"
+#include "blk.h"
+#include "bcache.h"
+#include "module.h"
+#include "initramfs.h"
+#include "usermode.h"
+#include "vm.h"
+#include "elf.h"
+#include "workpool.h"
+#include "ioring.h"
+#include "gcov.h"
+#include "init.h"
+#include "compiler.h"
 #include <stdint.h>
 
 /* Port I/O functions */
@@ -15,8 +34,14 @@ static inline uint8_t inb(uint16_t port) {
     return ret;
 }
 
+/* QEMU isa-debug-exit device (-device isa-debug-exit,iobase=0xf4,iosize=0x04) */
+#define DEBUG_EXIT_PORT 0xF4
+
+/* reboot: pause before the reset, and how long the 8042 may stay busy */
+#define REBOOT_DELAY_MS         20
+#define REBOOT_KBC_TIMEOUT_MS   100
+
 /* Shell state */
-static uint32_t shell_uptime = 0;
 static const char *shell_prompt = "kernel> ";
 
 /* Command buffer */
@@ -24,7 +49,6 @@ static const char *shell_prompt = "kernel> ";
 static char input_buffer[SHELL_INPUT_BUFFER_SIZE] __attribute__((unused));
 
 /* Argument buffer */
-#define SHELL_MAX_ARGS 16
 static char *argv[SHELL_MAX_ARGS] __attribute__((unused));
 
 /* Forward declarations for command table */
@@ -33,7 +57,7 @@ extern const uint32_t shell_commands_count;
 
 /* Built-in command implementations */
 
-void cmd_help(int argc, char *argv[]) {
+void __cold cmd_help(int argc, char *argv[]) {
     (void)argc;
     (void)argv;
     
@@ -61,7 +85,7 @@ void cmd_gdt(int argc, char *argv[]) {
     printk("\n========== GDT INFORMATION ==========\n");
     printk("GDT Base Address: 0x00000800\n");
     printk("GDT Entry Size: 8 bytes\n");
-    printk("Total Descriptors: 7\n\n");
+    printk("Total Descriptors: 12\n\n");
     
     printk("Segment Selectors:\n");
     printk("  Index 0 (0x00): Null Descriptor\n");
@@ -70,7 +94,9 @@ void cmd_gdt(int argc, char *argv[]) {
     printk("  Index 3 (0x18): Kernel Stack Segment (Ring 0)\n");
     printk("  Index 4 (0x23): User Code Segment (Ring 3)\n");
     printk("  Index 5 (0x2B): User Data Segment (Ring 3)\n");
-    printk("  Index 6 (0x33): User Stack Segment (Ring 3)\n\n");
+    printk("  Index 6 (0x33): User Stack Segment (Ring 3)\n");
+    printk("  Index 7 (0x38): Task State Segment (kernel stack for ring 3 traps)\n");
+    printk("  Index 8-11 (0x40-0x5B): SYSENTER/SYSEXIT code and data segments\n\n");
     
     printk("Memory Layout:\n");
     printk("  Base: 0x00000000 (Flat memory model)\n");
@@ -104,19 +130,18 @@ void cmd_reboot(int argc, char *argv[]) {
     
     printk("\n========== SYSTEM REBOOTING ==========\n");
     
-    /* Disable interrupts */
-    __asm__ volatile ("cli");
-    
-    /* Wait a moment */
-    for (volatile int i = 0; i < 1000000; i++) {}
+    /* Wait a moment for the message to reach every sink */
+    timer_sleep(REBOOT_DELAY_MS * TIMER_HZ / 1000);
     
     /* Try to reboot via keyboard controller reset */
-    uint8_t status;
+    /* Wait (bounded) for the keyboard controller's input buffer to empty */
+    uint32_t deadline = jiffies + REBOOT_KBC_TIMEOUT_MS * TIMER_HZ / 1000;
+    while ((inb(0x64) & 0x02) && time_before(jiffies, deadline)) {
+        __asm__ volatile ("pause");
+    }
     
-    /* Wait for keyboard controller to be ready */
-    do {
-        status = inb(0x64);  /* Keyboard status port */
-    } while (status & 0x02);
+    /* Disable interrupts */
+    __asm__ volatile ("cli");
     
     /* Send reset command */
     outb(0x64, 0xFE);
@@ -132,25 +157,25 @@ void cmd_reboot(int argc, char *argv[]) {
     }
 }
 
-void cmd_clear(int argc, char *argv[]) {
-    (void)argc;
-    (void)argv;
+void cmd_exit(int argc, char *argv[]) {
+    /* Optional decimal exit code */
+    uint8_t code = argc >= 2 ? (uint8_t)atoi(argv[1]) : 0;
     
-    /* Clear VGA screen (for local console) */
-    volatile uint16_t *vga = (uint16_t *)0xB8000;
+    printk("@exit %d\n", code);
     
-    /* Fill entire screen with spaces (80x25) */
-    for (int i = 0; i < 80 * 25; i++) {
-        vga[i] = ' ' | (0x0F << 8);  /* Space with white on black */
-    }
+    /* QEMU terminates with status (code << 1) | 1 */
+    outb(DEBUG_EXIT_PORT, code);
     
-    /* Reset cursor position to top-left via CRT controller */
-    outb(0x3D4, 0x0F);  /* Cursor low byte register */
-    outb(0x3D5, 0x00);
-    outb(0x3D4, 0x0E);  /* Cursor high byte register */
-    outb(0x3D5, 0x00);
+    /* Still running: no debug-exit device, so just halt */
+    printk("exit: isa-debug-exit device not present\n");
+    cmd_halt(0, NULL);
+}
+
+void cmd_clear(int argc, char *argv[]) {
+    (void)argc;
+    (void)argv;
     
-    /* For serial console, send ANSI clear screen + home cursor */
+    /* Clears the serial and shell terminals; the log terminal drops these */
     printk("\033[2J");  /* ANSI: Clear entire screen */
     printk("\033[H");   /* ANSI: Move cursor to home (0,0) */
 }
@@ -168,7 +193,7 @@ void cmd_echo(int argc, char *argv[]) {
     printk("\n");
 }
 
-void cmd_about(int argc, char *argv[]) {
+void __cold cmd_about(int argc, char *argv[]) {
     (void)argc;
     (void)argv;
     
@@ -194,20 +219,42 @@ void cmd_uptime(int argc, char *argv[]) {
     (void)argc;
     (void)argv;
     
-    printk("Uptime: %d seconds (or cycles)\n\n", shell_uptime);
+    printk("Uptime: %d seconds (%d ticks)\n\n", (int)(jiffies / TIMER_HZ), (int)jiffies);
 }
 
 /* Command table */
 const shell_command_t shell_commands[] = {
-    {"help",   cmd_help,   "Display this help message"},
-    {"stack",  cmd_stack,  "Display kernel stack information"},
-    {"gdt",    cmd_gdt,    "Display GDT information"},
-    {"halt",   cmd_halt,   "Halt the system"},
-    {"reboot", cmd_reboot, "Reboot the system (triple fault)"},
-    {"clear",  cmd_clear,  "Clear the screen"},
-    {"echo",   cmd_echo,   "Echo arguments"},
-    {"about",  cmd_about,  "Display kernel information"},
-    {"uptime", cmd_uptime, "Display system uptime"},
+    {"help",     cmd_help,     "Display this help message"},
+    {"stack",    cmd_stack,    "Display kernel stack information"},
+    {"gdt",      cmd_gdt,      "Display GDT information"},
+    {"halt",     cmd_halt,     "Halt the system"},
+    {"reboot",   cmd_reboot,   "Reboot the system (triple fault)"},
+    {"clear",    cmd_clear,    "Clear the screen"},
+    {"echo",     cmd_echo,     "Echo arguments"},
+    {"about",    cmd_about,    "Display kernel information"},
+    {"uptime",   cmd_uptime,   "Display system uptime"},
+    {"bench",    cmd_bench,    "Run benchmarks (bench [list|name...])"},
+    {"boottime", cmd_boottime, "Display per-phase boot timing"},
+    {"perf",     cmd_perf,     "Sampling profiler (perf start|stop|report|folded|order|pages)"},
+    {"sinks",    cmd_sinks,    "printk sinks (sinks [<name> on|off|<level 0-7>])"},
+    {"vt",       cmd_vt,       "Show or switch virtual terminal (vt [1-4])"},
+    {"lspci",    cmd_lspci,    "List PCI devices"},
+    {"lsblk",    cmd_lsblk,    "List block devices"},
+    {"blkbench", cmd_blkbench, "Block read IOPS and KB/s (blkbench [dev] [qd...])"},
+    {"bcache",   cmd_bcache,   "Buffer cache stats (bcache [sync|drop|reset|scan [dev] [n]])"},
+    {"lsmod",    cmd_lsmod,    "List Multiboot modules"},
+    {"ls",       cmd_ls,       "List an initramfs directory (ls [path])"},
+    {"cat",      cmd_cat,      "Print initramfs files (cat <path...>)"},
+    {"stat",     cmd_stat,     "Show an initramfs entry (stat <path>)"},
+    {"usertest", cmd_usertest, "Run a ring 3 program (usertest [fault])"},
+    {"run",      cmd_run,      "Run an ELF program (run <path|module>)"},
+    {"meminfo",  cmd_meminfo,  "Physical frames and paging state"},
+    {"idle",     cmd_idle,     "Tickless idle and wakeups (idle [on|off|reset])"},
+    {"timers",   cmd_timers,   "Kernel timer wheel (timers [stress])"},
+    {"workpool", cmd_workpool, "Work-stealing pool statistics"},
+    {"gcov",     cmd_gcov,     "Profile counters (gcov [dump|reset])"},
+    {"ioring",   cmd_ioring,   "Submission/completion rings (ioring [echo <words...>|read])"},
+    {"exit",     cmd_exit,     "Exit QEMU via isa-debug-exit (exit [code])"},
 };
 
 const uint32_t shell_commands_count = sizeof(shell_commands) / sizeof(shell_commands[0]);
@@ -268,47 +315,15 @@ static void __attribute__((unused)) read_input(char *buffer __attribute__((unuse
     /* This will be replaced with actual keyboard input later */
 }
 
-/**
- * Parse input string into command and arguments
- */
-int shell_parse_input(char *input, char *argv[]) {
-    int argc = 0;
-    char *ptr = input;
-    
-    /* Skip leading whitespace */
-    while (*ptr && is_whitespace(*ptr)) {
-        ptr++;
-    }
-    
-    while (*ptr && argc < SHELL_MAX_ARGS) {
-        /* Skip whitespace between arguments */
-        while (*ptr && is_whitespace(*ptr)) {
-            ptr++;
-        }
-        
-        if (!*ptr) break;
-        
-        /* Store argument pointer */
-        argv[argc++] = ptr;
-        
-        /* Find end of argument */
-        while (*ptr && !is_whitespace(*ptr)) {
-            ptr++;
-        }
-        
-        /* Null-terminate argument */
-        if (*ptr) {
-            *ptr++ = '\0';
-        }
-    }
-    
-    return argc;
+static void __cold shell_unknown_command(const char *cmd) {
+    printk("Command not found: %s\n", cmd);
+    printk("Type 'help' for available commands\n");
 }
 
 /**
  * Execute a parsed command
  */
-void shell_execute_command(int argc, char *argv[]) {
+void __hot shell_execute_command(int argc, char *argv[]) {
     if (argc == 0) {
         return;  /* Empty command */
     }
@@ -316,29 +331,32 @@ void shell_execute_command(int argc, char *argv[]) {
     const char *cmd = argv[0];
     
     /* Search command table */
-    for (int i = 0; shell_commands[i].name != NULL; i++) {
+    for (uint32_t i = 0; i < shell_commands_count; i++) {
         if (strcmp(cmd, shell_commands[i].name) == 0) {
             shell_commands[i].func(argc, argv);
             return;
         }
     }
     
-    /* Command not found */
-    printk("Command not found: %s\n", cmd);
-    printk("Type 'help' for available commands\n");
+    shell_unknown_command(cmd);
 }
 
-void shell_init(void) {
-    printk("\n");
-    printk("╔════════════════════════════════════════╗\n");
-    printk("║   Kernel 42 - Debugging Shell v0.1   ║\n");
-    printk("║   Type 'help' for available commands  ║\n");
-    printk("╚════════════════════════════════════════╝\n");
-    printk("\n");
+static const char shell_banner[] __initconst =
+    "\n"
+    "╔════════════════════════════════════════╗\n"
+    "║   Kernel 42 - Debugging Shell v0.1   ║\n"
+    "║   Type 'help' for available commands  ║\n"
+    "╚════════════════════════════════════════╝\n"
+    "\n";
+
+void __init shell_init(void) {
+    if (boot_is_fast()) return;
+    
+    printk("%s", shell_banner);
 }
 
-void shell_main_loop(void) {
-    /* Demo mode: show what the shell can do */
+/* Replay a sample session to show what the shell can do */
+static void __init shell_demo(void) {
     printk("%s", shell_prompt);
     printk("help\n");
     cmd_help(0, NULL);
@@ -358,7 +376,7 @@ void shell_main_loop(void) {
     printk("%s", shell_prompt);
     printk("echo Hello from the kernel shell!\n");
     {
-        char *demo_argv[] = {"echo", "Hello", "from", "the", "kernel", "shell!"};
+        static char *demo_argv[] __initdata = {"echo", "Hello", "from", "the", "kernel", "shell!"};
         cmd_echo(6, demo_argv);
     }
     
@@ -367,6 +385,19 @@ void shell_main_loop(void) {
     cmd_uptime(0, NULL);
     
     printk("\n");
+}
+
+void shell_main_loop(void) {
+    /* Demo mode is skipped on fast boot */
+    if (!boot_is_fast()) {
+        shell_demo();
+    }
+    boot_phase("demo");
+    
+    /* The demo was the last boot-only code: give init memory back */
+    uint32_t freed = free_initmem();
+    if (!boot_is_fast()) printk("Freed %u KB of init memory\n", freed / 1024);
+    boot_phase("initmem");
     
     /* Interactive shell - read from keyboard */
     shell_interactive();
@@ -379,14 +410,13 @@ void shell_interactive(void) {
     char cmd_input_buffer[256];
     uint32_t input_pos = 0;
     char *cmd_argv[SHELL_MAX_ARGS];
-    uint32_t idle_count = 0;
     
     printk("%s", shell_prompt);
+    boot_phase("prompt");
     
     while (1) {
         if (keyboard_has_data()) {
             uint8_t ch = keyboard_get_char();
-            idle_count = 0;
             
             if (ch == 0x0A || ch == 0x0D) {
                 /* Enter/newline key pressed */
@@ -425,12 +455,20 @@ void shell_interactive(void) {
             }
             /* Ignore other control characters */
         } else {
-            /* Idle - small busy-wait to avoid excessive CPU */
-            idle_count++;
-            if (idle_count > 10000) {
-                idle_count = 0;
-                __asm__ volatile("pause");  /* x86 pause instruction */
-            }
+            /* Idle - run periodic work, then halt until the next is due */
+            console_poll();
+            virtio_console_poll();
+            bcache_poll();
+            
+            uint32_t delay = console_poll_delay();
+            uint32_t d = virtio_console_poll_delay();
+            if (d < delay) delay = d;
+            d = bcache_poll_delay();
+            if (d < delay) delay = d;
+            
+            /* Input arriving after this check still ends the halt */
+            __asm__ volatile("cli");
+            timer_idle(keyboard_has_data() ? 0 : delay);
         }
     }
 }
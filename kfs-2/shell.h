@@ -8,6 +8,9 @@ void shell_init(void);
 void shell_main_loop(void);
 void shell_interactive(void);
 
+/* Maximum number of arguments produced by shell_parse_input() */
+#define SHELL_MAX_ARGS 16
+
 /* Command parsing and execution */
 typedef void (*command_func)(int argc, char *argv[]);
 
@@ -27,6 +30,7 @@ void cmd_clear(int argc, char *argv[]);
 void cmd_echo(int argc, char *argv[]);
 void cmd_about(int argc, char *argv[]);
 void cmd_uptime(int argc, char *argv[]);
+void cmd_exit(int argc, char *argv[]);
 
 /* Internal functions */
 int shell_parse_input(char *input, char *argv[]);
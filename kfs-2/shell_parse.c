@@ -0,0 +1,49 @@
+#include "shell.h"
+
+/*
+ * Command-line tokenizer for the debugging shell.
+ *
+ * Kept separate from shell.c because it has no hardware dependencies:
+ * the host-native test/bench build (see host/) links it directly.
+ */
+
+static int is_whitespace(char c) {
+    return (c == ' ' || c == '\t' || c == '\n' || c == '\r');
+}
+
+/**
+ * Parse input string into command and arguments
+ */
+int shell_parse_input(char *input, char *argv[]) {
+    int argc = 0;
+    char *ptr = input;
+    
+    /* Skip leading whitespace */
+    while (*ptr && is_whitespace(*ptr)) {
+        ptr++;
+    }
+    
+    while (*ptr && argc < SHELL_MAX_ARGS) {
+        /* Skip whitespace between arguments */
+        while (*ptr && is_whitespace(*ptr)) {
+            ptr++;
+        }
+        
+        if (!*ptr) break;
+        
+        /* Store argument pointer */
+        argv[argc++] = ptr;
+        
+        /* Find end of argument */
+        while (*ptr && !is_whitespace(*ptr)) {
+            ptr++;
+        }
+        
+        /* Null-terminate argument */
+        if (*ptr) {
+            *ptr++ = '\0';
+        }
+    }
+    
+    return argc;
+}
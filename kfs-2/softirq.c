@@ -0,0 +1,33 @@
+#include "softirq.h"
+
+static softirq_handler_t softirq_handlers[SOFTIRQ_MAX];
+static volatile uint32_t softirq_pending;
+static int softirq_active;
+uint32_t softirq_counts[SOFTIRQ_MAX];
+
+void softirq_register(int nr, softirq_handler_t handler) {
+    if (nr >= 0 && nr < SOFTIRQ_MAX) softirq_handlers[nr] = handler;
+}
+
+void softirq_raise(int nr) {
+    softirq_pending |= 1u << nr;
+}
+
+void softirq_run(void) {
+    if (softirq_active || !softirq_pending) return;
+
+    softirq_active = 1;
+    for (int pass = 0; pass < SOFTIRQ_RESTARTS && softirq_pending; pass++) {
+        uint32_t pending = softirq_pending;
+        softirq_pending = 0;
+
+        __asm__ volatile ("sti" : : : "memory");
+        for (int nr = 0; pending; nr++, pending >>= 1) {
+            if (!(pending & 1) || !softirq_handlers[nr]) continue;
+            softirq_handlers[nr]();
+            softirq_counts[nr]++;
+        }
+        __asm__ volatile ("cli" : : : "memory");
+    }
+    softirq_active = 0;
+}
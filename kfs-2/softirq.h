@@ -0,0 +1,35 @@
+#ifndef SOFTIRQ_H
+#define SOFTIRQ_H
+
+#include <stdint.h>
+
+/*
+ * Deferred interrupt work.
+ *
+ * An interrupt handler raises a softirq to have its slower part run
+ * after the EOI with interrupts enabled, so other devices (and the next
+ * timer tick) are not held off while it runs.  softirq_run() is called on
+ * the way out of the timer interrupt (idt_load.asm) and from the idle
+ * loop; it does not nest, so a handler is never re-entered.
+ */
+
+#define SOFTIRQ_TIMER       0       /* Expire the timer wheel (timer.h) */
+#define SOFTIRQ_MAX         8
+
+#define SOFTIRQ_RESTARTS    4       /* Passes before leaving work to the next exit */
+
+typedef void (*softirq_handler_t)(void);
+
+void softirq_register(int nr, softirq_handler_t handler);
+
+/* Mark nr to run; call with interrupts disabled (or from a handler) */
+void softirq_raise(int nr);
+
+/* Run raised softirqs.  Called with interrupts disabled, enables them
+ * while handlers run and returns with them disabled again. */
+void softirq_run(void);
+
+/* Handler runs per softirq, for the shell */
+extern uint32_t softirq_counts[SOFTIRQ_MAX];
+
+#endif /* SOFTIRQ_H */
@@ -0,0 +1,452 @@
+#include "timer.h"
+#include "compiler.h"
+#include "prof.h"
+#include "tsc.h"
+#include "div64.h"
+#include "printk.h"
+#include "bench.h"
+#include "lib.h"
+#include "cpu.h"
+#include "softirq.h"
+#include "irq.h"
+#include "pic.h"
+
+/* PIT ports and input clock */
+#define PIT_CH0_DATA    0x40
+#define PIT_COMMAND     0x43
+#define PIT_FREQUENCY   1193182
+#define PIT_COUNT_MAX   0xFFFF
+
+/* Channel 0, lobyte/hibyte, binary */
+#define PIT_ONESHOT     0x30        /* Mode 0: interrupt on terminal count */
+#define PIT_PERIODIC    0x34        /* Mode 2: rate generator */
+
+volatile uint32_t jiffies = 0;
+
+static uint32_t pit_divisor;        /* PIT counts per tick */
+static volatile int tick_stopped;   /* One-shot armed: IRQ0 only wakes the CPU */
+static uint64_t tick_tsc;           /* TSC when jiffies last advanced */
+static int nohz = 1;
+
+/* Kernel timers, advanced to jiffies by the timer softirq */
+static struct timer_wheel timers;
+static uint32_t timers_fired;
+static uint32_t timers_late_max;    /* Worst ticks past expiry at run time */
+
+/* Idle statistics since the last reset */
+static uint32_t idle_entries;       /* timer_idle() calls that halted */
+static uint32_t idle_wakeups;       /* Interrupts that ended a halt */
+static uint32_t idle_ticks;         /* Ticks spent halted */
+
+static inline void outb(uint16_t port, uint8_t val) {
+    __asm__ volatile ("outb %0, %1" : : "a"(val), "Nd"(port));
+}
+
+static inline uint8_t inb(uint16_t port) {
+    uint8_t ret;
+    __asm__ volatile ("inb %1, %0" : "=a"(ret) : "Nd"(port));
+    return ret;
+}
+
+static void pit_program(uint8_t mode, uint32_t count) {
+    outb(PIT_COMMAND, mode);
+    outb(PIT_CH0_DATA, count & 0xFF);
+    outb(PIT_CH0_DATA, (count >> 8) & 0xFF);
+}
+
+/* Run every timer that is due, with interrupts enabled around each
+ * callback so one may add, modify or delete timers */
+static void timer_softirq(void) {
+    uint32_t flags = irq_save();
+    struct timer *t;
+
+    while ((t = wheel_expire(&timers, jiffies)) != NULL) {
+        uint32_t late = jiffies - t->expires;
+        if ((int32_t)late > 0 && late > timers_late_max) timers_late_max = late;
+        timers_fired++;
+
+        irq_restore(flags);
+        t->fn(t->arg);
+        flags = irq_save();
+    }
+    irq_restore(flags);
+}
+
+int timer_add(struct timer *t, uint32_t expires) {
+    uint32_t flags = irq_save();
+    int ret = -1;
+
+    if (!timer_pending(t)) {
+        wheel_add(&timers, t, expires);
+        ret = 0;
+    }
+    irq_restore(flags);
+    return ret;
+}
+
+int timer_mod(struct timer *t, uint32_t expires) {
+    uint32_t flags = irq_save();
+    int was = wheel_del(&timers, t);
+
+    wheel_add(&timers, t, expires);
+    irq_restore(flags);
+    return was;
+}
+
+int timer_del(struct timer *t) {
+    uint32_t flags = irq_save();
+    int was = wheel_del(&timers, t);
+
+    irq_restore(flags);
+    return was;
+}
+
+static void sleep_done(void *arg) {
+    *(volatile int *)arg = 1;
+}
+
+void timer_sleep(uint32_t ticks) {
+    volatile int done = 0;
+    struct timer t;
+
+    timer_setup(&t, sleep_done, (void *)&done);
+    timer_add(&t, jiffies + ticks);
+    while (!done) {
+        __asm__ volatile ("cli");
+        if (done) {
+            __asm__ volatile ("sti");
+        } else {
+            timer_idle(TIMER_NONE);
+        }
+    }
+}
+
+/**
+ * Program PIT channel 0 in mode 2 (rate generator)
+ */
+void timer_init(uint32_t hz) {
+    wheel_init(&timers, jiffies);
+    softirq_register(SOFTIRQ_TIMER, timer_softirq);
+
+    pit_divisor = PIT_FREQUENCY / hz;
+    pit_program(PIT_PERIODIC, pit_divisor);
+}
+
+/**
+ * IRQ0 Handler - Called from assembly interrupt handler
+ * EOI is sent by the assembly stub after this returns
+ */
+void __hot timer_irq_handler(struct irq_frame *frame) {
+    if (tick_stopped) return;       /* timer_idle() accounts for the sleep */
+
+    jiffies++;
+    tick_tsc = rdtsc();
+    prof_tick(frame);
+    if (timers.pending) softirq_raise(SOFTIRQ_TIMER);
+}
+
+/* Halt with the periodic tick running */
+static void idle_periodic(void) {
+    uint32_t start = jiffies;
+
+    __asm__ volatile ("sti; hlt");
+    idle_wakeups++;
+    idle_ticks += jiffies - start;
+}
+
+/* Halt with the tick stopped for up to ticks, then add the whole ticks
+ * slept through to jiffies.  tick_tsc advances by those ticks only, so
+ * the part of a tick slept before another interrupt ended the halt
+ * counts towards the next one. */
+static void idle_oneshot(uint32_t ticks) {
+    uint32_t per_tick = (uint32_t)div64_u32((uint64_t)tsc_khz * 1000, TIMER_HZ, NULL);
+    uint32_t count = ticks < PIT_COUNT_MAX / pit_divisor ? ticks * pit_divisor : PIT_COUNT_MAX;
+
+    tick_stopped = 1;
+    pit_program(PIT_ONESHOT, count);
+    __asm__ volatile ("sti; hlt; cli");
+
+    uint32_t slept = (uint32_t)div64_u32(rdtsc() - tick_tsc, per_tick, NULL);
+    jiffies += slept;
+    tick_tsc += (uint64_t)slept * per_tick;
+    tick_stopped = 0;
+    pit_program(PIT_PERIODIC, pit_divisor);
+
+    idle_wakeups++;
+    idle_ticks += slept;
+    if (timers.pending) softirq_raise(SOFTIRQ_TIMER);
+    softirq_run();
+    __asm__ volatile ("sti");
+}
+
+void timer_idle(uint32_t ticks) {
+    uint32_t next = wheel_next(&timers, jiffies);
+
+    if (next < ticks) ticks = next;
+    if (ticks == 0) {
+        if (timers.pending) softirq_raise(SOFTIRQ_TIMER);
+        softirq_run();
+        __asm__ volatile ("sti");
+        return;
+    }
+
+    /* First idle after boot: the TSC measures the ticks slept through */
+    if (nohz && !tsc_khz) tsc_calibrate();
+
+    idle_entries++;
+    if (nohz && ticks > 1 && tsc_khz && pit_divisor && !prof_running()) {
+        idle_oneshot(ticks);
+    } else {
+        idle_periodic();
+    }
+}
+
+void timer_set_nohz(int on) {
+    nohz = on;
+}
+
+/**
+ * idle          - tickless mode and wakeup statistics
+ * idle on|off   - enable or disable tickless idle
+ * idle reset    - clear the statistics
+ */
+void cmd_idle(int argc, char *argv[]) {
+    if (argc > 1 && strcmp(argv[1], "on") == 0) {
+        timer_set_nohz(1);
+    } else if (argc > 1 && strcmp(argv[1], "off") == 0) {
+        timer_set_nohz(0);
+    } else if (argc > 1 && strcmp(argv[1], "reset") == 0) {
+        idle_entries = idle_wakeups = idle_ticks = 0;
+    } else if (argc > 1) {
+        printk("Usage: idle [on|off|reset]\n");
+        return;
+    }
+
+    printk("Mode:      %s\n", nohz ? "tickless (PIT one-shot)" : "periodic");
+    printk("Idle:      %u ms in %u halts, %u wakeups\n",
+           idle_ticks * (1000 / TIMER_HZ), idle_entries, idle_wakeups);
+    if (idle_ticks) {
+        printk("Wakeups/s: %u while idle\n",
+               (uint32_t)div64_u32((uint64_t)idle_wakeups * TIMER_HZ, idle_ticks, NULL));
+    }
+}
+
+/* RTC periodic interrupt (IRQ8), for wakeups that are not the timer's */
+#define CMOS_INDEX      0x70
+#define CMOS_DATA       0x71
+#define CMOS_NMI_OFF    0x80
+#define RTC_REG_A       0x0A
+#define RTC_REG_B       0x0B
+#define RTC_REG_C       0x0C
+#define RTC_B_PIE       0x40        /* Periodic interrupt enable */
+#define RTC_RATE_4096HZ 4           /* 32768 >> (rate - 1) Hz */
+#define RTC_IRQ         8
+
+static uint8_t cmos_read(uint8_t reg) {
+    outb(CMOS_INDEX, CMOS_NMI_OFF | reg);
+    return inb(CMOS_DATA);
+}
+
+static void cmos_write(uint8_t reg, uint8_t val) {
+    outb(CMOS_INDEX, CMOS_NMI_OFF | reg);
+    outb(CMOS_DATA, val);
+}
+
+/* Reading register C acknowledges the interrupt (and re-enables NMI) */
+static void rtc_irq(void *ctx) {
+    (void)ctx;
+    outb(CMOS_INDEX, RTC_REG_C);
+    inb(CMOS_DATA);
+}
+
+/* Start or stop a 4096 Hz RTC interrupt: a wakeup every quarter tick */
+static void rtc_periodic(int on) {
+    static int registered;
+    uint32_t flags = irq_save();
+
+    if (on) {
+        cmos_write(RTC_REG_A, (cmos_read(RTC_REG_A) & 0xF0) | RTC_RATE_4096HZ);
+        cmos_write(RTC_REG_B, cmos_read(RTC_REG_B) | RTC_B_PIE);
+        rtc_irq(NULL);
+        if (!registered) registered = irq_register(RTC_IRQ, rtc_irq, NULL) == 0;
+        else pic_enable_irq(RTC_IRQ);
+    } else {
+        cmos_write(RTC_REG_B, cmos_read(RTC_REG_B) & ~RTC_B_PIE);
+        rtc_irq(NULL);
+        pic_disable_irq(RTC_IRQ);
+    }
+    irq_restore(flags);
+}
+
+/* Wakeups during one second of idle; *drift_us gets the difference
+ * between jiffies and the TSC over that second.  Bounded by the TSC at
+ * two seconds, so a jiffies count that stalls shows up as drift. */
+static uint32_t idle_second(int on, uint32_t *drift_us) {
+    int saved = nohz;
+    uint32_t wakeups = idle_wakeups;
+    uint64_t limit = (uint64_t)tsc_khz * 2000;
+
+    nohz = on;
+    uint32_t start = jiffies;
+    uint64_t tsc_start = rdtsc();
+    while (jiffies - start < TIMER_HZ && rdtsc() - tsc_start < limit) {
+        __asm__ volatile ("cli");
+        timer_idle(TIMER_NONE);
+    }
+    uint32_t tsc_us = tsc_cycles_to_us(rdtsc() - tsc_start);
+    uint32_t jiffies_us = (jiffies - start) * (1000000 / TIMER_HZ);
+    nohz = saved;
+
+    *drift_us = tsc_us > jiffies_us ? tsc_us - jiffies_us : jiffies_us - tsc_us;
+    return idle_wakeups - wakeups;
+}
+
+void bench_idle(void) {
+    uint32_t drift;
+
+    tsc_calibrate();
+    bench_report("idle_wakeups_periodic", idle_second(0, &drift), "wakeups");
+    bench_report("idle_wakeups_nohz", idle_second(1, &drift), "wakeups");
+    bench_report("idle_drift_nohz", drift, "us");
+
+    /* Halts ended early by another device's interrupts */
+    rtc_periodic(1);
+    idle_second(1, &drift);
+    rtc_periodic(0);
+    bench_report("idle_drift_nohz_irq", drift, "us");
+}
+
+/* ------------------------------------------------------- timer stress */
+
+#define TIMER_STRESS_OPS    100000
+#define TIMER_STRESS_POOL   4096
+
+static struct timer stress_timers[TIMER_STRESS_POOL];
+static struct timer_wheel stress_wheel;
+static uint32_t stress_seed = 2463534242u;
+
+static uint32_t stress_rand(void) {
+    stress_seed ^= stress_seed << 13;
+    stress_seed ^= stress_seed >> 17;
+    stress_seed ^= stress_seed << 5;
+    return stress_seed;
+}
+
+/* Distance spread over every level: up to 2^0..2^23 ticks */
+static uint32_t stress_delay(void) {
+    uint32_t r = stress_rand();
+    return 1 + ((r >> 5) & ((1u << (r % 24)) - 1));
+}
+
+static void stress_fn(void *arg) {
+    (void)arg;
+}
+
+struct timer_stress {
+    uint32_t ops;                   /* Of each kind */
+    uint32_t add, mod, del;         /* Cycles per operation */
+    uint32_t expire;                /* Cycles per timer run off a private wheel */
+    uint32_t lost;                  /* Timers not accounted for (should be 0) */
+};
+
+/* Arm, re-arm and cancel TIMER_STRESS_OPS timers on the live wheel in
+ * batches of TIMER_STRESS_POOL, then expire a pool off a private wheel.
+ * The per-operation costs include the API's own irq_save/irq_restore. */
+static void timer_stress(struct timer_stress *st) {
+    uint64_t add = 0, mod = 0, del = 0, start;
+    uint32_t before = timers.pending;
+
+    memset(st, 0, sizeof(*st));
+    for (uint32_t i = 0; i < TIMER_STRESS_POOL; i++) timer_setup(&stress_timers[i], stress_fn, NULL);
+
+    while (st->ops < TIMER_STRESS_OPS) {
+        uint32_t n = TIMER_STRESS_OPS - st->ops;
+        if (n > TIMER_STRESS_POOL) n = TIMER_STRESS_POOL;
+
+        /* No tick may expire a timer under test (each call nests its own save) */
+        uint32_t flags = irq_save();
+        start = rdtsc();
+        for (uint32_t i = 0; i < n; i++) timer_add(&stress_timers[i], jiffies + stress_delay());
+        add += rdtsc() - start;
+
+        start = rdtsc();
+        for (uint32_t i = 0; i < n; i++) timer_mod(&stress_timers[i], jiffies + stress_delay());
+        mod += rdtsc() - start;
+
+        start = rdtsc();
+        for (uint32_t i = 0; i < n; i++) st->lost += !timer_del(&stress_timers[i]);
+        del += rdtsc() - start;
+        irq_restore(flags);
+
+        st->ops += n;
+    }
+    st->lost += timers.pending != before;
+
+    /* Expiry: a pool due within 64K ticks, run off by advancing a clock */
+    wheel_init(&stress_wheel, 0);
+    for (uint32_t i = 0; i < TIMER_STRESS_POOL; i++) {
+        wheel_add(&stress_wheel, &stress_timers[i], 1 + (stress_rand() & 0xFFFF));
+    }
+    uint32_t fired = 0;
+    start = rdtsc();
+    for (uint32_t now = 0; now <= 0x10000; now += 64) {
+        struct timer *t;
+        while ((t = wheel_expire(&stress_wheel, now)) != NULL) {
+            t->fn(t->arg);
+            fired++;
+        }
+    }
+    uint64_t expire = rdtsc() - start;
+    st->lost += fired != TIMER_STRESS_POOL;
+
+    st->add = (uint32_t)div64_u32(add, st->ops, NULL);
+    st->mod = (uint32_t)div64_u32(mod, st->ops, NULL);
+    st->del = (uint32_t)div64_u32(del, st->ops, NULL);
+    st->expire = (uint32_t)div64_u32(expire, TIMER_STRESS_POOL, NULL);
+}
+
+/**
+ * timers         - kernel timer wheel state
+ * timers stress  - arm/re-arm/cancel 100k timers, cycles per operation
+ */
+void cmd_timers(int argc, char *argv[]) {
+    if (argc > 1 && strcmp(argv[1], "stress") == 0) {
+        struct timer_stress st;
+
+        timer_stress(&st);
+        printk("timers stress: %u ops each, add %u, mod %u, del %u, expire %u cycles/op%s\n",
+               st.ops, st.add, st.mod, st.del, st.expire, st.lost ? " (LOST TIMERS)" : "");
+        return;
+    } else if (argc > 1) {
+        printk("Usage: timers [stress]\n");
+        return;
+    }
+
+    uint32_t flags = irq_save();
+    uint32_t pending = timers.pending, clk = timers.clk, next = wheel_next(&timers, jiffies);
+    uint32_t count[WHEEL_LEVELS + 1];
+    for (int lvl = 0; lvl <= WHEEL_LEVELS; lvl++) count[lvl] = wheel_level_count(&timers, lvl);
+    irq_restore(flags);
+
+    printk("Pending:   %u (root %u, levels %u/%u/%u/%u)\n",
+           pending, count[0], count[1], count[2], count[3], count[4]);
+    printk("Clock:     tick %u, jiffies %u\n", clk, jiffies);
+    printk("Fired:     %u, cascaded %u, worst %u ticks late\n",
+           timers_fired, timers.cascaded, timers_late_max);
+    if (next == TIMER_NONE) {
+        printk("Next:      none\n");
+    } else {
+        printk("Next:      in %u ticks\n", next);
+    }
+    printk("Softirq:   %u timer runs\n", softirq_counts[SOFTIRQ_TIMER]);
+}
+
+void bench_timers(void) {
+    struct timer_stress st;
+
+    timer_stress(&st);
+    bench_report("timer_add", st.add, "cycles");
+    bench_report("timer_mod", st.mod, "cycles");
+    bench_report("timer_del", st.del, "cycles");
+    bench_report("timer_expire", st.expire, "cycles");
+}
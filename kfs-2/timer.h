@@ -0,0 +1,70 @@
+#ifndef TIMER_H
+#define TIMER_H
+
+#include <stdint.h>
+#include "idt.h"
+#include "timer_wheel.h"
+
+/*
+ * PIT channel 0 tick and tickless idle.
+ *
+ * jiffies advances once per tick while the CPU is busy.  When the idle
+ * loop has nothing due for a while, timer_idle() stops the periodic tick,
+ * arms a one-shot PIT interrupt for the next deadline and halts; on any
+ * wakeup the ticks slept through are added back to jiffies from the TSC
+ * and the periodic tick restarts.  The PIT counter is 16 bits, so one
+ * sleep lasts at most about 55 ms.  The profiler needs every tick, so
+ * idle falls back to a plain hlt while it runs.
+ *
+ * Kernel timers live on a timer wheel (timer_wheel.h) that the timer
+ * softirq (softirq.h) advances to jiffies after each tick, running due
+ * callbacks with interrupts enabled.  Tickless idle never sleeps past
+ * the next one.
+ */
+
+/* PIT channel 0 periodic tick rate */
+#define TIMER_HZ        1000
+
+/* Ticks since timer_init() */
+extern volatile uint32_t jiffies;
+
+/* Program PIT channel 0 to raise IRQ0 hz times per second */
+void timer_init(uint32_t hz);
+
+/* IRQ0 handler, called from idt_load.asm with the interrupted frame */
+void timer_irq_handler(struct irq_frame *frame);
+
+/* Queue t (set up with timer_setup()) to run on tick expires; -1 if it
+ * is already pending */
+int timer_add(struct timer *t, uint32_t expires);
+
+/* (Re)queue t for expires; 1 if it was pending */
+int timer_mod(struct timer *t, uint32_t expires);
+
+/* Cancel t; 1 if it was pending */
+int timer_del(struct timer *t);
+
+/* Halt for ticks ticks; call with interrupts enabled, not from a timer */
+void timer_sleep(uint32_t ticks);
+
+/* Idle until an interrupt, or for at most ticks ticks (TIMER_NONE: no
+ * deadline).  Called with interrupts disabled, so that a wakeup source
+ * checked just before cannot be missed; returns with them enabled. */
+void timer_idle(uint32_t ticks);
+
+/* Turn tickless idle on or off (on by default) */
+void timer_set_nohz(int on);
+
+/* Shell command: idle [on|off|reset] */
+void cmd_idle(int argc, char *argv[]);
+
+/* Shell command: timers [stress] */
+void cmd_timers(int argc, char *argv[]);
+
+/* Benchmark: idle wakeups per second, tickless vs periodic */
+void bench_idle(void);
+
+/* Benchmark: timer add/mod/del and expiry, cycles per timer */
+void bench_timers(void);
+
+#endif /* TIMER_H */
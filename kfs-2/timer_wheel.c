@@ -0,0 +1,147 @@
+#include "timer_wheel.h"
+
+#define ROOT_MASK           (WHEEL_ROOT_SIZE - 1)
+#define LEVEL_MASK          (WHEEL_LEVEL_SIZE - 1)
+
+/* First clock bit of the slot index at level lvl (1..WHEEL_LEVELS) */
+#define LEVEL_SHIFT(lvl)    (WHEEL_ROOT_BITS + ((lvl) - 1) * WHEEL_LEVEL_BITS)
+
+static void list_add(struct timer **head, struct timer *t) {
+    t->next = *head;
+    if (t->next) t->next->pprev = &t->next;
+    *head = t;
+    t->pprev = head;
+}
+
+static void list_unlink(struct timer *t) {
+    *t->pprev = t->next;
+    if (t->next) t->next->pprev = t->pprev;
+    t->next = NULL;
+    t->pprev = NULL;
+}
+
+/* Slot for a timer firing on expires, by its distance from the clock */
+static struct timer **slot_for(struct timer_wheel *w, uint32_t expires) {
+    uint32_t delta = expires - w->clk;
+
+    if (delta < WHEEL_ROOT_SIZE) return &w->root[expires & ROOT_MASK];
+
+    int lvl = 1;
+    while (lvl < WHEEL_LEVELS && delta >> LEVEL_SHIFT(lvl + 1)) lvl++;
+    return &w->level[lvl - 1][(expires >> LEVEL_SHIFT(lvl)) & LEVEL_MASK];
+}
+
+/* Move the level lvl slot the clock has reached one level down; returns
+ * its index, which is 0 when the level above is due as well */
+static uint32_t cascade(struct timer_wheel *w, int lvl) {
+    uint32_t index = (w->clk >> LEVEL_SHIFT(lvl)) & LEVEL_MASK;
+    struct timer *t = w->level[lvl - 1][index];
+
+    w->level[lvl - 1][index] = NULL;
+    while (t) {
+        struct timer *next = t->next;
+        list_add(slot_for(w, t->expires), t);
+        w->cascaded++;
+        t = next;
+    }
+    return index;
+}
+
+void wheel_init(struct timer_wheel *w, uint32_t now) {
+    for (size_t i = 0; i < WHEEL_ROOT_SIZE; i++) w->root[i] = NULL;
+    for (int lvl = 0; lvl < WHEEL_LEVELS; lvl++) {
+        for (size_t i = 0; i < WHEEL_LEVEL_SIZE; i++) w->level[lvl][i] = NULL;
+    }
+    w->expired = NULL;
+    w->clk = now;
+    w->pending = 0;
+    w->cascaded = 0;
+}
+
+void timer_setup(struct timer *t, void (*fn)(void *arg), void *arg) {
+    t->next = NULL;
+    t->pprev = NULL;
+    t->expires = 0;
+    t->fn = fn;
+    t->arg = arg;
+}
+
+void wheel_add(struct timer_wheel *w, struct timer *t, uint32_t expires) {
+    t->expires = expires;
+    if (time_before(expires, w->clk)) {
+        list_add(&w->expired, t);           /* Its tick is already processed */
+    } else {
+        list_add(slot_for(w, expires), t);
+    }
+    w->pending++;
+}
+
+int wheel_del(struct timer_wheel *w, struct timer *t) {
+    if (!timer_pending(t)) return 0;
+
+    list_unlink(t);
+    w->pending--;
+    return 1;
+}
+
+struct timer *wheel_expire(struct timer_wheel *w, uint32_t now) {
+    for (;;) {
+        if (w->expired) {
+            struct timer *t = w->expired;
+            list_unlink(t);
+            w->pending--;
+            return t;
+        }
+        if (time_after(w->clk, now)) return NULL;
+        if (!w->pending) {
+            w->clk = now + 1;               /* Nothing to cascade on the way */
+            return NULL;
+        }
+
+        uint32_t index = w->clk & ROOT_MASK;
+        if (index == 0) {
+            for (int lvl = 1; lvl <= WHEEL_LEVELS && cascade(w, lvl) == 0; lvl++) {}
+        }
+
+        struct timer *due = w->root[index];
+        if (due) {
+            w->root[index] = NULL;
+            w->expired = due;
+            due->pprev = &w->expired;
+        }
+        w->clk++;
+    }
+}
+
+uint32_t wheel_next(const struct timer_wheel *w, uint32_t now) {
+    uint32_t index = w->clk & ROOT_MASK;
+    uint32_t at;
+
+    if (w->expired) return 0;
+    if (!w->pending) return TIMER_NONE;
+
+    /* A cascade pending at the clock itself may refill the root */
+    if (index == 0) {
+        at = w->clk;
+    } else {
+        at = w->clk + (WHEEL_ROOT_SIZE - index);
+        for (uint32_t i = index; i < WHEEL_ROOT_SIZE; i++) {
+            if (w->root[i]) {
+                at = w->clk + (i - index);
+                break;
+            }
+        }
+    }
+    return time_after(at, now) ? at - now : 0;
+}
+
+uint32_t wheel_level_count(const struct timer_wheel *w, int lvl) {
+    struct timer *const *slots = lvl ? w->level[lvl - 1] : w->root;
+    uint32_t size = lvl ? WHEEL_LEVEL_SIZE : WHEEL_ROOT_SIZE;
+    uint32_t count = 0;
+
+    for (uint32_t i = 0; i < size; i++) {
+        for (const struct timer *t = slots[i]; t; t = t->next) count++;
+    }
+    return count;
+}
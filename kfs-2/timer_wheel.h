@@ -0,0 +1,84 @@
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * Hierarchical timing wheel.
+ *
+ * Five levels of hashed slots cover the whole 32-bit tick range: level 0
+ * has 256 one-tick slots, levels 1-4 have 64 slots each 64 times wider
+ * than the level below.  A timer goes into the finest level its distance
+ * from the wheel clock fits, so adding one is a shift, a compare and a
+ * list insert, and deleting one is an unlink.  Each time the clock's
+ * low bits wrap, the next slot of the level above is redistributed
+ * ("cascaded") one level down; a timer is moved at most four times in its
+ * life, so expiry is amortised O(1) however many timers are pending.
+ *
+ * The wheel does no locking and calls nothing; the caller provides the
+ * current tick and runs the timers that wheel_expire() hands back
+ * (timer.h does this for the kernel's wheel, from the timer softirq).
+ *
+ * Portable: also built into the host tests.
+ */
+
+#define WHEEL_ROOT_BITS     8
+#define WHEEL_LEVEL_BITS    6
+#define WHEEL_ROOT_SIZE     (1 << WHEEL_ROOT_BITS)
+#define WHEEL_LEVEL_SIZE    (1 << WHEEL_LEVEL_BITS)
+#define WHEEL_LEVELS        4       /* Above the root */
+
+/* No deadline */
+#define TIMER_NONE          0xFFFFFFFFu
+
+/* Wrap-safe tick comparisons */
+#define time_after(a, b)        ((int32_t)((b) - (a)) < 0)
+#define time_after_eq(a, b)     ((int32_t)((a) - (b)) >= 0)
+#define time_before(a, b)       time_after(b, a)
+
+struct timer {
+    struct timer *next;
+    struct timer **pprev;           /* NULL when not pending */
+    uint32_t expires;               /* Tick the timer fires on */
+    void (*fn)(void *arg);
+    void *arg;
+};
+
+struct timer_wheel {
+    uint32_t clk;                   /* Next tick to process */
+    uint32_t pending;               /* Timers added and not yet handed back */
+    uint32_t cascaded;              /* Timers moved down a level */
+    struct timer *expired;          /* Due, waiting for wheel_expire() */
+    struct timer *root[WHEEL_ROOT_SIZE];
+    struct timer *level[WHEEL_LEVELS][WHEEL_LEVEL_SIZE];
+};
+
+/* Empty wheel whose clock starts at now */
+void wheel_init(struct timer_wheel *w, uint32_t now);
+
+void timer_setup(struct timer *t, void (*fn)(void *arg), void *arg);
+
+static inline int timer_pending(const struct timer *t) {
+    return t->pprev != NULL;
+}
+
+/* Queue t (not pending) to fire on tick expires; a tick already passed
+ * fires on the next wheel_expire() */
+void wheel_add(struct timer_wheel *w, struct timer *t, uint32_t expires);
+
+/* Unqueue t; 1 if it was pending */
+int wheel_del(struct timer_wheel *w, struct timer *t);
+
+/* Advance the clock to now and unqueue one due timer; NULL once none is
+ * left.  The caller runs t->fn(t->arg). */
+struct timer *wheel_expire(struct timer_wheel *w, uint32_t now);
+
+/* Ticks from now until the wheel next has to be advanced (possibly
+ * early, at a cascade), 0 if a timer is due, TIMER_NONE if empty */
+uint32_t wheel_next(const struct timer_wheel *w, uint32_t now);
+
+/* Timers queued at level lvl (0 is the root, 1..WHEEL_LEVELS above) */
+uint32_t wheel_level_count(const struct timer_wheel *w, int lvl);
+
+#endif /* TIMER_WHEEL_H */
@@ -0,0 +1,78 @@
+#!/usr/bin/env python3
+"""Extract .gcda profiles dumped by the kernel's gcov runtime (gcov.h).
+
+The "gcov dump" shell command writes every instrumented object's
+profile to the debug console as text records:
+
+    @gcda begin <file.gcda> <bytes>
+    @gcda <hex>
+    ...
+    @gcda end
+
+This tool finds them in a log (by default debugcon.log, where printk
+output is interleaved line by line) and writes each file into --dir,
+where -fprofile-use looks for it next to the object.  Objects dumped more
+than once keep the last dump.  Exit status 1 if a record is truncated or
+no profile is found.
+"""
+
+import argparse
+import os
+import re
+import sys
+
+BEGIN_RE = re.compile(r"^@gcda begin (\S+) (\d+)$")
+DATA_RE = re.compile(r"^@gcda ([0-9a-f]+)$")
+
+
+def parse(lines):
+    """Return {name: bytes} and a list of errors."""
+    files, errors = {}, []
+    name, size, data = None, 0, bytearray()
+    for line in lines:
+        line = line.rstrip("\r\n")
+        m = BEGIN_RE.match(line)
+        if m:
+            if name:
+                errors.append(f"{name}: no end record")
+            name, size, data = m.group(1), int(m.group(2)), bytearray()
+            continue
+        if name is None:
+            continue
+        if line == "@gcda end":
+            if len(data) != size:
+                errors.append(f"{name}: {len(data)} bytes, expected {size}")
+            else:
+                files[name] = bytes(data)
+            name = None
+            continue
+        m = DATA_RE.match(line)
+        if m:
+            data += bytes.fromhex(m.group(1))
+    if name:
+        errors.append(f"{name}: no end record")
+    return files, errors
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    ap.add_argument("log", nargs="?", default="debugcon.log", help="log with @gcda records")
+    ap.add_argument("--dir", default=".", help="where to write the .gcda files")
+    args = ap.parse_args()
+
+    with open(args.log, errors="replace") as f:
+        files, errors = parse(f)
+    for err in errors:
+        print(f"gcda: {err}", file=sys.stderr)
+    for name, data in sorted(files.items()):
+        if os.path.basename(name) != name or not name.endswith(".gcda"):
+            print(f"gcda: skipping odd name {name!r}", file=sys.stderr)
+            continue
+        with open(os.path.join(args.dir, name), "wb") as out:
+            out.write(data)
+    print(f"gcda: wrote {len(files)} profiles to {args.dir}")
+    return 1 if errors or not files else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,113 @@
+#!/usr/bin/env python3
+"""Generate the kernel symbol table from `nm -n` output.
+
+Reads nm output on stdin and writes a C file defining the tables declared
+in ksyms.h on stdout: sorted function addresses, front-coded names and
+block restart offsets, all placed in the .ksyms section.  With empty
+input it produces the empty table used for the first link pass.
+
+With --verify FILE, the table generated from stdin is compared with FILE
+instead, and the exit status is non-zero if they differ; the Makefile
+uses this to prove the second link pass did not move any function.
+"""
+
+import argparse
+import sys
+
+# Must match ksyms.h
+KSYMS_BLOCK = 16
+MAX_NAME = 255
+
+# Section bounds defined in linker.ld, not functions
+LINKER_MARKERS = {"_text_start", "_text_end", "__init_begin"}
+
+
+def read_symbols(stream):
+    syms = {}
+    for line in stream:
+        parts = line.split()
+        if len(parts) != 3:
+            continue
+        addr, kind, name = parts
+        if kind not in "Tt" or name in LINKER_MARKERS:
+            continue
+        # Several names at one address: prefer a global one
+        addr = int(addr, 16)
+        if addr not in syms or (kind == "T" and syms[addr][0] == "t"):
+            syms[addr] = (kind, name[:MAX_NAME])
+    return sorted((addr, name) for addr, (kind, name) in syms.items())
+
+
+def encode_names(names):
+    """Front-code names, restarting every KSYMS_BLOCK entries."""
+    blob, blocks, prev = bytearray(), [], b""
+    for i, name in enumerate(names):
+        name = name.encode()
+        if i % KSYMS_BLOCK == 0:
+            blocks.append(len(blob))
+            prev = b""
+        shared = 0
+        while shared < min(len(prev), len(name)) and prev[shared] == name[shared]:
+            shared += 1
+        blob += bytes([shared, len(name) - shared]) + name[shared:]
+        prev = name
+    return blob, blocks
+
+
+def c_array(values, fmt, per_line):
+    values = list(values) or [0]   # C does not allow empty arrays
+    lines = []
+    for i in range(0, len(values), per_line):
+        lines.append("    " + ", ".join(fmt.format(v) for v in values[i:i + per_line]) + ",")
+    return "\n".join(lines)
+
+
+def generate(syms):
+    addrs = [addr for addr, _ in syms]
+    names = [name for _, name in syms]
+    blob, blocks = encode_names(names)
+    raw = sum(len(n) + 1 for n in names)
+
+    return "\n".join([
+        "/* Generated by tools/gen_ksyms.py - do not edit */",
+        f"/* {len(syms)} symbols, names {len(blob)} bytes front-coded ({raw} raw) */",
+        '#include "ksyms.h"',
+        "",
+        f"const uint32_t ksyms_count __ksyms = {len(syms)};",
+        "",
+        "const uint32_t ksyms_addrs[] __ksyms = {",
+        c_array(addrs, "0x{:08x}", 6),
+        "};",
+        "",
+        "const uint32_t ksyms_blocks[] __ksyms = {",
+        c_array(blocks, "{}", 8),
+        "};",
+        "",
+        "const uint8_t ksyms_names[] __ksyms = {",
+        c_array(blob, "0x{:02x}", 12),
+        "};",
+        "",
+    ])
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    ap.add_argument("--verify", metavar="FILE",
+                    help="compare with a previously generated table")
+    args = ap.parse_args()
+
+    table = generate(read_symbols(sys.stdin))
+    if args.verify:
+        with open(args.verify) as f:
+            if f.read() != table:
+                print(f"gen_ksyms: text symbols moved since {args.verify} was generated",
+                      file=sys.stderr)
+                return 1
+        return 0
+
+    sys.stdout.write(table)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,62 @@
+#!/usr/bin/env python3
+"""Generate the kernel's text ordering file from profiler samples.
+
+Reads the "@order <function> <self> <inclusive>" lines that the shell's
+"perf order" command prints (from perf-serial.log by default) and writes
+a linker script fragment that linker.ld INCLUDEs inside .text:
+
+    *(.text.hot.printk .text.printk)
+    ...
+
+With -ffunction-sections every function has a section of its own
+(.text.hot.<name> when a profile or __attribute__((hot)) marked it), so
+listing them places the sampled functions next to each other, hottest
+first: functions with their own samples by self count, then their
+callers by inclusive count.  Functions the compiler split (foo.cold) or
+put in .text.unlikely are left where linker.ld puts cold code.
+"""
+
+import argparse
+import re
+import sys
+
+ORDER_RE = re.compile(r"^@order (\S+) (\d+) (\d+)\s*$")
+
+
+def parse(lines):
+    funcs = {}
+    for line in lines:
+        m = ORDER_RE.match(line.strip("\r\n"))
+        if m:
+            name, self_count, incl = m.group(1), int(m.group(2)), int(m.group(3))
+            old = funcs.get(name, (0, 0))
+            funcs[name] = (old[0] + self_count, old[1] + incl)
+    return funcs
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    ap.add_argument("log", nargs="?", default="perf-serial.log", help="log with @order lines")
+    ap.add_argument("--out", default="text_order.ld", help="fragment to write")
+    args = ap.parse_args()
+
+    with open(args.log, errors="replace") as f:
+        funcs = parse(f)
+    if not funcs:
+        print("gen_order: no @order lines (run 'perf order' after sampling)", file=sys.stderr)
+        return 1
+
+    order = sorted(funcs, key=lambda n: (-funcs[n][0], -funcs[n][1], n))
+    with open(args.out, "w") as out:
+        out.write(f"/* Generated by tools/gen_order.py from {len(order)} sampled "
+                  "functions, hottest first */\n")
+        for name in order:
+            if ".cold" in name:
+                continue
+            out.write(f"*(.text.hot.{name} .text.{name})\n")
+    print(f"gen_order: {len(order)} functions -> {args.out}")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,191 @@
+#!/usr/bin/env python3
+"""Tail the kernel log ring in an ivshmem backing file.
+
+The kernel lays out its printk ring directly in the memory BAR of an
+ivshmem-plain device (ivlog.h), which QEMU backs with a host file.  This
+tool maps that file and prints records as they are published, without
+any guest involvement.
+
+Records are read by sequence number.  A record counts as lost when the
+kernel's tail_seq has moved past it, either before it was read or while
+it was being copied.  A header whose checksum does not match was torn by
+a concurrent rewrite and is treated the same way.  Lost ranges are
+reported on stderr and reading resumes at the oldest record still in
+the ring.  A new boot_id (kernel restarted the ring) restarts from the
+beginning.
+"""
+
+import argparse
+import mmap
+import os
+import struct
+import sys
+import time
+
+# Must match ivlog.h
+MAGIC = 0x4C56494B
+VERSION = 1
+HEADER = struct.Struct("<16I")          # struct ivlog_header
+RECORD = struct.Struct("<IHHQII")       # struct ivlog_record
+F_PAD = 0x0001
+F_TRUNC = 0x0002
+
+(H_MAGIC, H_VERSION, H_DATA_OFFSET, H_DATA_SIZE, H_TSC_KHZ, H_BOOT_ID,
+ H_HEAD, H_HEAD_SEQ, H_TAIL, H_TAIL_SEQ, H_TRUNCATED) = range(11)
+
+
+def fnv1a(data):
+    h = 2166136261
+    for b in data:
+        h = ((h ^ b) * 16777619) & 0xFFFFFFFF
+    return h
+
+
+def seq_before(a, b):
+    """a < b in 32-bit sequence space."""
+    return a != b and ((b - a) & 0xFFFFFFFF) < 0x80000000
+
+
+class Ring:
+    def __init__(self, mem):
+        self.mem = mem
+
+    def header(self):
+        return HEADER.unpack_from(self.mem, 0)
+
+    def field(self, index):
+        return struct.unpack_from("<I", self.mem, index * 4)[0]
+
+    def record(self, base, off):
+        """(seq, len, flags, tsc) at data offset off, or None if torn."""
+        raw = bytes(self.mem[base + off:base + off + RECORD.size])
+        seq, length, flags, tsc, _, checksum = RECORD.unpack(raw)
+        if fnv1a(raw[:RECORD.size - 4]) != checksum:
+            return None
+        return seq, length, flags, tsc
+
+
+class Reader:
+    def __init__(self, ring, out, from_start):
+        self.ring = ring
+        self.out = out
+        self.from_start = from_start
+        self.boot_id = None
+        self.lost = 0
+        self.torn = 0
+
+    def start(self, hdr):
+        self.boot_id = hdr[H_BOOT_ID]
+        self.base = hdr[H_DATA_OFFSET]
+        self.size = hdr[H_DATA_SIZE]
+        if self.from_start:
+            self.off, self.seq = hdr[H_TAIL], hdr[H_TAIL_SEQ]
+        else:
+            self.off, self.seq = hdr[H_HEAD], hdr[H_HEAD_SEQ]
+        # After a restart, read the new ring from its beginning
+        self.from_start = True
+
+    def resync(self):
+        """Jump to the oldest record; False if the tail is moving."""
+        tail_seq = self.ring.field(H_TAIL_SEQ)
+        tail = self.ring.field(H_TAIL)
+        rec = self.ring.record(self.base, tail) if tail + RECORD.size <= self.size else None
+        if rec is None or rec[0] != tail_seq or self.ring.field(H_TAIL_SEQ) != tail_seq:
+            return False
+        missed = (tail_seq - self.seq) & 0xFFFFFFFF
+        if missed:
+            self.lost += missed
+            print(f"ivlog: {missed} records lost (overwritten before read)", file=sys.stderr)
+        self.off, self.seq = tail, tail_seq
+        return True
+
+    def stamp(self, tsc, khz):
+        if not khz:
+            return f"[{tsc:>16}] "
+        us = tsc * 1000 // khz
+        return f"[{us // 1000000:5}.{us % 1000000:06}] "
+
+    def poll(self):
+        """Print every published record; returns how many were printed."""
+        hdr = self.ring.header()
+        if hdr[H_MAGIC] != MAGIC or hdr[H_VERSION] != VERSION:
+            return 0
+        if hdr[H_BOOT_ID] != self.boot_id:
+            if self.boot_id is not None:
+                print("ivlog: kernel restarted the ring", file=sys.stderr)
+            self.start(hdr)
+
+        printed = 0
+        head_seq = hdr[H_HEAD_SEQ]
+        while seq_before(self.seq, head_seq):
+            if seq_before(self.seq, self.ring.field(H_TAIL_SEQ)):
+                if not self.resync():
+                    break
+                continue
+
+            if self.size - self.off < RECORD.size:
+                self.off = 0
+                continue
+
+            rec = self.ring.record(self.base, self.off)
+            if rec is None or (not rec[2] & F_PAD and rec[0] != self.seq):
+                # Torn or already reused: the tail must have passed us
+                self.torn += 1
+                if not self.resync():
+                    break
+                continue
+
+            seq, length, flags, tsc = rec
+            if flags & F_PAD:
+                self.off = 0
+                continue
+
+            start = self.base + self.off + RECORD.size
+            text = bytes(self.ring.mem[start:start + length])
+            if seq_before(self.seq, self.ring.field(H_TAIL_SEQ)):
+                continue    # Overwritten while copying; resync on the next pass
+
+            line = self.stamp(tsc, hdr[H_TSC_KHZ]) + text.decode("utf-8", "replace")
+            if flags & F_TRUNC:
+                line += " [truncated]\n"
+            self.out.write(line)
+            printed += 1
+            self.seq = (self.seq + 1) & 0xFFFFFFFF
+            self.off += (RECORD.size + length + 7) & ~7
+            if self.off >= self.size:
+                self.off = 0
+        if printed:
+            self.out.flush()
+        return printed
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    ap.add_argument("path", help="ivshmem backing file (mem-path= of the memory backend)")
+    ap.add_argument("-f", "--follow", action="store_true", help="keep waiting for new records")
+    ap.add_argument("-n", "--new", action="store_true",
+                    help="skip records already in the ring")
+    ap.add_argument("--interval", type=float, default=0.01, help="poll interval in seconds")
+    args = ap.parse_args()
+
+    fd = os.open(args.path, os.O_RDONLY)
+    mem = mmap.mmap(fd, 0, mmap.MAP_SHARED, mmap.PROT_READ)
+    reader = Reader(Ring(mem), sys.stdout, not args.new)
+
+    try:
+        while True:
+            printed = reader.poll()
+            if not args.follow and not printed:
+                break
+            if not printed:
+                time.sleep(args.interval)
+    except KeyboardInterrupt:
+        pass
+
+    if reader.lost or reader.torn:
+        print(f"ivlog: {reader.lost} records lost, {reader.torn} torn reads", file=sys.stderr)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,96 @@
+#!/usr/bin/env python3
+"""Compare kernel builds: code size, instruction counts and benchmarks.
+
+Each build is given as LABEL=KERNEL,PERF_JSON: the linked kernel image
+and the summary `make perf` wrote for it.  The first build is the
+reference; every other column shows its value and the change against
+it.  Instruction counts are static (instructions in .text, as
+disassembled by objdump); the benchmarks carry the dynamic picture.
+For units ending in "/s" higher is better, for all others lower.
+"""
+
+import argparse
+import json
+import re
+import subprocess
+import sys
+
+INSN_RE = re.compile(r"^\s*[0-9a-f]+:\t[0-9a-f ]+\t\S")
+
+
+def text_stats(objdump, kernel):
+    """(text bytes, instruction count) of kernel's .text."""
+    out = subprocess.run([objdump, "-h", kernel], capture_output=True, text=True,
+                         check=True).stdout
+    size = 0
+    for line in out.splitlines():
+        fields = line.split()
+        if len(fields) > 2 and fields[1] == ".text":
+            size = int(fields[2], 16)
+    out = subprocess.run([objdump, "-d", "-j", ".text", kernel], capture_output=True,
+                         text=True, check=True).stdout
+    insns = sum(1 for line in out.splitlines() if INSN_RE.match(line))
+    return size, insns
+
+
+def delta(cur, ref, unit):
+    """Change in percent, signed so that positive is always better."""
+    if ref == 0:
+        return ""
+    pct = 100.0 * (cur - ref) / ref
+    if not unit.endswith("/s"):
+        pct = -pct
+    pct += 0.0                          # No "-0.0%"
+    return f"{pct:+.1f}%"
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    ap.add_argument("builds", nargs="+", metavar="LABEL=KERNEL,PERF_JSON")
+    ap.add_argument("--objdump", default="objdump", help="objdump for the kernel's target")
+    args = ap.parse_args()
+
+    builds = []
+    for spec in args.builds:
+        label, _, files = spec.partition("=")
+        kernel, _, perf = files.partition(",")
+        if not label or not kernel or not perf:
+            ap.error(f"bad build {spec!r}")
+        with open(perf) as f:
+            metrics = json.load(f)["metrics"]
+        builds.append((label, text_stats(args.objdump, kernel), metrics))
+
+    col = 22
+    print(f"{'':<28}" + "".join(f"{b[0]:>{col}}" for b in builds))
+
+    ref = builds[0]
+    for i, (name, unit) in enumerate((("text", "bytes"), ("instructions", "insns"))):
+        row = f"{name + ' (' + unit + ')':<28}"
+        for _, stats, _ in builds:
+            d = "" if stats is ref[1] else " " + delta(stats[i], ref[1][i], "")
+            row += f"{str(stats[i]) + d:>{col}}"
+        print(row)
+    print()
+
+    names = sorted(set().union(*(b[2] for b in builds)))
+    for name in names:
+        ref_m = ref[2].get(name)
+        unit = ref_m["unit"] if ref_m else ""
+        row = f"{name:<28}"
+        for _, _, metrics in builds:
+            m = metrics.get(name)
+            if m is None:
+                cell = "-"
+            elif ref_m is None or m is ref_m or m["unit"] != unit:
+                cell = f"{m['value']} {m['unit']}"
+            else:
+                cell = f"{m['value']} {delta(m['value'], ref_m['value'], unit)}"
+            row += f"{cell:>{col}}"
+        print(row)
+    print("\nChanges are against the first build; positive is better "
+          "(smaller code, faster benchmark).")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
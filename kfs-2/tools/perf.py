@@ -0,0 +1,230 @@
+#!/usr/bin/env python3
+"""Headless QEMU boot-and-benchmark runner for the KFS-2 kernel.
+
+Boots the ISO with the serial port on stdio and an isa-debug-exit device,
+waits for the shell prompt, types the commands from a script file, and
+collects every "@bench <name> <value> <unit>" line the kernel prints.
+The run ends when the kernel writes to the debug-exit port (shell command
+"exit <code>"), which QEMU turns into process status (code << 1) | 1.
+
+A JSON summary is written to --out.  With --baseline, every metric is
+compared against a previous summary and the run fails when any metric
+regresses by more than --threshold percent.  Units ending in "/s" are
+higher-is-better; all others (cycles, us, ...) are lower-is-better.
+
+Exit status: 0 on success, 1 on regression, 2 on boot/protocol failure.
+"""
+
+import argparse
+import json
+import os
+import re
+import shlex
+import subprocess
+import sys
+import threading
+import time
+
+PROMPT = b"kernel> "
+BENCH_RE = re.compile(r"^@bench (\S+) (-?\d+) (\S+)\s*$")
+
+
+class Console:
+    """Collects QEMU serial output on a background thread."""
+
+    def __init__(self, proc, log):
+        self.proc = proc
+        self.log = log
+        self.buf = bytearray()
+        self.cond = threading.Condition()
+        self.thread = threading.Thread(target=self._pump, daemon=True)
+        self.thread.start()
+
+    def _pump(self):
+        while True:
+            chunk = self.proc.stdout.read1(4096)
+            if not chunk:
+                break
+            self.log.write(chunk)
+            self.log.flush()
+            with self.cond:
+                self.buf += chunk
+                self.cond.notify_all()
+        with self.cond:
+            self.cond.notify_all()
+
+    def wait_for(self, needle, start, timeout):
+        """Wait until needle appears at or after offset start; return its end."""
+        deadline = time.monotonic() + timeout
+        with self.cond:
+            while True:
+                pos = self.buf.find(needle, start)
+                if pos >= 0:
+                    return pos + len(needle)
+                remaining = deadline - time.monotonic()
+                if remaining <= 0 or self.proc.poll() is not None:
+                    return -1
+                self.cond.wait(min(remaining, 0.1))
+
+    def wait_idle_at(self, needle, settle, timeout):
+        """Wait until output ends with needle and stays unchanged for settle s."""
+        deadline = time.monotonic() + timeout
+        with self.cond:
+            while time.monotonic() < deadline and self.proc.poll() is None:
+                size = len(self.buf)
+                if self.buf.endswith(needle):
+                    self.cond.wait(settle)
+                    if len(self.buf) == size:
+                        return True
+                else:
+                    self.cond.wait(0.1)
+        return False
+
+    def size(self):
+        with self.cond:
+            return len(self.buf)
+
+    def text(self):
+        with self.cond:
+            return self.buf.decode("utf-8", errors="replace")
+
+    def send(self, line, char_delay):
+        # The shell polls the UART; pace characters so its FIFO never overflows.
+        for ch in line.encode() + b"\r":
+            self.proc.stdin.write(bytes([ch]))
+            self.proc.stdin.flush()
+            time.sleep(char_delay)
+
+
+def git_commit():
+    try:
+        out = subprocess.run(["git", "rev-parse", "--short", "HEAD"],
+                             capture_output=True, text=True, check=True)
+        return out.stdout.strip()
+    except (OSError, subprocess.CalledProcessError):
+        return "unknown"
+
+
+def read_script(path):
+    with open(path) as f:
+        lines = [l.strip() for l in f]
+    return [l for l in lines if l and not l.startswith("#")]
+
+
+def parse_metrics(text):
+    metrics = {}
+    for line in text.splitlines():
+        m = BENCH_RE.match(line.strip("\r"))
+        if m:
+            metrics[m.group(1)] = {"value": int(m.group(2)), "unit": m.group(3)}
+    return metrics
+
+
+def compare(metrics, baseline, threshold):
+    """Return (report lines, regression count)."""
+    report, regressions = [], 0
+    for name, cur in sorted(metrics.items()):
+        old = baseline.get(name)
+        if old is None or old["unit"] != cur["unit"] or old["value"] == 0:
+            report.append(f"  {name:<28} {cur['value']:>12} {cur['unit']:<10} (new)")
+            continue
+        delta = 100.0 * (cur["value"] - old["value"]) / old["value"]
+        worse = -delta if cur["unit"].endswith("/s") else delta
+        flag = ""
+        if worse > threshold:
+            flag = "  REGRESSION"
+            regressions += 1
+        report.append(f"  {name:<28} {cur['value']:>12} {cur['unit']:<10} "
+                      f"{delta:+7.1f}%{flag}")
+    return report, regressions
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    ap.add_argument("--qemu", required=True, help="QEMU command line")
+    ap.add_argument("--script", required=True, help="shell commands, one per line")
+    ap.add_argument("--out", default="perf-results.json", help="JSON summary path")
+    ap.add_argument("--log", default="perf-serial.log", help="raw serial transcript")
+    ap.add_argument("--baseline", help="previous JSON summary to compare against")
+    ap.add_argument("--threshold", type=float, default=10.0,
+                    help="allowed regression in percent (default 10)")
+    ap.add_argument("--timeout", type=float, default=120.0,
+                    help="seconds allowed for boot and for each command")
+    ap.add_argument("--settle", type=float, default=0.5,
+                    help="quiet seconds after the prompt that mark the end of boot")
+    ap.add_argument("--char-delay", type=float, default=0.002,
+                    help="seconds between typed characters")
+    args = ap.parse_args()
+
+    script = read_script(args.script)
+    started = time.monotonic()
+
+    with open(args.log, "wb") as log:
+        proc = subprocess.Popen(shlex.split(args.qemu), stdin=subprocess.PIPE,
+                                stdout=subprocess.PIPE, stderr=sys.stderr)
+        con = Console(proc, log)
+
+        # The boot demo prints the prompt several times (none on fast boot);
+        # the interactive one is the last output before the kernel goes quiet.
+        if not con.wait_idle_at(PROMPT, args.settle, args.timeout):
+            proc.kill()
+            print("perf: kernel never reached the interactive prompt", file=sys.stderr)
+            return 2
+        boot_s = time.monotonic() - started
+
+        for cmd in script:
+            start = con.size()
+            con.send(cmd, args.char_delay)
+            if con.wait_for(PROMPT, start, args.timeout) < 0:
+                break
+
+        try:
+            status = proc.wait(timeout=args.timeout)
+        except subprocess.TimeoutExpired:
+            proc.kill()
+            status = proc.wait()
+        con.thread.join(timeout=1)
+
+    text = con.text()
+    exit_match = re.search(r"^@exit (\d+)", text, re.M)
+    if not exit_match or status != (int(exit_match.group(1)) << 1 | 1):
+        print(f"perf: QEMU exited with status {status} without a kernel exit",
+              file=sys.stderr)
+        return 2
+    kernel_code = int(exit_match.group(1))
+
+    metrics = parse_metrics(text)
+    summary = {
+        "commit": git_commit(),
+        "timestamp": int(time.time()),
+        "qemu": args.qemu,
+        "script": script,
+        "kernel_exit_code": kernel_code,
+        "host_boot_to_prompt_s": round(boot_s, 3),
+        "metrics": metrics,
+    }
+    with open(args.out, "w") as f:
+        json.dump(summary, f, indent=2, sort_keys=True)
+        f.write("\n")
+
+    baseline = {}
+    if args.baseline and os.path.exists(args.baseline):
+        with open(args.baseline) as f:
+            baseline = json.load(f).get("metrics", {})
+
+    report, regressions = compare(metrics, baseline, args.threshold)
+    print(f"perf: commit {summary['commit']}, {len(metrics)} metrics -> {args.out}")
+    print("\n".join(report))
+
+    if kernel_code != 0:
+        print(f"perf: kernel exited with code {kernel_code}", file=sys.stderr)
+        return 2
+    if regressions:
+        print(f"perf: {regressions} metric(s) regressed by more than "
+              f"{args.threshold:g}%", file=sys.stderr)
+        return 1
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
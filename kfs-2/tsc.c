@@ -0,0 +1,55 @@
+#include "tsc.h"
+#include "div64.h"
+#include <stddef.h>
+
+/* PIT channel 2 is gated through the PC speaker control port */
+#define PIT_CH2_DATA    0x42
+#define PIT_COMMAND     0x43
+#define PIT_SPEAKER     0x61
+#define PIT_FREQUENCY   1193182
+#define CALIBRATE_MS    10
+
+uint32_t tsc_khz = 0;
+
+static inline void outb(uint16_t port, uint8_t val) {
+    __asm__ volatile ("outb %0, %1" : : "a"(val), "Nd"(port));
+}
+
+static inline uint8_t inb(uint16_t port) {
+    uint8_t ret;
+    __asm__ volatile ("inb %1, %0" : "=a"(ret) : "Nd"(port));
+    return ret;
+}
+
+/**
+ * Count TSC ticks while PIT channel 2 counts down CALIBRATE_MS
+ * milliseconds in mode 0 (interrupt on terminal count).  Channel 2
+ * does not raise IRQ0, so this is safe with interrupts enabled.
+ */
+uint32_t tsc_calibrate(void) {
+    const uint16_t count = PIT_FREQUENCY / (1000 / CALIBRATE_MS);
+    uint8_t speaker = inb(PIT_SPEAKER);
+
+    /* Gate high, speaker output off */
+    outb(PIT_SPEAKER, (speaker & ~0x02) | 0x01);
+
+    /* Channel 2, lobyte/hibyte, mode 0, binary */
+    outb(PIT_COMMAND, 0xB0);
+    outb(PIT_CH2_DATA, count & 0xFF);
+    outb(PIT_CH2_DATA, count >> 8);
+
+    uint64_t start = rdtsc();
+    while ((inb(PIT_SPEAKER) & 0x20) == 0) {}
+    uint64_t end = rdtsc();
+
+    outb(PIT_SPEAKER, speaker);
+
+    tsc_khz = (uint32_t)(end - start) / CALIBRATE_MS;
+    if (tsc_khz == 0) tsc_khz = 1;
+    return tsc_khz;
+}
+
+uint32_t tsc_cycles_to_us(uint64_t cycles) {
+    if (tsc_khz == 0) tsc_calibrate();
+    return (uint32_t)div64_u32(cycles * 1000, tsc_khz, NULL);
+}
@@ -0,0 +1,22 @@
+#ifndef TSC_H
+#define TSC_H
+
+#include <stdint.h>
+
+/* Read the CPU time-stamp counter */
+static inline uint64_t rdtsc(void) {
+    uint32_t lo, hi;
+    __asm__ volatile ("rdtsc" : "=a"(lo), "=d"(hi));
+    return ((uint64_t)hi << 32) | lo;
+}
+
+/* TSC frequency in kHz, 0 until tsc_calibrate() has run */
+extern uint32_t tsc_khz;
+
+/* Measure the TSC frequency against PIT channel 2 (takes ~10 ms) */
+uint32_t tsc_calibrate(void);
+
+/* Convert a TSC cycle count to microseconds (calibrates on first use) */
+uint32_t tsc_cycles_to_us(uint64_t cycles);
+
+#endif /* TSC_H */
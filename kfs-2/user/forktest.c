@@ -0,0 +1,28 @@
+#include "user.h"
+
+#define say(s) sys_write(s, sizeof(s) - 1)
+
+static volatile int counter;                /* Shared until someone writes it */
+
+int main(void) {
+    counter = 1;                            /* Resident (and writable) before the fork */
+    int pid = sys_fork();
+
+    if (pid == 0) {
+        counter = 42;
+        say("child: wrote its copy of counter\n");
+        return 7;
+    }
+    if (pid < 0) {
+        say("parent: fork failed\n");
+        return 1;
+    }
+
+    int code = sys_wait(pid);
+    if (code != 7 || counter != 1) {
+        say("parent: FAIL, child's write leaked or exit code lost\n");
+        return 1;
+    }
+    say("parent: counter untouched, child exited with 7\n");
+    return 0;
+}
@@ -0,0 +1,11 @@
+#include "user.h"
+
+static char greeting[] = "Hello from an ELF program\n";    /* .data: copied on first touch */
+static char scratch[64 * 1024];                             /* .bss: only touched pages become resident */
+
+int main(void) {
+    scratch[0] = 1;
+    scratch[sizeof(scratch) - 1] = 1;
+    sys_write(greeting, sizeof(greeting) - 1);
+    return scratch[4096];
+}
@@ -0,0 +1,6 @@
+#include "user.h"
+
+/* Entry point: a program's main() returns its exit code */
+void _start(void) {
+    sys_exit(main());
+}
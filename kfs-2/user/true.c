@@ -0,0 +1,6 @@
+#include "user.h"
+
+/* Does nothing: the exec benchmark measures only the launch */
+int main(void) {
+    return 0;
+}
@@ -0,0 +1,34 @@
+#ifndef USER_USER_H
+#define USER_USER_H
+
+#include <stdint.h>
+#include "usermode.h"
+
+/*
+ * Runtime for the ring 3 programs in user/.  They are linked on their
+ * own (start.c provides _start), loaded by elf.c and talk to the kernel
+ * only through int 0x80.
+ */
+
+int main(void);
+
+static inline uint32_t sys_write(const void *buf, uint32_t len) {
+    return syscall_int80(SYS_WRITE, (uint32_t)buf, len, 0);
+}
+
+/* Child pid in the parent, 0 in the child; the child has already
+ * finished when the parent gets here (see proc.h) */
+static inline int sys_fork(void) {
+    return (int)syscall_int80(SYS_FORK, 0, 0, 0);
+}
+
+static inline int sys_wait(int pid) {
+    return (int)syscall_int80(SYS_WAIT, (uint32_t)pid, 0, 0);
+}
+
+static inline __attribute__((noreturn)) void sys_exit(int code) {
+    syscall_int80(SYS_EXIT, (uint32_t)code, 0, 0);
+    for (;;) {}
+}
+
+#endif /* USER_USER_H */
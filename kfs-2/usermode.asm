@@ -0,0 +1,155 @@
+; usermode.asm - Ring 3 entry/exit and the system call entry points
+
+section .text
+global user_enter
+global user_resume
+global user_return
+global syscall_int80_entry
+global sysenter_entry
+
+extern syscall_dispatch
+extern syscall_int80_dispatch
+extern user_kernel_stack
+extern tss
+
+USER_CS     equ 0x23            ; GDT user code, RPL 3
+USER_DS     equ 0x2B            ; GDT user data, RPL 3 (also the user SS)
+KERNEL_DS   equ 0x10
+
+; Kernel context saved by user_enter/user_resume and restored by
+; user_return.  Entries nest (fork runs the child inside the parent's
+; system call), so each context also keeps the outer one's
+; user_kernel_esp and TSS.esp0.
+%macro SAVE_KERNEL_CONTEXT 0
+    pushfd
+    push ebp
+    push ebx
+    push esi
+    push edi
+    push dword [tss + 4]        ; tss.esp0
+    push dword [user_kernel_esp]
+    mov [user_kernel_esp], esp
+%endmacro
+
+%macro LOAD_USER_SEGMENTS 0
+    mov dx, USER_DS
+    mov ds, dx
+    mov es, dx
+    mov fs, dx
+    mov gs, dx
+%endmacro
+
+; int user_enter(int (*entry)(void *), void *arg, uint32_t user_esp)
+; Switches to ring 3 at entry(arg); "returns" when user_return() is called
+user_enter:
+    SAVE_KERNEL_CONTEXT
+
+    mov eax, [esp + 32]         ; entry
+    mov edx, [esp + 36]         ; arg
+    mov ecx, [esp + 40]         ; Top of the user stack
+    sub ecx, 8
+    mov [ecx + 4], edx          ; entry(arg) ...
+    mov dword [ecx], user_exit_stub ; ... returns into SYS_EXIT
+
+    LOAD_USER_SEGMENTS
+
+    ; iret frame for a privilege change: SS, ESP, EFLAGS, CS, EIP
+    push USER_DS
+    push ecx
+    pushfd
+    or dword [esp], 0x200       ; IF: interrupts stay on in ring 3
+    push USER_CS
+    push eax
+    iretd
+
+; int user_resume(const struct syscall_frame *regs)
+; Back to ring 3 with every register taken from regs; ring 3 traps now
+; land below this context, so the caller's frames survive
+user_resume:
+    SAVE_KERNEL_CONTEXT
+
+    push esp
+    call user_kernel_stack      ; tss.esp0 (and SYSENTER_ESP) = here
+    add esp, 4
+
+    mov eax, [esp + 32]         ; regs
+    push dword [eax + 48]       ; SS
+    push dword [eax + 44]       ; ESP
+    push dword [eax + 40]       ; EFLAGS
+    push dword [eax + 36]       ; CS
+    push dword [eax + 32]       ; EIP
+
+    LOAD_USER_SEGMENTS
+
+    mov edi, [eax + 0]
+    mov esi, [eax + 4]
+    mov ebp, [eax + 8]
+    mov ebx, [eax + 16]
+    mov edx, [eax + 20]
+    mov ecx, [eax + 24]
+    mov eax, [eax + 28]
+    iretd
+
+; Runs in ring 3: exit with entry()'s return value
+user_exit_stub:
+    mov ebx, eax
+    mov eax, 1                  ; SYS_EXIT
+    int 0x80
+    jmp user_exit_stub
+
+; void user_return(int code) - back to the innermost user_enter() or
+; user_resume() caller with code
+user_return:
+    mov ebx, [esp + 4]          ; Exit code (EBX is reloaded below)
+    mov esp, [user_kernel_esp]
+    mov dx, KERNEL_DS
+    mov ds, dx
+    mov es, dx
+    mov fs, dx
+    mov gs, dx
+    pop dword [user_kernel_esp]
+    call user_kernel_stack      ; Argument: the saved tss.esp0
+    add esp, 4
+    mov eax, ebx
+    pop edi
+    pop esi
+    pop ebx
+    pop ebp
+    popfd
+    ret
+
+; int 0x80: EAX = number, EBX/ESI/EDI = arguments, result in EAX.  The
+; whole register set is saved as a struct syscall_frame, which fork
+; copies for the child.
+syscall_int80_entry:
+    pusha
+    cld
+    push esp                    ; struct syscall_frame * argument
+    call syscall_int80_dispatch
+    add esp, 4
+    popa
+    iretd
+
+; sysenter: CS/SS come from IA32_SYSENTER_CS, ESP from IA32_SYSENTER_ESP
+; and interrupts are off.  The caller left its ESP in ECX and its resume
+; EIP in EDX, which is where sysexit takes them from.
+sysenter_entry:
+    push ecx
+    push edx
+    sti
+    push edi
+    push esi
+    push ebx
+    push eax
+    cld
+    call syscall_dispatch
+    add esp, 16
+    cli                         ; sysexit does not restore EFLAGS
+    pop edx
+    pop ecx
+    sti                         ; Takes effect after sysexit
+    sysexit
+
+section .bss
+user_kernel_esp:
+    resd 1
@@ -0,0 +1,208 @@
+#include "usermode.h"
+#include "gdt.h"
+#include "printk.h"
+#include "bench.h"
+#include "lib.h"
+#include "tsc.h"
+#include "cpu.h"
+#include "vm.h"
+#include "proc.h"
+#include "init.h"
+#include "compiler.h"
+
+#define MSR_SYSENTER_CS     0x174
+#define MSR_SYSENTER_ESP    0x175
+#define MSR_SYSENTER_EIP    0x176
+
+#define BUILTIN_STACK_SIZE  16384
+#define USER_KSTACK_SIZE    16384
+
+#define SYSCALL_BENCH_ITERS 10000
+
+/* usermode.asm */
+extern int user_enter(int (*entry)(void *), void *arg, uint32_t user_esp);
+extern void user_return(int code) __attribute__((noreturn));
+extern void syscall_int80_entry(void);
+extern void sysenter_entry(void);
+
+static uint8_t user_stack[BUILTIN_STACK_SIZE] __attribute__((aligned(16)));
+static uint8_t user_kstack[USER_KSTACK_SIZE] __attribute__((aligned(16)));
+static int sysenter_ok;
+static int user_active;
+
+static const char *const exception_names[] = {
+    [3] = "breakpoint",
+    [6] = "invalid opcode",
+    [13] = "general protection fault",
+    [14] = "page fault",
+};
+
+static inline void wrmsr(uint32_t msr, uint64_t value) {
+    __asm__ volatile ("wrmsr" : : "c"(msr), "a"((uint32_t)value), "d"((uint32_t)(value >> 32)));
+}
+
+void syscall_init(void) {
+    uint32_t a, b, c, d;
+    uint32_t esp0 = (uint32_t)(user_kstack + sizeof(user_kstack));
+
+    tss.esp0 = esp0;
+    idt_set_gate(SYSCALL_VECTOR, (uint32_t)syscall_int80_entry, IDT_GATE_TRAP, IDT_DPL_USER);
+
+    /* The Pentium Pro (family 6, model < 3, stepping < 3) reports SEP
+     * without supporting it */
+    cpuid(1, &a, &b, &c, &d);
+    uint32_t family = (a >> 8) & 0xF, model = (a >> 4) & 0xF, stepping = a & 0xF;
+    if (!(d & CPUID_EDX_SEP) || (family == 6 && model < 3 && stepping < 3)) return;
+
+    wrmsr(MSR_SYSENTER_CS, GDT_SYSENTER_CS);
+    wrmsr(MSR_SYSENTER_ESP, esp0);
+    wrmsr(MSR_SYSENTER_EIP, (uint32_t)sysenter_entry);
+    sysenter_ok = 1;
+}
+
+int syscall_has_sysenter(void) {
+    return sysenter_ok;
+}
+
+/* Where ring 3 traps and sysenter start the kernel stack */
+void user_kernel_stack(uint32_t esp0) {
+    if (tss.esp0 == esp0) return;
+
+    tss.esp0 = esp0;
+    if (sysenter_ok) wrmsr(MSR_SYSENTER_ESP, esp0);
+}
+
+uint32_t syscall_dispatch(uint32_t nr, uint32_t a1, uint32_t a2, uint32_t a3) {
+    (void)a3;
+
+    switch (nr) {
+    case SYS_NULL:
+        return 0;
+    case SYS_EXIT:
+        user_return((int)a1);
+    case SYS_WRITE:
+        if (!vm_user_range(a1, a2)) return (uint32_t)-1;
+        printk("%.*s", (int)a2, (const char *)a1);
+        return a2;
+    case SYS_WAIT:
+        return (uint32_t)proc_wait((int)a1);
+    default:
+        return (uint32_t)-1;
+    }
+}
+
+void syscall_int80_dispatch(struct syscall_frame *frame) {
+    if (frame->eax == SYS_FORK) {
+        frame->eax = (uint32_t)proc_fork(frame);
+    } else {
+        frame->eax = syscall_dispatch(frame->eax, frame->ebx, frame->esi, frame->edi);
+    }
+}
+
+/* A fault nothing could resolve: kill the ring 3 program, or stop */
+static void __cold exception_report(struct irq_frame *frame, uint32_t cr2) {
+    const char *name = NULL;
+
+    if (frame->int_no < sizeof(exception_names) / sizeof(exception_names[0])) {
+        name = exception_names[frame->int_no];
+    }
+    if (!name) name = "exception";
+
+    if ((frame->cs & 3) == 3) {
+        printk(KERN_ERR "user: %s at 0x%08x (error 0x%x, cr2 0x%08x), killed\n",
+               name, frame->eip, frame->err_code, cr2);
+        user_return(-1);
+    }
+
+    /* int3 is a trap: eip is past the poison byte */
+    uint32_t ip = frame->int_no == 3 ? frame->eip - 1 : frame->eip;
+    if (init_freed(ip)) {
+        printk(KERN_EMERG "kernel: executed freed init memory at 0x%08x\n", ip);
+    }
+    printk(KERN_EMERG "kernel: %s at 0x%08x (error 0x%x, cr2 0x%08x)\n",
+           name, frame->eip, frame->err_code, cr2);
+    print_stack();
+    for (;;) __asm__ volatile ("cli; hlt");
+}
+
+void exception_dispatch(struct irq_frame *frame) {
+    uint32_t cr2 = 0;
+
+    if (frame->int_no == 14) {
+        __asm__ volatile ("mov %%cr2, %0" : "=r"(cr2));
+        if (vm_fault(cr2, frame->err_code) == 0) return;    /* Demand paging */
+    }
+    exception_report(frame, cr2);
+}
+
+static int user_start(int (*entry)(void *), void *arg, uint32_t user_esp) {
+    if (user_active) return -1;
+
+    user_active = 1;
+    int code = user_enter(entry, arg, user_esp);
+    user_active = 0;
+    return code;
+}
+
+int user_run(int (*entry)(void *arg), void *arg) {
+    if (vm_current()) return -1;            /* Needs the kernel's address space */
+    return user_start(entry, arg, (uint32_t)(user_stack + sizeof(user_stack)));
+}
+
+int user_exec(uint32_t entry, uint32_t user_esp) {
+    return user_start((int (*)(void *))entry, NULL, user_esp);
+}
+
+/* ------------------------------------------------------- ring 3 code */
+
+static int user_hello(void *arg) {
+    static const char via_int80[] = "Hello from ring 3 (int 0x80)\n";
+    static const char via_sysenter[] = "Hello from ring 3 (sysenter)\n";
+    uint32_t cs;
+
+    syscall_int80(SYS_WRITE, (uint32_t)via_int80, sizeof(via_int80) - 1, 0);
+    if (sysenter_ok) syscall_sysenter(SYS_WRITE, (uint32_t)via_sysenter, sizeof(via_sysenter) - 1, 0);
+    if (arg) __asm__ volatile ("cli");          /* Privileged: #GP */
+
+    __asm__ volatile ("mov %%cs, %0" : "=r"(cs));
+    return (int)(cs & 3);                       /* Exit code: the CPL */
+}
+
+/* Each returns the cycles spent on SYSCALL_BENCH_ITERS null calls */
+static int user_bench_int80(void *arg) {
+    (void)arg;
+    uint64_t start = rdtsc();
+    for (int i = 0; i < SYSCALL_BENCH_ITERS; i++) syscall_int80(SYS_NULL, 0, 0, 0);
+    return (int)(uint32_t)(rdtsc() - start);
+}
+
+static int user_bench_sysenter(void *arg) {
+    (void)arg;
+    uint64_t start = rdtsc();
+    for (int i = 0; i < SYSCALL_BENCH_ITERS; i++) syscall_sysenter(SYS_NULL, 0, 0, 0);
+    return (int)(uint32_t)(rdtsc() - start);
+}
+
+/* usertest [fault]: run a ring 3 program, optionally one that faults */
+void cmd_usertest(int argc, char *argv[]) {
+    int fault = argc > 1 && strcmp(argv[1], "fault") == 0;
+
+    int code = user_run(user_hello, fault ? (void *)1 : NULL);
+    printk("usertest: exit code %d\n", code);
+}
+
+/* Best of three runs, in cycles per call */
+static uint32_t syscall_cost(int (*entry)(void *)) {
+    uint32_t best = 0xFFFFFFFF;
+
+    for (int run = 0; run < 3; run++) {
+        uint32_t cycles = (uint32_t)user_run(entry, NULL);
+        if (cycles < best) best = cycles;
+    }
+    return best / SYSCALL_BENCH_ITERS;
+}
+
+void bench_syscall(void) {
+    bench_report("syscall_int80", syscall_cost(user_bench_int80), "cycles");
+    if (sysenter_ok) bench_report("syscall_sysenter", syscall_cost(user_bench_sysenter), "cycles");
+}
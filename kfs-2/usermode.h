@@ -0,0 +1,95 @@
+#ifndef USERMODE_H
+#define USERMODE_H
+
+#include <stdint.h>
+#include "idt.h"
+
+/*
+ * Ring 3 and system calls.
+ *
+ * user_run() drops into ring 3 at entry(arg) on a user stack, using the
+ * 0x23/0x2B user segments, and returns the exit code once the code
+ * calls SYS_EXIT (or returns, or faults).  Traps from ring 3 land on a
+ * dedicated kernel stack (TSS.esp0 and SYSENTER_ESP both point at its
+ * top), so only one ring 3 context runs at a time, apart from a forked
+ * child, which runs to completion inside its parent's SYS_FORK.  user_run() runs code
+ * built into the kernel in the kernel's address space, where ring 3 can
+ * reach all low memory; user_exec() runs a loaded program (elf.h), which
+ * sees only its own pages.
+ *
+ * System calls have two entry points with one ABI: EAX holds the number,
+ * EBX/ESI/EDI the arguments, and the result comes back in EAX.
+ *
+ *   int 0x80           trap gate with DPL 3; iret back
+ *   sysenter           MSR-programmed entry, sysexit back.  The caller
+ *                      passes its resume EIP in EDX and its ESP in ECX,
+ *                      so those two are clobbered.
+ */
+
+#define SYS_NULL        0           /* Does nothing, returns 0 */
+#define SYS_EXIT        1           /* (code) */
+#define SYS_WRITE       2           /* (buf, len): to printk, returns len */
+#define SYS_FORK        3           /* int 0x80 only: child pid, 0 in the child */
+#define SYS_WAIT        4           /* (pid): exit code of a finished child */
+#define SYS_MAX         5
+
+#define SYSCALL_VECTOR  0x80
+
+/* Registers saved by the int 0x80 entry (usermode.asm) */
+struct syscall_frame {
+    uint32_t edi, esi, ebp, esp, ebx, edx, ecx, eax;  /* pusha */
+    uint32_t eip, cs, eflags;                         /* Pushed by the CPU ... */
+    uint32_t user_esp, user_ss;                       /* ... coming from ring 3 */
+} __attribute__((packed));
+
+/* Install the int 0x80 gate and program the SYSENTER MSRs if the CPU
+ * has them; call after idt_init() */
+void syscall_init(void);
+
+/* 1 if sysenter/sysexit are usable */
+int syscall_has_sysenter(void);
+
+/* Run entry(arg) in ring 3; returns its exit code, -1 if it faulted */
+int user_run(int (*entry)(void *arg), void *arg);
+
+/* Run ring 3 code at entry with the stack at user_esp, in the current
+ * address space (see vm.h); returns the exit code as user_run() does */
+int user_exec(uint32_t entry, uint32_t user_esp);
+
+/* Continue ring 3 with the registers in regs (a forked child), in the
+ * current address space; returns the exit code.  Nests inside a system
+ * call: ring 3 traps use the kernel stack below the caller's frames. */
+int user_resume(const struct syscall_frame *regs);
+
+/* Called from the assembly stubs */
+uint32_t syscall_dispatch(uint32_t nr, uint32_t a1, uint32_t a2, uint32_t a3);
+void syscall_int80_dispatch(struct syscall_frame *frame);
+void user_kernel_stack(uint32_t esp0);
+void exception_dispatch(struct irq_frame *frame);
+
+/* Ring 3 side: issue a system call through either entry point */
+static inline uint32_t syscall_int80(uint32_t nr, uint32_t a1, uint32_t a2, uint32_t a3) {
+    uint32_t ret;
+    __asm__ volatile ("int $0x80"
+                      : "=a"(ret) : "a"(nr), "b"(a1), "S"(a2), "D"(a3) : "memory");
+    return ret;
+}
+
+static inline uint32_t syscall_sysenter(uint32_t nr, uint32_t a1, uint32_t a2, uint32_t a3) {
+    uint32_t ret;
+    __asm__ volatile ("mov %%esp, %%ecx\n\t"
+                      "mov $1f, %%edx\n\t"
+                      "sysenter\n"
+                      "1:"
+                      : "=a"(ret) : "a"(nr), "b"(a1), "S"(a2), "D"(a3)
+                      : "ecx", "edx", "memory", "cc");
+    return ret;
+}
+
+/* Shell command: usertest */
+void cmd_usertest(int argc, char *argv[]);
+
+/* Benchmark: null system call round trip, int 0x80 vs sysenter */
+void bench_syscall(void);
+
+#endif /* USERMODE_H */
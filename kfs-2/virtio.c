@@ -0,0 +1,168 @@
+#include "virtio.h"
+#include "io.h"
+#include "lib.h"
+
+/* Full barrier: the avail index store must be visible before the used
+ * flags are read to decide whether to notify */
+static inline void virtio_mb(void) {
+    __asm__ volatile ("lock; addl $0, 0(%%esp)" : : : "memory");
+}
+
+/* x86 keeps stores in order with stores and loads with loads; only the
+ * compiler has to be stopped from reordering them */
+static inline void virtio_barrier(void) {
+    __asm__ volatile ("" : : : "memory");
+}
+
+int virtio_probe(uint16_t device_id, struct virtio_dev *vdev) {
+    if (pci_find_device(VIRTIO_PCI_VENDOR, device_id, &vdev->pci) < 0) return -1;
+
+    vdev->iobase = pci_bar_io(&vdev->pci, 0);
+    if (!vdev->iobase) return -1;
+    vdev->features = 0;
+
+    pci_enable(&vdev->pci, PCI_COMMAND_IO | PCI_COMMAND_MASTER);
+    outb(vdev->iobase + VIRTIO_REG_STATUS, 0);     /* Reset */
+    outb(vdev->iobase + VIRTIO_REG_STATUS, VIRTIO_STATUS_ACKNOWLEDGE);
+    outb(vdev->iobase + VIRTIO_REG_STATUS, VIRTIO_STATUS_ACKNOWLEDGE | VIRTIO_STATUS_DRIVER);
+    return 0;
+}
+
+uint32_t virtio_negotiate(struct virtio_dev *vdev, uint32_t wanted) {
+    uint32_t offered = inl(vdev->iobase + VIRTIO_REG_DEVICE_FEATURES);
+
+    vdev->features = offered & wanted;
+    outl(vdev->iobase + VIRTIO_REG_GUEST_FEATURES, vdev->features);
+    return vdev->features;
+}
+
+int virtq_setup(struct virtio_dev *vdev, struct virtq *vq, uint16_t index,
+                void *mem, size_t mem_size) {
+    outw(vdev->iobase + VIRTIO_REG_QUEUE_SELECT, index);
+    uint16_t size = inw(vdev->iobase + VIRTIO_REG_QUEUE_SIZE);
+
+    if (size == 0 || size > VIRTQ_MAX_SIZE || (size_t)VIRTQ_RING_BYTES(size) > mem_size ||
+        ((uint32_t)mem & (VIRTQ_ALIGN - 1))) {
+        return -1;
+    }
+
+    memset(mem, 0, VIRTQ_RING_BYTES(size));
+    vq->desc = mem;
+    vq->avail = (struct virtq_avail *)((uint8_t *)mem + 16 * size);
+    vq->used = (struct virtq_used *)((uint8_t *)mem + VIRTQ_ALIGN_UP(16 * size + 6 + 2 * size));
+    vq->size = size;
+    vq->index = index;
+    vq->notify_port = vdev->iobase + VIRTIO_REG_QUEUE_NOTIFY;
+    vq->free_head = 0;
+    vq->num_free = size;
+    vq->avail_idx = 0;
+    vq->last_used = 0;
+    vq->added = 0;
+    vq->kicks = 0;
+    vq->kicks_skipped = 0;
+
+    for (uint16_t i = 0; i < size; i++) {
+        vq->desc[i].next = (uint16_t)(i + 1);
+        vq->token[i] = NULL;
+    }
+
+    /* Completions are polled */
+    vq->avail->flags = VIRTQ_AVAIL_F_NO_INTERRUPT;
+
+    outl(vdev->iobase + VIRTIO_REG_QUEUE_PFN, (uint32_t)mem >> 12);
+    return 0;
+}
+
+void virtio_driver_ok(struct virtio_dev *vdev) {
+    uint8_t status = inb(vdev->iobase + VIRTIO_REG_STATUS);
+    outb(vdev->iobase + VIRTIO_REG_STATUS, status | VIRTIO_STATUS_DRIVER_OK);
+}
+
+void virtio_fail(struct virtio_dev *vdev) {
+    uint8_t status = inb(vdev->iobase + VIRTIO_REG_STATUS);
+    outb(vdev->iobase + VIRTIO_REG_STATUS, status | VIRTIO_STATUS_FAILED);
+}
+
+uint8_t virtio_isr_ack(const struct virtio_dev *vdev) {
+    return inb(vdev->iobase + VIRTIO_REG_ISR);
+}
+
+uint8_t virtio_config_read8(const struct virtio_dev *vdev, uint16_t offset) {
+    return inb(vdev->iobase + VIRTIO_REG_CONFIG + offset);
+}
+
+uint32_t virtio_config_read32(const struct virtio_dev *vdev, uint16_t offset) {
+    return inl(vdev->iobase + VIRTIO_REG_CONFIG + offset);
+}
+
+void virtq_set_interrupts(struct virtq *vq, int on) {
+    vq->avail->flags = on ? 0 : VIRTQ_AVAIL_F_NO_INTERRUPT;
+}
+
+int virtq_add(struct virtq *vq, const struct virtq_buf *bufs, int out, int in, void *token) {
+    int n = out + in;
+
+    if (n == 0 || n > vq->num_free) return -1;
+
+    uint16_t head = vq->free_head;
+    uint16_t i = head;
+
+    for (int k = 0; k < n; k++) {
+        struct virtq_desc *d = &vq->desc[i];
+        d->addr = (uint32_t)bufs[k].addr;
+        d->len = bufs[k].len;
+        d->flags = (uint16_t)((k < n - 1 ? VIRTQ_DESC_F_NEXT : 0) |
+                              (k >= out ? VIRTQ_DESC_F_WRITE : 0));
+        i = d->next;
+    }
+    vq->free_head = i;
+    vq->num_free = (uint16_t)(vq->num_free - n);
+    vq->token[head] = token;
+
+    vq->avail->ring[vq->avail_idx % vq->size] = head;
+    vq->avail_idx++;
+    vq->added++;
+    return 0;
+}
+
+int virtq_kick(struct virtq *vq) {
+    if (!vq->added) return 0;
+
+    virtio_barrier();
+    vq->avail->idx = vq->avail_idx;
+    vq->added = 0;
+
+    virtio_mb();
+    if (vq->used->flags & VIRTQ_USED_F_NO_NOTIFY) {
+        vq->kicks_skipped++;
+        return 0;
+    }
+    outw(vq->notify_port, vq->index);
+    vq->kicks++;
+    return 1;
+}
+
+void *virtq_get_used(struct virtq *vq, uint32_t *len) {
+    if (vq->last_used == vq->used->idx) return NULL;
+    virtio_barrier();
+
+    struct virtq_used_elem e = vq->used->ring[vq->last_used % vq->size];
+    uint16_t head = (uint16_t)e.id;
+    void *token = vq->token[head];
+
+    /* Return the chain to the free list */
+    uint16_t i = head;
+    uint16_t n = 1;
+    while (vq->desc[i].flags & VIRTQ_DESC_F_NEXT) {
+        i = vq->desc[i].next;
+        n++;
+    }
+    vq->desc[i].next = vq->free_head;
+    vq->free_head = head;
+    vq->num_free = (uint16_t)(vq->num_free + n);
+    vq->token[head] = NULL;
+    vq->last_used++;
+
+    if (len) *len = e.len;
+    return token;
+}
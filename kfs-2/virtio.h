@@ -0,0 +1,156 @@
+#ifndef VIRTIO_H
+#define VIRTIO_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "pci.h"
+
+/*
+ * Virtio over PCI, legacy interface (virtio 0.9.5): the device registers
+ * are in I/O BAR0 and each queue is one physically contiguous split ring.
+ * QEMU's virtio devices are transitional, so they offer this interface
+ * next to the modern one.  The kernel runs on a 4 MB identity map
+ * (vm.h), so ring and buffer addresses are used as physical addresses
+ * directly.
+ *
+ * Queues start with interrupts suppressed and are polled; a driver that
+ * wants completion interrupts enables them with virtq_set_interrupts()
+ * and acknowledges them with virtio_isr_ack().
+ */
+
+#define VIRTIO_PCI_VENDOR           0x1AF4
+#define VIRTIO_PCI_DEVICE_BLOCK     0x1001  /* Legacy/transitional IDs */
+#define VIRTIO_PCI_DEVICE_CONSOLE   0x1003
+
+/* Legacy register block (BAR0), without MSI-X */
+#define VIRTIO_REG_DEVICE_FEATURES  0x00    /* 32 */
+#define VIRTIO_REG_GUEST_FEATURES   0x04    /* 32 */
+#define VIRTIO_REG_QUEUE_PFN        0x08    /* 32, ring address >> 12 */
+#define VIRTIO_REG_QUEUE_SIZE       0x0C    /* 16, read-only */
+#define VIRTIO_REG_QUEUE_SELECT     0x0E    /* 16 */
+#define VIRTIO_REG_QUEUE_NOTIFY     0x10    /* 16 */
+#define VIRTIO_REG_STATUS           0x12    /* 8 */
+#define VIRTIO_REG_ISR              0x13    /* 8 */
+#define VIRTIO_REG_CONFIG           0x14    /* Device-specific */
+
+/* ISR status bits (reading the register clears them) */
+#define VIRTIO_ISR_QUEUE            0x01
+#define VIRTIO_ISR_CONFIG           0x02
+
+/* Device status bits */
+#define VIRTIO_STATUS_ACKNOWLEDGE   0x01
+#define VIRTIO_STATUS_DRIVER        0x02
+#define VIRTIO_STATUS_DRIVER_OK     0x04
+#define VIRTIO_STATUS_FAILED        0x80
+
+/* Descriptor flags */
+#define VIRTQ_DESC_F_NEXT           1
+#define VIRTQ_DESC_F_WRITE          2   /* Device writes this buffer */
+
+#define VIRTQ_AVAIL_F_NO_INTERRUPT  1
+#define VIRTQ_USED_F_NO_NOTIFY      1
+
+struct virtq_desc {
+    uint64_t addr;
+    uint32_t len;
+    uint16_t flags;
+    uint16_t next;
+};
+
+struct virtq_avail {
+    uint16_t flags;
+    uint16_t idx;
+    uint16_t ring[];
+};
+
+struct virtq_used_elem {
+    uint32_t id;
+    uint32_t len;
+};
+
+struct virtq_used {
+    uint16_t flags;
+    uint16_t idx;
+    struct virtq_used_elem ring[];
+};
+
+/* Largest queue a driver's ring memory is sized for */
+#define VIRTQ_MAX_SIZE  256
+
+/* Legacy ring layout: descriptors and avail ring, then the used ring on
+ * the next 4 KB boundary */
+#define VIRTQ_ALIGN             4096
+#define VIRTQ_ALIGN_UP(x)       (((x) + VIRTQ_ALIGN - 1) & ~(VIRTQ_ALIGN - 1))
+#define VIRTQ_RING_BYTES(n)     (VIRTQ_ALIGN_UP(16 * (n) + 6 + 2 * (n)) + \
+                                 VIRTQ_ALIGN_UP(6 + 8 * (n)))
+
+struct virtio_dev {
+    struct pci_dev pci;
+    uint16_t iobase;
+    uint32_t features;          /* Negotiated */
+};
+
+struct virtq {
+    struct virtq_desc *desc;
+    struct virtq_avail *avail;
+    volatile struct virtq_used *used;
+    uint16_t size;
+    uint16_t index;
+    uint16_t notify_port;
+    uint16_t free_head;         /* Free descriptors are linked through next */
+    uint16_t num_free;
+    uint16_t avail_idx;         /* Shadow of avail->idx */
+    uint16_t last_used;         /* Next used entry to reclaim */
+    uint16_t added;             /* Chains added since the last kick */
+    uint32_t kicks;             /* Notifies written (one VM exit each) */
+    uint32_t kicks_skipped;     /* Notifies the device asked us to skip */
+    void *token[VIRTQ_MAX_SIZE];
+};
+
+/* One buffer of a chain */
+struct virtq_buf {
+    const void *addr;
+    uint32_t len;
+};
+
+/* Find the first legacy device_id function, reset it and set ACKNOWLEDGE
+ * and DRIVER.  Returns 0 or -1 if there is no such device. */
+int virtio_probe(uint16_t device_id, struct virtio_dev *vdev);
+
+/* Accept the subset of wanted that the device offers; returns it */
+uint32_t virtio_negotiate(struct virtio_dev *vdev, uint32_t wanted);
+
+/* Set up queue index in mem (VIRTQ_ALIGN aligned, mem_size bytes).
+ * Returns 0, or -1 if the queue does not exist or does not fit. */
+int virtq_setup(struct virtio_dev *vdev, struct virtq *vq, uint16_t index,
+                void *mem, size_t mem_size);
+
+void virtio_driver_ok(struct virtio_dev *vdev);
+void virtio_fail(struct virtio_dev *vdev);
+
+/* Read and clear the ISR status, deasserting the INTx line */
+uint8_t virtio_isr_ack(const struct virtio_dev *vdev);
+
+uint8_t virtio_config_read8(const struct virtio_dev *vdev, uint16_t offset);
+uint32_t virtio_config_read32(const struct virtio_dev *vdev, uint16_t offset);
+
+/* Ask the device to interrupt (on != 0) or not when it uses buffers */
+void virtq_set_interrupts(struct virtq *vq, int on);
+
+/* Queue a chain of out device-readable buffers followed by in
+ * device-writable ones.  token is returned by virtq_get_used() once the
+ * device is done with it and must not be NULL.  Returns 0, or -1 if
+ * there are not enough free descriptors.  Nothing reaches the device
+ * before virtq_kick(). */
+int virtq_add(struct virtq *vq, const struct virtq_buf *bufs, int out, int in, void *token);
+
+/* Publish the chains added since the last kick and notify the device
+ * unless it suppressed notifications.  Returns 1 if it notified. */
+int virtq_kick(struct virtq *vq);
+
+/* Reclaim the next completed chain: returns its token and stores the
+ * number of bytes the device wrote in *len (if len is not NULL), or
+ * returns NULL if nothing has completed */
+void *virtq_get_used(struct virtq *vq, uint32_t *len);
+
+#endif /* VIRTIO_H */
@@ -0,0 +1,143 @@
+#include "virtio_blk.h"
+#include "virtio.h"
+#include "blk.h"
+#include "irq.h"
+#include "io.h"
+#include "printk.h"
+
+/* Feature bits */
+#define VIRTIO_BLK_F_SEG_MAX    (1u << 2)
+#define VIRTIO_BLK_F_RO         (1u << 5)
+
+/* Device configuration */
+#define VIRTIO_BLK_CFG_CAPACITY 0       /* 64-bit, in 512-byte sectors */
+#define VIRTIO_BLK_CFG_SEG_MAX  12
+
+/* Request types and status */
+#define VIRTIO_BLK_T_IN         0
+#define VIRTIO_BLK_T_OUT        1
+#define VIRTIO_BLK_S_OK         0
+
+#define VBLK_MAX_SEGS           64      /* Data segments per command */
+#define VBLK_MAX_SECTORS        2048    /* 1 MB per command */
+
+struct virtio_blk_req_hdr {
+    uint32_t type;
+    uint32_t reserved;
+    uint64_t sector;
+};
+
+/* Per-command header and status, kept until the device is done */
+struct vblk_slot {
+    struct virtio_blk_req_hdr hdr;
+    volatile uint8_t status;
+    struct blk_req *req;
+};
+
+static struct virtio_dev vblk_dev;
+static struct virtq vblk_vq;
+static uint8_t vblk_ring[VIRTQ_RING_BYTES(VIRTQ_MAX_SIZE)] __attribute__((aligned(VIRTQ_ALIGN)));
+static struct vblk_slot vblk_slots[VBLK_SLOTS];
+static uint32_t vblk_free_slots = 0xFFFFFFFFu;     /* Bit i: slot i is free */
+
+static int vblk_submit(struct blk_dev *dev, struct blk_req *req);
+static void vblk_commit(struct blk_dev *dev);
+
+static const struct blk_ops vblk_ops = {
+    .submit = vblk_submit,
+    .commit = vblk_commit,
+};
+
+static struct blk_dev vblk_blk = {
+    .name = "vda",
+    .ops = &vblk_ops,
+};
+
+static int vblk_submit(struct blk_dev *dev, struct blk_req *req) {
+    struct virtq_buf bufs[VBLK_MAX_SEGS + 2];
+    int n = 0;
+
+    (void)dev;
+    if (!vblk_free_slots) return -1;
+
+    int s = __builtin_ctz(vblk_free_slots);
+    struct vblk_slot *slot = &vblk_slots[s];
+
+    slot->hdr.type = req->op == BLK_WRITE ? VIRTIO_BLK_T_OUT : VIRTIO_BLK_T_IN;
+    slot->hdr.reserved = 0;
+    slot->hdr.sector = req->sector;
+    slot->status = 0xFF;
+    slot->req = req;
+
+    bufs[n].addr = &slot->hdr;
+    bufs[n++].len = sizeof(slot->hdr);
+    for (struct blk_req *r = req; r; r = r->merge_next) {
+        for (int i = 0; i < r->nseg; i++) {
+            bufs[n].addr = r->seg[i].buf;
+            bufs[n++].len = r->seg[i].len;
+        }
+    }
+    bufs[n].addr = (const void *)&slot->status;
+    bufs[n++].len = 1;
+
+    /* Reads: header out, data and status in.  Writes: status in only. */
+    int out = req->op == BLK_WRITE ? n - 1 : 1;
+    if (virtq_add(&vblk_vq, bufs, out, n - out, slot) < 0) return -1;
+
+    vblk_free_slots &= ~(1u << s);
+    return 0;
+}
+
+static void vblk_commit(struct blk_dev *dev) {
+    (void)dev;
+    virtq_kick(&vblk_vq);
+}
+
+static void vblk_irq(void *ctx) {
+    struct vblk_slot *slot;
+
+    (void)ctx;
+    /* Reading ISR acknowledges the interrupt; 0 means another device on
+     * a shared line raised it */
+    if (!(virtio_isr_ack(&vblk_dev) & VIRTIO_ISR_QUEUE)) return;
+
+    while ((slot = virtq_get_used(&vblk_vq, NULL)) != NULL) {
+        struct blk_req *req = slot->req;
+        int status = slot->status == VIRTIO_BLK_S_OK ? BLK_OK : BLK_EIO;
+
+        vblk_free_slots |= 1u << (slot - vblk_slots);
+        blk_complete(&vblk_blk, req, status);
+    }
+}
+
+int virtio_blk_init(void) {
+    if (virtio_probe(VIRTIO_PCI_DEVICE_BLOCK, &vblk_dev) < 0) return -1;
+
+    uint32_t features = virtio_negotiate(&vblk_dev, VIRTIO_BLK_F_SEG_MAX | VIRTIO_BLK_F_RO);
+    if (virtq_setup(&vblk_dev, &vblk_vq, 0, vblk_ring, sizeof(vblk_ring)) < 0) {
+        virtio_fail(&vblk_dev);
+        return -1;
+    }
+    virtq_set_interrupts(&vblk_vq, 1);
+
+    uint32_t seg_max = VBLK_MAX_SEGS;
+    if (features & VIRTIO_BLK_F_SEG_MAX) {
+        uint32_t dev_max = virtio_config_read32(&vblk_dev, VIRTIO_BLK_CFG_SEG_MAX);
+        if (dev_max && dev_max < seg_max) seg_max = dev_max;
+    }
+    /* A command needs its data segments plus header and status */
+    if (seg_max > (uint32_t)vblk_vq.size - 2) seg_max = vblk_vq.size - 2;
+
+    vblk_blk.nsectors = virtio_config_read32(&vblk_dev, VIRTIO_BLK_CFG_CAPACITY) |
+                        ((uint64_t)virtio_config_read32(&vblk_dev, VIRTIO_BLK_CFG_CAPACITY + 4) << 32);
+    vblk_blk.max_segs = seg_max;
+    vblk_blk.max_sectors = VBLK_MAX_SECTORS;
+    vblk_blk.read_only = (features & VIRTIO_BLK_F_RO) != 0;
+
+    if (irq_register(vblk_dev.pci.irq_line, vblk_irq, NULL) < 0) {
+        virtio_fail(&vblk_dev);
+        return -1;
+    }
+    virtio_driver_ok(&vblk_dev);
+    return blk_register(&vblk_blk);
+}
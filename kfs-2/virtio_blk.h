@@ -0,0 +1,23 @@
+#ifndef VIRTIO_BLK_H
+#define VIRTIO_BLK_H
+
+/*
+ * virtio-blk block device ("vda").
+ *
+ * Up to VBLK_SLOTS commands are in flight on the single request queue;
+ * completions are taken from the device's PCI interrupt.  Each block
+ * layer command, merged requests included, becomes one descriptor chain:
+ * request header, one descriptor per data segment, status byte.  The
+ * queue is notified once per batch of commands (blk_ops.commit).
+ *
+ *   qemu ... -drive file=disk.img,if=none,id=disk0,format=raw \
+ *            -device virtio-blk-pci,drive=disk0
+ */
+
+#define VBLK_SLOTS      32
+
+/* Register the block device if a virtio-blk device is present.
+ * Returns 0 on success, -1 if there is none. */
+int virtio_blk_init(void);
+
+#endif /* VIRTIO_BLK_H */
@@ -0,0 +1,240 @@
+#include "virtio_console.h"
+#include "virtio.h"
+#include "printk.h"
+#include "bench.h"
+#include "lib.h"
+#include "cpu.h"
+#include "timer.h"
+#include "tsc.h"
+#include "div64.h"
+
+/* Port 0 queues (no MULTIPORT); only transmit is used */
+#define VCON_TX_QUEUE       1
+
+#define VCON_SEGS           16          /* Ring of output segments */
+#define VCON_SEG_SIZE       4096        /* One descriptor each */
+#define VCON_BATCH_SEGS     4           /* Full segments that trigger a submit */
+#define VCON_FLUSH_MS       10          /* Longest a partial batch is held back */
+#define VCON_SPIN_LIMIT     50000000    /* Polls before a stuck device is dropped */
+
+static struct virtio_dev vcon_dev;
+static struct virtq vcon_txq;
+static uint8_t vcon_ring[VIRTQ_RING_BYTES(VIRTQ_MAX_SIZE)] __attribute__((aligned(VIRTQ_ALIGN)));
+
+static char vcon_seg[VCON_SEGS][VCON_SEG_SIZE];
+static uint16_t vcon_seg_len[VCON_SEGS];
+
+/*
+ * Running segment numbers, slot = n % VCON_SEGS:
+ * [seg_done, seg_sent) are with the device, [seg_sent, seg_open) are full
+ * and waiting, seg_open is being filled once its slot is free.
+ */
+static uint32_t seg_done, seg_sent, seg_open;
+static uint32_t last_submit;
+static int vcon_ready;
+
+static void vcon_write(const char *s, size_t len);
+static void vcon_flush(void);
+
+static struct printk_sink vcon_sink = {
+    .name  = "virtio",
+    .write = vcon_write,
+    .flush = vcon_flush,
+    .level = LOGLEVEL_DEBUG,
+    .enabled = 1,
+};
+
+static void vcon_reclaim(void) {
+    void *token;
+
+    while ((token = virtq_get_used(&vcon_txq, NULL)) != NULL) seg_done += (uint32_t)token;
+}
+
+static int vcon_pending(void) {
+    return seg_sent != seg_open || vcon_seg_len[seg_open % VCON_SEGS] != 0;
+}
+
+/* Pass everything written so far to the device as one chain, one notify */
+static void vcon_submit(void) {
+    struct virtq_buf bufs[VCON_SEGS];
+
+    if (vcon_seg_len[seg_open % VCON_SEGS]) {
+        seg_open++;
+        vcon_seg_len[seg_open % VCON_SEGS] = 0;
+    }
+
+    uint32_t n = seg_open - seg_sent;
+    if (n == 0) return;
+
+    for (uint32_t i = 0; i < n; i++) {
+        uint32_t slot = (seg_sent + i) % VCON_SEGS;
+        bufs[i].addr = vcon_seg[slot];
+        bufs[i].len = vcon_seg_len[slot];
+    }
+
+    /* Cannot fail: at most VCON_SEGS descriptors are ever in use */
+    virtq_add(&vcon_txq, bufs, (int)n, 0, (void *)n);
+    virtq_kick(&vcon_txq);
+    seg_sent = seg_open;
+    last_submit = jiffies;
+}
+
+/* Wait until the device has returned all segments up to seg;
+ * returns -1 (and gives up on the device) if it stops making progress */
+static int vcon_wait(uint32_t seg) {
+    uint32_t spins = 0;
+
+    while ((int32_t)(seg - seg_done) > 0) {
+        uint32_t before = seg_done;
+        vcon_reclaim();
+        if (seg_done != before) {
+            spins = 0;
+        } else if (++spins == VCON_SPIN_LIMIT) {
+            vcon_ready = 0;
+            vcon_sink.enabled = 0;
+            return -1;
+        } else {
+            __asm__ volatile ("pause");
+        }
+    }
+    return 0;
+}
+
+static void vcon_write(const char *s, size_t len) {
+    uint32_t flags = irq_save();
+
+    while (len && vcon_ready) {
+        /* The open segment's slot is still with the device: send what is
+         * waiting and wait for the oldest batch */
+        if (seg_open - seg_done >= VCON_SEGS) {
+            if (seg_sent != seg_open) vcon_submit();
+            if (vcon_wait(seg_open - VCON_SEGS + 1) < 0) break;
+        }
+
+        uint32_t slot = seg_open % VCON_SEGS;
+        size_t room = VCON_SEG_SIZE - vcon_seg_len[slot];
+        size_t n = len < room ? len : room;
+
+        memcpy(vcon_seg[slot] + vcon_seg_len[slot], s, n);
+        vcon_seg_len[slot] = (uint16_t)(vcon_seg_len[slot] + n);
+        s += n;
+        len -= n;
+
+        if (vcon_seg_len[slot] == VCON_SEG_SIZE) {
+            seg_open++;
+            vcon_seg_len[seg_open % VCON_SEGS] = 0;
+        }
+    }
+    irq_restore(flags);
+}
+
+/* End of a printk: submit once a batch is full or the oldest pending
+ * output has waited long enough */
+static void vcon_flush(void) {
+    uint32_t flags = irq_save();
+
+    vcon_reclaim();
+    if (seg_open - seg_sent >= VCON_BATCH_SEGS ||
+        (vcon_pending() && jiffies - last_submit >= VCON_FLUSH_MS)) {
+        vcon_submit();
+    }
+    irq_restore(flags);
+}
+
+void virtio_console_poll(void) {
+    if (!vcon_ready || (!vcon_pending() && seg_done == seg_sent)) return;
+
+    uint32_t flags = irq_save();
+    vcon_reclaim();
+    vcon_submit();
+    irq_restore(flags);
+}
+
+uint32_t virtio_console_poll_delay(void) {
+    if (!vcon_ready || (!vcon_pending() && seg_done == seg_sent)) return TIMER_NONE;
+    return vcon_pending() ? 0 : 1;          /* Completions are polled, not signalled */
+}
+
+void virtio_console_sync(void) {
+    if (!vcon_ready) return;
+
+    uint32_t flags = irq_save();
+    vcon_submit();
+    vcon_wait(seg_sent);
+    irq_restore(flags);
+}
+
+int virtio_console_init(void) {
+    if (virtio_probe(VIRTIO_PCI_DEVICE_CONSOLE, &vcon_dev) < 0) return -1;
+
+    virtio_negotiate(&vcon_dev, 0);
+    if (virtq_setup(&vcon_dev, &vcon_txq, VCON_TX_QUEUE, vcon_ring, sizeof(vcon_ring)) < 0 ||
+        vcon_txq.size < VCON_SEGS) {
+        virtio_fail(&vcon_dev);
+        return -1;
+    }
+    virtio_driver_ok(&vcon_dev);
+    vcon_ready = 1;
+    return printk_register_sink(&vcon_sink);
+}
+
+/* Benchmark */
+
+#define BENCH_SERIAL_RECORDS    256
+#define BENCH_VIRTIO_RECORDS    16384
+
+static const char bench_record[] =
+    "bench: virtio-console throughput, one 96-byte log record per write+flush ......................\n";
+
+/* Feed records to one sink the way printk does: write, then flush */
+static uint64_t bench_sink(struct printk_sink *sink, uint32_t records) {
+    uint64_t start = rdtsc();
+
+    for (uint32_t i = 0; i < records; i++) {
+        sink->write(bench_record, sizeof(bench_record) - 1);
+        if (sink->flush) sink->flush();
+    }
+    if (sink == &vcon_sink) virtio_console_sync();
+    return rdtsc() - start;
+}
+
+static uint32_t bench_kb_per_s(uint32_t bytes, uint64_t cycles) {
+    uint64_t num = (uint64_t)bytes * tsc_khz * 1000 / 1024;
+
+    while (cycles > 0xFFFFFFFFu) {
+        cycles >>= 1;
+        num >>= 1;
+    }
+    return cycles ? (uint32_t)div64_u32(num, (uint32_t)cycles, NULL) : 0;
+}
+
+static uint32_t bench_exits_per_mb(uint32_t exits, uint32_t bytes) {
+    return (uint32_t)div64_u32((uint64_t)exits << 20, bytes, NULL);
+}
+
+void bench_virtio_console(void) {
+    const uint32_t len = sizeof(bench_record) - 1;
+    struct printk_sink *serial = printk_sink_find("serial");
+
+    if (tsc_khz == 0) tsc_calibrate();
+
+    if (serial) {
+        uint32_t io = serial_port_io;
+        uint64_t cycles = bench_sink(serial, BENCH_SERIAL_RECORDS);
+        io = serial_port_io - io;
+        bench_report("serial_throughput", bench_kb_per_s(BENCH_SERIAL_RECORDS * len, cycles), "KB/s");
+        bench_report("serial_exits", bench_exits_per_mb(io, BENCH_SERIAL_RECORDS * len), "exits/MB");
+    }
+
+    if (!vcon_ready) {
+        printk("virtio-console: no device\n");
+        return;
+    }
+
+    virtio_console_sync();
+    uint32_t kicks = vcon_txq.kicks;
+    uint64_t cycles = bench_sink(&vcon_sink, BENCH_VIRTIO_RECORDS);
+    kicks = vcon_txq.kicks - kicks;
+    bench_report("virtio_throughput", bench_kb_per_s(BENCH_VIRTIO_RECORDS * len, cycles), "KB/s");
+    bench_report("virtio_exits", bench_exits_per_mb(kicks, BENCH_VIRTIO_RECORDS * len), "exits/MB");
+}
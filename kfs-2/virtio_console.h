@@ -0,0 +1,37 @@
+#ifndef VIRTIO_CONSOLE_H
+#define VIRTIO_CONSOLE_H
+
+#include <stdint.h>
+
+/*
+ * virtio-console printk sink ("virtio").
+ *
+ * Every byte sent to the COM1 UART costs at least two VM exits (status
+ * poll and data write).  This sink copies log records into a ring of
+ * 4 KB segments instead and hands several full segments to the device as
+ * one descriptor chain with a single queue notify, so the exit count is
+ * per batch rather than per byte.  A partial batch goes out after
+ * VCON_FLUSH_MS, when the shell is idle, or on virtio_console_sync().
+ *
+ *   qemu ... -device virtio-serial-pci \
+ *            -chardev file,id=vcon,path=virtio.log \
+ *            -device virtconsole,chardev=vcon
+ */
+
+/* Register the sink if a virtio-console device is present.
+ * Returns 0 on success, -1 if there is none. */
+int virtio_console_init(void);
+
+/* Reclaim finished batches and submit any pending output (idle loop) */
+void virtio_console_poll(void);
+
+/* Ticks until virtio_console_poll() has work again, TIMER_NONE if idle */
+uint32_t virtio_console_poll_delay(void);
+
+/* Submit pending output and wait until the device has consumed it */
+void virtio_console_sync(void);
+
+/* Benchmark: serial vs virtio throughput and exits */
+void bench_virtio_console(void);
+
+#endif /* VIRTIO_CONSOLE_H */
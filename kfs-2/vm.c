@@ -0,0 +1,310 @@
+#include "vm.h"
+#include "printk.h"
+#include "lib.h"
+#include "cpu.h"
+#include "init.h"
+
+#define PD_INDEX(addr)      ((addr) >> 22)
+#define PT_INDEX(addr)      (((addr) >> PAGE_SHIFT) & 0x3FF)
+#define USER_PDE_FIRST      PD_INDEX(USER_BASE)
+#define USER_PDE_END        PD_INDEX(USER_TOP)
+
+#define CR0_WP              (1u << 16)      /* Ring 0 honours read-only pages too */
+#define CR0_PG              (1u << 31)
+#define CR4_PSE             (1u << 4)
+
+static uint32_t kernel_pd[1024] __attribute__((aligned(PAGE_SIZE)));
+static struct vm_space spaces[VM_SPACES_MAX];
+static struct vm_space *current;
+static int paging_on;
+
+static inline void write_cr3(uint32_t pd) {
+    __asm__ volatile ("mov %0, %%cr3" : : "r"(pd) : "memory");
+}
+
+static inline void invlpg(uint32_t addr) {
+    __asm__ volatile ("invlpg (%0)" : : "r"(addr) : "memory");
+}
+
+/* After dropping permissions in a whole page directory */
+static void flush_tlb(struct vm_space *space) {
+    if (space == current) write_cr3((uint32_t)space->pd);
+}
+
+int vm_init(void) {
+    uint32_t a, b, c, d, cr;
+
+    cpuid(1, &a, &b, &c, &d);
+    if (!(d & CPUID_EDX_PSE)) {
+        printk(KERN_ERR "vm: no 4 MB page support, paging stays off\n");
+        return -1;
+    }
+
+    for (uint32_t i = 0; i < 1024; i++) {
+        uint32_t addr = i << 22;
+
+        if (i >= USER_PDE_FIRST && i < USER_PDE_END) {
+            kernel_pd[i] = 0;
+        } else {
+            kernel_pd[i] = addr | PTE_PRESENT | PTE_WRITE | PTE_LARGE |
+                           (addr < USER_BASE ? PTE_USER : 0);
+        }
+    }
+
+    __asm__ volatile ("mov %%cr4, %0" : "=r"(cr));
+    __asm__ volatile ("mov %0, %%cr4" : : "r"(cr | CR4_PSE));
+    write_cr3((uint32_t)kernel_pd);
+    __asm__ volatile ("mov %%cr0, %0" : "=r"(cr));
+    __asm__ volatile ("mov %0, %%cr0" : : "r"(cr | CR0_PG | CR0_WP) : "memory");
+    paging_on = 1;
+    return 0;
+}
+
+int vm_enabled(void) {
+    return paging_on;
+}
+
+struct vm_space *vm_create(void) {
+    struct vm_space *space = NULL;
+
+    if (!paging_on) return NULL;
+    for (uint32_t i = 0; i < VM_SPACES_MAX && !space; i++) {
+        if (!spaces[i].pd) space = &spaces[i];
+    }
+    if (!space) return NULL;
+
+    uint32_t pd = pmm_alloc();
+    if (!pd) return NULL;
+
+    /* Kernel half shared by value; the low identity map is supervisor only */
+    memset(space, 0, sizeof(*space));
+    space->pd = (uint32_t *)pd;
+    for (uint32_t i = 0; i < 1024; i++) space->pd[i] = kernel_pd[i] & ~PTE_USER;
+    return space;
+}
+
+struct vm_space *vm_clone(struct vm_space *space) {
+    struct vm_space *child = vm_create();
+
+    if (!child) return NULL;
+    memcpy(child->areas, space->areas, sizeof(space->areas));
+    child->areas_count = space->areas_count;
+    child->resident = space->resident;
+
+    /* Share every page table read-only; no entry inside is touched */
+    for (uint32_t i = USER_PDE_FIRST; i < USER_PDE_END; i++) {
+        if (!(space->pd[i] & PTE_PRESENT)) continue;
+        space->pd[i] &= ~PTE_WRITE;
+        child->pd[i] = space->pd[i];
+        pmm_get(space->pd[i] & PTE_FRAME);
+    }
+    flush_tlb(space);
+    return child;
+}
+
+void vm_destroy(struct vm_space *space) {
+    if (current == space) vm_switch(NULL);
+
+    for (uint32_t i = USER_PDE_FIRST; i < USER_PDE_END; i++) {
+        if (!(space->pd[i] & PTE_PRESENT)) continue;
+
+        /* A table still shared with another space keeps its frames */
+        uint32_t *pt = (uint32_t *)(space->pd[i] & PTE_FRAME);
+        if (pmm_refcount((uint32_t)pt) == 1) {
+            for (uint32_t j = 0; j < 1024; j++) {
+                if (pt[j] & PTE_PRESENT) pmm_put(pt[j] & PTE_FRAME);
+            }
+        }
+        pmm_put((uint32_t)pt);
+    }
+    pmm_put((uint32_t)space->pd);
+    space->pd = NULL;
+}
+
+int vm_add_area(struct vm_space *space, uint32_t start, uint32_t size, uint32_t flags,
+                const uint8_t *file, uint32_t file_size,
+                const uint8_t *image, uint32_t image_size) {
+    uint32_t first = start & PAGE_MASK;
+    uint32_t end = (start + size + PAGE_SIZE - 1) & PAGE_MASK;
+
+    if (space->areas_count == VM_AREAS_MAX || size == 0 || file_size > size) return -1;
+    if (start < USER_BASE || start >= USER_TOP || size > USER_TOP - start) return -1;
+    for (uint32_t i = 0; i < space->areas_count; i++) {
+        const struct vm_area *a = &space->areas[i];
+        if (first < a->end && end > a->start) return -1;
+    }
+
+    struct vm_area *a = &space->areas[space->areas_count++];
+    a->start = first;
+    a->end = end;
+    a->flags = flags;
+    a->file_start = start;
+    a->file_end = file ? start + file_size : start;
+    a->mem_end = start + size;
+    a->file = file;
+    a->image = image;
+    a->image_size = image_size;
+    return 0;
+}
+
+void vm_switch(struct vm_space *space) {
+    if (!paging_on || space == current) return;
+
+    current = space;
+    write_cr3(space ? (uint32_t)space->pd : (uint32_t)kernel_pd);
+}
+
+struct vm_space *vm_current(void) {
+    return current;
+}
+
+static struct vm_area *find_area(struct vm_space *space, uint32_t addr) {
+    for (uint32_t i = 0; i < space->areas_count; i++) {
+        struct vm_area *a = &space->areas[i];
+        if (addr >= a->start && addr < a->end) return a;
+    }
+    return NULL;
+}
+
+/* Make the page table at pde writable for space alone: copy it if
+ * another space still shares it (see vm.h) */
+static int unshare_table(struct vm_space *space, uint32_t *pde) {
+    uint32_t old = *pde & PTE_FRAME;
+
+    if (pmm_refcount(old) > 1) {
+        uint32_t copy = pmm_alloc();
+        if (!copy) return -1;
+
+        uint32_t *src = (uint32_t *)old, *dst = (uint32_t *)copy;
+        for (uint32_t j = 0; j < 1024; j++) {
+            uint32_t e = src[j];
+            if (e & PTE_PRESENT) {
+                if (e & PTE_WRITE) e = (e & ~PTE_WRITE) | PTE_COW;
+                src[j] = e;
+                pmm_get(e & PTE_FRAME);
+            }
+            dst[j] = e;
+        }
+        pmm_put(old);
+        *pde = copy;
+        space->tables++;
+        space->cow++;
+    }
+    *pde = (*pde & PTE_FRAME) | PTE_PRESENT | PTE_WRITE | PTE_USER;
+    flush_tlb(space);
+    return 0;
+}
+
+/* Page table entry for addr, allocating the table or taking a private
+ * copy of a shared one; NULL when out of memory */
+static uint32_t *pte_of(struct vm_space *space, uint32_t addr) {
+    uint32_t *pde = &space->pd[PD_INDEX(addr)];
+
+    if (!(*pde & PTE_PRESENT)) {
+        uint32_t pt = pmm_alloc();
+        if (!pt) return NULL;
+        memset((void *)pt, 0, PAGE_SIZE);
+        *pde = pt | PTE_PRESENT | PTE_WRITE | PTE_USER;
+        space->tables++;
+    } else if (!(*pde & PTE_WRITE) && unshare_table(space, pde) < 0) {
+        return NULL;
+    }
+    return (uint32_t *)(*pde & PTE_FRAME) + PT_INDEX(addr);
+}
+
+/* Image page to map in place for page, or 0 if the page needs a frame:
+ * the area must be read-only, the bytes page aligned inside the image,
+ * and nothing in the page may need zeroing */
+static uint32_t direct_page(const struct vm_area *a, uint32_t page) {
+    uint32_t src = (uint32_t)a->file + (page - a->file_start);
+    uint32_t image = (uint32_t)a->image;
+
+    if ((a->flags & VM_WRITE) || (src & ~PAGE_MASK)) return 0;
+    if (src < image || src + PAGE_SIZE > image + a->image_size) return 0;
+    if (page + PAGE_SIZE > a->file_end && a->file_end != a->mem_end) return 0;
+    return src;
+}
+
+/* Map the page holding addr: in place, copied or zeroed (see vm.h) */
+static int fill_page(struct vm_space *space, const struct vm_area *a, uint32_t addr) {
+    uint32_t page = addr & PAGE_MASK;
+    uint32_t *pte = pte_of(space, page);
+    uint32_t prot = PTE_PRESENT | PTE_USER | ((a->flags & VM_WRITE) ? PTE_WRITE : 0);
+
+    if (!pte) return -1;
+
+    int has_file = page < a->file_end && page + PAGE_SIZE > a->file_start;
+    uint32_t frame = has_file ? direct_page(a, page) : 0;
+    if (frame) {
+        space->direct++;
+    } else {
+        frame = pmm_alloc();
+        if (!frame) return -1;
+        memset((void *)frame, 0, PAGE_SIZE);
+        if (has_file) {
+            uint32_t from = page > a->file_start ? page : a->file_start;
+            uint32_t to = page + PAGE_SIZE < a->file_end ? page + PAGE_SIZE : a->file_end;
+            memcpy((uint8_t *)frame + (from - page), a->file + (from - a->file_start), to - from);
+            space->copied++;
+        } else {
+            space->zeroed++;
+        }
+    }
+
+    *pte = frame | prot;
+    space->resident++;
+    return 0;
+}
+
+/* Write to a present page: a shared table or a copy-on-write frame */
+static int break_cow(struct vm_space *space, uint32_t addr) {
+    uint32_t *pte = pte_of(space, addr);
+
+    if (!pte || !(*pte & PTE_PRESENT)) return -1;
+    if (*pte & PTE_WRITE) return 0;             /* Only the table was shared */
+    if (!(*pte & PTE_COW)) return -1;
+
+    uint32_t frame = *pte & PTE_FRAME;
+    if (pmm_refcount(frame) > 1) {
+        uint32_t copy = pmm_alloc();
+        if (!copy) return -1;
+        memcpy((void *)copy, (const void *)frame, PAGE_SIZE);
+        pmm_put(frame);
+        frame = copy;
+        space->cow++;
+    }
+    *pte = frame | PTE_PRESENT | PTE_WRITE | PTE_USER;
+    invlpg(addr & PAGE_MASK);
+    return 0;
+}
+
+int vm_fault(uint32_t addr, uint32_t err) {
+    struct vm_space *space = current;
+
+    if (!space || addr < USER_BASE || addr >= USER_TOP) return -1;
+
+    const struct vm_area *a = find_area(space, addr);
+    if (!a) return -1;
+    if ((err & PF_WRITE) && !(a->flags & VM_WRITE)) return -1;
+
+    space->faults++;
+    if (err & PF_PRESENT) return (err & PF_WRITE) ? break_cow(space, addr) : -1;
+    return fill_page(space, a, addr);
+}
+
+int vm_user_range(uint32_t addr, uint32_t len) {
+    if (!current) return 1;                 /* Kernel space: ring 3 code built in */
+    return addr >= USER_BASE && addr < USER_TOP && len <= USER_TOP - addr;
+}
+
+void cmd_meminfo(int argc, char *argv[]) {
+    (void)argc;
+    (void)argv;
+
+    uint32_t total = pmm_total_frames(), free = pmm_free_frames();
+    printk("Paging:      %s\n", paging_on ? "on" : "off");
+    printk("Frames:      %u total, %u free, %u used (%u KB free)\n",
+           total, free, total - free, free * (PAGE_SIZE / 1024));
+    printk("Init memory: %u KB freed at boot\n", initmem_freed() / 1024);
+    printk("User window: 0x%08x-0x%08x\n", USER_BASE, USER_TOP);
+}
@@ -0,0 +1,124 @@
+#ifndef VM_H
+#define VM_H
+
+#include <stdint.h>
+#include "pmm.h"
+
+/*
+ * Paging and user address spaces.
+ *
+ * The kernel keeps running on an identity map of the whole 4 GB made of
+ * 4 MB pages, so RAM, the modules, the GDT and every MMIO BAR stay where
+ * the drivers expect them (memory types still come from the firmware's
+ * MTRRs).  The one hole is the user window [USER_BASE, USER_TOP), which
+ * each address space fills with 4 KB pages.
+ *
+ * An address space is a page directory plus a few areas.  Adding an
+ * area maps nothing; the #PF handler fills one page at a time on first
+ * touch:
+ *
+ *   - read-only file pages whose bytes sit page aligned in the image
+ *     (Multiboot modules are page aligned) map the image page itself
+ *   - other file pages get a frame copied from the image
+ *   - pages past the file bytes (.bss, the stack) get a zeroed frame
+ *
+ * vm_clone() copies an address space in time independent of its size:
+ * the child's page directory points at the parent's page tables, and
+ * both directories lose write permission on them.  The first write
+ * through a shared table gives the writer its own copy of that table;
+ * the frames it maps gain a reference and become copy-on-write
+ * (PTE_COW) in both tables.  The first write to such a page copies it,
+ * or just makes it writable again once the writer holds the only
+ * reference.  Page tables and frames are refcounted in pmm.c.
+ *
+ * The kernel's own address space marks the low identity map user
+ * accessible for the ring 3 code built into the kernel (usertest, bench
+ * syscall); other address spaces see only the user window from ring 3.
+ */
+
+#define USER_BASE       PMM_LIMIT           /* 0x08000000, above all usable RAM */
+#define USER_TOP        0x40000000
+#define USER_STACK_TOP  USER_TOP
+#define USER_STACK_SIZE (256 * 1024)        /* Reserved; filled on demand */
+
+/* Page directory / table entry bits */
+#define PTE_PRESENT     0x001
+#define PTE_WRITE       0x002
+#define PTE_USER        0x004
+#define PTE_LARGE       0x080               /* 4 MB page (PDE) */
+#define PTE_COW         0x200               /* Writable once the frame is private */
+#define PTE_FRAME       PAGE_MASK
+
+/* #PF error code bits */
+#define PF_PRESENT      0x1                 /* Protection fault, not a missing page */
+#define PF_WRITE        0x2
+#define PF_USER         0x4
+
+/* vm_area.flags */
+#define VM_READ         0x1
+#define VM_WRITE        0x2
+#define VM_EXEC         0x4
+
+#define VM_AREAS_MAX    8
+#define VM_SPACES_MAX   16
+
+struct vm_area {
+    uint32_t start, end;                    /* Virtual range, rounded to pages */
+    uint32_t flags;                         /* VM_* */
+    uint32_t file_start, file_end;          /* Part backed by file bytes; empty if none */
+    uint32_t mem_end;                       /* Exact end of the area's contents */
+    const uint8_t *file;                    /* Byte shown at file_start */
+    const uint8_t *image;                   /* Whole image: only pages inside it */
+    uint32_t image_size;                    /* are mapped in place */
+};
+
+struct vm_space {
+    uint32_t *pd;                           /* Page directory (identity mapped frame) */
+    struct vm_area areas[VM_AREAS_MAX];
+    uint32_t areas_count;
+    uint32_t resident;                      /* User pages mapped ... */
+    uint32_t direct;                        /* ... of which image pages mapped in place */
+    uint32_t copied;                        /* ... filled from the image */
+    uint32_t zeroed;                        /* ... zero-filled */
+    uint32_t tables;                        /* Page tables allocated */
+    uint32_t cow;                           /* Pages and tables copied on write */
+    uint32_t faults;                        /* Faults handled */
+};
+
+/* Build the kernel page directory and turn paging on; after pmm_init().
+ * Returns -1 (and leaves paging off) without 4 MB page support. */
+int vm_init(void);
+
+/* 1 once paging is on */
+int vm_enabled(void);
+
+/* New address space with an empty user window; NULL when out of memory */
+struct vm_space *vm_create(void);
+
+/* Copy-on-write copy of space (areas included); NULL when out of memory */
+struct vm_space *vm_clone(struct vm_space *space);
+
+/* Free the space's pages (switching away first if it is current) */
+void vm_destroy(struct vm_space *space);
+
+/* Add an area ([start, start + size) holding size bytes of which the
+ * first file_size come from file); nothing is mapped yet.  -1 if it
+ * leaves the user window, overlaps another area or there is no room. */
+int vm_add_area(struct vm_space *space, uint32_t start, uint32_t size, uint32_t flags,
+                const uint8_t *file, uint32_t file_size,
+                const uint8_t *image, uint32_t image_size);
+
+/* Load the space's page directory; NULL for the kernel's */
+void vm_switch(struct vm_space *space);
+struct vm_space *vm_current(void);
+
+/* #PF handler: 0 if the fault at addr was resolved */
+int vm_fault(uint32_t addr, uint32_t err);
+
+/* 1 if ring 3 may pass [addr, addr + len) to a system call */
+int vm_user_range(uint32_t addr, uint32_t len);
+
+/* Shell command: meminfo */
+void cmd_meminfo(int argc, char *argv[]);
+
+#endif /* VM_H */
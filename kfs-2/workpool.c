@@ -0,0 +1,132 @@
+#include "workpool.h"
+
+#define WSDEQUE_MASK    (WSDEQUE_SIZE - 1)
+
+#define LOAD(p, order)          __atomic_load_n(p, order)
+#define STORE(p, v, order)      __atomic_store_n(p, v, order)
+#define FENCE(order)            __atomic_thread_fence(order)
+
+static inline void cpu_relax(void) {
+#if defined(__i386__) || defined(__x86_64__)
+    __builtin_ia32_pause();
+#endif
+}
+
+/* Slot words are copied one atomic word at a time; see workpool.h */
+static void slot_read(const struct pfor_task *slot, struct pfor_task *task) {
+    task->job = LOAD(&slot->job, __ATOMIC_RELAXED);
+    task->begin = LOAD(&slot->begin, __ATOMIC_RELAXED);
+    task->end = LOAD(&slot->end, __ATOMIC_RELAXED);
+}
+
+static void slot_write(struct pfor_task *slot, const struct pfor_task *task) {
+    STORE(&slot->job, task->job, __ATOMIC_RELAXED);
+    STORE(&slot->begin, task->begin, __ATOMIC_RELAXED);
+    STORE(&slot->end, task->end, __ATOMIC_RELAXED);
+}
+
+void wsdeque_init(struct wsdeque *d) {
+    d->top = 0;
+    d->bottom = 0;
+}
+
+int wsdeque_push(struct wsdeque *d, const struct pfor_task *task) {
+    uint32_t b = LOAD(&d->bottom, __ATOMIC_RELAXED);
+    uint32_t t = LOAD(&d->top, __ATOMIC_ACQUIRE);
+
+    if (b - t >= WSDEQUE_SIZE) return -1;
+    slot_write(&d->slots[b & WSDEQUE_MASK], task);
+    FENCE(__ATOMIC_RELEASE);
+    STORE(&d->bottom, b + 1, __ATOMIC_RELAXED);
+    return 0;
+}
+
+int wsdeque_pop(struct wsdeque *d, struct pfor_task *task) {
+    uint32_t b = LOAD(&d->bottom, __ATOMIC_RELAXED) - 1;
+
+    STORE(&d->bottom, b, __ATOMIC_RELAXED);
+    FENCE(__ATOMIC_SEQ_CST);
+    uint32_t t = LOAD(&d->top, __ATOMIC_RELAXED);
+
+    if ((int32_t)(b - t) < 0) {                 /* Empty */
+        STORE(&d->bottom, b + 1, __ATOMIC_RELAXED);
+        return 0;
+    }
+    slot_read(&d->slots[b & WSDEQUE_MASK], task);
+    if (b != t) return 1;
+
+    /* Last task: race the thieves for it */
+    int won = __atomic_compare_exchange_n(&d->top, &t, t + 1, 0,
+                                          __ATOMIC_SEQ_CST, __ATOMIC_RELAXED);
+    STORE(&d->bottom, b + 1, __ATOMIC_RELAXED);
+    return won;
+}
+
+int wsdeque_steal(struct wsdeque *d, struct pfor_task *task) {
+    uint32_t t = LOAD(&d->top, __ATOMIC_ACQUIRE);
+    FENCE(__ATOMIC_SEQ_CST);
+    uint32_t b = LOAD(&d->bottom, __ATOMIC_ACQUIRE);
+
+    if ((int32_t)(b - t) <= 0) return 0;
+    slot_read(&d->slots[t & WSDEQUE_MASK], task);
+    return __atomic_compare_exchange_n(&d->top, &t, t + 1, 0,
+                                       __ATOMIC_SEQ_CST, __ATOMIC_RELAXED);
+}
+
+void workpool_init(struct workpool *p, uint32_t workers) {
+    if (workers == 0) workers = 1;
+    if (workers > WORKPOOL_MAX_WORKERS) workers = WORKPOOL_MAX_WORKERS;
+
+    p->workers = workers;
+    for (uint32_t i = 0; i < WORKPOOL_MAX_WORKERS; i++) {
+        wsdeque_init(&p->deques[i]);
+        p->stats[i].tasks = p->stats[i].steals = p->stats[i].overflows = 0;
+    }
+}
+
+/* Split task down to the grain, leaving upper halves to be stolen, and
+ * run what is left */
+static void run_task(struct workpool *p, uint32_t self, struct pfor_task task) {
+    struct pfor_job *job = task.job;
+
+    while (task.end - task.begin > job->grain) {
+        struct pfor_task upper = { job, task.begin + (task.end - task.begin) / 2, task.end };
+        if (wsdeque_push(&p->deques[self], &upper) < 0) {
+            p->stats[self].overflows++;
+            break;
+        }
+        task.end = upper.begin;
+    }
+    job->fn(task.begin, task.end, job->arg);
+    p->stats[self].tasks++;
+    __atomic_fetch_sub(&job->remaining, task.end - task.begin, __ATOMIC_RELEASE);
+}
+
+int workpool_help(struct workpool *p, uint32_t self) {
+    struct pfor_task task;
+
+    if (wsdeque_pop(&p->deques[self], &task)) {
+        run_task(p, self, task);
+        return 1;
+    }
+    for (uint32_t i = 1; i < p->workers; i++) {
+        uint32_t victim = (self + i) % p->workers;
+        if (wsdeque_steal(&p->deques[victim], &task)) {
+            p->stats[self].steals++;
+            run_task(p, self, task);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+void parallel_for_on(struct workpool *p, uint32_t self, uint32_t begin, uint32_t end,
+                     uint32_t grain, pfor_fn fn, void *arg) {
+    struct pfor_job job = { fn, arg, grain ? grain : 1, end - begin };
+
+    if (end <= begin) return;
+    run_task(p, self, (struct pfor_task){ &job, begin, end });
+    while (LOAD(&job.remaining, __ATOMIC_ACQUIRE)) {
+        if (!workpool_help(p, self)) cpu_relax();
+    }
+}
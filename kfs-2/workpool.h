@@ -0,0 +1,94 @@
+#ifndef WORKPOOL_H
+#define WORKPOOL_H
+
+#include <stdint.h>
+
+/*
+ * Work-stealing pool for data-parallel kernel jobs.
+ *
+ * There is one worker per CPU, each owning a Chase-Lev deque: the owner
+ * pushes and pops tasks at the bottom without locking, idle workers
+ * steal from the top with a single compare-and-swap.  A task is a slice
+ * [begin, end) of a parallel_for() range, stored by value, so nothing is
+ * allocated.  Running a task splits it in halves down to the grain,
+ * pushing the upper halves for others to steal, so work spreads out in
+ * O(log n) steps and a worker mostly runs the cache-warm lower halves
+ * itself.  The caller of parallel_for() works on its own job and then
+ * helps (pops or steals, from any job) until all of its range is done.
+ *
+ * Deques are fixed size; when one is full the task is run without
+ * splitting further.  A slot the owner may overwrite is only ever read
+ * by a thief whose compare-and-swap then fails, so torn reads are
+ * discarded.
+ *
+ * Portable: also built into the host tests and benchmarks, where
+ * threads stand in for CPUs.
+ */
+
+#define WORKPOOL_MAX_WORKERS    8
+#define WSDEQUE_SIZE            256         /* Tasks per deque, power of two */
+
+typedef void (*pfor_fn)(uint32_t begin, uint32_t end, void *arg);
+
+struct pfor_job {
+    pfor_fn fn;
+    void *arg;
+    uint32_t grain;
+    uint32_t remaining;                     /* Iterations not yet run */
+};
+
+struct pfor_task {
+    struct pfor_job *job;
+    uint32_t begin, end;
+};
+
+struct wsdeque {
+    uint32_t top;                           /* Thieves take from here */
+    char pad[60];                           /* Keep top and bottom on separate lines */
+    uint32_t bottom;                        /* Owner pushes and pops here */
+    struct pfor_task slots[WSDEQUE_SIZE];
+} __attribute__((aligned(64)));
+
+struct workpool_stats {
+    uint32_t tasks;                         /* Slices run */
+    uint32_t steals;                        /* Slices taken from another worker */
+    uint32_t overflows;                     /* Splits refused by a full deque */
+};
+
+struct workpool {
+    uint32_t workers;
+    struct wsdeque deques[WORKPOOL_MAX_WORKERS];
+    struct workpool_stats stats[WORKPOOL_MAX_WORKERS];
+};
+
+/* Chase-Lev deque operations; pop and push are for the owner only.
+ * Pop and steal return 1 and fill *task, or 0 if empty (steal: or lost
+ * a race). */
+void wsdeque_init(struct wsdeque *d);
+int wsdeque_push(struct wsdeque *d, const struct pfor_task *task);
+int wsdeque_pop(struct wsdeque *d, struct pfor_task *task);
+int wsdeque_steal(struct wsdeque *d, struct pfor_task *task);
+
+void workpool_init(struct workpool *p, uint32_t workers);
+
+/* Run one task as worker self: its own newest, else one stolen.
+ * Returns 0 if there was none (idle workers loop on this). */
+int workpool_help(struct workpool *p, uint32_t self);
+
+/* Call fn on slices of [begin, end) no larger than grain, spread over
+ * the pool, as worker self; returns once every slice has run */
+void parallel_for_on(struct workpool *p, uint32_t self, uint32_t begin, uint32_t end,
+                     uint32_t grain, pfor_fn fn, void *arg);
+
+/* Kernel side (workpool_cmd.c): a pool with one worker per CPU */
+
+/* parallel_for_on() the kernel pool as the current CPU */
+void parallel_for(uint32_t begin, uint32_t end, uint32_t grain, pfor_fn fn, void *arg);
+
+/* Shell command: workpool (per-worker statistics) */
+void cmd_workpool(int argc, char *argv[]);
+
+/* Benchmark: memory- and compute-bound parallel_for throughput */
+void bench_workpool(void);
+
+#endif /* WORKPOOL_H */
@@ -0,0 +1,109 @@
+#include "workpool.h"
+#include "printk.h"
+#include "printf.h"
+#include "bench.h"
+#include "lib.h"
+#include "tsc.h"
+#include "div64.h"
+#include "cpu.h"
+#include "pmm.h"
+
+#define BENCH_FRAMES        1024        /* 4 MB of free frames */
+#define BENCH_GRAIN         8           /* Frames per slice */
+#define BENCH_TASKS         4096        /* Empty slices for the dispatch cost */
+
+static struct workpool kpool;
+
+static struct workpool *kernel_pool(void) {
+    if (!kpool.workers) workpool_init(&kpool, NR_CPUS);
+    return &kpool;
+}
+
+void parallel_for(uint32_t begin, uint32_t end, uint32_t grain, pfor_fn fn, void *arg) {
+    parallel_for_on(kernel_pool(), smp_processor_id(), begin, end, grain, fn, arg);
+}
+
+/* workpool: workers and what each has run */
+void cmd_workpool(int argc, char *argv[]) {
+    (void)argc;
+    (void)argv;
+
+    struct workpool *p = kernel_pool();
+    printk("Workers: %u (one per CPU), deques of %u tasks\n", p->workers, WSDEQUE_SIZE);
+    for (uint32_t i = 0; i < p->workers; i++) {
+        printk("  cpu%u: %u tasks, %u stolen, %u unsplit (deque full)\n",
+               i, p->stats[i].tasks, p->stats[i].steals, p->stats[i].overflows);
+    }
+}
+
+/* ------------------------------------------------------------ benchmark */
+
+static uint32_t bench_frames[BENCH_FRAMES];
+static volatile uint32_t bench_crcs[BENCH_FRAMES];   /* Volatile: nothing reads them */
+
+/* Memory-bound: clear frames, as freeing them in bulk would */
+static void zero_frames(uint32_t begin, uint32_t end, void *arg) {
+    (void)arg;
+    for (uint32_t i = begin; i < end; i++) memset((void *)bench_frames[i], 0, PAGE_SIZE);
+}
+
+/* Compute-bound: bitwise CRC-32 of each frame */
+static void crc_frames(uint32_t begin, uint32_t end, void *arg) {
+    (void)arg;
+    for (uint32_t i = begin; i < end; i++) {
+        const uint8_t *p = (const uint8_t *)bench_frames[i];
+        uint32_t crc = 0xFFFFFFFF;
+        for (uint32_t j = 0; j < PAGE_SIZE; j++) {
+            crc ^= p[j];
+            for (int k = 0; k < 8; k++) crc = (crc >> 1) ^ (0xEDB88320 & -(crc & 1));
+        }
+        bench_crcs[i] = ~crc;
+    }
+}
+
+static void empty_slice(uint32_t begin, uint32_t end, void *arg) {
+    (void)begin;
+    (void)end;
+    (void)arg;
+}
+
+/* MB/s for n frames processed in cycles */
+static uint32_t frames_rate(uint32_t n, uint64_t cycles) {
+    uint32_t us = tsc_cycles_to_us(cycles);
+    return us ? (uint32_t)div64_u32((uint64_t)n * PAGE_SIZE, us, NULL) : 0;
+}
+
+/* Serial loop vs parallel_for on the CPUs there are (one until APs are
+ * brought up; host-bench shows the scaling with threads as workers) */
+void bench_workpool(void) {
+    char name[32];
+    uint32_t n = 0;
+    uint64_t start;
+
+    tsc_calibrate();
+    while (n < BENCH_FRAMES && (bench_frames[n] = pmm_alloc()) != 0) n++;
+    if (n == 0) return;
+
+    struct {
+        const char *job;
+        pfor_fn fn;
+    } jobs[] = { { "zero", zero_frames }, { "crc", crc_frames } };
+
+    for (uint32_t j = 0; j < sizeof(jobs) / sizeof(jobs[0]); j++) {
+        start = rdtsc();
+        jobs[j].fn(0, n, NULL);
+        snprintf(name, sizeof(name), "workpool_%s_serial", jobs[j].job);
+        bench_report(name, frames_rate(n, rdtsc() - start), "MB/s");
+
+        start = rdtsc();
+        parallel_for(0, n, BENCH_GRAIN, jobs[j].fn, NULL);
+        snprintf(name, sizeof(name), "workpool_%s_%ucpu", jobs[j].job, kernel_pool()->workers);
+        bench_report(name, frames_rate(n, rdtsc() - start), "MB/s");
+    }
+
+    start = rdtsc();
+    parallel_for(0, BENCH_TASKS, 1, empty_slice, NULL);
+    bench_report("workpool_task", (uint32_t)div64_u32(rdtsc() - start, BENCH_TASKS, NULL), "cycles");
+
+    while (n) pmm_put(bench_frames[--n]);
+}